@@ -39,12 +39,6 @@ const char* const Dht11::VERSION = "0.5";
 
 // Various named constants.
 enum {
-    /*
-     * Time required to signal the DHT11 to switch from low power mode to
-     * running mode.  18 ms is the minimal, add a few extra ms to be safe.
-     */
-    START_SIGNAL_WAIT = 20,
-
     /*
      * Once the start signal has been sent, we wait for a response.  The doc
      * says this should take 20-40 us, we wait 5 ms to be safe.
@@ -96,14 +90,22 @@ enum {
 };
 
 Dht11::ReadStatus Dht11::read() {
-    uint8_t    buffer[RESPONSE_SIZE] = { 0 };
-    uint8_t    bitIndex              = BYTE_MS_BIT;
-    ReadStatus status                = OK;
+    this->startRead();
+    delay(START_SIGNAL_TIME);
 
+    return this->completeRead();
+}
+
+void Dht11::startRead() {
     // Request sample
     pinMode(this->pin, OUTPUT);
     digitalWrite(this->pin, LOW);
-    delay(START_SIGNAL_WAIT);
+}
+
+Dht11::ReadStatus Dht11::completeRead() {
+    uint8_t    buffer[RESPONSE_SIZE] = { 0 };
+    uint8_t    bitIndex              = BYTE_MS_BIT;
+    ReadStatus status                = OK;
 
     // Wait for response
     digitalWrite(this->pin, HIGH);
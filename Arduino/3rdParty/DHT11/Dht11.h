@@ -88,6 +88,30 @@ public:
      */
     ReadStatus read();
 
+    /*
+     * startRead
+     *
+     * Non-blocking alternative to read(): sends the start signal (pulls the
+     * data pin low). Call completeRead() once START_SIGNAL_TIME ms have passed.
+     */
+    void startRead();
+
+    /*
+     * completeRead
+     *
+     * Reads the response to the start signal sent by startRead(). Blocks
+     * while the sensor transmits (about 5 ms). Returns the same status as
+     * read().
+     */
+    ReadStatus completeRead();
+
+    /*
+     * Time (in ms) required to signal the DHT11 to switch from low power
+     * mode to running mode.  18 ms is the minimal, add a few extra ms to be
+     * safe.
+     */
+    static const unsigned long START_SIGNAL_TIME = 20;
+
     /*
      * getHumidity
      *
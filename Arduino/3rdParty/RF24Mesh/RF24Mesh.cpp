@@ -8,7 +8,11 @@
 #include <fstream>
 #endif
 
-RF24Mesh::RF24Mesh( RF24& _radio,RF24Network& _network ): radio(_radio),network(_network){}
+RF24Mesh::RF24Mesh( RF24& _radio,RF24Network& _network ): radio(_radio),network(_network){
+#if defined (MESH_ADDRESS_INDEX)
+  addrIndex = NULL;
+#endif
+}
 
 
 /*****************************************************/
@@ -30,6 +34,11 @@ bool RF24Mesh::begin(uint8_t channel, rf24_datarate_e data_rate, uint32_t timeou
     #if !defined (RF24_TINY) && !defined(MESH_NOMASTER)
 	addrList = (addrListStruct*)malloc(2 * sizeof(addrListStruct));
 	addrListTop = 0;
+	#if defined (MESH_ADDRESS_INDEX)
+	// Without the index, the address list is scanned.
+	if(!addrIndex){ addrIndex = (uint8_t*)calloc(MESH_MAX_ADDRESSES + 1, sizeof(uint8_t)); }
+	else{ memset(addrIndex, 0, MESH_MAX_ADDRESSES + 1); }
+	#endif
 	loadDHCP();
 	#endif
     mesh_address = 0;
@@ -41,6 +50,31 @@ bool RF24Mesh::begin(uint8_t channel, rf24_datarate_e data_rate, uint32_t timeou
 
 /*****************************************************/
 
+bool RF24Mesh::rejoin(uint16_t address, uint8_t channel, rf24_datarate_e data_rate){
+
+  if(!getNodeID() || !address || address == MESH_DEFAULT_ADDRESS){ return 0; }
+  
+  radio.begin();
+  radio_channel = channel;
+  radio.setChannel(radio_channel);
+  radio.setDataRate(data_rate);  
+  network.returnSysMsgs = 1;
+  
+  mesh_address = address;
+  network.begin(mesh_address);
+  
+  // The master keeps an address reserved for its nodeID until released, so a matching lookup means the address is still ours.
+  if(getAddress(getNodeID()) == (int16_t)address){
+    return 1;
+  }
+  
+  network.begin(MESH_DEFAULT_ADDRESS);
+  mesh_address = MESH_DEFAULT_ADDRESS;
+  return 0;
+}
+
+/*****************************************************/
+
 uint8_t RF24Mesh::update(){
 
     
@@ -163,12 +197,9 @@ int16_t RF24Mesh::getAddress(uint8_t nodeID){
 //#if defined (ARDUINO_SAM_DUE) || defined (__linux)
 #if !defined RF24_TINY && !defined(MESH_NOMASTER)
 	if(!getNodeID()){ //Master Node
-		uint16_t address = 0;
-		for(uint8_t i=0; i<addrListTop; i++){
-			if(addrList[i].nodeID == nodeID){
-				address = addrList[i].address;
-				return address;
-			}
+		uint8_t position = findPosition(nodeID);
+		if(position < addrListTop){
+			return addrList[position].address;
 		}
         return -1;
 	}
@@ -442,19 +473,16 @@ void RF24Mesh::setStaticAddress(uint8_t nodeID, uint16_t address){
 
 void RF24Mesh::setAddress(uint8_t nodeID, uint16_t address){
   
-  uint8_t position = addrListTop;
+  uint8_t position = findPosition(nodeID);
   
-  for(uint8_t i=0; i<addrListTop; i++){
-      if( addrList[i].nodeID == nodeID){
-          position = i;
-          break;
-      }
-  }
   addrList[position].nodeID = nodeID;
   addrList[position].address = address;
   
   if(position == addrListTop){
       ++addrListTop;  
+      #if defined (MESH_ADDRESS_INDEX)
+      if(addrIndex){ addrIndex[nodeID] = addrListTop; }
+      #endif
       addrList = (addrListStruct*)realloc(addrList,(addrListTop + 1) * sizeof(addrListStruct));
   }
   
@@ -469,6 +497,23 @@ void RF24Mesh::setAddress(uint8_t nodeID, uint16_t address){
 
 /*****************************************************/
 
+uint8_t RF24Mesh::findPosition(uint8_t nodeID){
+
+#if defined (MESH_ADDRESS_INDEX)
+  if(addrIndex){
+    return addrIndex[nodeID] ? addrIndex[nodeID] - 1 : addrListTop;
+  }
+#endif
+  for(uint8_t i=0; i<addrListTop; i++){
+    if(addrList[i].nodeID == nodeID){
+      return i;
+    }
+  }
+  return addrListTop;
+}
+
+/*****************************************************/
+
 void RF24Mesh::loadDHCP(){
 	
 #if defined (__linux) && !defined(__ARDUINO_X86__)
@@ -487,7 +532,9 @@ void RF24Mesh::loadDHCP(){
 	addrListTop = length/sizeof(addrListStruct);
 	for(int i=0; i<addrListTop; i++){
 		infile.read( (char*)&addrList[i],sizeof(addrListStruct));
-	
+		#if defined (MESH_ADDRESS_INDEX)
+		if(addrIndex){ addrIndex[addrList[i].nodeID] = i + 1; }
+		#endif
 	}
 	infile.close();
 #endif	
@@ -95,6 +95,19 @@ public:
    */
   bool begin(uint8_t channel = MESH_DEFAULT_CHANNEL, rf24_datarate_e data_rate = RF24_1MBPS, uint32_t timeout=MESH_RENEWAL_TIMEOUT );
   
+  /**
+   * Non-master nodes only: Call this in setup() instead of begin() to rejoin the mesh using a previously assigned address,
+   * skipping the address request exchange. The parent is implied by the address.
+   *
+   * The master is asked for the address of this nodeID. The address is only used if the master still has it assigned to this node.
+   * @code if(!mesh.rejoin(savedAddress)){ mesh.begin(); } @endcode
+   * @param address The RF24Network address previously assigned to this node (see mesh_address)
+   * @param channel The radio channel (1-127) default:97
+   * @param data_rate The data rate (RF24_250KBPS,RF24_1MBPS,RF24_2MBPS) default:RF24_1MBPS
+   * @return True if the address was confirmed. Otherwise the node is left at MESH_DEFAULT_ADDRESS and begin() should be called.
+   */
+  bool rejoin(uint16_t address, uint8_t channel = MESH_DEFAULT_CHANNEL, rf24_datarate_e data_rate = RF24_1MBPS);
+  
   /**
    * Very similar to network.update(), it needs to be called regularly to keep the network
    * and the mesh going.
@@ -248,6 +261,9 @@ public:
   // Pointer used for dynamic memory allocation of address list
   addrListStruct *addrList;  /**< See the addrListStruct class reference */
   uint8_t addrListTop;       /**< The number of entries in the assigned address list */
+#if defined (MESH_ADDRESS_INDEX)
+  uint8_t *addrIndex;        /**< Master only: addrIndex[nodeID] is the position of the node in addrList + 1, or 0 if the node has no entry. NULL if not allocated */
+#endif
 #endif
 
   /**
@@ -273,6 +289,7 @@ public:
   uint32_t lastFileSave;
   uint8_t radio_channel;
   uint16_t lastID,lastAddress;
+  uint8_t findPosition(uint8_t nodeID); /**< The position of the nodeID in addrList, or addrListTop if it has no entry */
 
  };
  
@@ -22,6 +22,9 @@
 #define MESH_MIN_SAVE_TIME 30000 /** Minimum time required before changing nodeID. Prevents excessive writing to EEPROM */
 #define MESH_DEFAULT_ADDRESS 04444
 #define MESH_MAX_ADDRESSES 255 /** Determines the max size of the array used for storing addresses on the Master Node */
+#if !defined (__AVR__)
+  #define MESH_ADDRESS_INDEX /** The Master Node looks up addresses through a nodeID index (MESH_MAX_ADDRESSES + 1 bytes of RAM) instead of scanning the address list */
+#endif
 //#define MESH_ADDRESS_HOLD_TIME 30000 /** How long before a released address becomes available */ 
 
   #if defined (MESH_DEBUG)
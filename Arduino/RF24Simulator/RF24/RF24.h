@@ -0,0 +1,123 @@
+/*
+ * Simulated nRF24L01(+) driver.
+ *
+ * Implements the parts of the RF24 interface used by RF24Network and RF24Mesh on top of a simulated radio medium shared by
+ * all RF24 instances in the process. Each instance is a virtual node (usually running in its own thread). The medium models
+ * airtime (from the data rate and payload size), auto-ack with retries, the 3 payload RX FIFO, random loss, propagation latency,
+ * range (positions) and collisions between overlapping transmissions heard by the same receiver.
+ */
+
+#ifndef __RF24_H__
+#define __RF24_H__
+
+#include "RF24_config.h"
+
+typedef enum { RF24_PA_MIN = 0,RF24_PA_LOW, RF24_PA_HIGH, RF24_PA_MAX, RF24_PA_ERROR } rf24_pa_dbm_e ;
+
+typedef enum { RF24_1MBPS = 0, RF24_2MBPS, RF24_250KBPS } rf24_datarate_e;
+
+typedef enum { RF24_CRC_DISABLED = 0, RF24_CRC_8, RF24_CRC_16 } rf24_crclength_e;
+
+// Medium wide counters.
+typedef struct {
+
+  uint32_t transmissions;   // Payloads sent (including retries).
+  uint32_t retries;         // Retransmissions caused by missing acks.
+  uint32_t failures;        // Writes that were never acknowledged.
+  uint32_t collisions;      // Receptions corrupted by overlapping transmissions.
+  uint32_t lost;            // Receptions dropped by the configured loss.
+  uint32_t fifoDrops;       // Receptions dropped because the receiver's RX FIFO was full.
+  uint64_t airtime;         // Total time (in µs) the medium was used.
+
+} RF24SimStatistics;
+
+// Configures the medium. Should be called before any radio is started.
+// loss: probability (0-1) that a single reception (or ack) is lost.
+// latency: extra delay (in µs) before a payload becomes available to the receiver.
+// range: the distance within which two radios hear each other (see RF24::setPosition). 0 means that all radios hear each other.
+void rf24SimConfigure(double loss, uint32_t latency, double range);
+
+// Returns the counters of the medium.
+RF24SimStatistics rf24SimStatistics();
+
+class RF24
+{
+public:
+
+  RF24(uint16_t _cepin = 0, uint16_t _cspin = 0);
+  ~RF24();
+
+  bool begin(void);
+  bool isValid() { return true; }
+
+  void startListening(void);
+  void stopListening(void);
+
+  bool available(void);
+  bool available(uint8_t* pipe_num);
+  void read(void* buf, uint8_t len);
+
+  bool write(const void* buf, uint8_t len);
+  bool write(const void* buf, uint8_t len, const bool multicast);
+  bool writeFast(const void* buf, uint8_t len);
+  bool writeFast(const void* buf, uint8_t len, const bool multicast);
+  bool txStandBy();
+  bool txStandBy(uint32_t timeout, bool startTx = 0);
+
+  void openWritingPipe(uint64_t address);
+  void openReadingPipe(uint8_t number, uint64_t address);
+  void closeReadingPipe(uint8_t pipe);
+
+  bool rxFifoFull();
+  bool testRPD(void) { return true; }
+  bool testCarrier(void) { return false; }
+
+  void powerDown(void);
+  void powerUp(void);
+  void printDetails(void) {}
+
+  void setAutoAck(bool enable);
+  void setAutoAck(uint8_t pipe, bool enable);
+  void enableDynamicPayloads(void) {}
+  void enableDynamicAck() {}
+  void enableAckPayload(void) {}
+  uint8_t getDynamicPayloadSize(void);
+  void setPayloadSize(uint8_t size) { (void) size; }
+
+  void setRetries(uint8_t delay, uint8_t count);
+  void setChannel(uint8_t channel);
+  uint8_t getChannel(void) { return channel; }
+  bool setDataRate(rf24_datarate_e speed);
+  rf24_datarate_e getDataRate(void) { return dataRate; }
+  void setPALevel(uint8_t level) { (void) level; }
+  void setCRCLength(rf24_crclength_e length) { (void) length; }
+
+  // Simulator only: the position of the radio used by the range model.
+  void setPosition(double x, double y);
+
+private:
+
+  friend class RF24Medium;
+
+  uint8_t channel;
+  rf24_datarate_e dataRate;
+  bool listening;
+  // Nothing is received while powered down, but the radio listens again once powered up (like the CE pin stays high).
+  bool poweredDown;
+  bool autoAck[6];
+  uint64_t readingPipes[6];
+  bool readingPipeOpen[6];
+  uint64_t writingPipe;
+  uint8_t retryDelay;
+  uint8_t retryCount;
+  double x, y;
+
+  // The result of the writes since the last txStandBy.
+  bool txOk;
+
+  // Receptions waiting to be read (owned by the medium).
+  void* rxFifo;
+
+};
+
+#endif // __RF24_H__
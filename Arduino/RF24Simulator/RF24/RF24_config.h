@@ -0,0 +1,45 @@
+/*
+ * Configuration used when RF24Network and RF24Mesh are built for Linux against the simulated radio (see ../RF24Sim.cpp).
+ * Replaces the configuration normally installed by the RF24 Linux build (<RF24/RF24_config.h>).
+ */
+
+#ifndef __RF24_CONFIG_H__
+#define __RF24_CONFIG_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define RF24_LINUX
+#define RF24_SIMULATOR
+
+#define rf24_max(a,b) (a>b?a:b)
+#define rf24_min(a,b) (a<b?a:b)
+
+#define _BV(x) (1<<(x))
+#define PSTR(x) (x)
+#define printf_P printf
+#define sprintf_P sprintf
+#define strlen_P strlen
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const unsigned char *)(addr))
+#define pgm_read_word(p) (*(p))
+
+#ifdef SERIAL_DEBUG
+  #define IF_SERIAL_DEBUG(x) ({x;})
+#else
+  #define IF_SERIAL_DEBUG(x)
+#endif
+
+typedef uint8_t byte;
+
+// Milliseconds since the simulation started.
+uint32_t millis(void);
+
+// Microseconds since the simulation started.
+uint32_t micros(void);
+
+void delay(uint32_t milliseconds);
+void delayMicroseconds(uint32_t microseconds);
+
+#endif // __RF24_CONFIG_H__
@@ -0,0 +1,278 @@
+/*
+ * Mesh throughput benchmark running RF24Network/RF24Mesh on the simulated radio medium.
+ *
+ * Every virtual node runs in its own thread. The master (node 0) assigns addresses and echoes every message it receives back to
+ * the sender. The slaves join the mesh and then send timestamped messages to the master at a fixed interval, measuring the round
+ * trip time of each echo.
+ *
+ * Usage: RF24Bench [-n nodes] [-l loss] [-t latency (µs)] [-d duration (s)] [-i interval (ms)] [-s size] [-line]
+ */
+
+#include "RF24/RF24.h"
+#include "RF24Network/RF24Network.h"
+#include "RF24Mesh/RF24Mesh.h"
+
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// The message type used by the benchmark.
+#define BENCH_MESSAGE_TYPE 'E'
+
+// The maximum size of a benchmark message (fragmented by RF24Network if larger than 24 bytes).
+#define BENCH_MAX_MESSAGE_SIZE 120
+
+// How long (in ms) a slave waits for an echo before the message is counted as lost.
+#define BENCH_ECHO_TIMEOUT 1000
+
+// The header of every benchmark message. The rest of the message is padding.
+typedef struct {
+
+  uint8_t nodeId;
+  uint32_t sequence;
+  uint32_t sentAt;
+
+} __attribute__((__packed__)) BenchMessage;
+
+typedef struct {
+
+  int nodes = 4;
+  double loss = 0;
+  uint32_t latency = 0;
+  uint32_t duration = 10;
+  uint32_t interval = 100;
+  uint8_t size = sizeof(BenchMessage);
+  bool line = false;
+
+} BenchOptions;
+
+static BenchOptions options;
+
+// Set once every slave has joined (or given up).
+static std::atomic<bool> running(true);
+static std::atomic<bool> measuring(false);
+
+static std::mutex resultMutex;
+static std::vector<uint32_t> roundTrips;
+static uint32_t sent = 0;
+static uint32_t writeFailures = 0;
+static uint32_t echoTimeouts = 0;
+static uint32_t joinFailures = 0;
+
+static void master() {
+
+  RF24 radio;
+  RF24Network network(radio);
+  RF24Mesh mesh(radio, network);
+
+  mesh.setNodeID(0);
+  mesh.begin();
+
+  uint8_t buffer[BENCH_MAX_MESSAGE_SIZE];
+
+  while (running) {
+
+    mesh.update();
+    mesh.DHCP();
+
+    while (network.available()) {
+
+      RF24NetworkHeader header;
+      uint16_t size = network.read(header, buffer, sizeof(buffer));
+
+      if (header.type != BENCH_MESSAGE_TYPE || size < sizeof(BenchMessage)) { continue; }
+
+      BenchMessage* message = (BenchMessage*) buffer;
+
+      mesh.write(buffer, BENCH_MESSAGE_TYPE, size, message->nodeId);
+
+    }
+
+    delayMicroseconds(200);
+
+  }
+
+}
+
+static void slave(uint8_t nodeId) {
+
+  RF24 radio;
+  RF24Network network(radio);
+  RF24Mesh mesh(radio, network);
+
+  // A line has each node in range of its neighbours only, forcing the messages to be routed.
+  if (options.line) { radio.setPosition(nodeId, 0); }
+
+  mesh.setNodeID(nodeId);
+
+  // Let the master start first.
+  delay(100 + nodeId * 50);
+
+  if (!mesh.begin(MESH_DEFAULT_CHANNEL, RF24_1MBPS, 15000)) {
+
+    std::lock_guard<std::mutex> lock(resultMutex);
+    joinFailures++;
+    return;
+
+  }
+
+  uint8_t buffer[BENCH_MAX_MESSAGE_SIZE];
+  uint32_t sequence = 0;
+  uint32_t lastSent = 0;
+  bool waiting = false;
+
+  while (running) {
+
+    mesh.update();
+
+    while (network.available()) {
+
+      RF24NetworkHeader header;
+      uint16_t size = network.read(header, buffer, sizeof(buffer));
+      BenchMessage* message = (BenchMessage*) buffer;
+
+      if (header.type != BENCH_MESSAGE_TYPE || size < sizeof(BenchMessage) || message->sequence != sequence) { continue; }
+
+      if (measuring) {
+
+        std::lock_guard<std::mutex> lock(resultMutex);
+        roundTrips.push_back(micros() - message->sentAt);
+
+      }
+
+      waiting = false;
+
+    }
+
+    if (waiting && millis() - lastSent > BENCH_ECHO_TIMEOUT) {
+
+      if (measuring) {
+
+        std::lock_guard<std::mutex> lock(resultMutex);
+        echoTimeouts++;
+
+      }
+
+      waiting = false;
+
+    }
+
+    if (!waiting && millis() - lastSent >= options.interval) {
+
+      memset(buffer, 0, sizeof(buffer));
+
+      BenchMessage* message = (BenchMessage*) buffer;
+
+      message->nodeId = nodeId;
+      message->sequence = ++sequence;
+      message->sentAt = micros();
+      lastSent = millis();
+
+      bool ok = mesh.write(buffer, BENCH_MESSAGE_TYPE, options.size);
+
+      if (measuring) {
+
+        std::lock_guard<std::mutex> lock(resultMutex);
+        sent++;
+        if (!ok) { writeFailures++; }
+
+      }
+
+      waiting = ok;
+
+      // Re-join if the route to the master is gone.
+      if (!ok && !mesh.checkConnection()) { mesh.renewAddress(5000); }
+
+    }
+
+    delayMicroseconds(200);
+
+  }
+
+}
+
+static uint32_t percentile(const std::vector<uint32_t>& sorted, double p) {
+
+  if (sorted.empty()) { return 0; }
+
+  return sorted[std::min(sorted.size() - 1, (size_t) (p * sorted.size()))];
+
+}
+
+static void usage() {
+
+  printf("Usage: RF24Bench [-n nodes] [-l loss] [-t latency (us)] [-d duration (s)] [-i interval (ms)] [-s size] [-line]\n");
+  exit(1);
+
+}
+
+int main(int argc, char** argv) {
+
+  for (int i = 1; i < argc; i++) {
+
+    bool hasValue = i + 1 < argc;
+
+    if (!strcmp(argv[i], "-n") && hasValue) { options.nodes = atoi(argv[++i]); }
+    else if (!strcmp(argv[i], "-l") && hasValue) { options.loss = atof(argv[++i]); }
+    else if (!strcmp(argv[i], "-t") && hasValue) { options.latency = atoi(argv[++i]); }
+    else if (!strcmp(argv[i], "-d") && hasValue) { options.duration = atoi(argv[++i]); }
+    else if (!strcmp(argv[i], "-i") && hasValue) { options.interval = atoi(argv[++i]); }
+    else if (!strcmp(argv[i], "-s") && hasValue) { options.size = atoi(argv[++i]); }
+    else if (!strcmp(argv[i], "-line")) { options.line = true; }
+    else { usage(); }
+
+  }
+
+  if (options.nodes < 1 || options.nodes > 250 || options.size < sizeof(BenchMessage) || options.size > BENCH_MAX_MESSAGE_SIZE) { usage(); }
+
+  // The master stores the assigned addresses here. Start with a clean mesh.
+  remove("dhcplist.txt");
+
+  rf24SimConfigure(options.loss, options.latency, options.line ? 1.0 : 0);
+
+  std::vector<std::thread> threads;
+
+  threads.push_back(std::thread(master));
+
+  for (int nodeId = 1; nodeId <= options.nodes; nodeId++) { threads.push_back(std::thread(slave, nodeId)); }
+
+  // Give the slaves time to join before measuring.
+  delay(2000 + options.nodes * 100);
+
+  RF24SimStatistics before = rf24SimStatistics();
+  uint32_t start = millis();
+
+  measuring = true;
+  delay(options.duration * 1000);
+  measuring = false;
+
+  double elapsed = (millis() - start) / 1000.0;
+  RF24SimStatistics after = rf24SimStatistics();
+
+  running = false;
+
+  for (std::thread& thread : threads) { thread.join(); }
+
+  std::lock_guard<std::mutex> lock(resultMutex);
+  std::sort(roundTrips.begin(), roundTrips.end());
+
+  printf("nodes: %d (%s), loss: %.2f, latency: %u us, size: %u bytes, interval: %u ms\n", options.nodes, options.line ? "line" : "star",
+         options.loss, options.latency, options.size, options.interval);
+  printf("join failures: %u\n", joinFailures);
+  printf("sent: %u, echoed: %zu (%.1f msgs/s), write failures: %u, echo timeouts: %u\n", sent, roundTrips.size(),
+         roundTrips.size() / elapsed, writeFailures, echoTimeouts);
+  printf("rtt (us): p50 %u, p95 %u, p99 %u, max %u\n", percentile(roundTrips, 0.5), percentile(roundTrips, 0.95),
+         percentile(roundTrips, 0.99), roundTrips.empty() ? 0 : roundTrips.back());
+  printf("medium: %u transmissions, %u retries, %u failed writes, %u collisions, %u lost, %u fifo drops, %.1f%% airtime\n",
+         after.transmissions - before.transmissions, after.retries - before.retries, after.failures - before.failures,
+         after.collisions - before.collisions, after.lost - before.lost, after.fifoDrops - before.fifoDrops,
+         (after.airtime - before.airtime) / (elapsed * 10000.0));
+
+  return 0;
+
+}
@@ -0,0 +1,563 @@
+/*
+ * Simulated radio medium and RF24 driver (see RF24/RF24.h).
+ *
+ * Timing is real time: a transmitting radio blocks for the airtime of the payload (and of the ack and retry delays), so virtual
+ * nodes should run in their own threads. A payload is delivered to every listening radio in range with a matching reading pipe
+ * and becomes available once it has been fully transmitted (plus the configured latency). If a receiver hears two overlapping
+ * transmissions, both receptions are corrupted.
+ */
+
+#include "RF24/RF24.h"
+
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <random>
+#include <algorithm>
+#include <cmath>
+
+// nRF24L01 frame overhead in bytes: preamble (1), address (5), packet control field (9 bits, rounded up) and CRC (2).
+#define RF24_SIM_FRAME_OVERHEAD 10
+
+// Time (in µs) between the end of a transmission and the start of the ack (and vice versa).
+#define RF24_SIM_TURNAROUND 130
+
+// The size of the RX FIFO of the nRF24L01.
+#define RF24_SIM_RX_FIFO_SIZE 3
+
+static std::chrono::steady_clock::time_point simulationStart = std::chrono::steady_clock::now();
+
+uint32_t millis(void) {
+
+  return (uint32_t) std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - simulationStart).count();
+
+}
+
+uint32_t micros(void) {
+
+  return (uint32_t) std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - simulationStart).count();
+
+}
+
+static uint64_t now64(void) {
+
+  return (uint64_t) std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - simulationStart).count();
+
+}
+
+void delay(uint32_t milliseconds) { std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds)); }
+
+void delayMicroseconds(uint32_t microseconds) { std::this_thread::sleep_for(std::chrono::microseconds(microseconds)); }
+
+// A payload received (or being received) by a radio.
+typedef struct {
+
+  uint8_t data[32];
+  uint8_t size;
+  uint8_t pipe;
+
+  // When the payload becomes available to the receiver.
+  uint64_t availableAt;
+
+  // Set if another transmission overlapped the reception.
+  std::shared_ptr<bool> corrupted;
+
+} RF24SimReception;
+
+typedef std::deque<RF24SimReception> RF24SimFifo;
+
+// A transmission in the air.
+typedef struct {
+
+  RF24* sender;
+  uint8_t channel;
+  uint64_t start;
+  uint64_t end;
+
+  // The receptions of this transmission (one per receiver).
+  std::vector<std::pair<RF24*, std::shared_ptr<bool> > > receptions;
+
+} RF24SimTransmission;
+
+class RF24Medium {
+
+public:
+
+  static RF24Medium& instance() {
+
+    // Never destroyed, since radios declared as globals (like the one of the router) are destroyed after it.
+    static RF24Medium* medium = new RF24Medium();
+    return *medium;
+
+  }
+
+  void configure(double _loss, uint32_t _latency, double _range) {
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    loss = _loss;
+    latency = _latency;
+    range = _range;
+
+  }
+
+  void add(RF24* radio) {
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (std::find(radios.begin(), radios.end(), radio) == radios.end()) { radios.push_back(radio); }
+
+  }
+
+  void remove(RF24* radio) {
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    radios.erase(std::remove(radios.begin(), radios.end(), radio), radios.end());
+    delete (RF24SimFifo*) radio->rxFifo;
+    radio->rxFifo = NULL;
+
+  }
+
+  // Sends the payload (with retries if an ack is expected). Returns true if it was acknowledged (or if no ack was expected).
+  bool transmit(RF24* sender, const void* buf, uint8_t len, bool wantAck) {
+
+    uint8_t attempts = wantAck ? sender->retryCount + 1 : 1;
+
+    for (uint8_t attempt = 0; attempt < attempts; attempt++) {
+
+      if (attempt > 0) {
+
+        increment(&statistics.retries);
+        delayMicroseconds(250 * (sender->retryDelay + 1));
+
+      }
+
+      std::shared_ptr<RF24SimTransmission> transmission = send(sender, buf, len);
+
+      // Wait for the payload to leave the radio.
+      std::this_thread::sleep_until(simulationStart + std::chrono::microseconds(transmission->end));
+
+      if (!wantAck) { return true; }
+
+      if (acknowledged(sender, transmission)) {
+
+        // The ack's own airtime.
+        delayMicroseconds(RF24_SIM_TURNAROUND + airtime(sender->dataRate, 0));
+        return true;
+
+      }
+
+      delayMicroseconds(RF24_SIM_TURNAROUND);
+
+    }
+
+    increment(&statistics.failures);
+
+    return false;
+
+  }
+
+  // Returns the next available reception of the radio or NULL. Corrupted receptions are discarded.
+  RF24SimReception* next(RF24* radio) {
+
+    RF24SimFifo* fifo = (RF24SimFifo*) radio->rxFifo;
+    uint64_t now = now64();
+
+    while (!fifo->empty() && now >= fifo->front().availableAt && *fifo->front().corrupted) { fifo->pop_front(); }
+
+    if (fifo->empty() || now < fifo->front().availableAt) { return NULL; }
+
+    return &fifo->front();
+
+  }
+
+  std::mutex mutex;
+  RF24SimStatistics statistics;
+
+private:
+
+  RF24Medium() : loss(0), latency(0), range(0), random(1) { memset(&statistics, 0, sizeof(statistics)); }
+
+  bool inRange(RF24* a, RF24* b) {
+
+    return range <= 0 || std::hypot(a->x - b->x, a->y - b->y) <= range;
+
+  }
+
+  bool lossRoll() {
+
+    return loss > 0 && std::uniform_real_distribution<double>(0, 1)(random) < loss;
+
+  }
+
+  static uint32_t airtime(rf24_datarate_e dataRate, uint8_t size) {
+
+    uint32_t bits = (RF24_SIM_FRAME_OVERHEAD + size) * 8;
+
+    switch (dataRate) {
+
+      case RF24_2MBPS: return bits / 2;
+      case RF24_250KBPS: return bits * 4;
+      default: return bits;
+
+    }
+
+  }
+
+  void increment(uint32_t* counter) {
+
+    std::lock_guard<std::mutex> lock(mutex);
+    (*counter)++;
+
+  }
+
+  std::shared_ptr<RF24SimTransmission> send(RF24* sender, const void* buf, uint8_t len) {
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::shared_ptr<RF24SimTransmission> transmission(new RF24SimTransmission());
+
+    transmission->sender = sender;
+    transmission->channel = sender->channel;
+    transmission->start = now64();
+    transmission->end = transmission->start + airtime(sender->dataRate, len);
+
+    statistics.transmissions++;
+    statistics.airtime += transmission->end - transmission->start;
+
+    // Forget the transmissions that have ended.
+    active.erase(std::remove_if(active.begin(), active.end(), [&](const std::shared_ptr<RF24SimTransmission>& t) { return t->end <= transmission->start; }), active.end());
+
+    for (RF24* receiver : radios) {
+
+      if (receiver == sender || receiver->channel != sender->channel || !inRange(sender, receiver)) { continue; }
+
+      int pipe = -1;
+
+      for (int i = 0; i < 6 && receiver->listening && !receiver->poweredDown; i++) {
+
+        if (receiver->readingPipeOpen[i] && receiver->readingPipes[i] == sender->writingPipe) { pipe = i; break; }
+
+      }
+
+      if (pipe < 0) { continue; }
+
+      std::shared_ptr<bool> corrupted(new bool(false));
+
+      // Overlapping transmissions heard by this receiver corrupt each other.
+      for (std::shared_ptr<RF24SimTransmission>& other : active) {
+
+        if (other->channel != sender->channel || other->sender == receiver || !inRange(other->sender, receiver)) { continue; }
+
+        *corrupted = true;
+
+        for (auto& reception : other->receptions) {
+
+          if (reception.first == receiver && !*reception.second) {
+
+            *reception.second = true;
+            statistics.collisions++;
+
+          }
+
+        }
+
+      }
+
+      if (*corrupted) { statistics.collisions++; }
+
+      if (lossRoll()) {
+
+        statistics.lost++;
+        continue;
+
+      }
+
+      RF24SimFifo* fifo = (RF24SimFifo*) receiver->rxFifo;
+
+      if (fifo->size() >= RF24_SIM_RX_FIFO_SIZE) {
+
+        statistics.fifoDrops++;
+        continue;
+
+      }
+
+      RF24SimReception reception;
+
+      memcpy(reception.data, buf, len);
+      reception.size = len;
+      reception.pipe = pipe;
+      reception.availableAt = transmission->end + latency;
+      reception.corrupted = corrupted;
+
+      fifo->push_back(reception);
+      transmission->receptions.push_back(std::make_pair(receiver, corrupted));
+
+    }
+
+    active.push_back(transmission);
+
+    return transmission;
+
+  }
+
+  bool acknowledged(RF24* sender, std::shared_ptr<RF24SimTransmission> transmission) {
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (auto& reception : transmission->receptions) {
+
+      RF24* receiver = reception.first;
+
+      if (*reception.second) { continue; }
+
+      for (int i = 0; i < 6; i++) {
+
+        if (receiver->readingPipeOpen[i] && receiver->readingPipes[i] == sender->writingPipe && receiver->autoAck[i]) {
+
+          // The ack might be lost as well.
+          if (lossRoll()) { statistics.lost++; return false; }
+
+          return true;
+
+        }
+
+      }
+
+    }
+
+    return false;
+
+  }
+
+  double loss;
+  uint32_t latency;
+  double range;
+  std::mt19937 random;
+
+  std::vector<RF24*> radios;
+  std::vector<std::shared_ptr<RF24SimTransmission> > active;
+
+};
+
+void rf24SimConfigure(double loss, uint32_t latency, double range) { RF24Medium::instance().configure(loss, latency, range); }
+
+RF24SimStatistics rf24SimStatistics() {
+
+  std::lock_guard<std::mutex> lock(RF24Medium::instance().mutex);
+
+  return RF24Medium::instance().statistics;
+
+}
+
+// -- RF24 --
+
+RF24::RF24(uint16_t _cepin, uint16_t _cspin) : channel(76), dataRate(RF24_1MBPS), listening(false), poweredDown(false), writingPipe(0),
+                                               retryDelay(5), retryCount(15), x(0), y(0), txOk(true) {
+
+  (void) _cepin;
+  (void) _cspin;
+
+  for (int i = 0; i < 6; i++) {
+
+    autoAck[i] = true;
+    readingPipes[i] = 0;
+    readingPipeOpen[i] = false;
+
+  }
+
+  rxFifo = new RF24SimFifo();
+
+}
+
+RF24::~RF24() { RF24Medium::instance().remove(this); }
+
+bool RF24::begin(void) {
+
+  RF24Medium::instance().add(this);
+
+  return true;
+
+}
+
+void RF24::startListening(void) {
+
+  std::lock_guard<std::mutex> lock(RF24Medium::instance().mutex);
+  listening = true;
+
+}
+
+void RF24::stopListening(void) {
+
+  std::lock_guard<std::mutex> lock(RF24Medium::instance().mutex);
+  listening = false;
+
+}
+
+void RF24::powerDown(void) {
+
+  std::lock_guard<std::mutex> lock(RF24Medium::instance().mutex);
+  poweredDown = true;
+
+}
+
+void RF24::powerUp(void) {
+
+  std::lock_guard<std::mutex> lock(RF24Medium::instance().mutex);
+  poweredDown = false;
+
+}
+
+bool RF24::available(void) { return available(NULL); }
+
+bool RF24::available(uint8_t* pipe_num) {
+
+  std::lock_guard<std::mutex> lock(RF24Medium::instance().mutex);
+
+  RF24SimReception* reception = RF24Medium::instance().next(this);
+
+  if (reception && pipe_num) { *pipe_num = reception->pipe; }
+
+  return reception != NULL;
+
+}
+
+void RF24::read(void* buf, uint8_t len) {
+
+  std::lock_guard<std::mutex> lock(RF24Medium::instance().mutex);
+
+  RF24SimReception* reception = RF24Medium::instance().next(this);
+
+  if (!reception) { return; }
+
+  memcpy(buf, reception->data, rf24_min(len, reception->size));
+  ((RF24SimFifo*) rxFifo)->pop_front();
+
+}
+
+uint8_t RF24::getDynamicPayloadSize(void) {
+
+  std::lock_guard<std::mutex> lock(RF24Medium::instance().mutex);
+
+  RF24SimReception* reception = RF24Medium::instance().next(this);
+
+  return reception ? reception->size : 0;
+
+}
+
+bool RF24::rxFifoFull() {
+
+  std::lock_guard<std::mutex> lock(RF24Medium::instance().mutex);
+
+  return ((RF24SimFifo*) rxFifo)->size() >= RF24_SIM_RX_FIFO_SIZE;
+
+}
+
+bool RF24::write(const void* buf, uint8_t len) { return write(buf, len, false); }
+
+bool RF24::write(const void* buf, uint8_t len, const bool multicast) {
+
+  return RF24Medium::instance().transmit(this, buf, rf24_min(len, 32), autoAck[0] && !multicast);
+
+}
+
+bool RF24::writeFast(const void* buf, uint8_t len) { return writeFast(buf, len, false); }
+
+bool RF24::writeFast(const void* buf, uint8_t len, const bool multicast) {
+
+  bool ok = write(buf, len, multicast);
+
+  txOk = txOk && ok;
+
+  return ok;
+
+}
+
+bool RF24::txStandBy() { return txStandBy(0); }
+
+bool RF24::txStandBy(uint32_t timeout, bool startTx) {
+
+  (void) timeout;
+  (void) startTx;
+
+  bool ok = txOk;
+  txOk = true;
+
+  return ok;
+
+}
+
+void RF24::openWritingPipe(uint64_t address) { writingPipe = address & 0xFFFFFFFFFFULL; }
+
+void RF24::openReadingPipe(uint8_t number, uint64_t address) {
+
+  if (number > 5) { return; }
+
+  std::lock_guard<std::mutex> lock(RF24Medium::instance().mutex);
+
+  readingPipes[number] = address & 0xFFFFFFFFFFULL;
+  readingPipeOpen[number] = true;
+
+}
+
+void RF24::closeReadingPipe(uint8_t pipe) {
+
+  if (pipe > 5) { return; }
+
+  std::lock_guard<std::mutex> lock(RF24Medium::instance().mutex);
+
+  readingPipeOpen[pipe] = false;
+
+}
+
+void RF24::setAutoAck(bool enable) {
+
+  for (int i = 0; i < 6; i++) { setAutoAck(i, enable); }
+
+}
+
+void RF24::setAutoAck(uint8_t pipe, bool enable) {
+
+  if (pipe > 5) { return; }
+
+  std::lock_guard<std::mutex> lock(RF24Medium::instance().mutex);
+
+  autoAck[pipe] = enable;
+
+}
+
+void RF24::setRetries(uint8_t delay, uint8_t count) {
+
+  retryDelay = rf24_min(delay, 15);
+  retryCount = rf24_min(count, 15);
+
+}
+
+void RF24::setChannel(uint8_t _channel) {
+
+  std::lock_guard<std::mutex> lock(RF24Medium::instance().mutex);
+
+  channel = rf24_min(_channel, 125);
+
+}
+
+bool RF24::setDataRate(rf24_datarate_e speed) {
+
+  dataRate = speed;
+
+  return true;
+
+}
+
+void RF24::setPosition(double _x, double _y) {
+
+  std::lock_guard<std::mutex> lock(RF24Medium::instance().mutex);
+
+  x = _x;
+  y = _y;
+
+}
@@ -0,0 +1,228 @@
+/*
+ * Wakes a sleeping slave using the RH24 router (r2RH24.cpp) of the r2I2CDeviceRouter on the simulated radio medium.
+ *
+ * The master (node 0) and the slave (node 1) each run their own copy of the router in their own thread (see r2Sim/r2SimNode.h).
+ * The master sends the slave to sleep, waits until the slave has gone to sleep and then requests it to wake up. With
+ * RH24_COMMAND_QUEUE the slave powers its radio down, so the request has to be queued by the master and delivered when the
+ * slave checks in. Without it (R2SIM_MINIMAL, the AVR defaults, see r2Sim/r2I2C_config.h) the request is sent right away and
+ * the slave, whose radio stays in RX, answers it once it wakes up. Exits with 0 if the slave woke up.
+ *
+ * Usage: RH24SleepTest
+ */
+
+#include "RF24/RF24.h"
+#include "RF24Network/RF24Network.h"
+#include "RF24Mesh/RF24Mesh.h"
+
+#include <EEPROM.h>
+#include <SPI.h>
+#include <avr/wdt.h>
+#include <stdbool.h>
+#include "r2I2C_config.h"
+
+#include <thread>
+#include <atomic>
+#include <cstdio>
+#include <unistd.h>
+
+// The real time (in ms) a simulated node sleeps per watchdog cycle. The router accounts for RH24_SLEEP_CYCLE_LENGTH per cycle.
+#define R2SIM_SLEEP_CYCLE_LENGTH 100
+
+// The number of sleep cycles between the check-ins of the slave.
+#define TEST_CHECK_IN_CYCLES 5
+
+// How long (in ms) the master waits for the slave to join, to power its radio down and to be woken up.
+#define TEST_JOIN_TIMEOUT 10000
+#define TEST_SLEEP_DELAY 3000
+#define TEST_WAKE_TIMEOUT 20000
+
+#define R2SIM_NODE_ID 0
+namespace master {
+  #include "r2Sim/r2SimNode.h"
+}
+#undef R2SIM_NODE_ID
+
+#define R2SIM_NODE_ID 1
+namespace slave {
+  #include "r2Sim/r2SimNode.h"
+}
+#undef R2SIM_NODE_ID
+
+// RF24Network only implements sleep mode for AVR.
+bool RF24Network::sleepNode(unsigned int cycles, int interruptPin, uint8_t INTERRUPT_MODE) {
+
+  (void) interruptPin;
+  (void) INTERRUPT_MODE;
+  
+  delay(cycles * R2SIM_SLEEP_CYCLE_LENGTH);
+  
+  return true;
+  
+}
+
+void RF24Network::setup_watchdog(uint8_t prescalar) { (void) prescalar; }
+
+static std::atomic<bool> running(true);
+
+// The router restarts the node (arghhhh) if it loses the mesh, which can't be simulated.
+static void restart() {
+
+  printf("A node restarted at %u ms.\nFAILED\n", millis());
+  _exit(1);
+  
+}
+
+static void runSlave() {
+
+  slave::rh24Setup();
+  
+  while (running) { 
+  
+    slave::loop_rh24(); 
+    delayMicroseconds(200);
+    
+  }
+  
+}
+
+// Runs the master's loop until the condition is met. Returns false on timeout.
+template <typename Condition> static bool masterLoopUntil(Condition condition, uint32_t timeout) {
+
+  uint32_t start = millis();
+  
+  while (!condition()) {
+  
+    if (millis() - start > timeout) { return false; }
+    
+    master::loop_rh24();
+    delayMicroseconds(200);
+    
+  }
+  
+  return true;
+  
+}
+
+static master::RequestPackage sleepRequest(bool on, byte cycles) {
+
+  master::RequestPackage request;
+  request.host = 1;
+  request.action = ACTION_SEND_TO_SLEEP;
+  request.id = 0;
+  request.argSize = 2;
+  request.args[SLEEP_MODE_TOGGLE_POSITION] = on;
+  request.args[SLEEP_MODE_CYCLES_POSITION] = cycles;
+  request.checksum = master::createRequestChecksum(&request);
+  
+  return request;
+  
+}
+
+static bool runMaster() {
+
+  if (!masterLoopUntil([] { return master::nodeAvailable(1); }, TEST_JOIN_TIMEOUT)) {
+  
+    printf("The slave didn't join the mesh.\n");
+    return false;
+    
+  }
+  
+  master::RequestPackage request = sleepRequest(true, TEST_CHECK_IN_CYCLES);
+  master::ResponsePackage response = master::rh24Send(&request);
+  
+  if (master::isError() || master::isError(response) || response.action != ACTION_SEND_TO_SLEEP) {
+  
+    printf("The slave couldn't be sent to sleep (error %d).\n", master::getErrorCode());
+    return false;
+    
+  }
+  
+  // The slave goes to sleep once it has finished the request.
+  uint32_t asleep = millis();
+  masterLoopUntil([asleep] { return millis() - asleep > TEST_SLEEP_DELAY; }, TEST_SLEEP_DELAY + 1000);
+  
+  request = sleepRequest(false, 0);
+  response = master::rh24Send(&request);
+  
+#ifdef RH24_COMMAND_QUEUE
+  if (master::isError() || response.contentSize < 1) {
+  
+    printf("The wake up request wasn't queued (error %d).\n", master::getErrorCode());
+    return false;
+    
+  }
+  
+  byte commandId = response.content[RESPONSE_POSITION_QUEUED_COMMAND_ID];
+  byte status = COMMAND_STATUS_QUEUED;
+  
+  bool finished = masterLoopUntil([commandId, &status] {
+  
+    master::ResponsePackage commandStatus = master::rh24CommandStatus(1, commandId);
+    status = commandStatus.content[RESPONSE_POSITION_COMMAND_STATUS];
+    
+    return status == COMMAND_STATUS_DELIVERED || status == COMMAND_STATUS_FAILED;
+    
+  }, TEST_WAKE_TIMEOUT);
+  
+  if (!finished || status != COMMAND_STATUS_DELIVERED) {
+  
+    printf("The wake up request wasn't delivered (status %d).\n", status);
+    return false;
+    
+  }
+#else
+  if (master::isError() || master::isError(response) || response.action != ACTION_SEND_TO_SLEEP) {
+  
+    printf("The slave didn't answer the wake up request (error %d).\n", master::getErrorCode());
+    return false;
+    
+  }
+#endif
+  
+  if (master::master_isNodeSleeping(1)) {
+  
+    printf("The master still believes that the slave is sleeping.\n");
+    return false;
+    
+  }
+  
+  printf("Woke the slave after %u ms.\n", millis() - asleep);
+  
+  return true;
+  
+}
+
+int main(int argc, char** argv) {
+
+  (void) argc;
+  (void) argv;
+  
+  // The master stores the assigned addresses here. Start with a clean mesh.
+  remove("dhcplist.txt");
+  
+  rf24SimConfigure(0, 0, 0);
+  
+  master::arghhhh = restart;
+  slave::arghhhh = restart;
+  
+  master::rh24Setup();
+  
+  std::thread slaveThread(runSlave);
+  
+  bool passed = runMaster();
+  
+  running = false;
+  slaveThread.join();
+  
+  if (passed && slave::isSleeping()) {
+  
+    printf("The slave is still sleeping.\n");
+    passed = false;
+    
+  }
+  
+  printf("%s\n", passed ? "PASSED" : "FAILED");
+  
+  return passed ? 0 : 1;
+  
+}
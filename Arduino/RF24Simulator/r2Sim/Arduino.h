@@ -0,0 +1,14 @@
+/*
+ * Minimal Arduino core used when the r2I2CDeviceRouter sources are built for Linux against the simulated radio (see ../RH24SleepTest.cpp).
+ */
+
+#ifndef __R2SIM_ARDUINO_H__
+#define __R2SIM_ARDUINO_H__
+
+#include "RF24/RF24_config.h"
+
+#include <stdlib.h>
+
+#define F(string) (string)
+
+#endif // __R2SIM_ARDUINO_H__
@@ -0,0 +1,25 @@
+/*
+ * Simulated EEPROM. Every virtual node owns an instance (see ../RH24SleepTest.cpp).
+ */
+
+#ifndef __R2SIM_EEPROM_H__
+#define __R2SIM_EEPROM_H__
+
+#include "Arduino.h"
+
+class EEPROMClass
+{
+public:
+
+  EEPROMClass() { memset(data, 0, sizeof(data)); }
+
+  uint8_t read(int address) { return data[address]; }
+  void write(int address, uint8_t value) { data[address] = value; }
+
+private:
+
+  uint8_t data[64];
+
+};
+
+#endif // __R2SIM_EEPROM_H__
@@ -0,0 +1,3 @@
+/*
+ * The simulated radio needs no SPI bus.
+ */
@@ -0,0 +1,10 @@
+/*
+ * The simulated nodes sleep without the watchdog (see RF24Network::sleepNode in ../../RH24SleepTest.cpp).
+ */
+
+#ifndef __R2SIM_WDT_H__
+#define __R2SIM_WDT_H__
+
+#define WDTO_2S 7
+
+#endif // __R2SIM_WDT_H__
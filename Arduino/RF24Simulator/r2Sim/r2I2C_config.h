@@ -0,0 +1,30 @@
+/*
+ * Configuration of the simulated RH24 nodes (see ../RH24SleepTest.cpp and ../../r2I2CDeviceRouter/r2I2CDeviceRouter/r2I2C_config.h.template).
+ */
+
+#ifndef R2I2C_CONFIG_H
+#define R2I2C_CONFIG_H
+
+#define USE_RH24
+
+#define RH24_PORT1 9
+#define RH24_PORT2 10
+
+#define SLEEP_MODE_EEPROM_ADDRESS 0x01
+#define MESH_ADDRESS_EEPROM_ADDRESS 0x02
+
+// The optional features, unless R2SIM_MINIMAL is defined (the AVR defaults).
+#ifndef R2SIM_MINIMAL
+  #define RH24_DISPATCH
+  #define RH24_VALUE_CACHE
+  #define RH24_COMMAND_QUEUE
+  #define RH24_GROUPS
+  #define RH24_LINK_STATS
+  #define RH24_TRANSFER
+#endif
+
+#define MAX_DEVICES 10
+
+#define NODE_ID_EEPROM_ADDRESS 0x00
+
+#endif
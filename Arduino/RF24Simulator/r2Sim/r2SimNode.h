@@ -0,0 +1,72 @@
+/*
+ * A virtual RH24 node. Included once per node, inside the node's namespace, with R2SIM_NODE_ID defined (see ../RH24SleepTest.cpp).
+ *
+ * Compiles a private copy of the router (r2RH24.cpp) and provides the parts of r2Common and r2I2CDeviceRouter it uses.
+ */
+
+// The packages and the functions of the router become the node's own.
+#undef R2I2C_DEVICE_ROUTER_H
+#undef R2I2C_COMMON_H
+#undef R2I2C_RH24_H
+#undef RH_24_CONFIGURED
+#include "r2Common.h"
+
+EEPROMClass EEPROM;
+
+byte errorCode = 0;
+byte errorInfo = 0;
+
+void err(const char* msg, byte code, byte info) { (void) msg; errorCode = code; errorInfo = info; }
+void err(const char* msg, byte code) { err(msg, code, 0); }
+bool isError() { return errorCode != 0; }
+bool isError(ResponsePackage response) { return response.action == ACTION_ERROR; }
+void clearError() { errorCode = errorInfo = 0; }
+byte getErrorCode() { return errorCode; }
+byte getErrorInfo() { return errorInfo; }
+
+void setStatus(bool on) { (void) on; }
+byte getNodeId() { return R2SIM_NODE_ID; }
+bool reservePort(byte port) { (void) port; return true; }
+
+byte createRequestChecksum(RequestPackage *package) {
+
+  byte checksum = 0;
+  
+  for (int i = 1; i < requestPackageSize(package); i++) { checksum += ((byte *)package)[i]; }
+  
+  return checksum;
+  
+}
+
+ResponsePackage execute(RequestPackage *request);
+
+#include "../../r2I2CDeviceRouter/r2I2CDeviceRouter/r2RH24.cpp"
+
+// Handles the sleep actions and ACTION_INITIALIZE (no devices are created) like r2I2CDeviceRouter.ino. Every other request is acknowledged.
+ResponsePackage execute(RequestPackage *request) {
+
+  ResponsePackage response;
+  response.messageId = 0;
+  response.host = getNodeId();
+  response.action = request->action;
+  response.id = request->id;
+  response.contentSize = 0;
+  
+  if (request->action == ACTION_SEND_TO_SLEEP) { sleep(request->args[SLEEP_MODE_TOGGLE_POSITION], request->args[SLEEP_MODE_CYCLES_POSITION]); }
+  else if (request->action == ACTION_PAUSE_SLEEP) { pauseSleep(request->args[SLEEP_MODE_TOGGLE_POSITION]); }
+  else if (request->action == ACTION_INITIALIZE) { 
+  
+    deviceCount = 0;
+    response.action = ACTION_INITIALIZATION_OK;
+    
+  }
+  else if (request->action == ACTION_CHECK_SLEEP_STATE) {
+  
+    response.contentSize = 1;
+    response.content[0] = isSleeping();
+    
+  }
+  
+  return response;
+  
+}
@@ -14,8 +14,9 @@
     void _setResponse(byte* data, size_t data_size);
 
     static int state = 0;
-    static byte* output_data = NULL;
-    static byte* input_data = NULL;
+    // Static, since they are filled from the Wire interrupt handlers.
+    static byte output_data[R2I2C_MAX_MESSAGE_SIZE];
+    static byte input_data[R2I2C_MAX_MESSAGE_SIZE];
     static size_t output_size = 0;
     static size_t input_size = 0;
 
@@ -26,6 +27,10 @@
     // If true, the READY_TO_SEND_FLAG has been transmitted to the host, indicating that I'm ready to transmit data.
     static bool ready_to_send_flag_sent = false;
     static int _slave_address = DEFAULT_I2C_ADDRESS;
+    // The protocol used when transmitting responses.
+    static byte protocol_version = R2I2C_PROTOCOL_VERSION_1;
+    // The version accepted during the latest negotiation. Applied once the master starts a new transmission, since the negotiation reply itself uses the legacy protocol.
+    static byte negotiated_version = R2I2C_PROTOCOL_VERSION_1;
     void (*onProcessI2C)(byte*, size_t);
 
 R2I2CCom :: R2I2CCom() {
@@ -48,12 +53,10 @@ void R2I2CCom :: setResponse(byte* data, size_t data_size) {
 
 void R2I2CCom :: loop() {
 
-	if (input_data && input_size > 0) {
+	if (input_size > 0) {
 
 		if (onProcessI2C) { onProcessI2C(input_data, input_size); }
     
-		free(input_data);
-		input_data = NULL;
 		input_size = 0;
 
 	}
@@ -73,18 +76,32 @@ void _receiveData(int data_size){
 
   _transmissionCleanup();
 
+  protocol_version = negotiated_version;
+
   if (data_size == 0) { return; }
 
-  input_data = (byte*)malloc(sizeof(byte) * data_size);
-  input_size = data_size;
-  int i = 0;
+  size_t i = 0;
 
-  while(Wire.available() && i < data_size) {
+  while(Wire.available() && i < (size_t)data_size && i < R2I2C_MAX_MESSAGE_SIZE) {
 
 	   input_data[i++] = Wire.read();
   
   }
 
+  if (i == 2 && input_data[0] == R2I2C_PROTOCOL_NEGOTIATION_FLAG) {
+
+	  negotiated_version = input_data[1] >= R2I2C_PROTOCOL_VERSION_2 ? R2I2C_PROTOCOL_VERSION_2 : R2I2C_PROTOCOL_VERSION_1;
+	  protocol_version = R2I2C_PROTOCOL_VERSION_1;
+
+	  _setResponse(&negotiated_version, 1);
+
+	  return;
+
+  }
+
+  // Set last, since loop() processes the message as soon as the size is set.
+  input_size = i;
+
 }
 
 void _sendData() {
@@ -94,8 +111,19 @@ void _sendData() {
 
   if (response_ready) {
 
-    if (!ready_to_send_flag_sent) {
+    if (protocol_version == R2I2C_PROTOCOL_VERSION_2 && output_size + 2 <= R2I2C_SINGLE_READ_SIZE) {
+
+        byte buffer[R2I2C_SINGLE_READ_SIZE];
+        buffer[0] = READY_TO_SEND_FLAG;
+        buffer[1] = output_size;
+        memcpy(buffer + 2, output_data, output_size);
+
+        Wire.write(buffer, output_size + 2);
+        _transmissionCleanup();
+
+    } else if (!ready_to_send_flag_sent) {
 
+        // Using R2I2C_PROTOCOL_VERSION_2, a response too large for a single read continues with the size and payload reads of version 1.
         ready_to_send_flag_sent = true;
         Wire.write(READY_TO_SEND_FLAG);
 
@@ -125,8 +153,7 @@ void _sendData() {
 // Prepare response data
 void _setResponse(byte* data, size_t data_size) {
 
-  output_size = data_size;
-  output_data = (byte*) malloc(sizeof(byte) * output_size);
+  output_size = data_size < R2I2C_MAX_MESSAGE_SIZE ? data_size : R2I2C_MAX_MESSAGE_SIZE;
   memcpy(output_data, data, output_size);
 
   response_ready = true;
@@ -141,10 +168,6 @@ void _transmissionCleanup() {
     output_size = 0;
     input_size = 0;
     size_sent_flag = false;
-    if (output_data) { free(output_data); }
-    if (input_data) { free(input_data); }
-    output_data = NULL;
-    input_data = NULL;
 
 }
 
@@ -6,13 +6,28 @@
 // Default address used by this slave as I2C port.
 #define DEFAULT_I2C_ADDRESS 0x08
 
+// Legacy protocol: the master reads the ready flag, the size and the payload using three separate read transactions.
+#define R2I2C_PROTOCOL_VERSION_1 1
+
+// Single read protocol: one read transaction returns [flag, size, payload...]. Larger responses (more than R2I2C_SINGLE_READ_SIZE - 2 bytes) are transmitted as in version 1.
+#define R2I2C_PROTOCOL_VERSION_2 2
+
+// A two byte message [R2I2C_PROTOCOL_NEGOTIATION_FLAG, <version>] from the master requests a protocol version. Never forwarded to the onProcess delegate.
+#define R2I2C_PROTOCOL_NEGOTIATION_FLAG 0xF4
+
+// The maximum number of bytes transmitted in a single read. Limited by the Wire buffer (BUFFER_LENGTH).
+#define R2I2C_SINGLE_READ_SIZE 32
+
+// The largest message received from, or response transmitted to, the master. Limited by the Wire buffer (BUFFER_LENGTH), so the buffers can be static.
+#define R2I2C_MAX_MESSAGE_SIZE 32
+
 class R2I2CCom {
 
 	public:
 		// Initializes the I2C bus as slave. The onProcess(byte <received bytes>, int <data_size>) delegate will be called when the master sends data.
 		void initialize(int slave_address, void (*onProcess)(byte*, size_t));
 
-		// When application is ready to respond to master, invoke this method. (set data_size to 0 if no response is needed).
+		// When application is ready to respond to master, invoke this method. (set data_size to 0 if no response is needed). At most R2I2C_MAX_MESSAGE_SIZE bytes are transmitted.
 		void setResponse(byte* data, size_t data_size);
 
 		// This method must live in the program loop.
@@ -37,6 +37,8 @@ byte errInfo = 0;
 
 byte getErrorCode() { return errCode; }
 
+byte getErrorInfo() { return errInfo; }
+
 bool isError() { return errCode != 0; }
 
 void clearError() {
@@ -61,6 +61,9 @@ ResponsePackage createErrorPackage(HOST_ADDRESS host);
 // Returns the latest error code
 byte getErrorCode();
 
+// Returns the additional information of the latest error
+byte getErrorInfo();
+
 // Returns true if an error has occured since the last clearError
 bool isError();
 
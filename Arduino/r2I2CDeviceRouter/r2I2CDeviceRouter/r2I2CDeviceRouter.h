@@ -146,7 +146,7 @@ typedef struct RequestPackage RequestPackage;
 #define ERROR_SERIAL_TIMEOUT 17
 // Failed to make the node sleep.
 #define ERROR_FAILED_TO_SLEEP 18
-// Messages are not in sync. Unrecieved messages found in the masters input buffer.
+// Messages are not in sync. Unrecieved messages found in the masters input buffer. No longer raised: the master keeps late responses for rh24Collect.
 #define ERROR_RH24_MESSAGE_SYNCHRONIZATION 19
 // If the size of the incomming data is invalid.
 #define ERROR_INVALID_REQUEST_PACKAGE_SIZE 20
@@ -158,6 +158,26 @@ typedef struct RequestPackage RequestPackage;
 #define ERROR_TCP_READ 23
 // If the number ports created exceeds DEVICE_MAX_PORTS when creating a DEVICE_TYPE_MULTIPLE_DIGITAL_OUTPUT
 #define ERROR_TOO_MANY_MULTIPLE_PORTS 24
+// ACTION_RH24_COLLECT: The node has not yet responded to the dispatched request.
+#define ERROR_RH24_RESPONSE_PENDING 25
+// ACTION_RH24_COLLECT: No outstanding request with the specified message id was found.
+#define ERROR_RH24_UNKNOWN_MESSAGE_ID 26
+// ACTION_RH24_DISPATCH: The master can't keep track of any more outstanding requests (see RH24_MAX_PENDING_REQUESTS). Collect the responses of the dispatched requests first.
+#define ERROR_RH24_TOO_MANY_PENDING_REQUESTS 27
+// No more commands can be queued for the sleeping node (see RH24_COMMAND_QUEUE_SIZE and RH24_MAX_COMMANDS_PER_NODE).
+#define ERROR_RH24_COMMAND_QUEUE_FULL 28
+// ACTION_RH24_COMMAND_STATUS: No queued command with the specified id was found.
+#define ERROR_RH24_UNKNOWN_COMMAND_ID 29
+// ACTION_RH24_GROUP: The group is out of range (see RH24_MAX_GROUPS) or has no members.
+#define ERROR_RH24_EMPTY_GROUP 30
+// ACTION_CREATE_DEVICE: The filter parameters of an analog input are out of range (see ANALOG_MAX_OVERSAMPLING_BITS and ANALOG_FILTER_MAX_WINDOW).
+#define ERROR_INVALID_FILTER 31
+// ACTION_RH24_SET_SAMPLING: No more devices can be sampled (see RH24_MAX_SAMPLED_DEVICES).
+#define ERROR_RH24_SAMPLING_FULL 32
+// ACTION_CREATE_DEVICE: A sonar and a PWM output on a Timer2 pin (3 and 11 on an Uno) can't be used at the same time (NewPing uses Timer2 on AVR).
+#define ERROR_TIMER2_IN_USE 33
+// The action can only be performed by a slave (i.e. ACTION_RH24_SET_GROUPS or ACTION_RH24_SET_SAMPLING sent to the master).
+#define ERROR_RH24_SLAVE_ONLY_ACTION 34
  
 
 // Error reserved for external purposes
@@ -212,10 +232,28 @@ typedef struct RequestPackage RequestPackage;
 #define ACTION_ACTIVATE_RPI_CONTROLLER 0x0F
 // Delete a device with a specified id
 #define ACTION_DELETE_DEVICE 0x10
+// Sends the request wrapped in the args (see REQUEST_ARG_DISPATCH_ACTION_POSITION) to a node without waiting for the response. Returns the message id used to collect the response.
+#define ACTION_RH24_DISPATCH 0x11
+// Returns the response of a request previously sent using ACTION_RH24_DISPATCH. The message id is passed in the first argument.
+#define ACTION_RH24_COLLECT 0x12
+// Returns the delivery status of a command (i.e. ACTION_SET_DEVICE) queued for a sleeping node. The command id is passed in the first argument.
+#define ACTION_RH24_COMMAND_STATUS 0x13
+// Sets the groups (bit mask) a node belongs to. The mask is passed in the first argument.
+#define ACTION_RH24_SET_GROUPS 0x14
+// Multicasts a request to all members of a group and returns their aggregated replies. First argument is the group, the second the action. The remaining args are passed as the args of that action.
+#define ACTION_RH24_GROUP 0x15
+// Returns the link statistics the master has gathered for the node (see RESPONSE_POSITION_LINK_).
+#define ACTION_RH24_LINK_STATS 0x16
+// Reads the bulk data offered by a node (see rh24SetTransferData), starting at the offset (16-bit) passed in the first two arguments.
+#define ACTION_RH24_TRANSFER 0x17
+// Reads every value of a multi-value device (DEVICE_TYPE_MULTIPLEX_MOIST) in one pass. The first argument (optional) is the index of the first value to read.
+#define ACTION_SCAN_DEVICE 0x18
+// Makes a sleeping (slave) node sample the device every n seconds (16-bit, first two arguments) and report the value to the master's cache. 0 stops sampling.
+#define ACTION_RH24_SET_SAMPLING 0x19
 
 // -- Internal Actions --
 
-// Internal action definition. Used to check that there were no unread message in the pipe.
+// Internal action definition. Used for responses that have not (yet) been received.
 #define ACTION_RH24_NO_MESSAGE_READ 0xF1
 // Ping message from master node to slave in order to find out if the slave is available
 #define ACTION_RH24_PING_SLAVE 0xF2
@@ -229,15 +267,58 @@ typedef struct RequestPackage RequestPackage;
 #define REQUEST_ARG_CREATE_TYPE_POSITION 0x0 // Position of the type to create.
 #define REQUEST_ARG_CREATE_PORT_POSITION 0x1 // Position of port information.
 
+// Used by ACTION_RH24_DISPATCH. The action to perform on the node. The remaining args are passed as the args of that action.
+#define REQUEST_ARG_DISPATCH_ACTION_POSITION 0x0
+
+// Used by ACTION_RH24_COLLECT. The message id returned by ACTION_RH24_DISPATCH.
+#define REQUEST_ARG_COLLECT_MESSAGE_ID_POSITION 0x0
+
+// Used by ACTION_RH24_COMMAND_STATUS. The command id returned when the command was queued.
+#define REQUEST_ARG_COMMAND_STATUS_ID_POSITION 0x0
+
+// Used by ACTION_RH24_SET_GROUPS. Bit n is set if the node is a member of group n.
+#define REQUEST_ARG_GROUPS_MASK_POSITION 0x0
+
+// Used by ACTION_RH24_GROUP. The group to send to and the action the members should perform.
+#define REQUEST_ARG_GROUP_POSITION 0x0
+#define REQUEST_ARG_GROUP_ACTION_POSITION 0x1
+
+// Used by ACTION_RH24_TRANSFER. The (16-bit) offset to read from.
+#define REQUEST_ARG_TRANSFER_OFFSET_POSITION 0x0
+
+// Used by ACTION_RH24_SET_SAMPLING. The (16-bit) sampling interval in seconds.
+#define REQUEST_ARG_SAMPLING_INTERVAL_POSITION 0x0
+
+// Used by ACTION_SCAN_DEVICE. The index of the first value to read.
+#define REQUEST_ARG_SCAN_FIRST_POSITION 0x0
+
 // Telling which position in the argument byte array for REQUEST_ARG_CREATE_PORT_POSITION the HC-SR04 will use as trigger port/echo port.
 #define SONAR_TRIG_PORT 0x0
 #define SONAR_ECHO_PORT 0x1
 #define SONAR_MAX_DISTANCE 0x3 // The maximum distance for a "regular" sonar
-#define HCSR04_SONAR_DISTANCE_DENOMIATOR 58 // I found this number somewhere
+
+// Sonar and DHT11 devices are measured in the background (see loop_devices). getValue returns the latest completed measurement.
+#define SONAR_SAMPLE_INTERVAL 100 // How often (in ms) each sonar pings. Sonars ping one at a time.
+#define SONAR_PING_TIMEOUT 50 // How long (in ms) a ping may take before it's considered to have no echo.
+#define DHT11_SAMPLE_INTERVAL 2000 // How often (in ms) each DHT11 is read (the sensor needs at least 1 s between reads).
 
 // Port positions for simple moisture sensors
 #define SIMPLE_MOIST_ANALOGUE_IN 0x0 // The analogue input port used for the actual reading.
 #define SIMPLE_MOIST_DIGITAL_OUT 0x1 // The digital output port used to enable reading.
+#define SIMPLE_MOIST_PORT_COUNT 0x2
+
+// Optional filter parameters of DEVICE_TYPE_ANALOG_INPUT and DEVICE_TYPE_SIMPLE_MOIST, following the port(s). The raw analogRead is used if omitted.
+#define ANALOG_FILTER_OVERSAMPLING_POSITION 0x0 // Oversample 4^n readings and decimate, adding n bits of resolution.
+#define ANALOG_FILTER_TYPE_POSITION 0x1 // One of the ANALOG_FILTER_ types.
+#define ANALOG_FILTER_PARAMETER_POSITION 0x2 // The median window size or the EMA smoothing shift (alpha = 1/2^n).
+
+#define ANALOG_FILTER_NONE 0x0
+#define ANALOG_FILTER_MEDIAN 0x1 // The median of a burst of (oversampled) readings. Removes spikes.
+#define ANALOG_FILTER_EMA 0x2 // An exponential moving average, updated on every read of the device.
+
+#define ANALOG_MAX_OVERSAMPLING_BITS 4 // 256 readings (about 30 ms on an ATmega). Keeps a 10-bit value within r2Int.
+#define ANALOG_FILTER_MAX_WINDOW 9
+#define ANALOG_FILTER_MAX_EMA_SHIFT 8
 
 #define MULTIPLE_DIGITAL_OUTPUT_PORT_COUNT_POSITION 0x0 //The input position containing the number of ports (and thus the length of the argument)
 
@@ -257,6 +338,50 @@ typedef struct RequestPackage RequestPackage;
 // The response position containing host availability information
 #define RESPONSE_POSITION_HOST_AVAILABLE 0x0
 
+// The response position containing the message id of a dispatched request.
+#define RESPONSE_POSITION_DISPATCH_MESSAGE_ID 0x0
+
+// If an ACTION_GET_DEVICE response was answered from the master's cache (the node is sleeping), the age of the value (16-bit, in seconds) is appended after the value.
+#define RESPONSE_POSITION_CACHED_VALUE_AGE RESPONSE_VALUE_CONTENT_SIZE
+
+// If a request was queued by the master (the node is sleeping and the action changes its state, i.e. ACTION_SET_DEVICE or ACTION_SEND_TO_SLEEP), the response contains the id of the queued command.
+#define RESPONSE_POSITION_QUEUED_COMMAND_ID 0x0
+
+// ACTION_RH24_COMMAND_STATUS response positions. The error position contains the error code of a failed command.
+#define RESPONSE_POSITION_COMMAND_STATUS 0x0
+#define RESPONSE_POSITION_COMMAND_ERROR 0x1
+
+// The delivery states of a queued command.
+#define COMMAND_STATUS_QUEUED 0x1     // Waiting for the node to check in.
+#define COMMAND_STATUS_SENT 0x2       // Sent to the node. Waiting for the response.
+#define COMMAND_STATUS_DELIVERED 0x3  // The node has executed the command.
+#define COMMAND_STATUS_FAILED 0x4     // The node responded with an error or RH24_COMMAND_MAX_ATTEMPTS was reached.
+
+// ACTION_RH24_SET_GROUPS response position. The group mask now used by the node.
+#define RESPONSE_POSITION_GROUPS_MASK 0x0
+
+// ACTION_RH24_GROUP response. The first byte is the number of members in the group, followed by one entry per successful reply: [node id, the first 16 bits of the reply's content].
+#define RESPONSE_POSITION_GROUP_MEMBER_COUNT 0x0
+#define RESPONSE_POSITION_GROUP_ENTRIES 0x1
+#define RESPONSE_GROUP_ENTRY_SIZE 3
+
+// ACTION_RH24_LINK_STATS response positions. The counters (one byte each) are counted since the previous ACTION_RH24_LINK_STATS.
+#define RESPONSE_POSITION_LINK_SEND_FAILURES 0x0  // Failed writes from the master.
+#define RESPONSE_POSITION_LINK_TIMEOUTS 0x1       // Requests never responded to.
+#define RESPONSE_POSITION_LINK_RETRIES 0x2        // Writes the node had to retry (reported by its pings).
+#define RESPONSE_POSITION_LINK_RTT 0x3            // Average round-trip time (16-bit, in ms).
+#define RESPONSE_POSITION_LINK_LAST_SEEN 0x5      // Seconds since the last message (16-bit).
+#define RESPONSE_LINK_STATS_SIZE 7
+
+// ACTION_RH24_TRANSFER response positions. The total size (16-bit) of the node's data, followed by the data read from the requested offset. No data is returned if the offset is at (or beyond) the end.
+#define RESPONSE_POSITION_TRANSFER_SIZE 0x0
+#define RESPONSE_POSITION_TRANSFER_DATA 0x2
+
+// ACTION_SCAN_DEVICE response positions. The number of values read, followed by the (16-bit) values. At most RESPONSE_SCAN_MAX_VALUES are returned per request.
+#define RESPONSE_POSITION_SCAN_COUNT 0x0
+#define RESPONSE_POSITION_SCAN_VALUES 0x1
+#define RESPONSE_SCAN_MAX_VALUES ((MAX_CONTENT_SIZE - 1) / 2)
+
 // -- Public methods and macros--
 
 // The size of the response on ACTION_GET_DEVICE requests
@@ -271,8 +396,8 @@ ResponsePackage interpret(byte* input);
 // Removes a device from list and free resources
 void deleteDevice(byte id);
 
-// Creates and stores a Device using the specified parameters. Returns true if successful
-bool createDevice(byte id, DEVICE_TYPE type, byte* input);
+// Creates and stores a Device using the specified parameters (`inputSize` bytes). Returns true if successful
+bool createDevice(byte id, DEVICE_TYPE type, byte* input, byte inputSize);
 
 // Tries to reserve the IO-Port. if reserved: return false and sets the error flag if port was already reserved.
 bool reservePort(byte IOPort);
@@ -286,6 +411,12 @@ void setValue(Device* device, r2Int value);
 // Returns the value(s) of a device. `params` is optional and in most cases not required, since most `Device`'s are mapped to exacly one value.
 r2Int* getValue(Device* device, byte* params);
 
+// Reads up to maxCount values of a multi-value device, starting with the value at index first. Returns the number of values read.
+byte scanDevice(Device* device, byte first, r2Int* values, byte maxCount);
+
+// Runs the background measurements of sonar and DHT11 devices. Should be called in loop().
+void loop_devices();
+
 // Performs the actions requested by the RequestPackage.
 ResponsePackage execute(RequestPackage *request);
 
@@ -134,15 +134,43 @@ ResponsePackage execute(RequestPackage *request) {
       
   } else if (request->action == ACTION_GET_NODES) {
   
-    HOST_ADDRESS *nodes = getNodes();
-    int count = nodeCount() > MAX_CONTENT_SIZE ? MAX_CONTENT_SIZE : nodeCount();
-    
-    response.contentSize = count;
-    
-    for (int i = 0; i < count; i++) { response.content[i] = nodes[i];  }
-    
-    free(nodes);
+    response.contentSize = getNodes(response.content, MAX_CONTENT_SIZE);
+  
+#ifdef RH24_DISPATCH
+  } else if (isMaster() && request->action == ACTION_RH24_DISPATCH) {
+  
+    response.contentSize = 1;
+    response.content[RESPONSE_POSITION_DISPATCH_MESSAGE_ID] = rh24Dispatch(request);
+  
+  } else if (isMaster() && request->action == ACTION_RH24_COLLECT) {
+  
+    response = rh24Collect(request->host, request->args[REQUEST_ARG_COLLECT_MESSAGE_ID_POSITION]);
+  
+#endif
+#ifdef RH24_COMMAND_QUEUE
+  } else if (isMaster() && request->action == ACTION_RH24_COMMAND_STATUS) {
+  
+    response = rh24CommandStatus(request->host, request->args[REQUEST_ARG_COMMAND_STATUS_ID_POSITION]);
+  
+#endif
+#ifdef RH24_TRANSFER
+  } else if (isMaster() && request->action == ACTION_RH24_TRANSFER) {
+  
+    response = rh24Transfer(request->host, request->args[REQUEST_ARG_TRANSFER_OFFSET_POSITION] | (request->args[REQUEST_ARG_TRANSFER_OFFSET_POSITION + 1] << 8));
+  
+#endif
+#ifdef RH24_LINK_STATS
+  } else if (isMaster() && request->action == ACTION_RH24_LINK_STATS) {
   
+    response = rh24LinkStats(request->host);
+  
+#endif
+#ifdef RH24_GROUPS
+  } else if (isMaster() && request->action == ACTION_RH24_GROUP) {
+  
+    response = rh24Group(request);
+  
+#endif
   } else if (isMaster() && request->host != getNodeId()) {
   
     R2_LOG(F("SENDING RH24 PACKAGE TO:"));
@@ -176,6 +204,37 @@ ResponsePackage execute(RequestPackage *request) {
        
     }
     
+  } else if (request->action == ACTION_RH24_SET_SAMPLING) {
+  
+    if (isMaster()) {
+      
+      err("E: I'm master.", ERROR_RH24_SLAVE_ONLY_ACTION, request->action);
+      
+    } else if (!getDevice(request->id)) {
+    
+      err("E: Dev.not found", ERROR_CODE_NO_DEVICE_FOUND, request->id);
+      
+    } else if (!setSampling(request->id, request->args[REQUEST_ARG_SAMPLING_INTERVAL_POSITION] | (request->args[REQUEST_ARG_SAMPLING_INTERVAL_POSITION + 1] << 8))) {
+    
+      err("E: sampling", ERROR_RH24_SAMPLING_FULL, request->id);
+      
+    }
+    
+#ifdef RH24_GROUPS
+  } else if (request->action == ACTION_RH24_SET_GROUPS) {
+  
+    if (isMaster()) {
+      
+      err("E: I'm master.", ERROR_RH24_SLAVE_ONLY_ACTION, request->action);
+      
+    } else {
+    
+      response.contentSize = 1;
+      response.content[RESPONSE_POSITION_GROUPS_MASK] = setGroups(request->args[REQUEST_ARG_GROUPS_MASK_POSITION]);
+      
+    }
+    
+#endif
   } else if (request->action == ACTION_CHECK_SLEEP_STATE) { 
   
     response.contentSize = 1;
@@ -236,8 +295,9 @@ ResponsePackage execute(RequestPackage *request) {
         
         // The parameters are everything (mainly port information) that comes after the type parameter.    
         byte *parameters = request->args + REQUEST_ARG_CREATE_PORT_POSITION;
+        byte parameterSize = request->argSize > REQUEST_ARG_CREATE_PORT_POSITION ? request->argSize - REQUEST_ARG_CREATE_PORT_POSITION : 0;
         
-        if (!createDevice(response.id, type, parameters)) {
+        if (!createDevice(response.id, type, parameters, parameterSize)) {
           
           // Unable to create!
           break;
@@ -294,6 +354,35 @@ ResponsePackage execute(RequestPackage *request) {
           
         } break;
 
+        case ACTION_SCAN_DEVICE: {
+          
+          Device *device = getDevice(request->id);
+
+          if (device) {
+          
+            r2Int values[RESPONSE_SCAN_MAX_VALUES];
+            byte first = request->argSize > REQUEST_ARG_SCAN_FIRST_POSITION ? request->args[REQUEST_ARG_SCAN_FIRST_POSITION] : 0;
+            byte count = scanDevice(device, first, values, RESPONSE_SCAN_MAX_VALUES);
+            
+            response.content[RESPONSE_POSITION_SCAN_COUNT] = count;
+            
+            for (int i = 0; i < count; i++) {
+            
+              response.content[RESPONSE_POSITION_SCAN_VALUES + i * 2] = values[i] & 0xFF;
+              response.content[RESPONSE_POSITION_SCAN_VALUES + i * 2 + 1] = values[i] >> 8;
+              
+            }
+            
+            response.contentSize = RESPONSE_POSITION_SCAN_VALUES + count * 2;
+            
+          } else {
+          
+            err("E: Dev.not found", ERROR_CODE_NO_DEVICE_FOUND, request->id);
+            
+          }
+          
+        } break;
+
         case ACTION_DELETE_DEVICE: {
 
           deleteDevice(request->id);
@@ -403,6 +492,8 @@ void loop() {
     statusIndicator();
   #endif
 
+  loop_devices();
+
   #ifdef USE_SERIAL
     loop_serial();
   #endif
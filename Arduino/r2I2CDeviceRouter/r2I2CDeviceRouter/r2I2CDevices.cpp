@@ -23,6 +23,336 @@ Device devices[MAX_DEVICES];
 #define MAX_PORTS 15
 byte portsInUse[MAX_PORTS];
 
+// -- Background measurements
+
+// Status of a DHT11 measurement.
+#define DHT11_STATUS_OK 0
+#define DHT11_STATUS_TIMEOUT 1
+#define DHT11_STATUS_CHECKSUM 2
+#define DHT11_STATUS_ERROR 3
+
+// Background measurement of a sonar (DEVICE_TYPE_SONAR or DEVICE_TYPE_HCSR04_SONAR). Stored in `Device.object`.
+typedef struct SonarMeasurements {
+
+#ifndef ESP8266
+  NewPing *sonar;
+#endif
+
+  unsigned int maxDistance;
+  
+  // True while a ping is in progress.
+  bool pinging;
+  
+  // True once a measurement has completed.
+  bool completed;
+  
+  // When the latest ping was started.
+  unsigned long timestamp;
+
+  // The latest distance in cm (NO_ECHO if out of range).
+  unsigned int distance;
+
+  // Set by the interrupt when the echo has been received.
+  volatile bool echoReceived;
+  volatile unsigned long echoStart;
+  volatile unsigned long echoTime;
+
+} SonarMeasurement;
+
+// Background measurement of a DHT11. Stored in `Device.object`.
+typedef struct DhtMeasurements {
+
+#ifdef ESP8266
+  DHTesp *sensor;
+#else
+  Dht11 *sensor;
+  
+  // True while the start signal is being sent.
+  bool reading;
+#endif
+
+  // True once a measurement has completed.
+  bool completed;
+
+  // When the latest read was started (or when the device was created).
+  unsigned long timestamp;
+  
+  // The latest measurement. The values are only valid if status is DHT11_STATUS_OK.
+  byte status;
+  r2Int temperature;
+  r2Int humidity;
+
+} DhtMeasurement;
+
+// Filter configuration of an analog input (DEVICE_TYPE_ANALOG_INPUT or DEVICE_TYPE_SIMPLE_MOIST). Stored in `Device.object` if configured.
+typedef struct AnalogFilters {
+
+  byte oversamplingBits;
+  byte type;
+  byte parameter;
+
+  // ANALOG_FILTER_EMA: the average scaled by 2^parameter. Seeded by the first reading.
+  bool initialized;
+  uint32_t ema;
+
+} AnalogFilter;
+
+// The sonar currently pinging. Only one sonar pings at a time (NewPing's timer is shared and it avoids crosstalk between sonars).
+SonarMeasurement* volatile activeSonar = NULL;
+
+#ifdef ESP8266
+
+  #define sonarConvertCm(echoTime) NewPingESP8266::convert_cm(echoTime)
+
+  // Measures the echo pulse of the active sonar (NewPingESP8266 has no timer support).
+  void ICACHE_RAM_ATTR sonarEchoChanged() {
+  
+    SonarMeasurement *measurement = activeSonar;
+    
+    if (measurement == NULL || measurement->echoReceived) { return; }
+    
+    if (measurement->echoStart == 0) { measurement->echoStart = micros(); }
+    else {
+    
+      measurement->echoTime = micros() - measurement->echoStart;
+      measurement->echoReceived = true;
+      
+    }
+    
+  }
+  
+#else
+
+  #define sonarConvertCm(echoTime) NewPing::convert_cm(echoTime)
+  
+  // Called by NewPing's timer interrupt while the active sonar is pinging.
+  void sonarEchoCheck() {
+  
+    SonarMeasurement *measurement = activeSonar;
+    
+    if (measurement != NULL && measurement->sonar->check_timer()) {
+    
+      measurement->echoTime = measurement->sonar->ping_result;
+      measurement->echoReceived = true;
+      
+    }
+    
+  }
+  
+#endif
+
+#ifdef TIMER2A
+
+  // NewPing's ping_timer uses Timer2, which also generates the PWM of the Timer2 pins (3 and 11 on an Uno, 9 and 10 on a Mega). Servo uses Timer1 and is not affected.
+  bool isTimer2Pin(byte pin) {
+  
+    uint8_t timer = digitalPinToTimer(pin);
+    return timer == TIMER2A || timer == TIMER2B;
+    
+  }
+  
+  // Returns true if a PWM output on a Timer2 pin and a sonar can't both be used (`pin` is the port of a new analog output or DEVICE_PORT_NOT_IN_USE for a new sonar).
+  bool timer2Conflict(byte pin) {
+  
+    for (int i = 0; i < MAX_DEVICES; i++) {
+    
+      if (pin != DEVICE_PORT_NOT_IN_USE && (devices[i].type == DEVICE_TYPE_SONAR || devices[i].type == DEVICE_TYPE_HCSR04_SONAR)) { return isTimer2Pin(pin); }
+      if (pin == DEVICE_PORT_NOT_IN_USE && devices[i].type == DEVICE_TYPE_ANALOG_OUTPUT && isTimer2Pin(devices[i].IOPorts[0])) { return true; }
+      
+    }
+    
+    return false;
+    
+  }
+  
+#else
+
+  #define timer2Conflict(pin) false
+  
+#endif
+
+// Starts a ping of the sonar device.
+void sonar_start(Device* device) {
+
+  SonarMeasurement *measurement = (SonarMeasurement *) device->object;
+  
+  measurement->echoReceived = false;
+  measurement->echoStart = 0;
+  measurement->echoTime = 0;
+  measurement->pinging = true;
+  measurement->timestamp = millis();
+  activeSonar = measurement;
+  
+#ifdef ESP8266
+  attachInterrupt(digitalPinToInterrupt(device->IOPorts[SONAR_ECHO_PORT]), sonarEchoChanged, CHANGE);
+  
+  digitalWrite(device->IOPorts[SONAR_TRIG_PORT], LOW);
+  delayMicroseconds(2);
+  digitalWrite(device->IOPorts[SONAR_TRIG_PORT], HIGH);
+  delayMicroseconds(10); 
+  digitalWrite(device->IOPorts[SONAR_TRIG_PORT], LOW);
+#else
+  measurement->sonar->ping_timer(sonarEchoCheck);
+#endif
+
+}
+
+// Stops the ping of the sonar device (if pinging).
+void sonar_stop(Device* device) {
+
+  SonarMeasurement *measurement = (SonarMeasurement *) device->object;
+  
+  if (!measurement->pinging) { return; }
+  
+#ifdef ESP8266
+  detachInterrupt(digitalPinToInterrupt(device->IOPorts[SONAR_ECHO_PORT]));
+#else
+  NewPing::timer_stop();
+#endif
+
+  measurement->pinging = false;
+  activeSonar = NULL;
+
+}
+
+// Completes the ping of the sonar device once the echo was received or the ping timed out.
+void sonar_update(Device* device) {
+
+  SonarMeasurement *measurement = (SonarMeasurement *) device->object;
+  
+  if (!measurement->echoReceived && millis() - measurement->timestamp < SONAR_PING_TIMEOUT) { return; }
+  
+  sonar_stop(device);
+  
+  unsigned int distance = measurement->echoReceived ? sonarConvertCm(measurement->echoTime) : NO_ECHO;
+  
+  measurement->distance = distance > measurement->maxDistance ? NO_ECHO : distance;
+  measurement->completed = true;
+  
+}
+
+// Starts, or completes, a read of the DHT11 device when due.
+void dht_update(Device* device) {
+
+  DhtMeasurement *measurement = (DhtMeasurement *) device->object;
+  
+#ifdef ESP8266
+
+  // Reading more often than the minimum sampling period returns the previous values.
+  unsigned long interval = measurement->sensor->getMinimumSamplingPeriod();
+  
+  if (measurement->completed && interval < DHT11_SAMPLE_INTERVAL) { interval = DHT11_SAMPLE_INTERVAL; }
+  
+  if (millis() - measurement->timestamp < interval) { return; }
+
+  measurement->timestamp = millis();
+  
+  TempAndHumidity th = measurement->sensor->getTempAndHumidity();
+  
+  switch (measurement->sensor->getStatus()) {
+  
+    case DHTesp::ERROR_NONE: measurement->status = DHT11_STATUS_OK; break;
+    case DHTesp::ERROR_TIMEOUT: measurement->status = DHT11_STATUS_TIMEOUT; break;
+    case DHTesp::ERROR_CHECKSUM: measurement->status = DHT11_STATUS_CHECKSUM; break;
+    default: measurement->status = DHT11_STATUS_ERROR;
+    
+  }
+  
+  measurement->temperature = th.temperature;
+  measurement->humidity = th.humidity;
+
+#else
+
+  if (!measurement->reading) {
+  
+    if (measurement->completed && millis() - measurement->timestamp < DHT11_SAMPLE_INTERVAL) { return; }
+    
+    measurement->timestamp = millis();
+    measurement->reading = true;
+    measurement->sensor->startRead();
+    return;
+    
+  }
+  
+  if (millis() - measurement->timestamp < Dht11::START_SIGNAL_TIME) { return; }
+  
+  measurement->reading = false;
+  
+  switch (measurement->sensor->completeRead()) {
+  
+    case Dht11::OK: measurement->status = DHT11_STATUS_OK; break;
+    case Dht11::ERROR_TIMEOUT: measurement->status = DHT11_STATUS_TIMEOUT; break;
+    case Dht11::ERROR_CHECKSUM: measurement->status = DHT11_STATUS_CHECKSUM; break;
+    default: measurement->status = DHT11_STATUS_ERROR;
+    
+  }
+  
+  measurement->temperature = measurement->sensor->getTemperature();
+  measurement->humidity = measurement->sensor->getHumidity();
+
+#endif
+
+  measurement->completed = true;
+  
+}
+
+// Returns true if the device has completed at least one background measurement.
+bool isMeasured(Device* device) {
+
+  if (device->object == NULL) { return true; }
+  
+  switch (device->type) {
+  
+    case DEVICE_TYPE_SONAR:
+    case DEVICE_TYPE_HCSR04_SONAR:
+      return ((SonarMeasurement *) device->object)->completed;
+      
+    case DEVICE_TYPE_DHT11:
+      return ((DhtMeasurement *) device->object)->completed;
+      
+  }
+  
+  return true;
+  
+}
+
+void loop_devices() {
+
+  SonarMeasurement *nextSonar = NULL;
+  Device *next = NULL;
+  
+  for (int i = 0; i < MAX_DEVICES; i++) {
+  
+    Device *device = &devices[i];
+    
+    if (device->object == NULL) { continue; }
+    
+    if (device->type == DEVICE_TYPE_DHT11) { dht_update(device); }
+    else if (device->type == DEVICE_TYPE_SONAR || device->type == DEVICE_TYPE_HCSR04_SONAR) {
+    
+      SonarMeasurement *measurement = (SonarMeasurement *) device->object;
+      
+      if (measurement->pinging) { sonar_update(device); }
+      else if (!measurement->completed || millis() - measurement->timestamp >= SONAR_SAMPLE_INTERVAL) {
+      
+        // Ping the sonar that has waited the longest (unmeasured sonars first).
+        if (next == NULL || (nextSonar->completed && (!measurement->completed || millis() - measurement->timestamp > millis() - nextSonar->timestamp))) {
+        
+          next = device;
+          nextSonar = measurement;
+          
+        }
+        
+      }
+      
+    }
+    
+  }
+  
+  if (next != NULL && activeSonar == NULL) { sonar_start(next); }
+  
+}
+
 // -- Device handling
 
 Device* getDevice(byte id) {
@@ -52,7 +382,15 @@ void deleteDevice(byte id) {
          
     } else if (devices[id].type == DEVICE_TYPE_DHT11) {
 
-        //delete devices[id].object;
+        delete ((DhtMeasurement *) devices[id].object)->sensor;
+         
+    } else if (devices[id].type == DEVICE_TYPE_SONAR || devices[id].type == DEVICE_TYPE_HCSR04_SONAR) {
+
+        sonar_stop(&devices[id]);
+        
+#ifndef ESP8266
+        delete ((SonarMeasurement *) devices[id].object)->sonar;
+#endif
          
     } else if (devices[id].type == DEVICE_TYPE_DIGITAL_OUTPUT) {
     
@@ -115,7 +453,129 @@ TODO: fix this...
   
 }
 
-bool createDevice(byte id, DEVICE_TYPE type, byte* input) {
+// Reads the analog port 4^bits times and decimates the sum, returning a value with `bits` additional bits of resolution.
+r2Int analog_oversample(byte port, byte bits) {
+
+  uint32_t sum = 0;
+  uint16_t count = 1 << (bits * 2);
+  
+  for (uint16_t i = 0; i < count; i++) { sum += analogRead(port); }
+  
+  return sum >> bits;
+  
+}
+
+// Reads the analog port using the filter of the device (if any).
+r2Int analog_read(byte port, AnalogFilter* filter) {
+
+  if (filter == NULL) { return analogRead(port); }
+  
+  switch (filter->type) {
+  
+    case ANALOG_FILTER_MEDIAN: {
+    
+      r2Int window[ANALOG_FILTER_MAX_WINDOW];
+      
+      // Insertion sort while reading the burst.
+      for (byte i = 0; i < filter->parameter; i++) {
+      
+        r2Int value = analog_oversample(port, filter->oversamplingBits);
+        byte j = i;
+        
+        for (; j > 0 && window[j - 1] > value; j--) { window[j] = window[j - 1]; }
+        
+        window[j] = value;
+        
+      }
+      
+      return window[filter->parameter / 2];
+      
+    }
+    
+    case ANALOG_FILTER_EMA: {
+    
+      uint32_t value = analog_oversample(port, filter->oversamplingBits);
+      
+      if (!filter->initialized) {
+      
+        filter->ema = value << filter->parameter;
+        filter->initialized = true;
+        
+      } else { filter->ema = filter->ema - (filter->ema >> filter->parameter) + value; }
+      
+      return filter->ema >> filter->parameter;
+      
+    }
+    
+    default:
+    
+      return analog_oversample(port, filter->oversamplingBits);
+  
+  }
+  
+}
+
+// Creates the filter of an analog input from the optional parameters following its ports. Returns false if they are invalid.
+bool createAnalogFilter(Device* device, byte* input, byte inputSize) {
+
+  if (inputSize <= ANALOG_FILTER_OVERSAMPLING_POSITION) { return true; }
+  
+  byte oversamplingBits = input[ANALOG_FILTER_OVERSAMPLING_POSITION];
+  byte type = inputSize > ANALOG_FILTER_TYPE_POSITION ? input[ANALOG_FILTER_TYPE_POSITION] : ANALOG_FILTER_NONE;
+  byte parameter = inputSize > ANALOG_FILTER_PARAMETER_POSITION ? input[ANALOG_FILTER_PARAMETER_POSITION] : 0;
+  
+  if (oversamplingBits > ANALOG_MAX_OVERSAMPLING_BITS) {
+  
+    err("Oversampling", ERROR_INVALID_FILTER, oversamplingBits);
+    return false;
+    
+  }
+  
+  switch (type) {
+  
+    case ANALOG_FILTER_NONE: break;
+    
+    case ANALOG_FILTER_MEDIAN:
+    
+      if (parameter == 0 || parameter > ANALOG_FILTER_MAX_WINDOW) {
+      
+        err("Median window", ERROR_INVALID_FILTER, parameter);
+        return false;
+        
+      } break;
+      
+    case ANALOG_FILTER_EMA:
+    
+      if (parameter == 0 || parameter > ANALOG_FILTER_MAX_EMA_SHIFT) {
+      
+        err("EMA shift", ERROR_INVALID_FILTER, parameter);
+        return false;
+        
+      } break;
+      
+    default:
+    
+      err("Filter type", ERROR_INVALID_FILTER, type);
+      return false;
+      
+  }
+  
+  // No filtering requested: use the raw analogRead.
+  if (oversamplingBits == 0 && type == ANALOG_FILTER_NONE) { return true; }
+  
+  AnalogFilter *filter = (AnalogFilter *) malloc(sizeof(AnalogFilter));
+  filter->oversamplingBits = oversamplingBits;
+  filter->type = type;
+  filter->parameter = parameter;
+  filter->initialized = false;
+  filter->ema = 0;
+  
+  device->object = (void *)filter;
+  return true;
+  
+}
+
+bool createDevice(byte id, DEVICE_TYPE type, byte* input, byte inputSize) {
 
   if (id >= MAX_DEVICES) {
     
@@ -143,6 +603,7 @@ bool createDevice(byte id, DEVICE_TYPE type, byte* input) {
     case DEVICE_TYPE_ANALOG_INPUT:
     
       if (reservePort(input[0])) { device.IOPorts[0] = input[0]; }
+      if (inputSize > 1 && !createAnalogFilter(&device, input + 1, inputSize - 1)) { return false; }
       break;
       
     case DEVICE_TYPE_DIGITAL_INPUT:
@@ -245,6 +706,9 @@ bool createDevice(byte id, DEVICE_TYPE type, byte* input) {
     pos += sensorPairCount;
     uint8_t analogInputPort = input[pos];
 
+    // The host sends the channels of all rods (SENSOR_ROD_COUNT per sensor pair).
+    sensorPairCount /= SENSOR_ROD_COUNT;
+
     memcpy(device.IOPorts, controlPorts, controlPortCount);
     memcpy(device.IOPorts + controlPortCount, multiplexerPorts, multiplexerPortCount);
 
@@ -254,34 +718,43 @@ bool createDevice(byte id, DEVICE_TYPE type, byte* input) {
     
   } break;
   
-  case DEVICE_TYPE_SONAR: {
+  case DEVICE_TYPE_SONAR:
+  case DEVICE_TYPE_HCSR04_SONAR: {
     
+      if (timer2Conflict(DEVICE_PORT_NOT_IN_USE)) {
+      
+        err("Timer2 PWM in use", ERROR_TIMER2_IN_USE);
+        return false;
+        
+      }
+      
       if (reservePort(input[SONAR_TRIG_PORT]) && reservePort(input[SONAR_ECHO_PORT])) {
 
+        device.IOPorts[SONAR_TRIG_PORT] = input[SONAR_TRIG_PORT];
+        device.IOPorts[SONAR_ECHO_PORT] = input[SONAR_ECHO_PORT];
+        
+        SonarMeasurement *measurement = (SonarMeasurement *) malloc(sizeof(SonarMeasurement));
+        
+        // The HC-SR04 has no configurable maximum distance.
+        measurement->maxDistance = device.type == DEVICE_TYPE_SONAR ? input[SONAR_MAX_DISTANCE] : MAX_SENSOR_DISTANCE;
+        measurement->pinging = false;
+        measurement->completed = false;
+        measurement->timestamp = 0;
+        measurement->distance = NO_ECHO;
+        measurement->echoReceived = false;
+        
         #ifdef ESP8266
-          NewPingESP8266 *sonar = new NewPingESP8266(SONAR_TRIG_PORT, SONAR_ECHO_PORT, input[SONAR_MAX_DISTANCE]);
+          pinMode(device.IOPorts[SONAR_TRIG_PORT], OUTPUT);
+          pinMode(device.IOPorts[SONAR_ECHO_PORT], INPUT);
         #else
-          NewPing *sonar = new NewPing(SONAR_TRIG_PORT, SONAR_ECHO_PORT, input[SONAR_MAX_DISTANCE]);
+          measurement->sonar = new NewPing(device.IOPorts[SONAR_TRIG_PORT], device.IOPorts[SONAR_ECHO_PORT], measurement->maxDistance);
         #endif
         
-        device.IOPorts[SONAR_TRIG_PORT] = input[SONAR_TRIG_PORT];
-        device.IOPorts[SONAR_ECHO_PORT] = input[SONAR_ECHO_PORT];
-        device.object = (void *)sonar;
+        device.object = (void *)measurement;
       
       }
   
     } break;
-  
-  case DEVICE_TYPE_HCSR04_SONAR:
-  
-      if (reservePort(input[SONAR_TRIG_PORT]) && reservePort(input[SONAR_ECHO_PORT])) {
-        
-        device.IOPorts[SONAR_TRIG_PORT] = input[SONAR_TRIG_PORT];
-        device.IOPorts[SONAR_ECHO_PORT] = input[SONAR_ECHO_PORT];
-        pinMode(input[SONAR_TRIG_PORT], OUTPUT);
-        pinMode(input[SONAR_ECHO_PORT], INPUT);
-   
-      } break;
       
   case DEVICE_TYPE_SERVO: { 
          
@@ -302,14 +775,20 @@ bool createDevice(byte id, DEVICE_TYPE type, byte* input) {
            
            device.IOPorts[0] = input[0];
            
+           DhtMeasurement *measurement = (DhtMeasurement *) malloc(sizeof(DhtMeasurement));
+           measurement->completed = false;
+           measurement->timestamp = millis();
+           measurement->status = DHT11_STATUS_ERROR;
+           
     #ifdef ESP8266
-           DHTesp *dht11 = new DHTesp();
-           dht11->setup(device.IOPorts[0], DHTesp::AUTO_DETECT);
-           device.object = (void *)dht11;
+           measurement->sensor = new DHTesp();
+           measurement->sensor->setup(device.IOPorts[0], DHTesp::AUTO_DETECT);
     #else
-           Dht11 *dht11 = new Dht11(device.IOPorts[0]);
-           device.object = (void *)dht11;
+           measurement->sensor = new Dht11(device.IOPorts[0]);
+           measurement->reading = false;
     #endif
+
+           device.object = (void *)measurement;
     
          }
          
@@ -324,10 +803,20 @@ bool createDevice(byte id, DEVICE_TYPE type, byte* input) {
     
         pinMode(device.IOPorts[SIMPLE_MOIST_DIGITAL_OUT], OUTPUT);
       
+        if (inputSize > SIMPLE_MOIST_PORT_COUNT && 
+            !createAnalogFilter(&device, input + SIMPLE_MOIST_PORT_COUNT, inputSize - SIMPLE_MOIST_PORT_COUNT)) { return false; }
+      
     } break;
     
     case DEVICE_TYPE_ANALOG_OUTPUT:
   
+      if (timer2Conflict(input[0])) {
+      
+        err("Timer2 used by sonar", ERROR_TIMER2_IN_USE, input[0]);
+        return false;
+        
+      }
+      
       if (reservePort(input[0])) {
         
         device.IOPorts[0] = input[0];
@@ -354,6 +843,9 @@ r2Int* getValue(Device* device, byte* params) {
   
   for (int i = 0; i < RESPONSE_VALUE_COUNT; i++) { values [i] = 0; }
   
+  // Wait for the first background measurement (i.e. when the device has just been created).
+  while (!isMeasured(device)) { loop_devices(); }
+  
   switch (device->type) {
     
     case DEVICE_TYPE_DIGITAL_INPUT:
@@ -363,35 +855,19 @@ r2Int* getValue(Device* device, byte* params) {
       
    case DEVICE_TYPE_ANALOG_INPUT:
    
-     values[0] = analogRead(device->IOPorts[0]);
+     values[0] = analog_read(device->IOPorts[0], (AnalogFilter *) device->object);
      break;
    
-   case DEVICE_TYPE_SONAR: {
+   case DEVICE_TYPE_SONAR:
+   case DEVICE_TYPE_HCSR04_SONAR: {
      
-     #ifdef ESP8266
-       NewPingESP8266 *sonar = ((NewPingESP8266 *) device->object);
-     #else
-       NewPing *sonar = ((NewPing *) device->object);
-     #endif
+     SonarMeasurement *measurement = (SonarMeasurement *) device->object;
      
-     int value = sonar->ping_cm();
-     if (value > 255) { value = 255; }
-     values[0] = value;
-     break;
+     values[0] = measurement->distance;
+     if (device->type == DEVICE_TYPE_SONAR && values[0] > 255) { values[0] = 255; }
      
-   }
-   
-   case DEVICE_TYPE_HCSR04_SONAR: {
+   } break;
    
-     digitalWrite(device->IOPorts[SONAR_TRIG_PORT], LOW);
-     delayMicroseconds(2);
-     digitalWrite(device->IOPorts[SONAR_TRIG_PORT], HIGH); //Trigger ultrasonic detection 
-     delayMicroseconds(10); 
-     digitalWrite(device->IOPorts[SONAR_TRIG_PORT], LOW);
-     long duration = pulseIn(device->IOPorts[SONAR_ECHO_PORT], HIGH); //Read ultrasonic reflection
-     values[0] = duration / HCSR04_SONAR_DISTANCE_DENOMIATOR;
-     break;
-   }
    case DEVICE_TYPE_MULTIPLEX_MOIST: {
 
      if (params == NULL) { values[0] = 0; }
@@ -406,68 +882,33 @@ r2Int* getValue(Device* device, byte* params) {
      
    case DEVICE_TYPE_DHT11: {
 
-#ifdef ESP8266
-
-        DHTesp *dht = ((DHTesp *) device->object);
-        delay(dht->getMinimumSamplingPeriod());
-        
-        TempAndHumidity th = dht->getTempAndHumidity();
-        
-        if (dht->getStatus() != DHTesp::ERROR_NONE) {
-          
-            values[RESPONSE_POSITION_DHT11_TEMPERATURE] = 0;
-            values[RESPONSE_POSITION_DHT11_HUMIDITY] = 0;
-            if (dht->getStatus() == DHTesp::ERROR_TIMEOUT) { err("DHT Timeout", ERROR_CODE_DHT11_READ_ERROR); }
-            else if (dht->getStatus() == DHTesp::ERROR_CHECKSUM) { err("DHT ChkSM", ERROR_CODE_DHT11_READ_ERROR); }
-            
-        } else {
-            
-            values[RESPONSE_POSITION_DHT11_TEMPERATURE] = th.temperature;
-            values[RESPONSE_POSITION_DHT11_HUMIDITY] = th.humidity;
-            
-        }
-        
-#else
-       Dht11 *sensor = ((Dht11 *) device->object);
+       DhtMeasurement *measurement = (DhtMeasurement *) device->object;
        
-       switch (sensor->read()) {
+       switch (measurement->status) {
          
-          case Dht11::OK: {
+          case DHT11_STATUS_OK:
             
-            r2Int temp = sensor->getTemperature();
-            r2Int humid = sensor->getHumidity();
-            values[RESPONSE_POSITION_DHT11_TEMPERATURE] = temp;
-            values[RESPONSE_POSITION_DHT11_HUMIDITY] = humid;
-            
-          } break;
+            values[RESPONSE_POSITION_DHT11_TEMPERATURE] = measurement->temperature;
+            values[RESPONSE_POSITION_DHT11_HUMIDITY] = measurement->humidity;
+            break;
           
-          case Dht11::ERROR_TIMEOUT:
+          case DHT11_STATUS_TIMEOUT:
           
-            values[RESPONSE_POSITION_DHT11_TEMPERATURE] = 0;
-            values[RESPONSE_POSITION_DHT11_HUMIDITY] = 0;
             err("DHT Timeout", ERROR_CODE_DHT11_READ_ERROR);
-            
             break;
 
-           case Dht11::ERROR_CHECKSUM:
+          case DHT11_STATUS_CHECKSUM:
           
-            values[RESPONSE_POSITION_DHT11_TEMPERATURE] = 0;
-            values[RESPONSE_POSITION_DHT11_HUMIDITY] = 0;
             err("DHT CHCKSM", ERROR_CODE_DHT11_READ_ERROR);
-            
             break;
             
           default:
           
-            values[RESPONSE_POSITION_DHT11_TEMPERATURE] = 0;
-            values[RESPONSE_POSITION_DHT11_HUMIDITY] = 0;
             err("DHT error.", ERROR_CODE_DHT11_READ_ERROR);
-       
             break;
        
        }
-#endif
-       // silent error
+       
    } break;
    
    
@@ -477,7 +918,7 @@ r2Int* getValue(Device* device, byte* params) {
       delayMicroseconds(2);
       analogRead(device->IOPorts[SIMPLE_MOIST_ANALOGUE_IN]); // First reading tends to be invalid
       delayMicroseconds(2);
-      values[0] = analogRead(device->IOPorts[SIMPLE_MOIST_ANALOGUE_IN]);
+      values[0] = analog_read(device->IOPorts[SIMPLE_MOIST_ANALOGUE_IN], (AnalogFilter *) device->object);
       digitalWrite(device->IOPorts[SIMPLE_MOIST_DIGITAL_OUT], LOW); // End measurement
       
     } break;
@@ -488,6 +929,30 @@ r2Int* getValue(Device* device, byte* params) {
   
 }
 
+byte scanDevice(Device* device, byte first, r2Int* values, byte maxCount) {
+
+  switch (device->type) {
+  
+    case DEVICE_TYPE_MULTIPLEX_MOIST: {
+    
+      int readings[maxCount];
+      byte count = ((R2Moist *) device->object)->Scan(readings, first, maxCount);
+      
+      for (int i = 0; i < count; i++) { values[i] = readings[i]; }
+      
+      return count;
+      
+    }
+    
+    default:
+    
+      err("Unable to scan device.", ERROR_CODE_DEVICE_TYPE_NOT_FOUND_READ_DEVICE, device->type);
+      return 0;
+      
+  }
+  
+}
+
 void setValue(Device* device, r2Int value) {
 
   switch (device->type) {
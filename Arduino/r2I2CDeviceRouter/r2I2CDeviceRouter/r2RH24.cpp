@@ -24,6 +24,9 @@
 // The default sleep cycles used by the WDT 
 #define RH24_SLEEP_CYCLES WDTO_2S
 
+// The length (in ms) of a sleep cycle (RH24_SLEEP_CYCLES). The WDT oscillator is only accurate to about 10%.
+#define RH24_SLEEP_CYCLE_LENGTH 2000
+
 // Maximum number of seconds for the paus sleep interval.
 #define MAX_PAUSE_SLEEP_SECONDS 60
 
@@ -53,22 +56,439 @@ uint32_t slaveRenewalFailures = 0;
 
 // Ping message from non-master nodes to master node
 #define RH24_MESSAGE_PING 'P'
+
+// Request multicast from the master to the members of a group. The host of the request contains the group.
+#define RH24_MESSAGE_GROUP 'G'
+
+// Bulk transfer request (master) and chunks (slave).
+#define RH24_MESSAGE_TRANSFER 'T'
+
+// A value sampled by a sleeping slave. Contains the ResponsePackage of an ACTION_GET_DEVICE request.
+#define RH24_MESSAGE_SAMPLE 'S'
           
 // Keeps track of the ping intervals.
 unsigned long pingTimer = 0;
 
+// The current ping interval. Adapts to the link quality.
+unsigned long pingInterval = RH24_PING_INTERVAL;
+
+// The current address renewal interval. Adapts to the link quality.
+unsigned long renewalInterval = RH24_NETWORK_RENEWAL_TIME;
+
+// The number of writes the slave had to retry since its last ping.
+byte slaveWriteRetries = 0;
+
+// States for the entries in the pending request table.
+#define RH24_PENDING_UNUSED 0
+#define RH24_PENDING_WAITING 1
+#define RH24_PENDING_DONE 2
+#define RH24_PENDING_TIMEOUT 3
+
+// Frame sent from the master to a slave. The slave returns the messageId in its ResponsePackage, allowing the master to match the response with the request.
+struct RH24RequestFrame {
+
+    byte messageId;
+    RequestPackage request;
+
+} __attribute__((__packed__));
+
+typedef struct RH24RequestFrame RH24RequestFrame;
+
+#define requestFrameSize(frame) (1 + requestPackageSize(&(frame)->request))
+
+// A request sent by the master, waiting for (or containing) the response from a slave.
+typedef struct RH24PendingRequests {
+
+  // The node the request was sent to.
+  HOST_ADDRESS nodeId;
+
+  // The id of the RH24RequestFrame used.
+  byte messageId;
+
+  // One of the RH24_PENDING_ states.
+  byte state;
+
+  // When the request was sent.
+  unsigned long timestamp;
+
+  // The response (if state is RH24_PENDING_DONE).
+  ResponsePackage response;
+
+  // If true, the response will be stored in the value cache (the request was a ACTION_GET_DEVICE without arguments).
+  bool cacheable;
+
+} RH24PendingRequest;
+
+// Outstanding requests, keyed by (nodeId, messageId).
+RH24PendingRequest pendingRequests[RH24_MAX_PENDING_REQUESTS];
+
+// Used to tag the requests sent by the master.
+byte rh24MessageId = 0;
+
+#ifdef RH24_VALUE_CACHE
+
+// The latest value read from a device on a node.
+typedef struct RH24CachedValues {
+
+  HOST_ADDRESS nodeId;
+  byte deviceId;
+
+  // True if the entry contains a value.
+  bool used;
+
+  // If true, a fresh read will be sent once the node checks in.
+  bool refresh;
+
+  // True while waiting for the response to the fresh read sent with messageId.
+  bool refreshing;
+  byte messageId;
+
+  // When the value was read.
+  unsigned long timestamp;
+
+  byte content[RESPONSE_VALUE_CONTENT_SIZE];
+
+} RH24CachedValue;
+
+// Values used to answer ACTION_GET_DEVICE requests for sleeping nodes.
+RH24CachedValue valueCache[RH24_VALUE_CACHE_SIZE];
+
+#endif
+
+// Bitmap of the nodes believed to be in sleep mode.
+byte sleepingNodes[32];
+
+// When (see slave_clock) a sleeping slave checks in next.
+unsigned long slaveNextCheckIn = 0;
+
+// The time (in ms) this slave has spent sleeping. millis() is stopped while sleeping.
+unsigned long slaveSleepTime = 0;
+
+// A device sampled by a sleeping slave.
+typedef struct RH24SampledDevices {
+
+  byte deviceId;
+
+  // The sampling interval in seconds. 0 if unused.
+  uint16_t interval;
+
+  // When (see slave_clock) the device is to be sampled next.
+  unsigned long deadline;
+
+} RH24SampledDevice;
+
+// The devices sampled while sleeping (see ACTION_RH24_SET_SAMPLING).
+RH24SampledDevice samplingSchedule[RH24_MAX_SAMPLED_DEVICES];
+
+// Keeps the slave awake during RH24_CHECK_IN_WINDOW.
+unsigned long checkInTimer = 0;
+
+// True if the master's last ping reply had RH24_PING_REPLY_FLAG_QUEUE set, i.e. requests for this slave are held until it checks in.
+bool slaveMasterQueues = false;
+
+#ifdef RH24_COMMAND_QUEUE
+
+// A request stored until the (sleeping) node checks in (see master_isQueuedAction).
+typedef struct RH24QueuedCommands {
+
+  byte commandId;
+
+  // 0 if unused. Otherwise one of the COMMAND_STATUS_ states.
+  byte state;
+
+  // The number of times the command has been sent.
+  byte attempts;
+
+  // The message id used when the command was last sent.
+  byte messageId;
+
+  // The error code if the state is COMMAND_STATUS_FAILED.
+  byte error;
+
+  // When the command was queued or finished.
+  unsigned long timestamp;
+
+  // When the command was last sent. It times out after RH24_READ_TIMEOUT ms.
+  unsigned long sent;
+
+  RequestPackage request;
+
+} RH24QueuedCommand;
+
+// Commands waiting to be delivered to sleeping nodes.
+RH24QueuedCommand commandQueue[RH24_COMMAND_QUEUE_SIZE];
+
+// Used to identify the queued commands.
+byte rh24CommandId = 0;
+
+#endif
+
+#ifdef RH24_GROUPS
+
+// Bitmaps of the members of each group.
+byte groupMembers[RH24_MAX_GROUPS][32];
+
+// True while the master is waiting for replies to a group request.
+bool groupActive = false;
+
+// The message id of the active group request.
+byte groupMessageId = 0;
+
+// Bitmap of the members who have replied to the active group request.
+byte groupReplied[32];
+
+// The number of replies to the active group request.
+byte groupReplyCount = 0;
+
+// The aggregated replies to the active group request.
+ResponsePackage groupResponse;
+
+// The groups this slave belongs to.
+byte slaveGroups = 0;
+
+// True if the slave has a reply to a group request waiting for its slot.
+bool slaveGroupReplyPending = false;
+
+// The reply to a group request.
+ResponsePackage slaveGroupReply;
+
+// When the group request was received.
+unsigned long slaveGroupReplyTimer = 0;
+
+#endif
+
+#ifdef RH24_LINK_STATS
+
+// Link statistics for a node, gathered by the master.
+typedef struct RH24LinkStatistics {
+
+  HOST_ADDRESS nodeId;
+  bool used;
+
+  byte sendFailures;
+  byte timeouts;
+  byte retries;
+
+  // Average round-trip time in ms.
+  uint16_t rtt;
+
+  unsigned long lastSeen;
+
+} RH24LinkStats;
+
+RH24LinkStats linkStats[RH24_LINK_STATS_SIZE];
+
+#endif
+
+#ifdef RH24_TRANSFER
+
+// Sent by the master to request a window of chunks. Acknowledges everything before the offset.
+struct RH24TransferRequest {
+
+    byte transferId;
+    uint16_t offset;
+    byte window;
+
+} __attribute__((__packed__));
+
+typedef struct RH24TransferRequest RH24TransferRequest;
+
+// A part of the slave's transfer data.
+struct RH24TransferChunk {
+
+    byte transferId;
+    uint16_t totalSize;
+    uint16_t offset;
+    byte size;
+    byte data[RH24_TRANSFER_CHUNK_SIZE];
+
+} __attribute__((__packed__));
+
+typedef struct RH24TransferChunk RH24TransferChunk;
+
+#define transferChunkSize(chunk) (sizeof(RH24TransferChunk) - RH24_TRANSFER_CHUNK_SIZE + (chunk)->size)
+
+// The window currently buffered by the master.
+byte transferBuffer[RH24_TRANSFER_WINDOW * RH24_TRANSFER_CHUNK_SIZE];
+HOST_ADDRESS transferNode = 0;
+byte transferId = 0;
+uint16_t transferStart = 0;
+uint16_t transferBuffered = 0;
+uint16_t transferTotalSize = 0;
+
+// Set once the first chunk of the window has been received and if a chunk was lost.
+bool transferResponded = false;
+bool transferInterrupted = false;
+
+// The data offered by the slave.
+const byte* slaveTransferData = NULL;
+uint16_t slaveTransferSize = 0;
+
+#endif
+
+#ifdef RH24_DISPATCH
+
+// Responses that matched no outstanding request (i.e. arriving after rh24Send gave up). Kept for rh24Collect, oldest first.
+ResponsePackage lateResponses[RH24_LATE_RESPONSE_QUEUE_SIZE];
+byte lateResponseCount = 0;
+
+#endif
+
+// A check-in (ping) received by the master.
+typedef struct RH24CheckIns {
+
+  HOST_ADDRESS nodeId;
+  
+  // The address the ping was sent from.
+  uint16_t address;
+  
+  // When the ping was read.
+  unsigned long received;
+
+} RH24CheckIn;
+
+// Check-ins waiting to be answered by the run loop (see master_handleCheckIns).
+RH24CheckIn checkIns[RH24_CHECK_IN_QUEUE_SIZE];
+byte checkInCount = 0;
+
+// Increments a counter without overflowing.
+#define saturatedIncrement(counter) if ((counter) < 0xFF) { (counter)++; }
+
 // -- Private method declarations --
 
 #endif
 
-// Blocks for RH24_READ_TIMEOUT ms and waits for a ResponsePackage from any node.
-ResponsePackage master_tryReadMessage();
+// Sends the request to a node and adds it to the pending request table. Returns NULL (and sets the error state) if the request could not be sent.
+RH24PendingRequest* master_dispatch(RequestPackage* request);
+
+// Sends the request to a node in a frame tagged with the message id. Returns false (and sets the error state) if the request could not be sent.
+bool master_write(RequestPackage* request, byte messageId);
+
+// Blocks until the pending request has been responded to or has timed out.
+void master_waitForResponse(RH24PendingRequest* pending);
+
+// Stores the response if it belongs to an outstanding request. Returns true if it did.
+bool master_storeResponse(ResponsePackage* response);
+
+// Marks the outstanding requests and sent commands older than RH24_READ_TIMEOUT as timed out.
+void master_updatePendingRequests();
+
+#ifdef RH24_VALUE_CACHE
+
+// Returns the cached value for a device on a node or NULL if there is none.
+RH24CachedValue* master_getCachedValue(HOST_ADDRESS nodeId, byte deviceId);
+
+// Creates a ACTION_GET_DEVICE response using a cached value, with the age of the value appended.
+ResponsePackage master_createCachedResponse(RH24CachedValue* cached);
+
+#endif
+
+// Stores the value of a ACTION_GET_DEVICE response. Does nothing without RH24_VALUE_CACHE.
+void master_cacheValue(ResponsePackage* response);
+
+// Stores the response to a fresh read sent when the node checked in. Returns false if it wasn't one.
+bool master_refreshResponse(ResponsePackage* response);
+
+// Removes all cached values of a node (i.e. if it has been reinitialized).
+void master_clearCachedValues(HOST_ADDRESS nodeId);
+
+// Remember the sleep state of a node.
+void master_setNodeSleeping(HOST_ADDRESS nodeId, bool sleeping);
+
+// Returns true if the node is believed to be in sleep mode.
+bool master_isNodeSleeping(HOST_ADDRESS nodeId);
+
+// Sends the requests queued for a node which just checked in. Does not alter the error state.
+void master_nodeCheckedIn(HOST_ADDRESS nodeId);
+
+// Stores a check-in until the run loop answers it. Ignored if the node has already checked in or the queue is full.
+void master_queueCheckIn(HOST_ADDRESS nodeId, uint16_t address);
+
+// Answers the queued check-ins and sends the requests queued for the nodes. Must not be called while rh24Send waits for a response.
+void master_handleCheckIns();
+
+#ifdef RH24_COMMAND_QUEUE
+
+// Returns true if the action is queued for a sleeping node instead of being sent (i.e. it changes the node's state and its response contains no value).
+bool master_isQueuedAction(ACTION_TYPE action);
+
+// Stores the request until the node checks in. Returns a response containing the command id.
+ResponsePackage master_queueCommand(RequestPackage* request);
+
+// Requeues (or fails) a sent command whose request timed out.
+void master_commandTimedOut(RH24QueuedCommand* command);
+
+// Sets the final state of a command.
+void master_finishCommand(RH24QueuedCommand* command, byte state, byte error);
+
+#endif
+
+// Updates the state of a sent command using the response of the node. Returns false if the response didn't belong to a command.
+bool master_commandResponse(ResponsePackage* response);
+
+// Remember the groups a node belongs to. Does nothing without RH24_GROUPS.
+void master_setNodeGroups(HOST_ADDRESS nodeId, byte mask);
+
+// Adds the reply to the active group request. Returns false if the response wasn't a reply to it.
+bool master_storeGroupReply(ResponsePackage* response);
+
+#ifdef RH24_LINK_STATS
+
+// Returns the link statistics for a node, adding it (replacing the least recently seen) if it wasn't found.
+RH24LinkStats* master_getLinkStats(HOST_ADDRESS nodeId);
+
+#endif
+
+// Updates the link statistics of a node. These do nothing without RH24_LINK_STATS.
+void master_linkSeen(HOST_ADDRESS nodeId);
+void master_linkSendFailed(HOST_ADDRESS nodeId);
+void master_linkTimedOut(HOST_ADDRESS nodeId);
+void master_addLinkRetries(HOST_ADDRESS nodeId, byte retries);
+
+// Adds a round-trip time sample to the node's average.
+void master_addRoundTrip(HOST_ADDRESS nodeId, unsigned long rtt);
+
+// Tries to rejoin the mesh using the address stored in EEPROM. Returns false if a full address request is required.
+bool slave_rejoin();
+
+// Stores the current mesh address in EEPROM (if it has changed).
+void slave_saveAddress();
+
+#ifdef RH24_TRANSFER
+
+// Adds a chunk to the buffered window if it's the next one expected.
+void master_storeTransferChunk(RH24TransferChunk* chunk);
+
+// Sends the requested window of chunks to the master.
+void slave_readTransferRequest(RF24NetworkHeader header);
+
+#endif
+
+#ifdef RH24_GROUPS
+
+// Reads a group request and prepares the reply if this node is a member.
+void slave_readGroupMessage(RF24NetworkHeader header);
+
+#endif
+
+// Sends the response to the master. Returns false if the write failed.
+bool slave_writeResponse(ResponsePackage* response);
+
+// Sends a ping message ([node id, sleep state]) to the master. Returns false if the write failed.
+bool slave_sendPing();
 
-// Reads the latest message from any node. 
-ResponsePackage master_readResponse();
+// Reads every frame waiting in the network queue: stores responses, group replies, transfer chunks and check-ins.
+void master_readFrames();
 
-// Will clean the buffer and hopefully return a "ACTION_RH24_NO_MESSAGE_READ" if the buffer was empty. Run this method prior to any transmission.
-ResponsePackage master_readClean(RequestPackage* request);
+// Stores a response that matched no outstanding request, replacing the oldest one if the queue is full. Drops it without RH24_DISPATCH.
+void master_storeLateResponse(ResponsePackage* response);
+
+#ifdef RH24_DISPATCH
+
+// Removes a late response from the queue. Returns false if there is no response from the node with the message id.
+bool master_takeLateResponse(HOST_ADDRESS nodeId, byte messageId, ResponsePackage* response);
+
+#endif
 
 // Slave run loop: check network status, send ping and renew address
 void slave_networkCheck();
@@ -76,6 +496,24 @@ void slave_networkCheck();
 // Slave run loop: handle sleeping
 void slave_handleSleep();
 
+// Returns the time (in ms) since this slave started, including the time spent sleeping.
+unsigned long slave_clock();
+
+// Returns the time (in ms) between the check-ins of this sleeping slave.
+unsigned long slave_checkInInterval();
+
+// Returns when (see slave_clock) this sleeping slave has to wake up next: the earliest sampling deadline or check-in.
+unsigned long slave_nextWakeUp();
+
+// Samples the devices due before the end of the next sleep cycle and checks in. Everything is sent in a single wake window.
+void slave_wakeUp();
+
+// Reads the device and sends the value to the master's cache. Returns false if the read or write failed.
+bool slave_sendSample(byte deviceId);
+
+// Returns the number of commands and cache refreshes waiting for the node to check in.
+byte master_queuedCount(HOST_ADDRESS nodeId);
+
 // Reads a ping from the network 
 void slave_readPing(RF24NetworkHeader header);
 
@@ -129,15 +567,30 @@ void rh24Setup() {
   reservePort(RH24_PORT1);
   reservePort(RH24_PORT2);
   
-  if (!isMaster()) {  R2_LOG(F("Setting up as slave and ")); }
+  if (!isMaster()) {  
+  
+    R2_LOG(F("Setting up as slave and ")); 
+    
+#ifdef RH24_GROUPS
+    // Forward group requests to the nodes further away from the master.
+    network.multicastRelay = true;
+#endif
+    
+  }
 
   mesh.setNodeID(id);
   mesh.setChild(isMaster());
 
   //radio.setPALevel(RF24_PA_HIGH);
   
-  if (mesh.begin()) { R2_LOG(F("Did start mesh network")); } 
-  else {
+  if (!isMaster() && slave_rejoin()) { R2_LOG(F("Did rejoin mesh network")); }
+  else if (mesh.begin()) { 
+  
+    R2_LOG(F("Did start mesh network")); 
+    
+    if (!isMaster()) { slave_saveAddress(); }
+    
+  } else {
     delay(1000);
     err("E: mesh.begin()", ERROR_RH24_TIMEOUT); 
     arghhhh();
@@ -157,9 +610,10 @@ bool nodeAvailable(HOST_ADDRESS nodeId) {
 
   if (nodeId == DEVICE_HOST_LOCAL) { return true; }
   
-  for (int i = 0; i < mesh.addrListTop; i++) {
+  // Only the master keeps track of the addresses.
+  if (!isMaster()) { return false; }
   
-    if (nodeId == mesh.addrList[i].nodeID) { 
+  if (mesh.getAddress(nodeId) >= 0) { 
     
       return true;
       
@@ -176,8 +630,6 @@ bool nodeAvailable(HOST_ADDRESS nodeId) {
       free(request);
       return response.action == ACTION_RH24_PING_SLAVE;
       
-    }
-  
   }
   
   return false;
@@ -186,33 +638,77 @@ bool nodeAvailable(HOST_ADDRESS nodeId) {
 
 int nodeCount() { return mesh.addrListTop; }
 
-HOST_ADDRESS* getNodes() {
+byte getNodes(HOST_ADDRESS* nodes, byte maxCount) {
 
-    HOST_ADDRESS* addresses = (HOST_ADDRESS*)malloc(mesh.addrListTop);
+    byte count = mesh.addrListTop < maxCount ? mesh.addrListTop : maxCount;
     
-    for (int i = 0; i < mesh.addrListTop; i++) { addresses[i] = mesh.addrList[i].nodeID; }
+    for (int i = 0; i < count; i++) { nodes[i] = mesh.addrList[i].nodeID; }
     
-    return addresses;
+    return count;
   
 }
 
-ResponsePackage master_readClean(RequestPackage* request) {
+ResponsePackage rh24Send(RequestPackage* request) {
 
-  ResponsePackage response = master_readResponse();
+#ifdef RH24_COMMAND_QUEUE
+  // The node will not hear the command until it checks in.
+  if (master_isQueuedAction(request->action) && master_isNodeSleeping(request->host)) { 
   
-  // Remove any messages still in the pipe (and return an error if there are any non-ping messages)
-  while (response.action != ACTION_RH24_NO_MESSAGE_READ) {
+    return master_queueCommand(request); 
+    
+  }
+#endif
+
+#ifdef RH24_VALUE_CACHE
+  if (request->action == ACTION_GET_DEVICE && request->argSize == 0 && master_isNodeSleeping(request->host)) {
   
-    if (response.action != ACTION_RH24_NO_MESSAGE_READ && 
-        response.action != ACTION_RH24_PING) {
+    RH24CachedValue* cached = master_getCachedValue(request->host, request->id);
     
-          // A message was read, which means that there was unread messages in the pipe. 
-      err("E: Sync", ERROR_RH24_MESSAGE_SYNCHRONIZATION, request->action);
-      break;
+    // Answer from the cache and read a fresh value once the node checks in.
+    if (cached) { 
+    
+      cached->refresh = true;
+      return master_createCachedResponse(cached);
       
     }
     
-    response = master_readResponse();
+  }
+#endif
+  
+  ResponsePackage response;
+  response.host = request->host;
+  response.id = request->id;
+  response.action = ACTION_RH24_NO_MESSAGE_READ;
+  response.contentSize = 0;
+  
+#ifndef RH24_VALUE_CACHE
+  // The master has nowhere to store the sampled values.
+  if (request->action == ACTION_RH24_SET_SAMPLING) {
+  
+    err("E: no cache", ERROR_CODE_UNKNOWN_ACTION, request->action);
+    return response;
+    
+  }
+#endif
+  
+  // Frames left in the queue (i.e. late responses) are sorted out before sending, so they can't be mistaken for the response.
+  master_readFrames();
+  
+  RH24PendingRequest* pending = master_dispatch(request);
+  
+  if (!pending) { return response; }
+  
+  master_waitForResponse(pending);
+  
+  // The message id allows a late response to be read using rh24Collect.
+  if (pending->state == RH24_PENDING_DONE) { response = pending->response; } 
+  else { err("Read timeout", ERROR_RH24_TIMEOUT, pending->messageId); }
+  
+  pending->state = RH24_PENDING_UNUSED;
+  
+  if (request->action == ACTION_SEND_TO_SLEEP && !isError() && !isError(response)) {
+  
+    master_setNodeSleeping(request->host, request->args[SLEEP_MODE_TOGGLE_POSITION]);
     
   }
   
@@ -220,46 +716,79 @@ ResponsePackage master_readClean(RequestPackage* request) {
   
 }
 
-ResponsePackage rh24Send(RequestPackage* request) {
+#ifdef RH24_DISPATCH
+
+byte rh24Dispatch(RequestPackage* request) {
+
+  if (request->argSize < 1) {
+  
+    err("E: dispatch size", ERROR_INVALID_REQUEST_PACKAGE_SIZE, request->argSize);
+    return 0;
+    
+  }
+  
+  // Unwrap the request that should be sent to the node.
+  RequestPackage dispatched;
+  
+  dispatched.host = request->host;
+  dispatched.action = request->args[REQUEST_ARG_DISPATCH_ACTION_POSITION];
+  dispatched.id = request->id;
+  dispatched.argSize = request->argSize - 1;
+  memcpy(dispatched.args, request->args + REQUEST_ARG_DISPATCH_ACTION_POSITION + 1, dispatched.argSize);
+  dispatched.checksum = createRequestChecksum(&dispatched);
+  
+  RH24PendingRequest* pending = master_dispatch(&dispatched);
+  
+  return pending ? pending->messageId : 0;
+  
+}
 
-  // Make sure there are nothing unread in the input buffer 
-  ResponsePackage response = master_readClean(request);
+ResponsePackage rh24Collect(HOST_ADDRESS nodeId, byte messageId) {
+
+  ResponsePackage response;
+  response.host = nodeId;
+  response.id = 0;
+  response.action = ACTION_RH24_NO_MESSAGE_READ;
+  response.contentSize = 0;
+  
+  // Store the responses received since the last run loop iteration.
+  master_readFrames();
   
-  // If synchronization issues occurred
-  if (isError()) { return response; }
+  master_updatePendingRequests();
   
-  for (int i = 0; i < mesh.addrListTop; i++) {
+  for (int i = 0; i < RH24_MAX_PENDING_REQUESTS; i++) {
   
-    if (request->host == mesh.addrList[i].nodeID) {
+    RH24PendingRequest* pending = &pendingRequests[i];
     
-        RF24NetworkHeader header(mesh.addrList[i].address, RH24_MESSAGE);
-        
-        if (!network.write(header, request, requestPackageSize(request))) {
-        
-            err("E: slave write.", ERROR_RH24_WRITE_ERROR, request->host);
-            return response;
-            
-        } else {
-          
-             response = master_tryReadMessage();
-             
-             // ignore ping messages:
-             while (!isError() && response.action == ACTION_RH24_PING) { response = master_tryReadMessage(); }
-             
-             return response;
-   
-        }
-        
-     }
+    if (pending->state == RH24_PENDING_UNUSED || pending->nodeId != nodeId || pending->messageId != messageId) { continue; }
+    
+    if (pending->state == RH24_PENDING_WAITING) {
+    
+      err("E: pending", ERROR_RH24_RESPONSE_PENDING, messageId);
+      return response;
+      
+    }
+    
+    if (pending->state == RH24_PENDING_DONE) { response = pending->response; } 
+    else { err("Read timeout", ERROR_RH24_TIMEOUT, messageId); }
+    
+    pending->state = RH24_PENDING_UNUSED;
+    
+    return response;
     
   }
   
-  err("E: slave dead?", ERROR_RH24_NODE_NOT_AVAILABLE, (byte) mesh.addrListTop);
+  // The response arrived after its request was given up.
+  if (master_takeLateResponse(nodeId, messageId, &response)) { return response; }
+  
+  err("E: message id", ERROR_RH24_UNKNOWN_MESSAGE_ID, messageId);
   
   return response;
   
 }
 
+#endif
+
 void sleep(bool on) { sleep(on, RH24_SLEEP_UNTIL_MESSAGE_RECEIVED); }
 
 void pauseSleep() { pauseSleep(PAUSE_SLEEP_DEFAULT_INTERVAL); }
@@ -304,13 +833,10 @@ bool isSleeping() { return shouldSleep; }
 
 // -- Private method bodies
 
-ResponsePackage master_readResponse() {
+void master_readFrames() {
 
-   ResponsePackage response;
-   response.id = 0;
-   response.action = ACTION_RH24_NO_MESSAGE_READ;
-   
-  if (network.available()) {
+  // Empty the queue, so that a response to an old request never blocks the frames behind it.
+  while (network.available()) {
   
         RF24NetworkHeader header;
         network.peek(header);
@@ -318,236 +844,1598 @@ ResponsePackage master_readResponse() {
         switch (header.type) {
           
           case RH24_MESSAGE: {
+          
+            ResponsePackage response;
         
              // Try to read the response from the slave
             byte bytesRead = network.read(header, &response, sizeof(ResponsePackage));
             
-            if (bytesRead < MIN_REQUEST_SIZE) {  err("E: read size", ERROR_RH24_BAD_SIZE_READ, bytesRead); } 
-            else { 
-                
-              R2_LOG(F("Read m/a/ui:"));
-              R2_LOG(response.messageId); 
-              R2_LOG(response.action);
-              R2_LOG(response.host);
+            // Not related to the request currently being handled, so it's logged rather than reported.
+            if (bytesRead < MIN_REQUEST_SIZE) { 
+            
+              R2_LOG(F("E: read size"));
+              R2_LOG(bytesRead);
+              break;
               
-            }
+            } 
+              
+            master_linkSeen(response.host);
+              
+            R2_LOG(F("Read m/a/ui:"));
+            R2_LOG(response.messageId); 
+            R2_LOG(response.action);
+            R2_LOG(response.host);
             
-          } break; 
-          
-          case RH24_MESSAGE_PING: {
+            if (response.action == ACTION_CHECK_SLEEP_STATE && response.contentSize > 0) { 
             
-            R2_LOG(F("Ping!"));
+              master_setNodeSleeping(response.host, response.content[0]); 
+              
+            } else if (response.action == ACTION_INITIALIZE || response.action == ACTION_INITIALIZATION_OK) { 
+            
+              // The devices of the node has been (or has to be) recreated.
+              master_clearCachedValues(response.host); 
+              
+              // The node has restarted and forgot its groups.
+              if (response.action == ACTION_INITIALIZE) { master_setNodeGroups(response.host, 0); }
+              
+            } else if (response.action == ACTION_RH24_SET_GROUPS && response.contentSize > 0) {
             
-            byte ping = 0;
-            network.read(header, &ping, 1);
+              master_setNodeGroups(response.host, response.content[RESPONSE_POSITION_GROUPS_MASK]);
+              
+            }
             
-            RF24NetworkHeader responseHeader(header.from_node, RH24_MESSAGE_PING);
-            response.action = ACTION_RH24_PING;
+            // Check-in traffic (queued commands and fresh reads) doesn't use the pending request table.
+            if (!master_storeResponse(&response) && !master_commandResponse(&response) && !master_refreshResponse(&response)) { 
             
-            if (!network.write(responseHeader, &ping, 1)) {
-                R2_LOG(F("E: Ping reply failed"));
-                //TODO: ping failed
+              master_storeLateResponse(&response); 
+              
             }
             
-          } break;
+          } break; 
+          
+#ifdef RH24_TRANSFER
+          case RH24_MESSAGE_TRANSFER: {
+          
+            RH24TransferChunk chunk;
+            
+            if (network.read(header, &chunk, sizeof(RH24TransferChunk)) >= transferChunkSize(&chunk)) { master_storeTransferChunk(&chunk); }
+            
+          } break;
+#endif
+          
+          case RH24_MESSAGE_SAMPLE: {
+          
+            ResponsePackage response;
+            
+            if (network.read(header, &response, sizeof(ResponsePackage)) < MIN_REQUEST_SIZE) { 
+            
+              R2_LOG(F("E: sample size"));
+              break;
+              
+            }
+            
+            master_linkSeen(response.host);
+            master_cacheValue(&response);
+            
+          } break;
+          
+          case RH24_MESSAGE_PING: {
+            
+            R2_LOG(F("Ping!"));
+            
+            byte ping[RH24_PING_SIZE];
+            
+            if (network.read(header, ping, RH24_PING_SIZE) < RH24_PING_SIZE) { 
+            
+              R2_LOG(F("E: ping size"));
+              break;
+              
+            }
+            
+            master_linkSeen(ping[RH24_PING_POSITION_NODE_ID]);
+            master_addLinkRetries(ping[RH24_PING_POSITION_NODE_ID], ping[RH24_PING_POSITION_RETRIES]);
+            
+            master_setNodeSleeping(ping[RH24_PING_POSITION_NODE_ID], ping[RH24_PING_POSITION_SLEEPING]);
+            
+            // The reply and the queued requests are sent by the run loop, since rh24Send might be waiting for a response.
+            master_queueCheckIn(ping[RH24_PING_POSITION_NODE_ID], header.from_node);
+            
+          } break;
           
           default:
           
-            if (header.type != 0) { err("E: header.type", ERROR_RH24_UNKNOWN_MESSAGE_TYPE_ERROR, header.type); }
-            //else {R2_LOG(F("Unknown message type (0). Should this be ignored?"));}
+            if (header.type != 0) { 
+            
+              R2_LOG(F("E: header.type")); 
+              R2_LOG(header.type); 
+              
+            }
              
             network.read(header, 0, 0);
             
         }
        
     }
+
+}
+
+#ifdef RH24_DISPATCH
+
+void master_storeLateResponse(ResponsePackage* response) {
+
+  R2_LOG(F("Late response from:"));
+  R2_LOG(response->host);
+  
+  if (lateResponseCount == RH24_LATE_RESPONSE_QUEUE_SIZE) {
+  
+    memmove(lateResponses, lateResponses + 1, (RH24_LATE_RESPONSE_QUEUE_SIZE - 1) * sizeof(ResponsePackage));
+    lateResponseCount--;
     
-    return response;
+  }
+  
+  lateResponses[lateResponseCount++] = *response;
+  
+}
+
+bool master_takeLateResponse(HOST_ADDRESS nodeId, byte messageId, ResponsePackage* response) {
+
+  for (int i = 0; i < lateResponseCount; i++) {
+  
+    if (lateResponses[i].host != nodeId || lateResponses[i].messageId != messageId) { continue; }
+    
+    *response = lateResponses[i];
+    
+    memmove(lateResponses + i, lateResponses + i + 1, (lateResponseCount - i - 1) * sizeof(ResponsePackage));
+    lateResponseCount--;
+    
+    return true;
+    
+  }
+  
+  return false;
+  
+}
+
+#else
+
+void master_storeLateResponse(ResponsePackage* response) {
+
+  // Nobody would collect it.
+  R2_LOG(F("Late response dropped from:"));
+  R2_LOG(response->host);
+  
+}
+
+#endif
+
+RH24PendingRequest* master_dispatch(RequestPackage* request) {
+
+  master_updatePendingRequests();
+  
+  RH24PendingRequest* pending = NULL;
+  
+  // An entry stays reserved until its response has been read by rh24Send or collected by rh24Collect.
+  for (int i = 0; i < RH24_MAX_PENDING_REQUESTS; i++) {
+  
+    if (pendingRequests[i].state == RH24_PENDING_UNUSED) { 
+    
+      pending = &pendingRequests[i];
+      break;
+      
+    }
+    
+  }
+  
+  if (!pending) {
+  
+    err("E: pending full", ERROR_RH24_TOO_MANY_PENDING_REQUESTS, request->host);
+    return NULL;
+    
+  }
+  
+  byte messageId = rh24MessageId++;
+  
+  if (!master_write(request, messageId)) { return NULL; }
+  
+  pending->nodeId = request->host;
+  pending->messageId = messageId;
+  pending->state = RH24_PENDING_WAITING;
+  pending->timestamp = millis();
+  pending->cacheable = request->action == ACTION_GET_DEVICE && request->argSize == 0;
+  
+  return pending;
+  
+}
+
+bool master_write(RequestPackage* request, byte messageId) {
+
+  int16_t address = mesh.getAddress(request->host);
+  
+  // The node has never been seen or it has released its address.
+  if (address <= 0) {
+  
+    err("E: slave dead?", ERROR_RH24_NODE_NOT_AVAILABLE, (byte) mesh.addrListTop);
+    return false;
+    
+  }
+  
+  RH24RequestFrame frame;
+  frame.messageId = messageId;
+  memcpy(&frame.request, request, requestPackageSize(request));
+  
+  RF24NetworkHeader header(address, RH24_MESSAGE);
+  
+  if (!network.write(header, &frame, requestFrameSize(&frame))) {
+  
+      master_linkSendFailed(request->host);
+      err("E: slave write.", ERROR_RH24_WRITE_ERROR, request->host);
+      return false;
+      
+  }
+  
+  return true;
+  
+}
+
+void master_waitForResponse(RH24PendingRequest* pending) {
+
+   // Responses to other outstanding requests are stored while waiting.
+   while (pending->state == RH24_PENDING_WAITING) { 
+    
+     mesh.update();
+     mesh.DHCP();
+     master_readFrames();
+     master_updatePendingRequests();
+     
+   }
+    
+}
+
+bool master_storeResponse(ResponsePackage* response) {
+
+  if (master_storeGroupReply(response)) { return true; }
+
+  for (int i = 0; i < RH24_MAX_PENDING_REQUESTS; i++) {
+  
+    RH24PendingRequest* pending = &pendingRequests[i];
+    
+    // A timed out request that hasn't been collected yet still takes its (late) response.
+    if ((pending->state == RH24_PENDING_WAITING || pending->state == RH24_PENDING_TIMEOUT) && 
+        pending->nodeId == response->host && 
+        pending->messageId == response->messageId) {
+        
+        pending->response = *response;
+        pending->state = RH24_PENDING_DONE;
+        
+        master_addRoundTrip(response->host, millis() - pending->timestamp);
+        
+        if (pending->cacheable) { master_cacheValue(response); }
+        
+        return true;
+        
+    }
+    
+  }
+  
+  return false;
+  
+}
+
+void master_updatePendingRequests() {
+
+  for (int i = 0; i < RH24_MAX_PENDING_REQUESTS; i++) {
+  
+    if (pendingRequests[i].state == RH24_PENDING_WAITING && millis() - pendingRequests[i].timestamp > RH24_READ_TIMEOUT) {
+    
+      R2_LOG(F("Request timed out for node:"));
+      R2_LOG(pendingRequests[i].nodeId);
+      pendingRequests[i].state = RH24_PENDING_TIMEOUT;
+      
+      master_linkTimedOut(pendingRequests[i].nodeId);
+      
+    }
+    
+  }
+  
+#ifdef RH24_COMMAND_QUEUE
+  for (int i = 0; i < RH24_COMMAND_QUEUE_SIZE; i++) {
+  
+    if (commandQueue[i].state == COMMAND_STATUS_SENT && millis() - commandQueue[i].sent > RH24_READ_TIMEOUT) {
+    
+      master_linkTimedOut(commandQueue[i].request.host);
+      
+      master_commandTimedOut(&commandQueue[i]);
+      
+    }
+    
+  }
+#endif
+  
+}
+
+#ifdef RH24_VALUE_CACHE
+
+RH24CachedValue* master_getCachedValue(HOST_ADDRESS nodeId, byte deviceId) {
+
+  for (int i = 0; i < RH24_VALUE_CACHE_SIZE; i++) {
+  
+    if (valueCache[i].used && valueCache[i].nodeId == nodeId && valueCache[i].deviceId == deviceId) { return &valueCache[i]; }
+    
+  }
+  
+  return NULL;
+  
+}
+
+void master_cacheValue(ResponsePackage* response) {
+
+  if (response->action != ACTION_GET_DEVICE || response->contentSize < RESPONSE_VALUE_CONTENT_SIZE) { return; }
+  
+  RH24CachedValue* cached = master_getCachedValue(response->host, response->id);
+  
+  if (!cached) {
+  
+    // Use an unused entry or replace the oldest one.
+    for (int i = 0; i < RH24_VALUE_CACHE_SIZE; i++) {
+    
+      if (!valueCache[i].used) { 
+      
+        cached = &valueCache[i];
+        break;
+        
+      } else if (!cached || millis() - valueCache[i].timestamp > millis() - cached->timestamp) { 
+      
+        cached = &valueCache[i]; 
+        
+      }
+      
+    }
+    
+  }
+  
+  cached->nodeId = response->host;
+  cached->deviceId = response->id;
+  cached->used = true;
+  cached->refresh = false;
+  cached->refreshing = false;
+  cached->timestamp = millis();
+  memcpy(cached->content, response->content, RESPONSE_VALUE_CONTENT_SIZE);
+  
+}
+
+bool master_refreshResponse(ResponsePackage* response) {
+
+  for (int i = 0; i < RH24_VALUE_CACHE_SIZE; i++) {
+  
+    RH24CachedValue* cached = &valueCache[i];
+    
+    if (cached->used && cached->refreshing && cached->nodeId == response->host && cached->messageId == response->messageId) { 
+    
+      // An error leaves the old value in place.
+      if (isError(*response)) { cached->refreshing = false; }
+      else { master_cacheValue(response); }
+      
+      return true;
+      
+    }
+    
+  }
+  
+  return false;
+  
+}
+
+void master_clearCachedValues(HOST_ADDRESS nodeId) {
+
+  for (int i = 0; i < RH24_VALUE_CACHE_SIZE; i++) {
+  
+    if (valueCache[i].nodeId == nodeId) { valueCache[i].used = false; }
+    
+  }
+  
+}
+
+ResponsePackage master_createCachedResponse(RH24CachedValue* cached) {
+
+  ResponsePackage response;
+  
+  response.messageId = 0;
+  response.host = cached->nodeId;
+  response.action = ACTION_GET_DEVICE;
+  response.id = cached->deviceId;
+  response.contentSize = RESPONSE_VALUE_CONTENT_SIZE + 2;
+  
+  memcpy(response.content, cached->content, RESPONSE_VALUE_CONTENT_SIZE);
+  
+  unsigned long age = (millis() - cached->timestamp) / 1000;
+  if (age > 0xFFFF) { age = 0xFFFF; }
+  
+  response.content[RESPONSE_POSITION_CACHED_VALUE_AGE] = age & 0xFF;
+  response.content[RESPONSE_POSITION_CACHED_VALUE_AGE + 1] = age >> 8;
+  
+  return response;
+  
+}
+
+#else
+
+void master_cacheValue(ResponsePackage* response) {}
+
+bool master_refreshResponse(ResponsePackage* response) { return false; }
+
+void master_clearCachedValues(HOST_ADDRESS nodeId) {}
+
+#endif
+
+void master_setNodeSleeping(HOST_ADDRESS nodeId, bool sleeping) {
+
+  if (sleeping) { sleepingNodes[nodeId / 8] |= 1 << (nodeId % 8); }
+  else { sleepingNodes[nodeId / 8] &= ~(1 << (nodeId % 8)); }
+  
+}
+
+bool master_isNodeSleeping(HOST_ADDRESS nodeId) { return sleepingNodes[nodeId / 8] & (1 << (nodeId % 8)); }
+
+byte master_queuedCount(HOST_ADDRESS nodeId) {
+
+  byte count = 0;
+  
+#ifdef RH24_COMMAND_QUEUE
+  for (int i = 0; i < RH24_COMMAND_QUEUE_SIZE; i++) {
+  
+    if (commandQueue[i].state == COMMAND_STATUS_QUEUED && commandQueue[i].request.host == nodeId) { count++; }
+    
+  }
+#endif
+  
+#ifdef RH24_VALUE_CACHE
+  for (int i = 0; i < RH24_VALUE_CACHE_SIZE; i++) {
+  
+    if (valueCache[i].used && valueCache[i].refresh && valueCache[i].nodeId == nodeId) { count++; }
+    
+  }
+#endif
+  
+  return count;
+  
+}
+
+void master_queueCheckIn(HOST_ADDRESS nodeId, uint16_t address) {
+
+  for (int i = 0; i < checkInCount; i++) {
+  
+    if (checkIns[i].nodeId == nodeId) { return; }
+    
+  }
+  
+  // The node checks in again later.
+  if (checkInCount == RH24_CHECK_IN_QUEUE_SIZE) { 
+  
+    R2_LOG(F("E: check-ins full"));
+    return;
+    
+  }
+  
+  checkIns[checkInCount].nodeId = nodeId;
+  checkIns[checkInCount].address = address;
+  checkIns[checkInCount].received = millis();
+  checkInCount++;
+  
+}
 
+void master_handleCheckIns() {
+
+  for (int i = 0; i < checkInCount; i++) {
+  
+    // The ping might have been read while rh24Send was waiting for a response. If the node's wake window is (almost) over,
+    // the queued requests would only use up attempts, so they are left for the next check-in.
+    if (millis() - checkIns[i].received > RH24_CHECK_IN_MAX_AGE) { 
+    
+      R2_LOG(F("E: stale check-in"));
+      continue;
+      
+    }
+    
+    RF24NetworkHeader header(checkIns[i].address, RH24_MESSAGE_PING);
+    
+    // Tell the node whether it has to stay awake for queued commands.
+    byte reply[RH24_PING_REPLY_SIZE];
+    reply[0] = checkIns[i].nodeId;
+    reply[RH24_PING_REPLY_POSITION_QUEUED] = master_queuedCount(checkIns[i].nodeId);
+    reply[RH24_PING_REPLY_POSITION_FLAGS] = 0;
+    
+#ifdef RH24_COMMAND_QUEUE
+    reply[RH24_PING_REPLY_POSITION_FLAGS] |= RH24_PING_REPLY_FLAG_QUEUE;
+#endif
+    
+    if (!network.write(header, reply, RH24_PING_REPLY_SIZE)) {
+        R2_LOG(F("E: Ping reply failed"));
+        //TODO: ping failed
+    }
+    
+    master_nodeCheckedIn(checkIns[i].nodeId);
+    
+  }
+  
+  checkInCount = 0;
+  
+}
+
+void master_nodeCheckedIn(HOST_ADDRESS nodeId) {
+
+  // Failed sends are retried during the next check-in and must not be reported in the response to the next request.
+  byte errorCode = getErrorCode();
+  byte errorInfo = getErrorInfo();
+  
+#ifdef RH24_COMMAND_QUEUE
+  // Send the queued commands in one burst, in the order they were queued.
+  for (int i = 0; i < RH24_COMMAND_QUEUE_SIZE; i++) {
+  
+    RH24QueuedCommand* command = NULL;
+    
+    for (int j = 0; j < RH24_COMMAND_QUEUE_SIZE; j++) {
+    
+      RH24QueuedCommand* candidate = &commandQueue[j];
+      
+      if (candidate->state == COMMAND_STATUS_QUEUED && candidate->request.host == nodeId &&
+          (!command || millis() - candidate->timestamp > millis() - command->timestamp)) {
+          
+          command = candidate;
+          
+      }
+      
+    }
+    
+    if (!command) { break; }
+    
+    byte messageId = rh24MessageId++;
+    
+    // Retry during the next check-in.
+    if (!master_write(&command->request, messageId)) { break; }
+    
+    command->state = COMMAND_STATUS_SENT;
+    command->messageId = messageId;
+    command->sent = millis();
+    command->attempts++;
+    
+  }
+#endif
+  
+#ifdef RH24_VALUE_CACHE
+  for (int i = 0; i < RH24_VALUE_CACHE_SIZE; i++) {
+  
+    RH24CachedValue* cached = &valueCache[i];
+    
+    // A fresh read that is still unanswered is sent again.
+    if (!cached->used || !(cached->refresh || cached->refreshing) || cached->nodeId != nodeId) { continue; }
+    
+    RequestPackage request;
+    request.host = nodeId;
+    request.action = ACTION_GET_DEVICE;
+    request.id = cached->deviceId;
+    request.argSize = 0;
+    request.checksum = createRequestChecksum(&request);
+    
+    byte messageId = rh24MessageId++;
+    
+    // The response will update the cache once it arrives (see master_refreshResponse).
+    if (master_write(&request, messageId)) { 
+    
+      cached->refresh = false;
+      cached->refreshing = true;
+      cached->messageId = messageId;
+      
+    }
+    
+  }
+#endif
+  
+  clearError();
+  if (errorCode != 0) { err(NULL, errorCode, errorInfo); }
+  
+}
+
+#ifdef R2_PRINT_DEBUG
+unsigned long masterDebugTimer = 0;
+#endif
+
+void rh24MasterLoop() {
+  
+  #ifdef R2_PRINT_DEBUG
+  
+  // Check if i'm alive.
+  if (millis() - masterDebugTimer >= 5000) {
+  
+    masterDebugTimer = millis();
+    R2_PRINT(F("."));
+  }
+  
+  #endif
+    mesh.update();
+    mesh.DHCP();
+  
+  master_readFrames();
+  
+  master_updatePendingRequests();
+  
+  master_handleCheckIns();
+  
+  if (mesh.addrListTop > 0) {
+    setStatus(true);
+  } else {
+    setStatus(false);
+  }
+  
+}
+
+void rh24SlaveLoop() {
+
+  mesh.update();
+  
+  slave_networkCheck();
+  
+  while (network.available()) {
+
+      RF24NetworkHeader header;
+      network.peek(header);
+      
+      // A reply to my check-in doesn't wake me up.
+      if (header.type != RH24_MESSAGE_PING) {
+      
+        if (slaveSleepStarted) { R2_LOG(F("Waking up from sleep")); }
+        
+        slaveSleepStarted = false;
+        
+      }
+      
+      // Stay awake for a while, since the master might have more to send.
+      checkInTimer = millis();
+      
+      // The link is working. No need to check it for a while.
+      renewalTimer = millis();
+      
+      switch(header.type) {
+        
+        case RH24_MESSAGE: {
+           
+          slave_readMessage(header);
+          
+        } break;
+        
+        case RH24_MESSAGE_PING: {
+          
+          slave_readPing(header);
+          
+        } break;
+        
+#ifdef RH24_GROUPS
+        case RH24_MESSAGE_GROUP: {
+          
+          slave_readGroupMessage(header);
+          
+        } break;
+#endif
+        
+#ifdef RH24_TRANSFER
+        case RH24_MESSAGE_TRANSFER: {
+          
+          slave_readTransferRequest(header);
+          
+        } break;
+#endif
+        
+        default:
+        
+          network.read(header, 0, 0);
+    
+      }
+      
+  } 
+  
+#ifdef RH24_GROUPS
+  // Reply in my own slot to avoid collisions with the other members of the group.
+  if (slaveGroupReplyPending && millis() - slaveGroupReplyTimer >= (unsigned long) getNodeId() * RH24_GROUP_SLOT_LENGTH) {
+  
+    slaveGroupReplyPending = false;
+    
+    if (!slave_writeResponse(&slaveGroupReply)) { R2_LOG(F("Group reply failed.")); }
+    
+  }
+#endif
+   
+  slave_handleSleep(); 
+
+}
+
+void slave_networkCheck() {
+
+#ifdef RH24_PING_ENABLED
+  if (millis() - pingTimer >= pingInterval) {
+    
+      pingTimer = millis();
+      
+      if (!slave_sendPing()) {
+        
+        R2_LOG(F("Ping failed. Renewing address."));
+        pingInterval = RH24_MIN_PING_INTERVAL;
+        
+        if (mesh.renewAddress(RH24_SLAVE_RENEWAL_TIMEOUT)) { slave_saveAddress(); }
+        
+      } else if (pingInterval < RH24_MAX_PING_INTERVAL) {
+      
+        pingInterval = pingInterval * 2 < RH24_MAX_PING_INTERVAL ? pingInterval * 2 : RH24_MAX_PING_INTERVAL;
+        
+      }
+  }
+#endif
+
+  if (millis() - renewalTimer >= renewalInterval) {
+  
+    renewalTimer = millis();
+    
+    #ifdef R2_PRINT_DEBUG
+    R2_PRINT(F("."));
+    if (slaveDebugOutputCount++ > 30) { R2_LOG(""); slaveDebugOutputCount = 0; }
+    #endif
+    
+    if (!mesh.checkConnection()) {
+      
+        R2_LOG(F("No connection. Restarting."));
+        arghhhh();
+        //mesh.renewAddress(RH24_SLAVE_RENEWAL_TIMEOUT); 
+        
+    } else if (renewalInterval < RH24_MAX_NETWORK_RENEWAL_TIME) {
+    
+      renewalInterval = renewalInterval * 2 < RH24_MAX_NETWORK_RENEWAL_TIME ? renewalInterval * 2 : RH24_MAX_NETWORK_RENEWAL_TIME;
+      
+    }
+   
+  }
+  
+}
+
+void slave_handleSleep() {
+   
+  // Handle sleep pausing:
+   if (pauseSleepInterval > 0 && pauseSleepTimer + pauseSleepInterval > millis()) {
+   
+     return;
+     
+   } else {
+   
+     pauseSleepTimer = 0;
+     pauseSleepInterval = 0;
+     
+   }
+   
+   if (shouldSleep == true) {
+   
+     // Allow the master to send the requests queued during sleep.
+     if (checkInTimer > 0 && millis() - checkInTimer < RH24_CHECK_IN_WINDOW) { return; }
+     
+#ifdef RH24_GROUPS
+     if (slaveGroupReplyPending) { return; }
+#endif
+
+     if (!slaveSleepStarted) { 
+       
+       R2_LOG(F("Sending node to sleep.")); 
+       slaveSleepStarted = true;
+    
+       // Allows me to finish stuff (i.e. device configiratons, debug output etc.) 
+       delay(1000); 
+       
+       // The master has just heard from me.
+       slaveNextCheckIn = slave_clock() + slave_checkInInterval();
+    
+     }
+     
+     // Sleep for as many whole cycles as possible before the next deadline. Deadlines within the last cycle are met early.
+     long remaining = (long) (slave_nextWakeUp() - slave_clock());
+     unsigned int cycles = remaining > 0 ? remaining / RH24_SLEEP_CYCLE_LENGTH : 0;
+     
+     if (cycles > 0) {
+     
+       // A master queueing the requests sends nothing before I check in, so the radio doesn't need to listen. Otherwise the
+       // radio stays in RX, keeping the requests sent while I sleep until I wake up.
+       if (slaveMasterQueues) { radio.powerDown(); }
+       
+       bool slept = network.sleepNode(cycles, 255);
+       
+       if (slaveMasterQueues) { radio.powerUp(); }
+       
+       if (!slept) {
+       
+         R2_LOG(F("Failed to sleep node."));
+         err("E: sleep", ERROR_FAILED_TO_SLEEP);
+         return;
+         
+       }
+       
+       slaveSleepTime += (unsigned long) cycles * RH24_SLEEP_CYCLE_LENGTH;
+       
+     }
+     
+     slave_wakeUp();
+    
+  }
+  
+}
+
+unsigned long slave_clock() { return millis() + slaveSleepTime; }
+
+unsigned long slave_checkInInterval() {
+
+  // ACTION_SEND_TO_SLEEP may set the number of cycles between check-ins.
+  byte cycles = sleepCycles == 0 || sleepCycles == RH24_SLEEP_UNTIL_MESSAGE_RECEIVED ? RH24_CHECK_IN_CYCLES : sleepCycles;
+  
+  return (unsigned long) cycles * RH24_SLEEP_CYCLE_LENGTH;
+  
+}
+
+unsigned long slave_nextWakeUp() {
+
+  unsigned long wakeUp = slaveNextCheckIn;
+  
+  for (int i = 0; i < RH24_MAX_SAMPLED_DEVICES; i++) {
+  
+    RH24SampledDevice* sampled = &samplingSchedule[i];
+    
+    if (sampled->interval > 0 && (long) (sampled->deadline - wakeUp) < 0) { wakeUp = sampled->deadline; }
+    
+  }
+  
+  return wakeUp;
+  
+}
+
+void slave_wakeUp() {
+
+  unsigned long now = slave_clock();
+  
+  // Everything due before the next cycle would end is handled now, so that the radio is only used once.
+  unsigned long horizon = now + RH24_SLEEP_CYCLE_LENGTH;
+  bool sampled = false;
+  
+  for (int i = 0; i < RH24_MAX_SAMPLED_DEVICES; i++) {
+  
+    RH24SampledDevice* device = &samplingSchedule[i];
+    
+    if (device->interval == 0 || (long) (device->deadline - horizon) >= 0) { continue; }
+    
+    if (!slave_sendSample(device->deviceId)) { R2_LOG(F("Sample failed.")); }
+    
+    sampled = true;
+    device->deadline += (unsigned long) device->interval * 1000;
+    
+    // Don't try to catch up on missed deadlines.
+    if ((long) (device->deadline - now) < 0) { device->deadline = now + (unsigned long) device->interval * 1000; }
+    
+  }
+  
+  // Check in while the radio is in use anyway, allowing the master to deliver queued commands in the same window.
+  if (sampled || (long) (slaveNextCheckIn - horizon) < 0) {
+  
+    slaveNextCheckIn = now + slave_checkInInterval();
+    checkInTimer = millis();
+    
+    if (!slave_sendPing()) { R2_LOG(F("Check-in failed.")); }
+    
+  }
+  
+}
+
+bool slave_sendSample(byte deviceId) {
+
+  RequestPackage request;
+  request.host = getNodeId();
+  request.action = ACTION_GET_DEVICE;
+  request.id = deviceId;
+  request.argSize = 0;
+  request.checksum = createRequestChecksum(&request);
+  
+  ResponsePackage response = execute(&request);
+  
+  bool failed = isError() || isError(response);
+  clearError();
+  
+  if (failed) { return false; }
+  
+  if (mesh.write(&response, RH24_MESSAGE_SAMPLE, responsePackageSize(&response))) { return true; }
+  
+  saturatedIncrement(slaveWriteRetries);
+  
+  return false;
+  
+}
+
+bool setSampling(byte deviceId, uint16_t interval) {
+
+  RH24SampledDevice* sampled = NULL;
+  
+  for (int i = 0; i < RH24_MAX_SAMPLED_DEVICES; i++) {
+  
+    if (samplingSchedule[i].interval > 0 && samplingSchedule[i].deviceId == deviceId) { 
+    
+      sampled = &samplingSchedule[i];
+      break;
+      
+    } else if (!sampled && samplingSchedule[i].interval == 0) { sampled = &samplingSchedule[i]; }
+    
+  }
+  
+  if (interval == 0) {
+  
+    if (sampled && sampled->deviceId == deviceId) { sampled->interval = 0; }
+    return true;
+    
+  }
+  
+  if (!sampled) { return false; }
+  
+  // Shorter intervals would keep the node awake.
+  const uint16_t minInterval = RH24_SLEEP_CYCLE_LENGTH / 1000;
+  
+  sampled->deviceId = deviceId;
+  sampled->interval = interval < minInterval ? minInterval : interval;
+  
+  // The first sample is taken during the next wake up.
+  sampled->deadline = slave_clock();
+  
+  return true;
+  
+}
+
+#ifdef RH24_COMMAND_QUEUE
+
+bool master_isQueuedAction(ACTION_TYPE action) {
+
+  switch (action) {
+  
+    case ACTION_SET_DEVICE:
+    case ACTION_DELETE_DEVICE:
+    case ACTION_INITIALIZE:
+    case ACTION_RESET:
+    case ACTION_SEND_TO_SLEEP:
+    case ACTION_PAUSE_SLEEP:
+    case ACTION_RH24_SET_GROUPS:
+    case ACTION_RH24_SET_SAMPLING:
+      return true;
+      
+    // Reads, and ACTION_CREATE_DEVICE (whose response contains the id of the new device), are sent and fail if the node doesn't wake up.
+    default:
+      return false;
+      
+  }
+  
+}
+
+ResponsePackage master_queueCommand(RequestPackage* request) {
+
+  ResponsePackage response;
+  
+  response.messageId = 0;
+  response.host = request->host;
+  response.action = request->action;
+  response.id = request->id;
+  response.contentSize = 0;
+  
+  RH24QueuedCommand* command = NULL;
+  byte nodeCommandCount = 0;
+  
+  for (int i = 0; i < RH24_COMMAND_QUEUE_SIZE; i++) {
+  
+    RH24QueuedCommand* candidate = &commandQueue[i];
+    
+    if (candidate->state == COMMAND_STATUS_QUEUED && candidate->request.host == request->host && 
+        candidate->request.id == request->id && candidate->request.action == request->action) {
+    
+      // Replace the unsent command for the same device.
+      command = candidate;
+      break;
+    
+    } else if (candidate->state == COMMAND_STATUS_QUEUED || candidate->state == COMMAND_STATUS_SENT) {
+    
+      if (candidate->request.host == request->host) { nodeCommandCount++; }
+      
+    } else if (!command || (command->state != 0 && 
+               (candidate->state == 0 || millis() - candidate->timestamp > millis() - command->timestamp))) {
+    
+      // Use an unused entry or replace the oldest finished command.
+      command = candidate;
+      
+    }
+    
+  }
+  
+  if (!command || (command->state != COMMAND_STATUS_QUEUED && nodeCommandCount >= RH24_MAX_COMMANDS_PER_NODE)) {
+  
+    err("E: queue full", ERROR_RH24_COMMAND_QUEUE_FULL, request->host);
+    return response;
+    
+  }
+  
+  if (command->state != COMMAND_STATUS_QUEUED) {
+  
+    command->commandId = rh24CommandId++;
+    command->timestamp = millis();
+    
+  }
+  
+  command->state = COMMAND_STATUS_QUEUED;
+  command->attempts = 0;
+  command->error = 0;
+  memcpy(&command->request, request, requestPackageSize(request));
+  
+  R2_LOG(F("Queued command for node:"));
+  R2_LOG(request->host);
+  
+  response.contentSize = 1;
+  response.content[RESPONSE_POSITION_QUEUED_COMMAND_ID] = command->commandId;
+  
+  return response;
+  
+}
+
+ResponsePackage rh24CommandStatus(HOST_ADDRESS nodeId, byte commandId) {
+
+  ResponsePackage response;
+  
+  response.messageId = 0;
+  response.host = nodeId;
+  response.action = ACTION_RH24_COMMAND_STATUS;
+  response.id = commandId;
+  response.contentSize = 0;
+  
+  for (int i = 0; i < RH24_COMMAND_QUEUE_SIZE; i++) {
+  
+    RH24QueuedCommand* command = &commandQueue[i];
+    
+    if (command->state == 0 || command->request.host != nodeId || command->commandId != commandId) { continue; }
+    
+    response.contentSize = 2;
+    response.content[RESPONSE_POSITION_COMMAND_STATUS] = command->state;
+    response.content[RESPONSE_POSITION_COMMAND_ERROR] = command->error;
+    
+    if (command->state == COMMAND_STATUS_DELIVERED || command->state == COMMAND_STATUS_FAILED) { command->state = 0; }
+    
+    return response;
+    
+  }
+  
+  err("E: command id", ERROR_RH24_UNKNOWN_COMMAND_ID, commandId);
+  
+  return response;
+  
+}
+
+bool master_commandResponse(ResponsePackage* response) {
+
+  for (int i = 0; i < RH24_COMMAND_QUEUE_SIZE; i++) {
+  
+    RH24QueuedCommand* command = &commandQueue[i];
+    
+    // A command re-queued after a timeout might still have been delivered.
+    bool sent = command->state == COMMAND_STATUS_SENT || (command->state == COMMAND_STATUS_QUEUED && command->attempts > 0);
+    
+    if (!sent || command->request.host != response->host || command->messageId != response->messageId) { continue; }
+    
+    master_addRoundTrip(response->host, millis() - command->sent);
+    
+    bool delivered = response->action == command->request.action || 
+                     (command->request.action == ACTION_INITIALIZE && response->action == ACTION_INITIALIZATION_OK);
+    
+    if (delivered) { 
+    
+      master_finishCommand(command, COMMAND_STATUS_DELIVERED, 0); 
+      
+      if (command->request.action == ACTION_SEND_TO_SLEEP) { 
+      
+        master_setNodeSleeping(command->request.host, command->request.args[SLEEP_MODE_TOGGLE_POSITION]); 
+        
+      }
+      
+    } else if (isError(*response)) { master_finishCommand(command, COMMAND_STATUS_FAILED, response->content[RESPONSE_POSITION_ERROR_TYPE]); }
+    
+    // The node has not been initialized (ACTION_INITIALIZE), so its devices are gone.
+    else { master_finishCommand(command, COMMAND_STATUS_FAILED, ERROR_CODE_NO_DEVICE_FOUND); }
+    
+    return true;
+    
+  }
+  
+  return false;
+  
+}
+
+void master_commandTimedOut(RH24QueuedCommand* command) {
+
+  R2_LOG(F("Command timed out for node:"));
+  R2_LOG(command->request.host);
+  
+  if (command->attempts >= RH24_COMMAND_MAX_ATTEMPTS) { master_finishCommand(command, COMMAND_STATUS_FAILED, ERROR_RH24_TIMEOUT); }
+  else { command->state = COMMAND_STATUS_QUEUED; }
+  
+}
+
+void master_finishCommand(RH24QueuedCommand* command, byte state, byte error) {
+
+  R2_LOG(F("Command finished with state:"));
+  R2_LOG(state);
+  
+  command->state = state;
+  command->error = error;
+  command->timestamp = millis();
+  
+}
+
+#else
+
+bool master_commandResponse(ResponsePackage* response) { return false; }
+
+#endif
+
+#ifdef RH24_GROUPS
+
+ResponsePackage rh24Group(RequestPackage* request) {
+
+  ResponsePackage response;
+  
+  response.messageId = 0;
+  response.host = request->host;
+  response.action = request->action;
+  response.id = request->id;
+  response.contentSize = 0;
+  
+  if (request->argSize < 2) {
+  
+    err("E: group size", ERROR_INVALID_REQUEST_PACKAGE_SIZE, request->argSize);
+    return response;
+    
+  }
+  
+  byte group = request->args[REQUEST_ARG_GROUP_POSITION];
+  byte memberCount = 0;
+  HOST_ADDRESS lastMember = 0;
+  
+  for (int nodeId = 1; group < RH24_MAX_GROUPS && nodeId < 256; nodeId++) {
+  
+    if (groupMembers[group][nodeId / 8] & (1 << (nodeId % 8))) { 
+    
+      memberCount++;
+      lastMember = nodeId;
+      
+    }
+    
+  }
+  
+  if (memberCount == 0) {
+  
+    err("E: empty group", ERROR_RH24_EMPTY_GROUP, group);
+    return response;
+    
+  }
+  
+  // Unwrap the request that should be sent to the members. The host tells the members which group the request is for.
+  RH24RequestFrame frame;
+  
+  frame.messageId = rh24MessageId++;
+  frame.request.host = group;
+  frame.request.action = request->args[REQUEST_ARG_GROUP_ACTION_POSITION];
+  frame.request.id = request->id;
+  frame.request.argSize = request->argSize - 2;
+  memcpy(frame.request.args, request->args + REQUEST_ARG_GROUP_ACTION_POSITION + 1, frame.request.argSize);
+  frame.request.checksum = createRequestChecksum(&frame.request);
+  
+  groupResponse = response;
+  groupResponse.contentSize = RESPONSE_POSITION_GROUP_ENTRIES;
+  groupResponse.content[RESPONSE_POSITION_GROUP_MEMBER_COUNT] = memberCount;
+  groupMessageId = frame.messageId;
+  groupReplyCount = 0;
+  memset(groupReplied, 0, sizeof(groupReplied));
+  
+  // One frame reaches the first level of the mesh, which relays it to the next.
+  RF24NetworkHeader header(0, RH24_MESSAGE_GROUP);
+  
+  if (!network.multicast(header, &frame, requestFrameSize(&frame), 1)) {
+  
+    err("E: multicast", ERROR_RH24_WRITE_ERROR, group);
+    return response;
+    
+  }
+  
+  groupActive = true;
+  
+  unsigned long timer = millis();
+  unsigned long timeout = (unsigned long) lastMember * RH24_GROUP_SLOT_LENGTH + RH24_GROUP_TIMEOUT;
+  
+  while (groupReplyCount < memberCount && millis() - timer < timeout) {
+  
+    mesh.update();
+    mesh.DHCP();
+    master_readFrames();
+    master_updatePendingRequests();
+    
+  }
+  
+  groupActive = false;
+  
+  R2_LOG(F("Group replies:"));
+  R2_LOG(groupReplyCount);
+  
+  return groupResponse;
+  
+}
+
+void master_setNodeGroups(HOST_ADDRESS nodeId, byte mask) {
+
+  for (byte group = 0; group < RH24_MAX_GROUPS; group++) {
+  
+    if (mask & (1 << group)) { groupMembers[group][nodeId / 8] |= 1 << (nodeId % 8); }
+    else { groupMembers[group][nodeId / 8] &= ~(1 << (nodeId % 8)); }
+    
+  }
+  
 }
 
-ResponsePackage master_tryReadMessage() {
+bool master_storeGroupReply(ResponsePackage* response) {
+
+  if (!groupActive || response->messageId != groupMessageId) { return false; }
+  
+  // Ignore duplicates (i.e. relayed twice).
+  if (groupReplied[response->host / 8] & (1 << (response->host % 8))) { return true; }
+  
+  groupReplied[response->host / 8] |= 1 << (response->host % 8);
+  groupReplyCount++;
+  
+  if (isError(*response) || groupResponse.contentSize + RESPONSE_GROUP_ENTRY_SIZE > MAX_CONTENT_SIZE) { return true; }
+  
+  byte* entry = groupResponse.content + groupResponse.contentSize;
+  
+  entry[0] = response->host;
+  entry[1] = response->contentSize > 0 ? response->content[0] : 0;
+  entry[2] = response->contentSize > 1 ? response->content[1] : 0;
+  
+  groupResponse.contentSize += RESPONSE_GROUP_ENTRY_SIZE;
   
-   ResponsePackage response;
-   response.id = 0;
-   response.action = ACTION_RH24_NO_MESSAGE_READ;
+  return true;
+  
+}
+
+#else
+
+void master_setNodeGroups(HOST_ADDRESS nodeId, byte mask) {}
+
+bool master_storeGroupReply(ResponsePackage* response) { return false; }
+
+#endif
+
+#ifdef RH24_LINK_STATS
 
-   unsigned long responseTimer = millis();
+RH24LinkStats* master_getLinkStats(HOST_ADDRESS nodeId) {
+
+  RH24LinkStats* stats = NULL;
+  
+  for (int i = 0; i < RH24_LINK_STATS_SIZE; i++) {
   
-   // Try to fetch a response. The response will have the ACTION_RH24_NO_MESSAGE_READ action until it contains data.
-   while (responseTimer + RH24_READ_TIMEOUT > millis()) { 
+    RH24LinkStats* candidate = &linkStats[i];
     
-     response = master_readResponse();
-     mesh.update();
-     mesh.DHCP();
-     
-     // Return the message if it was read.
-     if (response.action != ACTION_RH24_NO_MESSAGE_READ) { return response; }
-     
-   }
-   
-   err("Read timeout", ERROR_RH24_TIMEOUT);
-   
-   return response;
+    if (candidate->used && candidate->nodeId == nodeId) { return candidate; }
+    
+    if (!stats || (stats->used && (!candidate->used || millis() - candidate->lastSeen > millis() - stats->lastSeen))) { stats = candidate; }
     
+  }
+  
+  memset(stats, 0, sizeof(RH24LinkStats));
+  stats->nodeId = nodeId;
+  stats->used = true;
+  stats->lastSeen = millis();
+  
+  return stats;
+  
 }
 
-#ifdef R2_PRINT_DEBUG
-unsigned long masterDebugTimer = 0;
-#endif
+void master_addRoundTrip(HOST_ADDRESS nodeId, unsigned long rtt) {
 
-void rh24MasterLoop() {
+  RH24LinkStats* stats = master_getLinkStats(nodeId);
   
-  #ifdef R2_PRINT_DEBUG
+  if (rtt > 0xFFFF) { rtt = 0xFFFF; }
   
-  // Check if i'm alive.
-  if (millis() - masterDebugTimer >= 5000) {
+  // Exponential moving average (1/4 weight for the new sample).
+  stats->rtt = stats->rtt == 0 ? rtt : (stats->rtt * 3 + rtt) / 4;
   
-    masterDebugTimer = millis();
-    R2_PRINT(F("."));
-  }
+}
+
+void master_linkSeen(HOST_ADDRESS nodeId) { master_getLinkStats(nodeId)->lastSeen = millis(); }
+
+void master_linkSendFailed(HOST_ADDRESS nodeId) { saturatedIncrement(master_getLinkStats(nodeId)->sendFailures); }
+
+void master_linkTimedOut(HOST_ADDRESS nodeId) { saturatedIncrement(master_getLinkStats(nodeId)->timeouts); }
+
+void master_addLinkRetries(HOST_ADDRESS nodeId, byte retries) {
+
+  RH24LinkStats* stats = master_getLinkStats(nodeId);
   
-  #endif
-    mesh.update();
-    mesh.DHCP();
+  stats->retries = stats->retries + retries < 0xFF ? stats->retries + retries : 0xFF;
   
-  ResponsePackage response = master_readResponse();
+}
+
+ResponsePackage rh24LinkStats(HOST_ADDRESS nodeId) {
+
+  ResponsePackage response;
   
-  if (response.action != ACTION_RH24_NO_MESSAGE_READ && response.action != ACTION_RH24_PING) {
-    R2_LOG(F("WTF!!"));
-    R2_LOG(response.action);
-  }
+  response.messageId = 0;
+  response.host = nodeId;
+  response.action = ACTION_RH24_LINK_STATS;
+  response.id = 0;
+  response.contentSize = 0;
   
-  if (mesh.addrListTop > 0) {
-    setStatus(true);
-  } else {
-    setStatus(false);
+  for (int i = 0; i < RH24_LINK_STATS_SIZE; i++) {
+  
+    RH24LinkStats* stats = &linkStats[i];
+    
+    if (!stats->used || stats->nodeId != nodeId) { continue; }
+    
+    unsigned long lastSeen = (millis() - stats->lastSeen) / 1000;
+    
+    if (lastSeen > 0xFFFF) { lastSeen = 0xFFFF; }
+    
+    response.contentSize = RESPONSE_LINK_STATS_SIZE;
+    response.content[RESPONSE_POSITION_LINK_SEND_FAILURES] = stats->sendFailures;
+    response.content[RESPONSE_POSITION_LINK_TIMEOUTS] = stats->timeouts;
+    response.content[RESPONSE_POSITION_LINK_RETRIES] = stats->retries;
+    response.content[RESPONSE_POSITION_LINK_RTT] = stats->rtt & 0xFF;
+    response.content[RESPONSE_POSITION_LINK_RTT + 1] = stats->rtt >> 8;
+    response.content[RESPONSE_POSITION_LINK_LAST_SEEN] = lastSeen & 0xFF;
+    response.content[RESPONSE_POSITION_LINK_LAST_SEEN + 1] = lastSeen >> 8;
+    
+    stats->sendFailures = stats->timeouts = stats->retries = 0;
+    
+    return response;
+    
   }
   
+  err("E: no stats", ERROR_RH24_NODE_NOT_AVAILABLE, nodeId);
+  
+  return response;
+  
 }
 
-void rh24SlaveLoop() {
+#else
 
-  mesh.update();
+void master_linkSeen(HOST_ADDRESS nodeId) {}
+
+void master_linkSendFailed(HOST_ADDRESS nodeId) {}
+
+void master_linkTimedOut(HOST_ADDRESS nodeId) {}
+
+void master_addLinkRetries(HOST_ADDRESS nodeId, byte retries) {}
+
+void master_addRoundTrip(HOST_ADDRESS nodeId, unsigned long rtt) {}
+
+#endif
+
+#ifdef RH24_TRANSFER
+
+ResponsePackage rh24Transfer(HOST_ADDRESS nodeId, uint16_t offset) {
+
+  ResponsePackage response;
   
-  slave_networkCheck();
+  response.messageId = 0;
+  response.host = nodeId;
+  response.action = ACTION_RH24_TRANSFER;
+  response.id = 0;
+  response.contentSize = 0;
   
-  while (network.available()) {
-
-      if (slaveSleepStarted) { R2_LOG(F("Waking up from sleep")); }
+  bool buffered = transferNode == nodeId && offset >= transferStart && offset < transferStart + transferBuffered;
+  
+  // Request the window starting at the offset. This acknowledges the data before it and resumes interrupted transfers.
+  if (!buffered && !(transferNode == nodeId && transferTotalSize > 0 && offset >= transferTotalSize)) {
+  
+    int16_t address = mesh.getAddress(nodeId);
+    
+    if (address <= 0) {
+    
+      err("E: slave dead?", ERROR_RH24_NODE_NOT_AVAILABLE, nodeId);
+      return response;
       
-      slaveSleepStarted = false;
+    }
+    
+    RH24TransferRequest request;
+    
+    request.transferId = ++transferId;
+    request.offset = offset;
+    request.window = RH24_TRANSFER_WINDOW;
+    
+    transferNode = nodeId;
+    transferStart = offset;
+    transferBuffered = 0;
+    transferTotalSize = 0;
+    transferResponded = false;
+    transferInterrupted = false;
+    
+    RF24NetworkHeader header(address, RH24_MESSAGE_TRANSFER);
+    
+    if (!network.write(header, &request, sizeof(RH24TransferRequest))) {
+    
+      master_linkSendFailed(nodeId);
+      err("E: transfer write", ERROR_RH24_WRITE_ERROR, nodeId);
+      return response;
       
-      RF24NetworkHeader header;
-      network.peek(header);
+    }
+    
+    unsigned long timer = millis();
+    
+    // Wait for the whole window (or the end of the data). Missing chunks are requested again by the next read.
+    while (millis() - timer < RH24_TRANSFER_TIMEOUT && !transferInterrupted && transferBuffered < sizeof(transferBuffer) &&
+           !(transferResponded && transferStart + transferBuffered >= transferTotalSize)) {
+    
+      mesh.update();
+      mesh.DHCP();
+      master_readFrames();
+      master_updatePendingRequests();
       
-      switch(header.type) {
-        
-        case RH24_MESSAGE: {
-           
-          slave_readMessage(header);
-          
-        } break;
-        
-        case RH24_MESSAGE_PING: {
-          
-          slave_readPing(header);
-          
-        } break;
+    }
     
-      }
+    if (!transferResponded) {
+    
+      transferNode = 0;
+      master_linkTimedOut(nodeId);
+      err("E: transfer timeout", ERROR_RH24_TIMEOUT, nodeId);
+      return response;
       
-  } 
-   
-  slave_handleSleep(); 
-
+    }
+    
+  }
+  
+  response.content[RESPONSE_POSITION_TRANSFER_SIZE] = transferTotalSize & 0xFF;
+  response.content[RESPONSE_POSITION_TRANSFER_SIZE + 1] = transferTotalSize >> 8;
+  response.contentSize = RESPONSE_POSITION_TRANSFER_DATA;
+  
+  if (transferNode == nodeId && offset >= transferStart && offset < transferStart + transferBuffered) {
+  
+    uint16_t size = transferStart + transferBuffered - offset;
+    
+    if (size > MAX_CONTENT_SIZE - RESPONSE_POSITION_TRANSFER_DATA) { size = MAX_CONTENT_SIZE - RESPONSE_POSITION_TRANSFER_DATA; }
+    
+    memcpy(response.content + RESPONSE_POSITION_TRANSFER_DATA, transferBuffer + offset - transferStart, size);
+    response.contentSize += size;
+    
+  }
+  
+  return response;
+  
 }
 
-void slave_networkCheck() {
+void master_storeTransferChunk(RH24TransferChunk* chunk) {
 
-#ifdef RH24_PING_ENABLED
-  if (millis() - pingTimer >= RH24_PING_INTERVAL) {
+  if (chunk->transferId != transferId || chunk->size > RH24_TRANSFER_CHUNK_SIZE) { return; }
+  
+  transferTotalSize = chunk->totalSize;
+  transferResponded = true;
+  
+  // Only contiguous data is kept. A lost chunk ends the window early.
+  if (chunk->offset != transferStart + transferBuffered || transferBuffered + chunk->size > sizeof(transferBuffer)) { 
+  
+    transferInterrupted = true;
+    return; 
     
-      pingTimer = millis();
-      byte slaveId = getNodeId();
-      
-      if (!mesh.write(&slaveId, RH24_PING, 1)) {
-        
-        R2_LOG(F("Ping failed. Renewing address."));
-        mesh.renewAddress(RH24_SLAVE_RENEWAL_TIMEOUT);
-        
-      }
   }
-#endif
+  
+  memcpy(transferBuffer + transferBuffered, chunk->data, chunk->size);
+  transferBuffered += chunk->size;
+  
+}
 
-  if (millis() - renewalTimer >= RH24_NETWORK_RENEWAL_TIME) {
+void slave_readTransferRequest(RF24NetworkHeader header) {
+
+  RH24TransferRequest request;
   
-    renewalTimer = millis();
+  if (network.read(header, &request, sizeof(RH24TransferRequest)) != sizeof(RH24TransferRequest)) { return; }
+  
+  RH24TransferChunk chunk;
+  
+  chunk.transferId = request.transferId;
+  chunk.totalSize = slaveTransferSize;
+  chunk.offset = request.offset;
+  
+  for (byte i = 0; i < request.window; i++) {
+  
+    chunk.size = chunk.offset < slaveTransferSize ? (slaveTransferSize - chunk.offset < RH24_TRANSFER_CHUNK_SIZE ? slaveTransferSize - chunk.offset : RH24_TRANSFER_CHUNK_SIZE) : 0;
     
-    #ifdef R2_PRINT_DEBUG
-    R2_PRINT(F("."));
-    if (slaveDebugOutputCount++ > 30) { R2_LOG(""); slaveDebugOutputCount = 0; }
-    #endif
+    if (chunk.size > 0) { memcpy(chunk.data, slaveTransferData + chunk.offset, chunk.size); }
     
-    if (!mesh.checkConnection()) {
+    // The master will resume from the first missing chunk.
+    if (!mesh.write(&chunk, RH24_MESSAGE_TRANSFER, transferChunkSize(&chunk))) { 
+    
+      saturatedIncrement(slaveWriteRetries);
+      break;
       
-        R2_LOG(F("No connection. Restarting."));
-        arghhhh();
-        //mesh.renewAddress(RH24_SLAVE_RENEWAL_TIMEOUT); 
-        
     }
-   
+    
+    chunk.offset += chunk.size;
+    
+    if (chunk.offset >= slaveTransferSize) { break; }
+    
   }
   
 }
 
-void slave_handleSleep() {
-   
-  // Handle sleep pausing:
-   if (pauseSleepInterval > 0 && pauseSleepTimer + pauseSleepInterval > millis()) {
-   
-     return;
-     
-   } else {
-   
-     pauseSleepTimer = 0;
-     pauseSleepInterval = 0;
-     
-   }
-   
-   if (shouldSleep == true) {
+void rh24SetTransferData(const byte* data, uint16_t size) {
 
-     if (!slaveSleepStarted) { 
-       
-       R2_LOG(F("Sending node to sleep.")); 
-       slaveSleepStarted = true;
-    
-       // Allows me to finish stuff (i.e. device configiratons, debug output etc.) 
-       delay(1000); 
-    
-     }
-    
-    if (!network.sleepNode(1,255)) {
-    
-      R2_LOG(F("Failed to sleep node."));
-      err("E: sleep", ERROR_FAILED_TO_SLEEP);
-    
-    }
+  slaveTransferData = data;
+  slaveTransferSize = size;
+  
+}
+
+#endif
+
+#ifdef RH24_GROUPS
+
+byte setGroups(byte mask) {
+
+  slaveGroups = mask;
+  
+  return slaveGroups;
+  
+}
+
+#endif
+
+bool slave_rejoin() {
+
+  uint16_t address = EEPROM.read(MESH_ADDRESS_EEPROM_ADDRESS) | (EEPROM.read(MESH_ADDRESS_EEPROM_ADDRESS + 1) << 8);
+  
+  // Unwritten EEPROM reads 0xFFFF.
+  if (address == 0xFFFF) { return false; }
+  
+  return mesh.rejoin(address);
+  
+}
+
+void slave_saveAddress() {
+
+  // Avoid redundant EEPROM writes:
+  if (EEPROM.read(MESH_ADDRESS_EEPROM_ADDRESS) != (mesh.mesh_address & 0xFF)) { EEPROM.write(MESH_ADDRESS_EEPROM_ADDRESS, mesh.mesh_address & 0xFF); }
+  if (EEPROM.read(MESH_ADDRESS_EEPROM_ADDRESS + 1) != (mesh.mesh_address >> 8)) { EEPROM.write(MESH_ADDRESS_EEPROM_ADDRESS + 1, mesh.mesh_address >> 8); }
+  
+}
+
+bool slave_sendPing() {
+
+  byte ping[RH24_PING_SIZE];
+  ping[RH24_PING_POSITION_NODE_ID] = getNodeId();
+  ping[RH24_PING_POSITION_SLEEPING] = isSleeping();
+  ping[RH24_PING_POSITION_RETRIES] = slaveWriteRetries;
+  
+  if (!mesh.write(ping, RH24_MESSAGE_PING, RH24_PING_SIZE)) { 
+  
+    saturatedIncrement(slaveWriteRetries);
+    return false;
     
   }
   
+  slaveWriteRetries = 0;
+  
+  return true;
+  
 }
 
 void slave_readPing(RF24NetworkHeader header) {
 
-  byte ping = 0;
+  byte ping[RH24_PING_REPLY_SIZE];
   
-  if (network.read(header, &ping, 1) != 1) { R2_LOG(F("Unable to read ping!")); } 
+  if (network.read(header, ping, RH24_PING_REPLY_SIZE) < RH24_PING_REPLY_SIZE) { R2_LOG(F("Unable to read ping!")); } 
   else {
   
     // TODO: Remove this...
     R2_LOG(F("Got ping!"));
-    R2_LOG(ping);
+    R2_LOG(ping[0]);
+    
+    // Nothing is queued for me, so there's no need to stay awake.
+    if (ping[RH24_PING_REPLY_POSITION_QUEUED] == 0) { checkInTimer = 0; }
+    
+    slaveMasterQueues = ping[RH24_PING_REPLY_POSITION_FLAGS] & RH24_PING_REPLY_FLAG_QUEUE;
     
   }
   
@@ -557,36 +2445,67 @@ void slave_readMessage(RF24NetworkHeader header) {
 
    R2_LOG(F("Got message")); 
   
-   RequestPackage request;
+   RH24RequestFrame frame;
    
-   const uint16_t bytesRead = network.read(header, &request, MAX_REQUEST_SIZE);
+   const uint16_t bytesRead = network.read(header, &frame, sizeof(RH24RequestFrame));
    
     // Try to read the response from the slave
-    if (bytesRead < MIN_REQUEST_SIZE) {
+    if (bytesRead < 1 + MIN_REQUEST_SIZE) {
       
       err("E:Slave Bad read size", ERROR_RH24_BAD_SIZE_READ);
       
     } else {
       
-      ResponsePackage response = execute(&request);
-      const uint16_t responseSize = responsePackageSize(&response);
+      ResponsePackage response = execute(&frame.request);
+      
+      // Allows the master to match the response with its request.
+      response.messageId = frame.messageId;
+      
       R2_LOG(F("Slave: Response with action:"));
       R2_LOG(response.action);
       
-      if (!mesh.write(&response, RH24_MESSAGE, responseSize)) {
-  
-        delay(RH24_SLAVE_WRITE_RETRY);
-        
-        if (!mesh.write(&response, RH24_MESSAGE, responseSize)) {
-  
-          err("E: Slave write", ERROR_RH24_WRITE_ERROR);
-      
-        }
-        
-      }
+      if (!slave_writeResponse(&response)) { err("E: Slave write", ERROR_RH24_WRITE_ERROR); }
     
     } 
     
 }
 
+bool slave_writeResponse(ResponsePackage* response) {
+
+  const uint16_t responseSize = responsePackageSize(response);
+  
+  if (mesh.write(response, RH24_MESSAGE, responseSize)) { return true; }
+  
+  saturatedIncrement(slaveWriteRetries);
+  delay(RH24_SLAVE_WRITE_RETRY);
+  
+  return mesh.write(response, RH24_MESSAGE, responseSize);
+  
+}
+
+#ifdef RH24_GROUPS
+
+void slave_readGroupMessage(RF24NetworkHeader header) {
+
+  RH24RequestFrame frame;
+  
+  const uint16_t bytesRead = network.read(header, &frame, sizeof(RH24RequestFrame));
+  
+  if (bytesRead < 1 + MIN_REQUEST_SIZE || frame.request.host >= RH24_MAX_GROUPS || !(slaveGroups & (1 << frame.request.host))) { return; }
+  
+  R2_LOG(F("Got group message"));
+  
+  // The request was addressed to the group.
+  frame.request.host = getNodeId();
+  frame.request.checksum = createRequestChecksum(&frame.request);
+  
+  slaveGroupReply = execute(&frame.request);
+  slaveGroupReply.messageId = frame.messageId;
+  slaveGroupReplyTimer = millis();
+  slaveGroupReplyPending = true;
+  
+}
+
+#endif
+
 #endif
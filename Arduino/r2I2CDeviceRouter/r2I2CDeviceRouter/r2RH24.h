@@ -4,6 +4,20 @@
 
 #include "r2I2CDeviceRouter.h"
 
+#ifdef USE_RH24
+
+// Configurations created before the mesh address was cached don't define its EEPROM offset.
+#ifndef MESH_ADDRESS_EEPROM_ADDRESS
+  #define MESH_ADDRESS_EEPROM_ADDRESS (SLEEP_MODE_EEPROM_ADDRESS + 1)
+#endif
+
+#if (MESH_ADDRESS_EEPROM_ADDRESS <= SLEEP_MODE_EEPROM_ADDRESS && MESH_ADDRESS_EEPROM_ADDRESS + 1 >= SLEEP_MODE_EEPROM_ADDRESS) || \
+    (MESH_ADDRESS_EEPROM_ADDRESS <= NODE_ID_EEPROM_ADDRESS && MESH_ADDRESS_EEPROM_ADDRESS + 1 >= NODE_ID_EEPROM_ADDRESS)
+  #error MESH_ADDRESS_EEPROM_ADDRESS (2 bytes) overlaps SLEEP_MODE_EEPROM_ADDRESS or NODE_ID_EEPROM_ADDRESS. Check r2I2C_config.h.
+#endif
+
+#endif
+
 // Definitions for the package (Action) containing sleep information
 #define SLEEP_MODE_TOGGLE_POSITION 0x0
 #define SLEEP_MODE_CYCLES_POSITION 0x1
@@ -11,14 +25,17 @@
 // Will the slave try to ping the master
 //#define RH24_PING_ENABLED
 
-// How often will the slave try to ping the master
+// How often will the slave try to ping the master. The interval is doubled after each successful ping (up to RH24_MAX_PING_INTERVAL) and reset to RH24_MIN_PING_INTERVAL after a failure.
 #define RH24_PING_INTERVAL 60000
+#define RH24_MIN_PING_INTERVAL 15000
+#define RH24_MAX_PING_INTERVAL 240000
 
 // If this amount is reached, the mest.begin() should be called on the slave
 #define MAX_RENEWAL_FAILURE_COUNT 5
 
-// How often the slave will try to renew it's address (in ms)
+// How often the slave will try to renew it's address (in ms). The interval is doubled after each successful check (up to RH24_MAX_NETWORK_RENEWAL_TIME) and messages from the master postpone it.
 #define RH24_NETWORK_RENEWAL_TIME 3000
+#define RH24_MAX_NETWORK_RENEWAL_TIME 48000
 
 // The timeout for a slave before it gives up it's renewal attempt
 #define RH24_SLAVE_RENEWAL_TIMEOUT 5000
@@ -32,9 +49,130 @@
 // The number of second which is the default interval for pause sleep actions
 #define PAUSE_SLEEP_DEFAULT_INTERVAL 30
 
+#ifdef RH24_DISPATCH
+
+// The maximum number of requests the master can wait for simultaneously. Each request times out individually after RH24_READ_TIMEOUT ms, but keeps its entry until the response has been collected (see rh24Collect).
+#define RH24_MAX_PENDING_REQUESTS 4
+
+// The number of responses the master keeps when they match no outstanding request (i.e. responses arriving after rh24Send timed out). They can still be read using rh24Collect.
+#define RH24_LATE_RESPONSE_QUEUE_SIZE 2
+
+#else
+
+// Only rh24Send waits for a response. Late responses are dropped.
+#define RH24_MAX_PENDING_REQUESTS 1
+
+#endif
+
+// The number of (node, device) values the master remembers. Used to answer ACTION_GET_DEVICE requests for sleeping nodes.
+#define RH24_VALUE_CACHE_SIZE 8
+
+// The number of commands (i.e. ACTION_SET_DEVICE or ACTION_SEND_TO_SLEEP) the master can store for sleeping nodes.
+#define RH24_COMMAND_QUEUE_SIZE 6
+
+// The maximum number of commands queued for a single node.
+#define RH24_MAX_COMMANDS_PER_NODE 3
+
+// The number of check-ins during which a queued command will be sent before it's considered failed.
+#define RH24_COMMAND_MAX_ATTEMPTS 3
+
+// The number of check-ins the master can store until its run loop answers them (the check-ins received while waiting for a response).
+#define RH24_CHECK_IN_QUEUE_SIZE 4
+
+// The number of node groups available for ACTION_RH24_GROUP (at most 8). The master uses 32 bytes per group to keep track of the members.
+#define RH24_MAX_GROUPS 4
+
+// The reply slot (in ms) of each node answering a group request. A member replies after node id * RH24_GROUP_SLOT_LENGTH ms.
+#define RH24_GROUP_SLOT_LENGTH 10
+
+// How long (in ms) the master waits for group replies after the last member's slot.
+#define RH24_GROUP_TIMEOUT 1000
+
+// The number of nodes the master keeps link statistics for. The least recently seen node is replaced when full.
+#define RH24_LINK_STATS_SIZE 8
+
+// The number of data bytes in each frame of a bulk transfer. Frames larger than 24 bytes are fragmented by RF24Network (see MAX_PAYLOAD_SIZE).
+#define RH24_TRANSFER_CHUNK_SIZE 48
+
+// The number of chunks a slave sends per transfer request. The master buffers one window (RH24_TRANSFER_WINDOW * RH24_TRANSFER_CHUNK_SIZE bytes).
+#define RH24_TRANSFER_WINDOW 3
+
+// How long (in ms) the master waits for the chunks of a window.
+#define RH24_TRANSFER_TIMEOUT 2000
+
+// The number of sleep cycles (RH24_SLEEP_CYCLES) between the check-ins of a sleeping slave, unless set by ACTION_SEND_TO_SLEEP.
+#define RH24_CHECK_IN_CYCLES 15
+
+// The number of devices a sleeping slave can sample (see ACTION_RH24_SET_SAMPLING).
+#define RH24_MAX_SAMPLED_DEVICES 4
+
+// For how long (in ms) a sleeping slave stays awake after checking in or receiving a message, allowing the master to send queued requests.
+#define RH24_CHECK_IN_WINDOW 500
+
+// A check-in older than this (in ms) is not answered by the master, leaving time to deliver the queued requests within RH24_CHECK_IN_WINDOW.
+#define RH24_CHECK_IN_MAX_AGE (RH24_CHECK_IN_WINDOW / 2)
+
+// Size of the ping message: [node id, sleep state, retries]
+#define RH24_PING_SIZE 3
+#define RH24_PING_POSITION_NODE_ID 0x0
+#define RH24_PING_POSITION_SLEEPING 0x1
+#define RH24_PING_POSITION_RETRIES 0x2
+
+// Size of the master's reply to a ping: [node id, number of commands and reads queued for the node, RH24_PING_REPLY_FLAG_ flags]
+#define RH24_PING_REPLY_SIZE 3
+#define RH24_PING_REPLY_POSITION_QUEUED 0x1
+#define RH24_PING_REPLY_POSITION_FLAGS 0x2
+
+// The master queues the requests for sleeping nodes until they check in (RH24_COMMAND_QUEUE).
+#define RH24_PING_REPLY_FLAG_QUEUE 0x1
+
 // Send a package!
 ResponsePackage rh24Send(RequestPackage* request);
 
+#ifdef RH24_DISPATCH
+
+// Sends the request wrapped in a ACTION_RH24_DISPATCH request without waiting for the response. Returns the message id required to collect the response.
+byte rh24Dispatch(RequestPackage* request);
+
+// Returns the response to a request sent using rh24Dispatch. Sets ERROR_RH24_RESPONSE_PENDING if the node has not yet responded.
+ResponsePackage rh24Collect(HOST_ADDRESS nodeId, byte messageId);
+
+#endif
+
+#ifdef RH24_COMMAND_QUEUE
+
+// Returns the delivery status of a command queued for a sleeping node. Delivered and failed commands are removed once their status has been returned.
+ResponsePackage rh24CommandStatus(HOST_ADDRESS nodeId, byte commandId);
+
+#endif
+
+#ifdef RH24_GROUPS
+
+// Multicasts the request wrapped in a ACTION_RH24_GROUP request to the members of the group and returns the aggregated replies.
+ResponsePackage rh24Group(RequestPackage* request);
+
+// Sets the groups this (slave) node belongs to. Returns the mask now in use.
+byte setGroups(byte mask);
+
+#endif
+
+#ifdef RH24_LINK_STATS
+
+// Returns the link statistics the master has gathered for a node. The counters are reset once returned.
+ResponsePackage rh24LinkStats(HOST_ADDRESS nodeId);
+
+#endif
+
+#ifdef RH24_TRANSFER
+
+// Returns the node's bulk data at the offset. The master reads a window of chunks from the node whenever the offset is outside of the buffered window.
+ResponsePackage rh24Transfer(HOST_ADDRESS nodeId, uint16_t offset);
+
+// Sets the data this (slave) node offers for ACTION_RH24_TRANSFER (i.e. logged values). The data must stay valid while it's being transferred.
+void rh24SetTransferData(const byte* data, uint16_t size);
+
+#endif
+
 // Initializes RH24 communication. Should be called in setup().
 void rh24Setup();
 
@@ -47,8 +185,8 @@ bool nodeAvailable(HOST_ADDRESS nodeId);
 // Number of connected nodes.
 int nodeCount();
 
-// Returns an array of HOST_ADDRESS containing all connected nodes
-HOST_ADDRESS* getNodes();
+// Copies the ids of the connected nodes (at most maxCount) to nodes. Returns the number of ids copied.
+byte getNodes(HOST_ADDRESS* nodes, byte maxCount);
 
 // Returns true if this node is the router (master) node.
 bool isMaster();
@@ -68,4 +206,7 @@ void pauseSleep();
 // Returns true if this node is sleeping.
 bool isSleeping();
 
+// Samples the device every `interval` seconds while this (slave) node is sleeping. The values are sent to the master's cache. An interval of 0 stops sampling. Returns false if too many devices are sampled.
+bool setSampling(byte deviceId, uint16_t interval);
+
 #endif
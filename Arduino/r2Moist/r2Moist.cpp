@@ -14,7 +14,7 @@ uint8_t** GenerateSensorPairs(uint8_t *sensorPairs, uint8_t sensorPairCount) {
 	    
 	    for(int j = 0; j < SENSOR_ROD_COUNT; j++) {
 
-	    	_sensorPairs[i][j] = sensorPairs[i * sensorPairCount + j];
+	    	_sensorPairs[i][j] = sensorPairs[i * SENSOR_ROD_COUNT + j];
 
 	    }
 
@@ -105,24 +105,46 @@ void R2Moist::ActivateControlPort(int activeControlPort) {
 
 int R2Moist::Read(int sensorPairIndex) {
 
-	int readings[SENSOR_ROD_COUNT];
+	int value = 0;
 
-	for(int i = 0; i < SENSOR_ROD_COUNT; i++) {
+	if (sensorPairIndex >= 0) { Scan(&value, sensorPairIndex, 1); }
+
+	return value;
+
+}
+
+uint8_t R2Moist::Scan(int* values, uint8_t firstSensorPairIndex, uint8_t count) {
+
+	if (firstSensorPairIndex >= _sensorPairCount) { return 0; }
+
+	if (count > _sensorPairCount - firstSensorPairIndex) { count = _sensorPairCount - firstSensorPairIndex; }
 
-		_multiplexer->Open(_sensorPairs[sensorPairIndex][i]);
-		ActivateControlPort(i);
+	for(int i = 0; i < count; i++) { values[i] = 0; }
+
+	// A control port powers the same rod of every sensor, so the rods are read one control port at a time.
+	for(int rod = 0; rod < SENSOR_ROD_COUNT; rod++) {
+
+		_multiplexer->Open(_sensorPairs[firstSensorPairIndex][rod]);
+		ActivateControlPort(rod);
 		delay(MEASURE_TIME_MS);
-		readings[i] = analogRead(_analogPort);
+
+		for(int i = 0; i < count; i++) {
+
+			_multiplexer->Open(_sensorPairs[firstSensorPairIndex + i][rod]);
+
+			// The first conversion after switching channel charges the ADC's sample and hold capacitor (and lets the multiplexer settle).
+			analogRead(_analogPort);
+			values[i] += analogRead(_analogPort);
+
+		}
 
 	}
 
 	ActivateControlPort(CONTROL_PORTS_OFF);
 
-	int value = 0;
-	
-	for(int i = 0; i < SENSOR_ROD_COUNT; i++) { value += readings[i]; }
+	for(int i = 0; i < count; i++) { values[i] /= SENSOR_ROD_COUNT; }
 
-	return value / SENSOR_ROD_COUNT;
+	return count;
 
 }
 
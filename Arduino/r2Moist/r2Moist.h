@@ -54,6 +54,10 @@ class R2Moist {
 		/// `sensorPairIndex` is the index of a sensor pair defined in `sensorPairs`.
 		int Read(int sensorPairIndex);
 
+		/// Reads up to `count` sensor pairs in one pass, starting with `firstSensorPairIndex`, and stores the averages in `values`.
+		/// Each control port is only activated (and allowed to settle) once per pass. Returns the number of sensor pairs read.
+		uint8_t Scan(int* values, uint8_t firstSensorPairIndex, uint8_t count);
+
 		/// Returns the number of registered sensor pairs. Will match using `read(sensorPairIndex)`.
 		inline uint8_t SensorPairCount() { return _sensorPairCount; }
 
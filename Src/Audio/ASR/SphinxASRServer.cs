@@ -42,7 +42,7 @@ namespace R2Core.Audio.ASR
 		private const string dllPath = "libr2sphinx.so";
 	
 		[DllImport(dllPath, CharSet = CharSet.Auto)]
-		public static extern int _ext_asr_start();
+		public static extern int _ext_asr_start_async();
 
 		[DllImport( dllPath)]
 		protected static extern int _ext_asr_turn_off();
@@ -70,7 +70,6 @@ namespace R2Core.Audio.ASR
 		
 
 		protected bool m_isRunning;
-		protected Task m_asrTask;
 
 		//observers are called from a gstreamer thread...
 		private static ICollection<IASRObserver> m_observers;
@@ -122,22 +121,6 @@ namespace R2Core.Audio.ASR
 			m_textReceivedCallBack = new TextInterpretedCallBack(this.DefaultTextReceived);
 			m_errorReceivedCallBack = new SphinxErrorCallBack(this.DefaultErrorReceived);
 			
-			m_asrTask = new Task(() => {
-				
-				while (m_isRunning) {
-					
-					if (_ext_asr_start() != 0) {
-
-						m_isRunning = false;
-
-						throw new ExternalException("Unable to start ASR!");
-					
-					}
-				
-				}
-
-			});
-
 			if (_ext_asr_init(
 				    m_textReceivedCallBack, 
 				    m_errorReceivedCallBack,
@@ -179,8 +162,14 @@ namespace R2Core.Audio.ASR
 				throw new DeviceException("ASR is already running...");
 			}
 			
+			// Runs on the shared GStreamer loop thread, which restarts the pipeline until it's turned off.
+			if (_ext_asr_start_async() != 0) {
+
+				throw new ExternalException("Unable to start ASR!");
+
+			}
+
 			m_isRunning = true;
-			m_asrTask.Start();
 		}
 		
 		public override void Stop() {
@@ -208,7 +197,8 @@ namespace R2Core.Audio.ASR
 		
 		#region ITaskMonitored implementation
 		public IDictionary<string,Task> GetTasksToObserve() {
-			return new Dictionary<string, Task>() {{"SPHINX ASR",m_asrTask}};
+			// Nothing to observe: the pipeline runs on the shared GStreamer loop thread.
+			return new Dictionary<string, Task>();
 		}
 		#endregion
 
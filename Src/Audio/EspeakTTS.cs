@@ -21,19 +21,20 @@ using System.Runtime.InteropServices;
 using System.Collections.Generic;
 using R2Core;
 using R2Core.Device;
-using System.Threading.Tasks;
 
 namespace R2Core.Audio.TTS
 {
 	public class EspeakTTS : DeviceBase, ITTS {
 		
+		protected delegate void SpeechDoneCallBack();
+
 		private const string dllPath = "libr2espeak.so";
 		
 		[DllImport(dllPath, CharSet = CharSet.Auto)]
    	 	protected static extern int _ext_init_espeak();
 
 		[DllImport(dllPath, CharSet = CharSet.Auto)]
-		protected static extern void _ext_speak_espeak(string text);
+		protected static extern void _ext_speak_espeak_async(string text, SpeechDoneCallBack doneCallback);
 		
 		[DllImport(dllPath, CharSet = CharSet.Auto)]
 		protected static extern void _ext_set_rate_espeak(int rate);
@@ -58,12 +59,16 @@ namespace R2Core.Audio.TTS
 		private bool m_isStarted;
 		
 		private IList<ITTSObserver> m_observers;
+
+		// Kept as a member, so that it isn't collected while the native side holds it.
+		private SpeechDoneCallBack m_speechDoneCallBack;
 		
 		private static readonly object m_lock = new object();					
 		
 		public EspeakTTS(string identifier) : base(identifier) {
 
 			m_observers = new List<ITTSObserver>();
+			m_speechDoneCallBack = new SpeechDoneCallBack(this.SpeechDone);
 			_ext_init_espeak();
 		
 		}
@@ -77,25 +82,29 @@ namespace R2Core.Audio.TTS
 				throw new DeviceException("Unable to speak: not started!");
 			}
 
+			// Nothing is said while the player is busy.
+			if (_ext_is_playing_espeak() != 0) { return; }
+
 			m_currentText = text;
 
-			Task.Factory.StartNew( () => {
-			
-				foreach (ITTSObserver observer in m_observers) {
+			foreach (ITTSObserver observer in m_observers) {
 
-					observer.TalkStarted(this);
+				observer.TalkStarted(this);
 
-				}
+			}
+
+			// The speech is played by the shared GStreamer loop thread, which calls SpeechDone when it has ended.
+			_ext_speak_espeak_async(text, m_speechDoneCallBack);
 
-				_ext_speak_espeak(text);
+		}
 
-				foreach (ITTSObserver observer in m_observers) {
+		private void SpeechDone() {
 
-					observer.TalkEnded(this);
+			foreach (ITTSObserver observer in m_observers) {
 
-				}
+				observer.TalkEnded(this);
 
-			});
+			}
 
 		}
 
@@ -19,8 +19,6 @@
 ﻿using System;
 using R2Core.Device;
 using System.Runtime.InteropServices;
-using System.Threading;
-using System.Threading.Tasks;
 using System.IO;
 using R2Core;
 using System.Linq;
@@ -36,7 +34,7 @@ namespace R2Core.Audio
 		protected static extern int _ext_init_mp3_file();
 
 		[DllImport(dllPath, CharSet = CharSet.Auto)]
-		protected static extern void _ext_play_file_mp3(int id, string fileName);
+		protected static extern void _ext_play_file_mp3_async(int id, string fileName);
 
 		[DllImport(dllPath, CharSet = CharSet.Auto)]
 		protected static extern void _ext_stop_mp3(int id);
@@ -55,7 +53,6 @@ namespace R2Core.Audio
 
         private const int ID_NOT_INITIALIZED = -1;
 		private string m_basePath;
-		private Task m_playTaks;
         private int mp3_id = ID_NOT_INITIALIZED;
 
         public Mp3Player(string id, string basePath) : base(id) {
@@ -78,17 +75,14 @@ namespace R2Core.Audio
 			
 			}
 
-			if (m_playTaks != null && m_playTaks.Status == TaskStatus.Running) {
+			if (IsPlaying) {
 			
 				_ext_stop_playback_mp3(mp3_id);
 
 			}
 
-			m_playTaks = Task.Factory.StartNew(() => {
-			
-				_ext_play_file_mp3(mp3_id, fileName);
-			
-			});
+			// The playback runs on the shared GStreamer loop thread.
+			_ext_play_file_mp3_async(mp3_id, fileName);
 
 		}
 
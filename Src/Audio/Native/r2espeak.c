@@ -19,8 +19,12 @@
 // (c) tord wessman 2012
 
 #include "r2espeak.h"
+#include "r2gstloop.h"
 
-static GMainLoop *loop;
+// The bus watch is attached to the shared loop (r2gstloop). done is signaled when the speech ends.
+static GSource *bus_watch;
+static GMutex mutex;
+static GCond done;
 
 static GstElement *bin, 	// the containing all the elements
 		*pipeline, 	 		// the pipeline for the bin
@@ -32,14 +36,34 @@ static GstElement *bin, 	// the containing all the elements
 		*effect1,			// using audiocheblimit filter from gst-good
 		*alsa_sink;
 
-static GstBus *bus;	//the bus element te transport messages from/to the pipeline
-
 static int is_playing; //indicates that the player is busy
 static int pitch;
 static int rate;
 
 static bool is_initialized = false;
 
+// Set by _ext_speak_espeak_async and called once when that speech ends
+static void (*speech_done)();
+
+// Ends the playback and wakes up the thread waiting in play. Called from any thread.
+static void playback_done() {
+
+	gst_element_set_state(GST_ELEMENT(pipeline), GST_STATE_NULL);
+
+	g_mutex_lock(&mutex);
+	int was_playing = is_playing;
+	void (*callback)() = speech_done;
+	is_playing = 0;
+	speech_done = NULL;
+	g_cond_broadcast(&done);
+	g_mutex_unlock(&mutex);
+
+	if (was_playing && callback) {
+		callback();
+	}
+
+}
+
 static gboolean bus_call(GstBus *bus, GstMessage *msg, void *user_data)
 {
 
@@ -47,7 +71,7 @@ static gboolean bus_call(GstBus *bus, GstMessage *msg, void *user_data)
 	case GST_MESSAGE_EOS: {
 		//g_message("End-of-stream");
 		//report the end of stream
-		g_main_loop_quit(loop);
+		playback_done();
 		break;
 	}
 	case GST_MESSAGE_ERROR: {
@@ -57,7 +81,7 @@ static gboolean bus_call(GstBus *bus, GstMessage *msg, void *user_data)
 		printf ("ERROR: %s", err->message);
 		g_error_free(err);
 		
-		g_main_loop_quit(loop);
+		playback_done();
 		
 		break;
 	} 
@@ -79,7 +103,7 @@ static gboolean bus_call(GstBus *bus, GstMessage *msg, void *user_data)
 		str = gst_message_get_structure (msg);
 		 if (gst_structure_has_name(str,"turn_off"))
 			{
-				g_main_loop_quit(loop);
+				playback_done();
 			}
 
 		break;
@@ -96,13 +120,11 @@ static gboolean bus_call(GstBus *bus, GstMessage *msg, void *user_data)
 
 //this method initiates the gobjects, the pipeline, the bus and the entire bin
 int init() {
-	gst_init (NULL, NULL);
+	// Starts GStreamer and the shared loop thread.
+	r2_loop_context();
 	pitch = 100;
 	rate = -100;
 
-	// create the main loop
-	loop = g_main_loop_new(NULL, FALSE);
-
 	pipeline = gst_pipeline_new ("espeak_pipeline");
 	bin = gst_bin_new ("espeak_bin");
 
@@ -154,12 +176,8 @@ int init() {
 	g_object_set (G_OBJECT (espeak), "text", "", NULL);
 	g_object_set (G_OBJECT (espeak), "voice", "de", NULL);
 
-	// create the bus for the pipeline:
-	bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline));
-	//add the bus handler method:
-	gst_bus_add_watch(bus, bus_call, NULL);
-
-	gst_object_unref(bus);
+	//add the bus handler method to the shared loop:
+	bus_watch = r2_loop_add_bus_watch(pipeline, bus_call, NULL);
 
 	// Add the elements to the bin
 	gst_bin_add_many (GST_BIN (bin), 
@@ -194,25 +212,40 @@ int init() {
 
 }
 
-//stop the main loop and dealocate resources
+//stop the playback and dealocate resources
 void stop() {
-	g_main_loop_quit(loop);
+	playback_done();
+	r2_loop_remove_watch(bus_watch);
+	bus_watch = NULL;
 	gst_object_unref(GST_OBJECT(pipeline));
-	g_main_loop_unref (loop);
 }
 
-void play(const char* text) {
+// Starts speaking and returns. The bus messages are handled by the shared loop thread.
+bool start(const char* text) {
 
 	if (!is_initialized) {
 		g_critical ("Espeak Unable to play. You have to initialize first!");
-		return; 
+		return false; 
 	}
 	is_playing = 1;
 	g_object_set (G_OBJECT (espeak), "text", text, NULL);
 	gst_element_set_state(GST_ELEMENT(pipeline), GST_STATE_PLAYING);
-	g_main_loop_run(loop);
-	gst_element_set_state(GST_ELEMENT(pipeline), GST_STATE_NULL);
-	is_playing = 0;
+
+	return true;
+}
+
+// Blocks until the speech has ended.
+void play(const char* text) {
+
+	if (!start(text)) {
+		return;
+	}
+
+	g_mutex_lock(&mutex);
+	while (is_playing) {
+		g_cond_wait(&done, &mutex);
+	}
+	g_mutex_unlock(&mutex);
 }
 
 void _ext_stop_espeak() {
@@ -235,8 +268,17 @@ void _ext_speak_espeak(const char* text) {
 		play(text);
 }
 
+void _ext_speak_espeak_async(const char* text, void (*done_callback)()) {
+	if (is_playing == 0) {
+		speech_done = done_callback;
+		if (!start(text)) {
+			speech_done = NULL;
+		}
+	}
+}
+
 void _ext_pause_espeak() {
-	g_main_loop_quit(loop);
+	playback_done();
 }
 
 int _ext_is_playing_espeak() {
@@ -27,6 +27,9 @@
 int _ext_init_espeak();
 //speaks the text (!)
 void _ext_speak_espeak(const char* text);
+//starts speaking the text and returns. done_callback (may be NULL) is called from the shared loop thread when the speech
+//has ended (or from the thread stopping it). ignored while the player is playing
+void _ext_speak_espeak_async(const char* text, void (*done_callback)());
 //set the pause between words (-100 to 100)
 void _ext_set_rate_espeak(int _rate);
 //set the voice pitch (-100 to 100)
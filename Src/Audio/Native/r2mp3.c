@@ -19,13 +19,17 @@
 // (c) tord wessman 2012
 
 #include "r2mp3.h"
+#include "r2gstloop.h"
 #include <gio/gio.h>
 
 #define MAX_MP3_PLAYERS 10
 
 typedef struct Mp3PlayerInstances {
 
-	GMainLoop *mp3_loop;
+	// The bus watch is attached to the shared loop (r2gstloop). mp3_done is signaled when the playback ends.
+	GSource *mp3_bus_watch;
+	GMutex mp3_mutex;
+	GCond mp3_done;
 
 	GMemoryInputStream *mistream;
 
@@ -37,8 +41,6 @@ typedef struct Mp3PlayerInstances {
 			*mp3_echo,	
 			*mp3_alsa_sink;
 
-	GstBus *mp3_bus;	//the bus element te transport messages from/to the pipeline
-
 	int mp3_is_playing; //indicates that the player is busy
 
 	int mp3_is_initialized;
@@ -51,6 +53,18 @@ typedef struct Mp3PlayerInstances {
 Mp3Player players[MAX_MP3_PLAYERS]; 
 static int id_counter = 0;
 
+// Ends the playback and wakes up the thread waiting in mp3_play. Called from any thread.
+static void mp3_playback_done(Mp3Player *player) {
+
+	gst_element_set_state(GST_ELEMENT(player->mp3_pipeline), GST_STATE_NULL);
+
+	g_mutex_lock(&player->mp3_mutex);
+	player->mp3_is_playing = 0;
+	g_cond_broadcast(&player->mp3_done);
+	g_mutex_unlock(&player->mp3_mutex);
+
+}
+
 static gboolean mp3_bus_call(GstBus *bus, GstMessage *msg, void *user_data) {
 
 	Mp3Player *player = (Mp3Player *)user_data;
@@ -58,7 +72,7 @@ static gboolean mp3_bus_call(GstBus *bus, GstMessage *msg, void *user_data) {
 
 		case GST_MESSAGE_EOS: {
 
-			g_main_loop_quit(player->mp3_loop);
+			mp3_playback_done(player);
 			break;
 		
 		} case GST_MESSAGE_ERROR: {
@@ -69,7 +83,7 @@ static gboolean mp3_bus_call(GstBus *bus, GstMessage *msg, void *user_data) {
 			printf ("ERROR: %s", err->message);
 			g_error_free(err);
 			
-			g_main_loop_quit(players->mp3_loop);
+			mp3_playback_done(player);
 			
 			break;
 		} default: { break;}
@@ -88,8 +102,8 @@ int mp3_init(GstElement *src) {
 	players[id_counter].id = id_counter;
 	players[id_counter].mp3_is_initialized = 0;
 
-	// create the main loop
-	players[id_counter].mp3_loop = g_main_loop_new(NULL, FALSE);
+	g_mutex_init(&players[id_counter].mp3_mutex);
+	g_cond_init(&players[id_counter].mp3_done);
 
 	players[id_counter].mp3_pipeline = gst_pipeline_new ("mp3_pipeline");
 	players[id_counter].mp3_bin = gst_bin_new ("mp3_bin");
@@ -130,12 +144,8 @@ int mp3_init(GstElement *src) {
 	
 	}
 
-	// create the bus for the pipeline:
-	players[id_counter].mp3_bus = gst_pipeline_get_bus(GST_PIPELINE(players[id_counter].mp3_pipeline));
-	//add the bus handler method:
-	gst_bus_add_watch(players[id_counter].mp3_bus, mp3_bus_call, &players[id_counter]);
-
-	gst_object_unref(players[id_counter].mp3_bus);
+	//add the bus handler method to the shared loop:
+	players[id_counter].mp3_bus_watch = r2_loop_add_bus_watch(players[id_counter].mp3_pipeline, mp3_bus_call, &players[id_counter]);
 
 	// Add the elements to the bin
 	gst_bin_add_many(GST_BIN(players[id_counter].mp3_bin), 
@@ -171,47 +181,67 @@ int mp3_init(GstElement *src) {
 	
 }
 
-//stop the main loop and dealocate resources
+//stop the playback and dealocate resources
 void mp3_stop(int id) {
 
-	gst_element_set_state(GST_ELEMENT(players[id].mp3_pipeline), GST_STATE_NULL);
-	g_main_loop_quit(players[id].mp3_loop);
+	mp3_playback_done(&players[id]);
+	r2_loop_remove_watch(players[id].mp3_bus_watch);
+	players[id].mp3_bus_watch = NULL;
 	gst_object_unref(GST_OBJECT(players[id].mp3_pipeline));
-	g_main_loop_unref(players[id].mp3_loop);
 
 }
 
 // Just stops the playback
 void mp3_stop_playback(int id) {
 
-	gst_element_set_state(GST_ELEMENT(players[id].mp3_pipeline), GST_STATE_NULL);
-	g_main_loop_quit(players[id].mp3_loop);
+	mp3_playback_done(&players[id]);
 
 }
 
-void mp3_play(int id) {
+// Starts the playback and returns. The bus messages are handled by the shared loop thread.
+void mp3_start(int id) {
 
 	gst_element_set_state(GST_ELEMENT(players[id].mp3_pipeline), GST_STATE_PLAYING);
-	g_main_loop_run(players[id].mp3_loop);
-	gst_element_set_state(GST_ELEMENT(players[id].mp3_pipeline), GST_STATE_NULL);
+
+}
+
+// Blocks until the playback has ended.
+void mp3_play(int id) {
+
+	mp3_start(id);
+
+	g_mutex_lock(&players[id].mp3_mutex);
 	
-	players[id].mp3_is_playing = 0;
+	while (players[id].mp3_is_playing) {
+
+		g_cond_wait(&players[id].mp3_done, &players[id].mp3_mutex);
+	
+	}
+
+	g_mutex_unlock(&players[id].mp3_mutex);
 
 }
 
-void mp3_file_play(int id, const char* mp3_file) {
+// Sets the file to play. Returns false if the player has not been initialized.
+static bool mp3_file_set(int id, const char* mp3_file) {
 
 	if (!players[id].mp3_is_initialized) {
 
 		g_critical ("Mp3 player Unable to play. You have to initialize first!");
-		return; 
+		return false; 
 	
 	}
 
 	players[id].mp3_is_playing = 1;
 	g_object_set (G_OBJECT(players[id].mp3_src), "location", mp3_file, NULL);
 
-	mp3_play(id);
+	return true;
+
+}
+
+void mp3_file_play(int id, const char* mp3_file) {
+
+	if (mp3_file_set(id, mp3_file)) { mp3_play(id); }
 
 }
 
@@ -252,14 +282,14 @@ void _ext_stop_playback_mp3(int id) {
 
 int _ext_init_mp3_file() {
 
-	gst_init (NULL, NULL);
+	r2_loop_context();
 	return mp3_init(gst_element_factory_make ("filesrc", "src"));
 
 }
 
 int _ext_init_mp3_memory() {
 
-	gst_init (NULL, NULL);
+	r2_loop_context();
 	return mp3_init(gst_element_factory_make ("giostreamsrc", "src"));
 
 }
@@ -271,6 +301,13 @@ void _ext_play_file_mp3(int id, const char* mp3_file) {
 
 }
 
+void _ext_play_file_mp3_async(int id, const char* mp3_file) {
+
+	if (players[id].mp3_is_playing != 0) { g_print("Already playing!"); }
+	else if (mp3_file_set(id, mp3_file)) { mp3_start(id); }
+
+}
+
 void _ext_play_memory_mp3(int id, uint8_t* mp3_pointer, int size) {
 
 	if (players[id].mp3_is_playing == 0) { mp3_memory_play(id, mp3_pointer, size); }
@@ -279,7 +316,7 @@ void _ext_play_memory_mp3(int id, uint8_t* mp3_pointer, int size) {
 
 void _ext_pause_mp3(int id) {
 
-	g_main_loop_quit(players[id].mp3_loop);
+	mp3_playback_done(&players[id]);
 
 }
 
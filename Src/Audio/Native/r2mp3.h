@@ -46,6 +46,9 @@ int _ext_init_mp3_memory ();
 // Play from file with location ´mp3_file´. Requires an initialization by ´_ext_init_mp3_file´.
 void _ext_play_file_mp3(int id, const char* mp3_file);
 
+// Same as ´_ext_play_file_mp3´, but returns as soon as the playback has started (´_ext_is_playing_mp3´ returns 0 when it has ended).
+void _ext_play_file_mp3_async(int id, const char* mp3_file);
+
 // Play resource from memory. Require the ´_ext_init_mp3_memory´ to be called.
 void _ext_play_memory_mp3(int id, uint8_t* mp3_pointer, int size);
 
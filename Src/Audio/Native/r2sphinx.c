@@ -17,6 +17,7 @@
 // 
 
 #include "r2sphinx.h"
+#include "r2gstloop.h"
 #include <string.h>
 #include <stdlib.h>
 
@@ -28,13 +29,19 @@ static bool _r2Sphinx_is_active = true, _r2Sphinx_is_running = false, use_tcp_se
 static int _r2Sphinx_threshold = 90;
 static int m_port = 5002, error_count = 0;
 static const char *m_hostIp;
-static GMainLoop *loop;
 GstElement *pipeline;
 
 #define MAX_ERROR_RETRIES 10
+// The delay before a pipeline started by _ext_asr_start_async is restarted after EOS or an error
+#define ASR_RESTART_DELAY_MS 1000
 
-static GstBus *bus;	//the bus element te transport messages from/to the pipeline
-guint bus_watch_id;
+// Set by _ext_asr_start_async and cleared by _ext_asr_turn_off
+static bool keep_running = false;
+
+static GSource *bus_watch;	//attached to the shared loop (r2gstloop)
+static GSource *restart_source;	//pending restart_pipeline timeout. Guarded by asr_mutex
+static GMutex asr_mutex;
+static GCond asr_stopped;	//signaled when the pipeline stops running
 
 static const char *lm_file_name, *dic_file_name, *hmm_file_name;
 
@@ -42,7 +49,13 @@ static const char *lm_file_name, *dic_file_name, *hmm_file_name;
 void turn_off () {
 
 	should_turn_off = true;
-	g_main_loop_quit(loop);
+
+	gst_element_set_state(pipeline, GST_STATE_NULL);
+
+	g_mutex_lock(&asr_mutex);
+	_r2Sphinx_is_running = false;
+	g_cond_broadcast(&asr_stopped);
+	g_mutex_unlock(&asr_mutex);
 
 }
 
@@ -62,14 +75,43 @@ char *strdupa (const char *s) {
     return d;                            // Return new memory
 }
 
+static int start_pipeline ();
+
+static gboolean restart_pipeline(gpointer data) {
+
+	g_mutex_lock(&asr_mutex);
+	if (restart_source) {
+		g_source_unref(restart_source);
+		restart_source = NULL;
+	}
+	g_mutex_unlock(&asr_mutex);
+
+	if (keep_running && !_r2Sphinx_is_running && start_pipeline() != 0) {
+		keep_running = false;
+	}
+
+	return G_SOURCE_REMOVE;
+}
+
+// Restarts the pipeline (i.e. after the tcp client has disconnected) until it's turned off.
+static void schedule_restart () {
+
+	g_mutex_lock(&asr_mutex);
+	if (keep_running && !restart_source) {
+		restart_source = r2_loop_add_timeout(ASR_RESTART_DELAY_MS, restart_pipeline, NULL);
+	}
+	g_mutex_unlock(&asr_mutex);
+
+}
+
 static gboolean bus_call(GstBus * bus, GstMessage * msg, gpointer data) {
-    GMainLoop *loop = (GMainLoop *) data;
 
     switch (GST_MESSAGE_TYPE(msg)) {
 
     case GST_MESSAGE_EOS:
         g_print("End of stream\n");
 	turn_off();
+	schedule_restart();
         break;
 
     case GST_MESSAGE_ERROR:{
@@ -84,9 +126,8 @@ static gboolean bus_call(GstBus * bus, GstMessage * msg, gpointer data) {
 		send_error(error->code, error->message);
 
 		turn_off();
+		schedule_restart();
             g_error_free(error);
-		
-            g_main_loop_quit(loop);
             break;
         }
     default:
@@ -119,6 +160,16 @@ static gboolean bus_call(GstBus * bus, GstMessage * msg, gpointer data) {
 }
 
 int _ext_asr_turn_off() {
+	keep_running = false;
+
+	g_mutex_lock(&asr_mutex);
+	GSource *pending_restart = restart_source;
+	restart_source = NULL;
+	g_mutex_unlock(&asr_mutex);
+
+	// Removed outside of the lock, since it waits for the loop thread (which might be waiting for the lock in restart_pipeline).
+	r2_loop_remove_watch(pending_restart);
+
 	turn_off ();
 	return 1;
 }
@@ -218,49 +269,58 @@ int init_elements (const char *lm_file, const char *dict_file, const char *hmm_f
 
 }
 
-int _ext_asr_start () {
+static int start_pipeline () {
 	if (_r2Sphinx_is_running) {
 		send_error (0, "Unable to start ASR - already running!");
 		return 1;  
 	}
 
-	_r2Sphinx_is_running = true;
-
-	
-    loop = g_main_loop_new(NULL, FALSE);
+	if (!bus_watch) {
+		bus_watch = r2_loop_add_bus_watch(pipeline, bus_call, NULL);
+	}
 
-    bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline));
-    bus_watch_id = gst_bus_add_watch(bus, bus_call, loop);
-    gst_object_unref(bus);
+	should_turn_off = false;
+	_r2Sphinx_is_running = true;
 
     	if (GST_STATE_CHANGE_FAILURE == gst_element_set_state(pipeline, GST_STATE_PLAYING)) {
 		error_count++;
 	}
 
 	if (error_count > MAX_ERROR_RETRIES) {
+		_r2Sphinx_is_running = false;
 		return send_error(ASR_ERROR_GST, "Unable to start pipeline.");
 	} else {
 		error_count = 0;
 	}
 
-    g_main_loop_run(loop);
+	return 0;
+}
 
-	_r2Sphinx_is_running = false;
-    	gst_element_set_state(pipeline, GST_STATE_NULL);
-	g_main_loop_unref(loop);
-	//gst_object_unref(GST_OBJECT(pipeline));
-	g_source_remove(bus_watch_id);
-	if (should_turn_off) {
+int _ext_asr_start_async () {
 
-	    
-	} else {
+	keep_running = true;
+
+	int result = start_pipeline();
 
-		return _ext_asr_start();
+	if (result != 0) { keep_running = false; }
+
+	return result;
+}
+
+int _ext_asr_start () {
+
+	int result = start_pipeline();
+
+	if (result != 0) { return result; }
+
+	g_mutex_lock(&asr_mutex);
+	while (_r2Sphinx_is_running) {
+		g_cond_wait(&asr_stopped, &asr_mutex);
 	}
-	
+	g_mutex_unlock(&asr_mutex);
+
 	should_turn_off = false;
 	
-	
 	return 0;
 }
 
@@ -338,7 +398,8 @@ int _ext_asr_init (const char*(*text_received_callback)(const char *message ),
 
 	}
 
-	gst_init (NULL, NULL);
+	// Starts GStreamer and the shared loop thread.
+	r2_loop_context();
 	
 	return init_elements(lm_file_name , dic_file_name, hmm_file_name);
 
@@ -46,10 +46,17 @@ bool _ext_asr_get_is_active ();
 int _ext_asr_turn_off();
 
 /** 	the asr_start fires up the engine and makes it ready to receive audio from the microphone
-	and to fire delegate methods.
+	and to fire delegate methods. Blocks until the engine is turned off or the stream ends. Unlike
+	_ext_asr_start_async, the pipeline is not restarted after EOS or an error.
 **/
 int _ext_asr_start ();
 
+/** 	same as _ext_asr_start, but returns as soon as the pipeline is playing. The messages are
+	handled by the shared loop thread (r2gstloop). The pipeline is restarted after EOS or an
+	error (i.e. when the tcp client disconnects) until _ext_asr_turn_off is called.
+**/
+int _ext_asr_start_async ();
+
 /**
 	asr_init is the main initialization method.
 	params: 
@@ -18,14 +18,13 @@
 ﻿using System;
 using R2Core.Device;
 using System.Runtime.InteropServices;
-using System.Threading.Tasks;
 
 namespace R2Core.Common
 {
 	/// <summary>
 	/// Represent a gstreamer pipeline object. Use this object to create a simple gstreamer pipline. 
 	/// </summary>
-	public class Gstream : DeviceBase, IGstream, ITaskMonitored {
+	public class Gstream : DeviceBase, IGstream {
 
 		private const string dllPath = "libr2gstparseline.so";
 
@@ -39,7 +38,7 @@ namespace R2Core.Common
 		protected static extern int _ext_destroy_gstream(IntPtr pipeline);
 
 		[DllImport(dllPath, CharSet = CharSet.Auto)]
-		protected static extern int _ext_play_gstream(IntPtr ptr);
+		protected static extern int _ext_start_gstream(IntPtr ptr);
 
 		[DllImport(dllPath, CharSet = CharSet.Auto)]
 		protected static extern int _ext_stop_gstream(IntPtr ptr);
@@ -54,13 +53,20 @@ namespace R2Core.Common
 		protected static extern int _ext_get_error_code(System.IntPtr ptr);
 
 		private string m_pipeLine;
-		private Task m_task;
 
         private IntPtr m_ptr;
 
 		readonly object m_startLock = new object();
 
-        public bool IsRunning { get; private set; }
+        public bool IsRunning {
+
+			get {
+
+				return m_ptr != IntPtr.Zero && _ext_is_playing_gstream(m_ptr) == 1;
+
+			}
+
+		}
 
         public Gstream(string id, string pipeline) : base(id) {
 
@@ -131,32 +137,17 @@ namespace R2Core.Common
 
 			}
 
-			m_task = Task.Factory.StartNew(() => {
-
-				IsRunning = true;
-
-				if (_ext_play_gstream(m_ptr) != 1) {
-
-					IsRunning = false;
-
-					Log.e($"Gstream '{Identifier}' start playback failed with error code: {_ext_get_error_code(m_ptr)}. Unable to play pipeline '{m_pipeLine}'.");
+			// The native pipeline runs on the shared GStreamer loop thread.
+			if (_ext_start_gstream(m_ptr) != 1) {
 
-				}
+				Log.e($"Gstream '{Identifier}' start playback failed with error code: {_ext_get_error_code(m_ptr)}. Unable to play pipeline '{m_pipeLine}'.");
 
-				if (_ext_get_error_code(m_ptr) != 0) {
-
-					Log.e($"Gstream '{Identifier}' playback failed with error code: {_ext_get_error_code(m_ptr)}. Unable to play pipeline '{m_pipeLine}'.");
-
-				}
-
-			});
+			}
 
 		}
 
 		public override void Stop() {
 
-			IsRunning = false;
-
 			if (Ready && _ext_stop_gstream(m_ptr) != 1) {
 
 				Log.e("Gstream '" + Identifier + "' Unable to stop pipeline: " + m_pipeLine);
@@ -189,16 +180,6 @@ namespace R2Core.Common
 
 		}
 
-		#region ITaskMonitored implementation
-
-		public System.Collections.Generic.IDictionary<string, Task> GetTasksToObserve() {
-
-			return new System.Collections.Generic.Dictionary<string,Task> {{ "Gst" + Identifier, m_task}};
-		
-		}
-
-		#endregion
-
 	}
 
 }
\ No newline at end of file
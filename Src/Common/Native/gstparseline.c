@@ -23,6 +23,19 @@
 
 int stopGstPipeLine (struct PLC* plc);
 
+// Sets the pipeline to NULL and wakes up the callers waiting in playGstPipeLine. Called from any thread.
+static void finishGstPipeLine(struct PLC* plc) {
+
+	gst_element_set_state(GST_ELEMENT(plc->pipeline), GST_STATE_NULL);
+
+	g_mutex_lock(&plc->mutex);
+	plc->is_playing = false;
+	plc->is_stopped = true;
+	g_cond_broadcast(&plc->stopped);
+	g_mutex_unlock(&plc->mutex);
+
+}
+
 static gboolean bus_callGstPipeLine(GstBus *busObj, GstMessage *msg, void *user_data)
 {
 	
@@ -33,8 +46,7 @@ static gboolean bus_callGstPipeLine(GstBus *busObj, GstMessage *msg, void *user_
 		//g_message("End-of-stream");
 		//report the end of stream
 		
-		g_main_loop_quit(plc->loop);
-		plc->is_stopped = true;
+		finishGstPipeLine(plc);
 		break;
 	}
 	case GST_MESSAGE_ERROR: {
@@ -47,8 +59,7 @@ static gboolean bus_callGstPipeLine(GstBus *busObj, GstMessage *msg, void *user_
 		plc->error_code = err->code;
 		g_error_free(err);
 		
-		g_main_loop_quit(plc->loop);
-		plc->is_stopped = true;
+		finishGstPipeLine(plc);
 		
 		break;
 	} 
@@ -71,8 +82,7 @@ static gboolean bus_callGstPipeLine(GstBus *busObj, GstMessage *msg, void *user_
 
 		 if (gst_structure_has_name(str,"turn_off"))
 			{
-				g_main_loop_quit(plc->loop);
-				plc->is_stopped = true;
+				finishGstPipeLine(plc);
 			}
 
 		break;
@@ -99,11 +109,16 @@ struct PLC* createPipeLine (const char* pipelineString) {
 	}
 
 	plc->pipelineString = strdup(pipelineString);
+	plc->pipeline = NULL;
+	plc->bus_watch = NULL;
 	plc->is_playing = false;
 	plc->is_initialized = false;
 	plc->is_stopped = false;
 	plc->error_code = 0;
 
+	g_mutex_init(&plc->mutex);
+	g_cond_init(&plc->stopped);
+
 	return plc;
 
 }
@@ -112,12 +127,23 @@ int destroyPipeLine(struct PLC *plc) {
 
 	if (plc != NULL) {
 
-		if (!plc->is_stopped && plc->is_initialized) {
+		if (plc->is_playing) {
 		
 			stopGstPipeLine(plc);
 
 		}
 
+		r2_loop_remove_watch(plc->bus_watch);
+
+		if (plc->pipeline != NULL) {
+
+			gst_object_unref(GST_OBJECT(plc->pipeline));
+
+		}
+
+		g_cond_clear(&plc->stopped);
+		g_mutex_clear(&plc->mutex);
+		free((void*)plc->pipelineString);
 		free(plc);
 
 		return true;
@@ -149,12 +175,16 @@ int initGstPipeLine(struct PLC* plc) {
 		
 	} else if (plc->is_initialized) {
 
+		r2_loop_remove_watch(plc->bus_watch);
+		plc->bus_watch = NULL;
 		gst_object_unref(GST_OBJECT(plc->pipeline));		
+		plc->pipeline = NULL;
+		plc->is_initialized = false;
 		
 	}
 
-	gst_init (NULL, NULL);
-	plc->loop = g_main_loop_new(NULL, FALSE);
+	// Starts GStreamer and the shared loop thread.
+	r2_loop_context();
 
 	plc->pipeline = gst_parse_launch (plc->pipelineString, &error);
 	plc->error_code = error ? error->code : 0;
@@ -169,11 +199,7 @@ int initGstPipeLine(struct PLC* plc) {
     		
 	}
 
-	plc->bus = gst_pipeline_get_bus(GST_PIPELINE(plc->pipeline));
-
-	gst_bus_add_watch(plc->bus, bus_callGstPipeLine, plc);
-
-	gst_object_unref(plc->bus);
+	plc->bus_watch = r2_loop_add_bus_watch(plc->pipeline, bus_callGstPipeLine, plc);
 
 	plc->is_initialized = true;
 
@@ -182,7 +208,7 @@ int initGstPipeLine(struct PLC* plc) {
 }
 
 
-int playGstPipeLine(struct PLC *plc) {
+int startGstPipeLine(struct PLC *plc) {
 
 	if (plc == NULL) {
 		
@@ -209,15 +235,45 @@ int playGstPipeLine(struct PLC *plc) {
 	
 	}
 
+	if (plc->is_playing) {
+
+		g_critical ("Unable to start Gtreamer pipeline. It's already playing.");
+		return false;
+
+	}
+
 	plc->is_playing = true;
 
-	gst_element_set_state(GST_ELEMENT(plc->pipeline), GST_STATE_PLAYING);
-	g_main_loop_run(plc->loop);
-	gst_element_set_state(GST_ELEMENT(plc->pipeline), GST_STATE_NULL);
-	//gst_object_unref(GST_OBJECT(plc->pipeline));
-	//g_main_loop_unref (plc->loop);
+	if (gst_element_set_state(GST_ELEMENT(plc->pipeline), GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
 
-	plc->is_playing = false;
+		g_critical ("Unable to start Gtreamer pipeline. State change failed.");
+		finishGstPipeLine(plc);
+		return false;
+
+	}
+
+	return true;
+
+}
+
+// Blocks until the pipeline has stopped (EOS, error or stopGstPipeLine). The messages are handled by the shared loop thread.
+int playGstPipeLine(struct PLC *plc) {
+
+	if (!startGstPipeLine(plc)) {
+
+		return false;
+
+	}
+
+	g_mutex_lock(&plc->mutex);
+
+	while (plc->is_playing) {
+
+		g_cond_wait(&plc->stopped, &plc->mutex);
+
+	}
+
+	g_mutex_unlock(&plc->mutex);
 	
 	return true;
 
@@ -241,27 +297,14 @@ int stopGstPipeLine (struct PLC* plc) {
 
 	}
 
-	if (plc->pipeline != NULL) {
-
-		gst_element_set_state(GST_ELEMENT(plc->pipeline), GST_STATE_NULL);
-	
-	}  else {
+	if (plc->pipeline == NULL) {
 
 		g_critical ("Unable to stop Gtreamer pipeline. pipeline was null.");
+		return false;
 	
 	}
 
-	if (plc->loop != NULL) {
-		
-		g_main_loop_quit(plc->loop);
-	
-	} else {
-
-		g_critical ("Unable to stop Gtreamer pipeline. Loop was null.");
-	
-	}
-	
-	plc->is_stopped = true;
+	finishGstPipeLine(plc);
 
 	return true;
 
@@ -279,6 +322,11 @@ int _ext_play_gstream(struct PLC* plc) {
 	return playGstPipeLine(plc);
 }
 
+int _ext_start_gstream(struct PLC* plc) {
+
+	return startGstPipeLine(plc);
+}
+
 void* _ext_create_gstream(const char* pipelineString) {
 
 	return (void*) createPipeLine (pipelineString);	
@@ -327,8 +375,6 @@ int main(int argc, char *argv[])
 
 	if (playGstPipeLine(plc)) {
 		
-		
-		stopGstPipeLine(plc);
 		destroyPipeLine(plc);
 	
 		return 0;	
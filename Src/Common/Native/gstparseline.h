@@ -22,14 +22,16 @@
 
 #include <gst/gst.h>
 #include <stdbool.h>
+#include "r2gstloop.h"
 
 struct PLC {
 
-	GMainLoop *loop;
+	GSource *bus_watch;	//attached to the shared loop (r2gstloop)
 
-	GstElement *pipeline;
+	GMutex mutex;
+	GCond stopped;	//signaled when the pipeline stops playing
 
-	GstBus *bus;	//the bus element te transport messages from/to the pipeline
+	GstElement *pipeline;
 
 	int is_playing; //indicates that the player is busy
 
@@ -46,6 +48,7 @@ int _ext_destroy_gstream(struct PLC* plc);
 int _ext_init_gstream(struct PLC* plc);
 int _ext_stop_gstream(struct PLC* plc);
 int _ext_play_gstream(struct PLC* plc);
+int _ext_start_gstream(struct PLC* plc);
 int _ext_is_playing_gstream(struct PLC* plc);
 int _ext_is_initialized_gstream(struct PLC* plc);
 int _ext_get_error_code(struct PLC* plc);
@@ -0,0 +1,158 @@
+// This file is part of r2Poject.
+//
+// Copyright 2016 Tord Wessman
+// 
+// r2Project is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// r2Project is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with r2Project. If not, see <http://www.gnu.org/licenses/>.
+// 
+
+#include "r2gstloop.h"
+#include <stdio.h>
+
+static GMainContext *context;
+static GMainLoop *loop;
+static GThread *loop_thread;
+
+// Used by r2_loop_invoke_sync
+typedef struct {
+	GSourceFunc func;
+	gpointer user_data;
+	bool done;
+	GMutex mutex;
+	GCond cond;
+} Invocation;
+
+static gpointer run_loop(gpointer notUsed) {
+
+	g_main_context_push_thread_default(context);
+	g_main_loop_run(loop);
+	g_main_context_pop_thread_default(context);
+
+	return NULL;
+}
+
+GMainContext* r2_loop_context() {
+
+	static gsize initialized = 0;
+
+	if (g_once_init_enter(&initialized)) {
+
+		gst_init(NULL, NULL);
+
+		context = g_main_context_new();
+		loop = g_main_loop_new(context, false);
+		loop_thread = g_thread_new("r2gstloop", run_loop, NULL);
+
+		g_once_init_leave(&initialized, 1);
+	}
+
+	return context;
+}
+
+bool r2_loop_is_loop_thread() {
+
+	return loop_thread && g_thread_self() == loop_thread;
+}
+
+GSource* r2_loop_add_bus_watch(GstElement *pipeline, GstBusFunc func, gpointer user_data) {
+
+	GMainContext *ctx = r2_loop_context();
+	GstBus *bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline));
+	GSource *watch = gst_bus_create_watch(bus);
+
+	g_source_set_callback(watch, (GSourceFunc)func, user_data, NULL);
+	g_source_attach(watch, ctx);
+	gst_object_unref(bus);
+
+	return watch;
+}
+
+GSource* r2_loop_add_timeout(guint interval_ms, GSourceFunc func, gpointer user_data) {
+
+	GMainContext *ctx = r2_loop_context();
+	GSource *timeout = g_timeout_source_new(interval_ms);
+
+	g_source_set_callback(timeout, func, user_data, NULL);
+	g_source_attach(timeout, ctx);
+
+	return timeout;
+}
+
+static gboolean destroy_source(gpointer user_data) {
+
+	g_source_destroy((GSource *)user_data);
+
+	return G_SOURCE_REMOVE;
+}
+
+void r2_loop_remove_watch(GSource *watch) {
+
+	if (!watch) {
+		return;
+	}
+
+	// Destroying it on the loop thread guarantees that no dispatch is in progress.
+	r2_loop_invoke_sync(destroy_source, watch);
+	g_source_unref(watch);
+}
+
+static gboolean invoke_and_signal(gpointer user_data) {
+
+	Invocation *invocation = (Invocation *)user_data;
+
+	invocation->func(invocation->user_data);
+
+	g_mutex_lock(&invocation->mutex);
+	invocation->done = true;
+	g_cond_signal(&invocation->cond);
+	g_mutex_unlock(&invocation->mutex);
+
+	return G_SOURCE_REMOVE;
+}
+
+void r2_loop_invoke_sync(GSourceFunc func, gpointer user_data) {
+
+	GMainContext *ctx = r2_loop_context();
+
+	if (r2_loop_is_loop_thread()) {
+		func(user_data);
+		return;
+	}
+
+	Invocation invocation = { func, user_data, false };
+
+	g_mutex_init(&invocation.mutex);
+	g_cond_init(&invocation.cond);
+
+	GSource *source = g_idle_source_new();
+	g_source_set_callback(source, invoke_and_signal, &invocation, NULL);
+	g_source_attach(source, ctx);
+	g_source_unref(source);
+
+	g_mutex_lock(&invocation.mutex);
+	while (!invocation.done) {
+		g_cond_wait(&invocation.cond, &invocation.mutex);
+	}
+	g_mutex_unlock(&invocation.mutex);
+
+	g_cond_clear(&invocation.cond);
+	g_mutex_clear(&invocation.mutex);
+}
+
+void r2_loop_invoke(GSourceFunc func, gpointer user_data) {
+
+	GSource *source = g_idle_source_new();
+	g_source_set_callback(source, func, user_data, NULL);
+	g_source_attach(source, r2_loop_context());
+	g_source_unref(source);
+}
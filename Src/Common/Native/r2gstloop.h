@@ -0,0 +1,50 @@
+// This file is part of r2Poject.
+//
+// Copyright 2016 Tord Wessman
+// 
+// r2Project is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// r2Project is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with r2Project. If not, see <http://www.gnu.org/licenses/>.
+// 
+
+/**
+*	One GLib main loop thread shared by all native GStreamer pipelines of the process.
+*	The pipelines attach their bus watches to its context instead of running a loop each.
+**/
+
+#ifndef R2_GST_LOOP_H
+#define R2_GST_LOOP_H
+
+#include <gst/gst.h>
+#include <stdbool.h>
+
+// Returns the shared context. The loop thread (and GStreamer) is started on the first call.
+GMainContext* r2_loop_context();
+
+// Attaches a watch for the bus of the pipeline to the shared loop. func is called on the loop thread.
+GSource* r2_loop_add_bus_watch(GstElement *pipeline, GstBusFunc func, gpointer user_data);
+
+// Calls func on the loop thread every interval_ms until it returns G_SOURCE_REMOVE or the source is removed.
+GSource* r2_loop_add_timeout(guint interval_ms, GSourceFunc func, gpointer user_data);
+
+// Removes a watch (or a timeout). When this returns, the callback of the watch is not running and will never be called again.
+void r2_loop_remove_watch(GSource *watch);
+
+// Calls func on the loop thread and waits for it to return (calls it directly if called from the loop thread).
+void r2_loop_invoke_sync(GSourceFunc func, gpointer user_data);
+
+// Calls func on the loop thread without waiting.
+void r2_loop_invoke(GSourceFunc func, gpointer user_data);
+
+bool r2_loop_is_loop_thread();
+
+#endif
@@ -93,6 +93,21 @@ namespace R2Core.GPIO.Tests
 			}
 		}
 
+		[Test]
+		public void TestMoistureMultiplexerScan() {
+
+			var host = new ArduinoDeviceRouter("h", mock_connection, m_packageFactory);
+			var factory = new SerialGPIOFactory("f", host);
+
+			// 5 sensor pairs: more than fit in a single scan response of the mock.
+			var multiplexer = factory.CreateMoistureMultiplexer("moist", new int[] { 4, 5, 6 }, new int[] { 7, 8 }, new int[] { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 }, 14);
+			var remoteMock = mock_connection.Devices.Last();
+			remoteMock.IntValues = new int[] { 100, 200, 300, 400, 65535 };
+
+			Assert.AreEqual(remoteMock.IntValues, multiplexer.Scan());
+
+		}
+
 		[Test]
 		public void TestSerialDeviceManager() {
 
@@ -110,6 +110,9 @@ namespace R2Core.GPIO.Tests
 		// Simulate message id:s
 		public byte messageId;
 
+		// The maximum number of values returned per ScanDevice request (RESPONSE_SCAN_MAX_VALUES in r2I2CDeviceRouter.h).
+		public int ScanMaxValues = 3;
+
 		public IList<byte> nodes;
 
 		private readonly object m_lock = new object();
@@ -164,7 +167,7 @@ namespace R2Core.GPIO.Tests
 				byte action = data[ArduinoSerialPackageFactory.REQUEST_POSITION_ACTION];
 				byte id = data[ArduinoSerialPackageFactory.REQUEST_POSITION_ID];
 				byte contentLength = (byte)(data.Length - ArduinoSerialPackageFactory.REQUEST_POSITION_CONTENT);
-				byte[] content = new byte[2];
+				byte[] content = new byte[Math.Max(2, (int)contentLength)];
 
 				if (contentLength > 0) { 
 				
@@ -183,6 +186,25 @@ namespace R2Core.GPIO.Tests
 
 					response = GetMockDevice(id).ToBytes;
 
+				} else if ((SerialActionType)action == SerialActionType.ScanDevice) {
+
+					// Returns [count, 16-bit values...] of the mock device's IntValues, starting with the requested index.
+					int[] values = GetMockDevice(id).IntValues;
+					int first = content[ArduinoSerialPackageFactory.POSITION_CONTENT_SCAN_FIRST];
+					int count = Math.Max(0, Math.Min(ScanMaxValues, values.Length - first));
+
+					response = new byte[ArduinoSerialPackageFactory.RESPONSE_POSITION_CONTENT + 1 + count * 2];
+					response[ArduinoSerialPackageFactory.RESPONSE_POSITION_MESSAGE_ID] = messageId++;
+					response[ArduinoSerialPackageFactory.RESPONSE_POSITION_HOST] = host;
+					response[ArduinoSerialPackageFactory.RESPONSE_POSITION_ACTION] = action;
+					response[ArduinoSerialPackageFactory.RESPONSE_POSITION_ID] = id;
+					response[ArduinoSerialPackageFactory.RESPONSE_POSITION_CONTENT_LENGTH] = (byte)(1 + count * 2);
+					response[ArduinoSerialPackageFactory.RESPONSE_POSITION_CONTENT + ArduinoSerialPackageFactory.POSITION_CONTENT_SCAN_COUNT] = (byte)count;
+
+					for (int i = 0; i < count; i++) {
+						Array.Copy(values[first + i].ToBytes(2), 0, response, ArduinoSerialPackageFactory.RESPONSE_POSITION_CONTENT + ArduinoSerialPackageFactory.POSITION_CONTENT_SCAN_VALUES + i * 2, 2);
+					}
+
 				} else if ((SerialActionType)action == SerialActionType.Create) {
 
 					if (!nodes.Contains(host)) {
@@ -84,6 +84,19 @@ namespace R2Core.GPIO
 
         }
 
+		public int[] Scan(byte deviceId, int nodeId, int first = 0) {
+
+			DeviceResponsePackage<byte[]> response = Send<byte[]>(m_packageFactory.ScanDevice(deviceId, (byte)nodeId, (byte)first));
+
+			int count = response.Content[ArduinoSerialPackageFactory.POSITION_CONTENT_SCAN_COUNT];
+			int[] values = new int[count];
+
+			for (int i = 0; i < count; i++) { values[i] = response.Content.ToInt(ArduinoSerialPackageFactory.POSITION_CONTENT_SCAN_VALUES + i * 2, 2); }
+
+			return values;
+
+		}
+
 		public void Set(byte deviceId, int nodeId, int value) {
     
             DeviceResponsePackage<int> response = Send<int>(m_packageFactory.SetDevice(deviceId, (byte)nodeId, value));
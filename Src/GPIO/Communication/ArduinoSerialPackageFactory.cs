@@ -93,6 +93,13 @@ namespace R2Core.GPIO
 		public const int POSITION_CONTENT_SLEEP_TOGGLE = 0x0;
 		public const int POSITION_CONTENT_SLEEP_CYCLES = 0x1;
 
+		// Used by ScanDevice. The index of the first value to read.
+		public const int POSITION_CONTENT_SCAN_FIRST = 0x0;
+
+		// ScanDevice response positions. The number of values read, followed by the (16-bit) values.
+		public const int POSITION_CONTENT_SCAN_COUNT = 0x0;
+		public const int POSITION_CONTENT_SCAN_VALUES = 0x1;
+
 		private const int MAX_CONTENT_LENGTH = 0xFF;
 
 		public ArduinoSerialPackageFactory() {
@@ -217,6 +224,20 @@ namespace R2Core.GPIO
 
 		}
 
+		public DeviceRequestPackage ScanDevice(byte deviceId, byte nodeId, byte first) {
+
+			byte[] content = new byte[1];
+			content[POSITION_CONTENT_SCAN_FIRST] = first;
+
+			return new DeviceRequestPackage {
+				NodeId = nodeId,
+				Action = SerialActionType.ScanDevice,
+				Id = deviceId,
+				Content = content
+			};
+
+		}
+
 		public DeviceRequestPackage Sleep(byte nodeId, bool toggle, byte cycles) {
 		
 			byte[] content = new byte[2];
@@ -48,6 +48,16 @@ namespace R2Core.GPIO
         /// <param name="parameters">Optional extra parameters added to the get-request.</param>
         DeviceData<T> GetValue<T>(byte deviceId, int nodeId, byte[] parameters = null);
 
+		/// <summary>
+		/// Returns the values of a device with multiple sensors (i.e. a moisture multiplexer) on node with id `nodeId`, starting with the value at index `first`.
+		/// The number of values is limited by the response content size, so fewer values than the device has might be returned.
+		/// </summary>
+		/// <returns>The values.</returns>
+		/// <param name="deviceId">The id of the device for the remote node.</param>
+		/// <param name="nodeId">Node identifier.</param>
+		/// <param name="first">Index of the first value.</param>
+		int[] Scan(byte deviceId, int nodeId, int first = 0);
+
 		/// <summary>
 		/// Sets the value of an object. `deviceId` is the id of the device located on the node with id `nodeId`. 
 		/// </summary>
@@ -73,6 +73,15 @@ namespace R2Core.GPIO
         /// <param name="nodeId">Node identifier.</param>
         DeviceRequestPackage DeleteDevice(byte deviceId, byte nodeId);
 
+        /// <summary>
+        /// Used for returning the values of a device with multiple sensors (i.e. a moisture multiplexer), starting with the value at index `first`.
+        /// </summary>
+        /// <returns>The device.</returns>
+        /// <param name="deviceId">Remote device identifier.</param>
+        /// <param name="nodeId">Node identifier.</param>
+        /// <param name="first">Index of the first value.</param>
+        DeviceRequestPackage ScanDevice(byte deviceId, byte nodeId, byte first);
+
         /// <summary>
         /// Creates a set-to-sleep-package
         /// </summary>
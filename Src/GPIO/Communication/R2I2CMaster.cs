@@ -50,6 +50,9 @@ namespace R2Core.GPIO
 		[DllImport(dllPath, CharSet = CharSet.Auto)]
 		private static extern void r2I2C_should_run(bool shouldRun);
 
+		[DllImport(dllPath, CharSet = CharSet.Auto)]
+		private static extern int r2I2C_negotiate(int wait);
+
 		// Delay before starting to read from slave. Usefull if slave response is slow.
 		public int ReadDelay = Settings.Consts.I2CReadDelay();
 
@@ -98,6 +101,11 @@ namespace R2Core.GPIO
 			r2I2C_should_run(true);
             ShouldRun = true;
 
+			// Use the single read protocol if supported by the slave (otherwise the legacy protocol is kept).
+			int version = r2I2C_negotiate(ReadDelay);
+
+			if (version < 0) { Log.w($"I2C protocol negotiation failed. Error type: {(I2CError)version}.", Identifier); }
+
         }
 
 		public override void Stop() {
@@ -41,6 +41,17 @@ namespace R2Core.GPIO
 		Multiplex= 0xC            		// R2Multiplexer.
     }
 
+    /// <summary>
+    /// Filters applied on the node when reading AnalogInput and SimpleMoist devices. Defined in r2I2CDeviceRouter.h (ANALOG_FILTER_).
+    /// </summary>
+    public enum AnalogFilterType : byte {
+
+        None = 0x0,                     // Oversampling only (if any).
+        Median = 0x1,                   // The median of a burst of readings. The parameter is the window size (1-9).
+        Ema = 0x2                       // An exponential moving average updated on every read. The parameter is the smoothing shift (alpha = 1/2^n, 1-8).
+
+    }
+
     /// <summary>
     /// Actions defined in r2I2CDeviceRouter.h
     /// </summary>
@@ -130,7 +141,54 @@ namespace R2Core.GPIO
         /// <summary>
         /// Delete a remote device
         /// </summary>
-        DeleteDevice = 0x10
+        DeleteDevice = 0x10,
+
+        /// <summary>
+        /// Sends the request wrapped in the content (action followed by its arguments) to a RH24 node without waiting for the response. The response contains the message id required by `Collect`.
+        /// </summary>
+        Dispatch = 0x11,
+
+        /// <summary>
+        /// Returns the response of a request sent using `Dispatch`. The content should contain the message id.
+        /// </summary>
+        Collect = 0x12,
+
+        /// <summary>
+        /// Returns the delivery status ([status, error]) of a command (i.e. `Set` or `SendToSleep`) queued by the master for a sleeping RH24 node. The content should contain the command id.
+        /// </summary>
+        CommandStatus = 0x13,
+
+        /// <summary>
+        /// Sets the groups (bit mask in the content) a RH24 node belongs to.
+        /// </summary>
+        SetGroups = 0x14,
+
+        /// <summary>
+        /// Multicasts a request to the members of a group. The content should contain the group, the action and the arguments of the action. The response contains the member count followed by [node id, 16-bit value] for each successful reply.
+        /// </summary>
+        Group = 0x15,
+
+        /// <summary>
+        /// Returns the link statistics gathered by the master for a RH24 node: send failures, timeouts, retries, round-trip time (16-bit, ms) and seconds since last seen (16-bit).
+        /// </summary>
+        LinkStats = 0x16,
+
+        /// <summary>
+        /// Reads the bulk data of a RH24 node from the (16-bit) offset in the content. The response contains the total size (16-bit) followed by the data.
+        /// </summary>
+        Transfer = 0x17,
+
+        /// <summary>
+        /// Reads every value of a multi-value device (i.e. all sensor pairs of a MultiplexMoist) in one pass, starting at the index in the content (optional).
+        /// The response contains the number of values followed by the (16-bit) values.
+        /// </summary>
+        ScanDevice = 0x18,
+
+        /// <summary>
+        /// Makes a sleeping RH24 node sample the device every n seconds (16-bit content) and report the value to the master's cache. 0 stops sampling.
+        /// Queued by the master if the node is sleeping.
+        /// </summary>
+        SetSampling = 0x19
 
     }
 
@@ -184,6 +242,26 @@ namespace R2Core.GPIO
         ERROR_TCP_READ = 23,
         // If the number ports created exceeds DEVICE_MAX_PORTS when creating a DEVICE_TYPE_MULTIPLE_DIGITAL_OUTPUT
         ERROR_TOO_MANY_MULTIPLE_PORTS = 24,
+        // Collect: The node has not yet responded to the dispatched request.
+        ERROR_RH24_RESPONSE_PENDING = 25,
+        // Collect: No outstanding request with the specified message id was found.
+        ERROR_RH24_UNKNOWN_MESSAGE_ID = 26,
+        // Dispatch: The master can't keep track of any more outstanding requests.
+        ERROR_RH24_TOO_MANY_PENDING_REQUESTS = 27,
+        // No more commands can be queued for the sleeping node.
+        ERROR_RH24_COMMAND_QUEUE_FULL = 28,
+        // CommandStatus: No queued command with the specified id was found.
+        ERROR_RH24_UNKNOWN_COMMAND_ID = 29,
+        // Group: The group is out of range or has no members.
+        ERROR_RH24_EMPTY_GROUP = 30,
+        // CreateDevice: The filter parameters of an analog input are out of range.
+        ERROR_INVALID_FILTER = 31,
+        // SetSampling: No more devices can be sampled by the node.
+        ERROR_RH24_SAMPLING_FULL = 32,
+        // CreateDevice: A sonar and a PWM output on a Timer2 pin (3 and 11 on an Uno) can't be used at the same time.
+        ERROR_TIMER2_IN_USE = 33,
+        // The action can only be performed by a slave (i.e. SetGroups or SetSampling sent to the master).
+        ERROR_RH24_SLAVE_ONLY_ACTION = 34,
 
         // Internally created error: If the response data mismatched the expected data.
         ERROR_DATA_MISMATCH = 0xF0,
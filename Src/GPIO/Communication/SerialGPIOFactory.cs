@@ -68,16 +68,21 @@ namespace R2Core.GPIO
 
 		public override bool Ready { get { return m_connection.Ready; } }
 
-		public IInputMeter<double> CreateAnalogInput(string id, int port, int nodeId = ArduinoSerialPackageFactory.DEVICE_NODE_LOCAL) {
+		/// <summary>
+		/// Creates an analog input. Optionally oversampled (4^oversamplingBits readings per value) and filtered on the node.
+		/// </summary>
+		public IInputMeter<double> CreateAnalogInput(string id, int port, int nodeId = ArduinoSerialPackageFactory.DEVICE_NODE_LOCAL, 
+		                                             int oversamplingBits = 0, AnalogFilterType filter = AnalogFilterType.None, int filterParameter = 0) {
 
-			return InstantiateDevice(new SerialAnalogInput(id, m_devices.GetNode(nodeId), m_connection, new int[1] {port})); 
+			return InstantiateDevice(new SerialAnalogInput(id, m_devices.GetNode(nodeId), m_connection, new int[1] {port}, oversamplingBits, filter, filterParameter)); 
 
 
 		}
 
-		public IInputMeter<double> CreateMoisture(string id, int analogueInput, int digitalOutput, int nodeId = ArduinoSerialPackageFactory.DEVICE_NODE_LOCAL) {
+		public IInputMeter<double> CreateMoisture(string id, int analogueInput, int digitalOutput, int nodeId = ArduinoSerialPackageFactory.DEVICE_NODE_LOCAL,
+		                                          int oversamplingBits = 0, AnalogFilterType filter = AnalogFilterType.None, int filterParameter = 0) {
 
-			return InstantiateDevice(new SimpleAnalogueHumiditySensor(id, m_devices.GetNode(nodeId), m_connection, new int[2] {analogueInput, digitalOutput})); 
+			return InstantiateDevice(new SimpleAnalogueHumiditySensor(id, m_devices.GetNode(nodeId), m_connection, new int[2] {analogueInput, digitalOutput}, oversamplingBits, filter, filterParameter)); 
 
 		}
 
@@ -22,12 +22,26 @@ namespace R2Core.GPIO
 
         protected byte[] m_ports;
 
-        internal SerialAnalogInput(string id, ISerialNode node, IArduinoDeviceRouter host, int[] ports) : base(id, node, host) {
+        internal SerialAnalogInput(string id, ISerialNode node, IArduinoDeviceRouter host, int[] ports, 
+                                   int oversamplingBits = 0, AnalogFilterType filter = AnalogFilterType.None, int filterParameter = 0) : base(id, node, host) {
 
-            m_ports = new byte[ports.Length];
-            Denomiator = 1;
+            bool filtered = oversamplingBits > 0 || filter != AnalogFilterType.None;
+
+            // The filter parameters follow the ports.
+            m_ports = new byte[ports.Length + (filtered ? 3 : 0)];
             for (int i = 0; i < ports.Length; i++) { m_ports[i] = (byte)ports[i]; }
 
+            if (filtered) {
+
+                m_ports[ports.Length] = (byte)oversamplingBits;
+                m_ports[ports.Length + 1] = (byte)filter;
+                m_ports[ports.Length + 2] = (byte)filterParameter;
+
+            }
+
+            // Oversampled values have `oversamplingBits` additional bits. Keep the scale of a raw reading.
+            Denomiator = 1 << oversamplingBits;
+
         }
 
         protected override byte[] CreationParameters { get { return m_ports; } }
@@ -45,7 +59,8 @@ namespace R2Core.GPIO
 
 	internal class SimpleAnalogueHumiditySensor : SerialAnalogInput {
 
-		internal SimpleAnalogueHumiditySensor(string id, ISerialNode node, IArduinoDeviceRouter host, int[] ports): base(id, node, host, ports) {
+		internal SimpleAnalogueHumiditySensor(string id, ISerialNode node, IArduinoDeviceRouter host, int[] ports, 
+                                              int oversamplingBits = 0, AnalogFilterType filter = AnalogFilterType.None, int filterParameter = 0): base(id, node, host, ports, oversamplingBits, filter, filterParameter) {
 
             if (node.ContinousSynchronization) {
 
@@ -122,6 +122,34 @@ namespace R2Core.GPIO {
 
         }
 
+        /// <summary>
+        /// Returns the values of all sensor pairs defined in the constructor (`sensorPairs`), ordered by sensor pair index. The node
+        /// reads the pairs in one pass, so this is faster than calling `ValueFor` for each pair. Requires more than one request if 
+        /// the values don't fit in a single response.
+        /// </summary>
+        /// <returns>The values.</returns>
+        public int[] Scan() {
+
+            if (!Ready) { throw new System.IO.IOException("Unable to scan. Device not Ready." + (Deleted ? " Deleted" : "")); }
+
+            int[] values = new int[m_sensorPairs.Length / SENSOR_ROD_COUNT];
+            int count = 0;
+
+            while (count < values.Length) {
+
+                int[] scanned = Host.Scan(DeviceId, Node.NodeId, count);
+
+                if (scanned.Length == 0) { throw new System.IO.IOException($"Scan returned no values for sensor pair {count}."); }
+
+                Array.Copy(scanned, 0, values, count, Math.Min(scanned.Length, values.Length - count));
+                count += scanned.Length;
+
+            }
+
+            return values;
+
+        }
+
         /// <summary>
         /// Will wrap the multiplexer as a simpler `SerialMultiplexerMoistureSensor` which represents a sensor
         /// defined by the `sensorPairs` in the constructor (will hence not _create_ a sensor at the host, but rather
@@ -30,6 +30,12 @@ namespace R2Core.GPIO {
         /// <param name="sensorIndex">Sensor index.</param>
         T ValueFor(int sensorIndex);
 
+        /// <summary>
+        /// Returns the values of all internal sensors, ordered by sensor index.
+        /// </summary>
+        /// <returns>The values.</returns>
+        T[] Scan();
+
         /// <summary>
         /// Creates a "link" to a sensor with index `sensorPairIndex`.
         /// </summary>
@@ -51,6 +51,13 @@ static bool _r2I2C_should_run = true;
 static bool _r2I2C_is_busy = false;
 static bool _r2I2C_is_initialized = false;
 static bool _r2I2C_is_reading = false;
+static uint8_t _r2I2C_protocol_version = R2I2C_PROTOCOL_VERSION_1;
+// Consecutive single reads with an invalid size
+static int _r2I2C_protocol_failures = 0;
+// Set when the protocol should be negotiated again before the next transaction
+static bool _r2I2C_should_negotiate = false;
+// The timeout of the latest r2I2C_negotiate, used when negotiating again
+static long _r2I2C_negotiation_timeout = 0;
 
 typedef struct i2c_read_result {
 
@@ -87,6 +94,11 @@ int r2I2C_init (int bus, int address) {
 	_r2I2C_is_initialized = true;
 	_r2I2C_should_run = true;
 
+	// The slave may have been restarted: the protocol has to be negotiated again.
+	_r2I2C_protocol_version = R2I2C_PROTOCOL_VERSION_1;
+	_r2I2C_protocol_failures = 0;
+	_r2I2C_should_negotiate = false;
+
 	R2_LOG("R2I2C initialization succeeded.\n");
 	return R2I2C_OPERATION_OK;
 
@@ -233,13 +245,22 @@ int r2I2C_receive(long timeout) {
 	
 	int c = 0;
 
+	// Using R2I2C_PROTOCOL_VERSION_2, every poll returns the complete response once the slave is ready.
+	size_t poll_size = _r2I2C_protocol_version == R2I2C_PROTOCOL_VERSION_2 ? R2I2C_SINGLE_READ_SIZE : 1;
+
+	// Set if the response was retrieved during the poll (R2I2C_PROTOCOL_VERSION_2).
+	bool single_read_done = false;
+
+	// Set if the slave only transmitted the ready flag during a R2I2C_PROTOCOL_VERSION_2 poll. The size and the payload are then read using the legacy protocol.
+	bool legacy_fallback = false;
+
 	if (_r2I2C_should_run) {
 
 		int delay = 10;
 
 		do {
 
-			response = r2I2C_read(fd, timeout,1);
+			response = r2I2C_read(fd, timeout, poll_size);
 			
 			if (response.status == R2I2C_OPERATION_OK && response.data && response.data[0] != R2I2C_READY_TO_READ_FLAG) {
 
@@ -264,9 +285,32 @@ int r2I2C_receive(long timeout) {
 	R2_LOG("\n");
 
 	R2_LOG("Got status: %d, flag: %d, time: %d\n", response.status,  response.status == R2I2C_OPERATION_OK && response.data ? response.data[0] : -666, c );
-	
+
+	if (_r2I2C_should_run && response.status == R2I2C_OPERATION_OK && response.data && _r2I2C_protocol_version == R2I2C_PROTOCOL_VERSION_2) {
+
+		uint8_t size = response.data[1];
+
+		if (size <= R2I2C_SINGLE_READ_SIZE - 2) {
+
+			_r2I2C_responseSize = size;
+			for (int i = 0; i < _r2I2C_responseSize; i++) { _r2I2C_responseBuffer[i] = response.data[2 + i]; }
+			single_read_done = true;
+			_r2I2C_protocol_failures = 0;
+
+		} else {
+
+			// Only the ready flag was transmitted, since the response doesn't fit in a single read (or the slave has been restarted and is using the legacy protocol again).
+			R2_LOG("Single read size: %d. Reading the size and the payload separately.\n", size);
+			legacy_fallback = true;
+
+		}
+
+	}
+
+	if (response.data) { free(response.data); response.data = NULL; }
+
 	// Fetch response size:
-	if (_r2I2C_should_run && response.status == R2I2C_OPERATION_OK) {
+	if (_r2I2C_should_run && response.status == R2I2C_OPERATION_OK && !single_read_done) {
 
 		response =  r2I2C_read(fd, timeout,1);
 		_r2I2C_responseSize = (response.status != R2I2C_OPERATION_OK) ? 0 : response.data[0];
@@ -274,9 +318,27 @@ int r2I2C_receive(long timeout) {
 		if (response.data) { free(response.data); };
 
 	}
+
+	if (legacy_fallback && response.status == R2I2C_OPERATION_OK) {
+
+		if (_r2I2C_responseSize > R2I2C_SINGLE_READ_SIZE - 2) {
+
+			_r2I2C_protocol_failures = 0;
+
+		} else if (++_r2I2C_protocol_failures >= R2I2C_MAX_PROTOCOL_FAILURES) {
+
+			// The response would have fit in a single read, so the slave isn't using R2I2C_PROTOCOL_VERSION_2.
+			R2_LOG("Warning: %d short responses without a single read. The protocol will be negotiated again.\n", _r2I2C_protocol_failures);
+			_r2I2C_protocol_version = R2I2C_PROTOCOL_VERSION_1;
+			_r2I2C_protocol_failures = 0;
+			_r2I2C_should_negotiate = true;
+
+		}
+
+	}
 	
 	// Fetch the response
-	if (_r2I2C_should_run && response.status == R2I2C_OPERATION_OK) {
+	if (_r2I2C_should_run && response.status == R2I2C_OPERATION_OK && !single_read_done) {
 		
 		response = r2I2C_read(fd, timeout, _r2I2C_responseSize);
 		
@@ -322,6 +384,17 @@ int r2I2C_send(uint8_t data[], int data_size) {
 
 	}
 
+	if (_r2I2C_should_negotiate) {
+
+		// Cleared first, since the negotiation is sent using this function.
+		_r2I2C_should_negotiate = false;
+
+		int version = r2I2C_negotiate(_r2I2C_negotiation_timeout);
+
+		if (version < 0) { R2_LOG("Warning: Protocol negotiation failed: %d.\n", version); }
+
+	}
+
 	_r2I2C_is_busy = true;
 
 	int fd = r2I2C_open_bus(O_WRONLY);
@@ -369,6 +442,41 @@ int r2I2C_send(uint8_t data[], int data_size) {
 
 }
 
+int r2I2C_negotiate(long timeout) {
+
+	uint8_t negotiation[] = { R2I2C_PROTOCOL_NEGOTIATION_FLAG, R2I2C_PROTOCOL_VERSION_2 };
+
+	// The reply to the negotiation is always transmitted using the legacy protocol.
+	_r2I2C_protocol_version = R2I2C_PROTOCOL_VERSION_1;
+	_r2I2C_protocol_failures = 0;
+	_r2I2C_negotiation_timeout = timeout;
+
+	int status = r2I2C_send(negotiation, sizeof(negotiation));
+
+	if (status == R2I2C_OPERATION_OK) { status = r2I2C_receive(timeout); }
+
+	if (status == R2I2C_OPERATION_CANCELED) { return R2I2C_SHOULD_NOT_RUN_ERROR; }
+	else if (status != R2I2C_OPERATION_OK) { return status; }
+
+	// Slaves unaware of the negotiation will reply with an error package instead of the accepted version.
+	if (_r2I2C_responseSize == 1 && _r2I2C_responseBuffer[0] == R2I2C_PROTOCOL_VERSION_2) {
+
+		_r2I2C_protocol_version = R2I2C_PROTOCOL_VERSION_2;
+
+	}
+
+	R2_LOG("Negotiated protocol version: %d\n", _r2I2C_protocol_version);
+
+	return _r2I2C_protocol_version;
+
+}
+
+uint8_t r2I2C_get_protocol_version() {
+
+	return _r2I2C_protocol_version;
+
+}
+
 uint8_t r2I2C_get_response_size() {
 
 	return _r2I2C_responseSize;
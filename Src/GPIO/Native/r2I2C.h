@@ -42,6 +42,22 @@
 // The I2C slave should begin every response with R2I2C_READY_TO_READ_FLAG, telling the receive operation that it's ready to receive data.
 #define R2I2C_READY_TO_READ_FLAG 0xF0
 
+// Legacy protocol: the ready flag, the size byte and the payload are fetched using three separate read transactions.
+#define R2I2C_PROTOCOL_VERSION_1 1
+
+// Single read protocol: one read transaction of R2I2C_SINGLE_READ_SIZE bytes returns [flag, size, payload...].
+// Responses larger than R2I2C_SINGLE_READ_SIZE - 2 bytes are sent as in R2I2C_PROTOCOL_VERSION_1: the poll only returns the flag, followed by the size and the payload reads.
+#define R2I2C_PROTOCOL_VERSION_2 2
+
+// First byte of the (two byte) negotiation message sent by r2I2C_negotiate. Requests are never this short, so slaves unaware of the negotiation will respond with an error package.
+#define R2I2C_PROTOCOL_NEGOTIATION_FLAG 0xF4
+
+// The fixed number of bytes read per transaction using R2I2C_PROTOCOL_VERSION_2. Must not exceed the Wire buffer of the slave (32 bytes on AVR).
+#define R2I2C_SINGLE_READ_SIZE 32
+
+// Consecutive R2I2C_PROTOCOL_VERSION_2 responses small enough for a single read, but sent using the legacy reads (i.e. after a restart of the slave), before the protocol is negotiated again.
+#define R2I2C_MAX_PROTOCOL_FAILURES 3
+
 // Initializes the bus and address variables. Will return the status of the bus request operation.
 int r2I2C_init (int bus, int address);
 
@@ -49,6 +65,13 @@ int r2I2C_init (int bus, int address);
 // ´timeout´ is the the timeout in ms before a transmission fails.
 int r2I2C_receive(long timeout);
 
+// Asks the slave to use R2I2C_PROTOCOL_VERSION_2. Falls back to R2I2C_PROTOCOL_VERSION_1 if the slave does not support it. Returns the negotiated version or a negative error code.
+// Repeated by the next r2I2C_send after R2I2C_MAX_PROTOCOL_FAILURES responses that should have been single reads.
+int r2I2C_negotiate(long timeout);
+
+// Returns the protocol version currently used by r2I2C_receive.
+uint8_t r2I2C_get_protocol_version();
+
 // Returns the size of the last successfull transmission.
 uint8_t r2I2C_get_response_size();
 
@@ -13,8 +13,9 @@ then
 	rm  "$full_path"
 fi
 
-gcc `pkg-config gstreamer-1.0 --cflags`  VideoServer.c VideoServerGst.c -o $library `pkg-config gstreamer-1.0 --libs` -shared \
-  -Wall -fPIC -I /usr/include -L /usr/lib -lgstapp-1.0  -lopencv_highgui  -lopencv_core -lopencv_ml -lopencv_imgproc -lopencv_objdetect `pkg-config glib-2.0 gobject-2.0 --libs --cflags`
+gcc `pkg-config gstreamer-1.0 --cflags` -I../../Common/Native VideoServer.c VideoServerGst.c FrameRing.c R2Pipeline.c TeeBranch.c PipelineStats.c MotionDetector.c -o $library `pkg-config gstreamer-1.0 --libs` -shared \
+  -Wall -fPIC -I /usr/include -L /usr/lib -lgstapp-1.0  -lopencv_highgui  -lopencv_core -lopencv_ml -lopencv_imgproc -lopencv_objdetect `pkg-config glib-2.0 gobject-2.0 --libs --cflags` \
+  -L$lib_path -lr2gstloop -Wl,-rpath,'$ORIGIN'
 
 
 if [ $? -eq 0 ];
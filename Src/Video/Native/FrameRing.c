@@ -0,0 +1,289 @@
+// This file is part of r2Poject.
+//
+// Copyright 2016 Tord Wessman
+// 
+// r2Project is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// r2Project is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with r2Project. If not, see <http://www.gnu.org/licenses/>.
+// 
+
+#include "FrameRing.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct R2FrameRing {
+
+	R2Frame frames[kFRAME_RING_SIZE];
+
+	// The most recently published frame. The ring holds one reference of it.
+	R2Frame *latest;
+
+	guint64 sequence;
+	guint64 dropped;
+	guint64 clears;			// incremented by frame_ring_clear, so that the waiting consumers return
+
+	// The caps of the previous sample and what was parsed from them.
+	GstCaps *caps;
+	int width, height, channels;
+
+	GMutex mutex;
+	GCond cond;
+};
+
+// Parses the caps of a sample. Only 8 bit formats are supported:
+// video/x-raw, format=BGR -> 3 channels
+// video/x-raw, format=GRAY8 -> 1 channel
+// video/x-bayer -> 1 channel (bayer data is never decoded, the user is responsible for that)
+static bool parse_caps(R2FrameRing *ring, GstCaps *caps) {
+
+	if (caps == ring->caps) {
+		return ring->channels > 0;
+	}
+
+	if (ring->caps) {
+		gst_caps_unref(ring->caps);
+	}
+
+	ring->caps = gst_caps_ref(caps);
+	ring->channels = 0;
+
+	GstStructure *structure = gst_caps_get_structure(caps, 0);
+
+	if (!structure ||
+	    !gst_structure_get_int(structure, "width", &ring->width) ||
+	    !gst_structure_get_int(structure, "height", &ring->height) ||
+	    ring->width < 1 || ring->height < 1) {
+		g_critical ("Width and height could not be retrieved.");
+		return false;
+	}
+
+	const gchar* name = gst_structure_get_name(structure);
+	const gchar* format = gst_structure_get_string(structure, "format");
+
+	if (name && strcasecmp(name, "video/x-bayer") == 0) {
+		ring->channels = 1;
+	} else if (name && format && strcasecmp(name, "video/x-raw") == 0) {
+		if (strcasecmp(format, "BGR") == 0) {
+			ring->channels = 3;
+		} else if (strcasecmp(format, "GRAY8") == 0) {
+			ring->channels = 1;
+		}
+	}
+
+	if (ring->channels < 1) {
+		g_critical ("Caps not compatible: %s (%s)", name, format);
+		return false;
+	}
+
+	return true;
+}
+
+// Requires the mutex. Unmaps the frame when the last reference is gone.
+static void frame_unref(R2Frame *frame) {
+
+	if (--frame->refcount > 0) {
+		return;
+	}
+
+	gst_buffer_unmap(frame->buffer, &frame->map);
+	gst_sample_unref(frame->sample);
+
+	frame->sample = NULL;
+	frame->buffer = NULL;
+	frame->data = NULL;
+}
+
+R2FrameRing* frame_ring_new() {
+
+	R2FrameRing *ring = calloc(1, sizeof(R2FrameRing));
+
+	g_mutex_init(&ring->mutex);
+	g_cond_init(&ring->cond);
+
+	return ring;
+}
+
+void frame_ring_free(R2FrameRing *ring) {
+
+	if (!ring) {
+		return;
+	}
+
+	g_mutex_lock(&ring->mutex);
+
+	for (int i = 0; i < kFRAME_RING_SIZE; i++) {
+		if (ring->frames[i].refcount > 0) {
+			ring->frames[i].refcount = 1;
+			frame_unref(&ring->frames[i]);
+		}
+	}
+
+	if (ring->caps) {
+		gst_caps_unref(ring->caps);
+	}
+
+	g_mutex_unlock(&ring->mutex);
+
+	g_cond_clear(&ring->cond);
+	g_mutex_clear(&ring->mutex);
+	free(ring);
+}
+
+int frame_ring_push(R2FrameRing *ring, GstSample *sample) {
+
+	GstBuffer *buffer = gst_sample_get_buffer(sample);
+	GstCaps *caps = gst_sample_get_caps(sample);
+
+	if (!buffer || !caps) {
+		return kFRAME_RING_DROPPED;
+	}
+
+	R2Frame *frame = NULL;
+
+	g_mutex_lock(&ring->mutex);
+
+	if (!parse_caps(ring, caps)) {
+		g_mutex_unlock(&ring->mutex);
+		return kFRAME_RING_INCOMPATIBLE;
+	}
+
+	for (int i = 0; i < kFRAME_RING_SIZE && !frame; i++) {
+		if (ring->frames[i].refcount == 0) {
+			frame = &ring->frames[i];
+		}
+	}
+
+	if (!frame) {
+		ring->dropped++;
+		g_mutex_unlock(&ring->mutex);
+		return kFRAME_RING_DROPPED;
+	}
+
+	int stride = GST_ROUND_UP_4(ring->width * ring->channels);
+
+	if (!gst_buffer_map(buffer, &frame->map, GST_MAP_READ)) {
+		g_critical ("Unable to map buffer.");
+		g_mutex_unlock(&ring->mutex);
+		return kFRAME_RING_DROPPED;
+	}
+
+	if (frame->map.size < (gsize)(stride * ring->height)) {
+		g_critical ("Buffer too small: %zu bytes for %ix%i.", frame->map.size, ring->width, ring->height);
+		gst_buffer_unmap(buffer, &frame->map);
+		g_mutex_unlock(&ring->mutex);
+		return kFRAME_RING_DROPPED;
+	}
+
+	frame->sample = gst_sample_ref(sample);
+	frame->buffer = buffer;
+	frame->data = frame->map.data;
+	frame->width = ring->width;
+	frame->height = ring->height;
+	frame->channels = ring->channels;
+	frame->stride = stride;
+	frame->timestamp = GST_BUFFER_PTS(buffer);
+	frame->sequence = ++ring->sequence;
+	frame->refcount = 1;
+
+	if (ring->latest) {
+		frame_unref(ring->latest);
+	}
+
+	ring->latest = frame;
+
+	g_cond_broadcast(&ring->cond);
+	g_mutex_unlock(&ring->mutex);
+
+	return kFRAME_RING_PUSHED;
+}
+
+R2Frame* frame_ring_acquire(R2FrameRing *ring) {
+
+	g_mutex_lock(&ring->mutex);
+
+	R2Frame *frame = ring->latest;
+
+	if (frame) {
+		frame->refcount++;
+	}
+
+	g_mutex_unlock(&ring->mutex);
+
+	return frame;
+}
+
+R2Frame* frame_ring_acquire_next(R2FrameRing *ring, guint64 sequence, int timeout_ms) {
+
+	gint64 end_time = g_get_monotonic_time() + (gint64)timeout_ms * G_TIME_SPAN_MILLISECOND;
+
+	g_mutex_lock(&ring->mutex);
+
+	guint64 clears = ring->clears;
+
+	while ((!ring->latest || ring->latest->sequence <= sequence) && ring->clears == clears) {
+		if (!g_cond_wait_until(&ring->cond, &ring->mutex, end_time)) {
+			break;
+		}
+	}
+
+	R2Frame *frame = ring->latest;
+
+	if (frame && frame->sequence > sequence) {
+		frame->refcount++;
+	} else {
+		frame = NULL;
+	}
+
+	g_mutex_unlock(&ring->mutex);
+
+	return frame;
+}
+
+void frame_ring_release(R2FrameRing *ring, R2Frame *frame) {
+
+	if (!frame) {
+		return;
+	}
+
+	g_mutex_lock(&ring->mutex);
+
+	if (frame->refcount > 0) {
+		frame_unref(frame);
+	} else {
+		g_warning ("Frame %" G_GUINT64_FORMAT " released too many times.", frame->sequence);
+	}
+
+	g_mutex_unlock(&ring->mutex);
+}
+
+void frame_ring_clear(R2FrameRing *ring) {
+
+	g_mutex_lock(&ring->mutex);
+
+	if (ring->latest) {
+		frame_unref(ring->latest);
+		ring->latest = NULL;
+	}
+
+	ring->clears++;
+	g_cond_broadcast(&ring->cond);
+	g_mutex_unlock(&ring->mutex);
+}
+
+guint64 frame_ring_dropped(R2FrameRing *ring) {
+
+	g_mutex_lock(&ring->mutex);
+	guint64 dropped = ring->dropped;
+	g_mutex_unlock(&ring->mutex);
+
+	return dropped;
+}
@@ -0,0 +1,73 @@
+// This file is part of r2Poject.
+//
+// Copyright 2016 Tord Wessman
+// 
+// r2Project is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// r2Project is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with r2Project. If not, see <http://www.gnu.org/licenses/>.
+// 
+
+#ifndef FRAME_RING_H
+#define FRAME_RING_H
+
+#include <gst/gst.h>
+#include <stdbool.h>
+
+// The number of frames in a ring. If the consumers hold all of them, new frames are dropped until one is released.
+#define kFRAME_RING_SIZE 4
+
+// Returned by frame_ring_push
+#define kFRAME_RING_PUSHED 1
+#define kFRAME_RING_DROPPED 0
+#define kFRAME_RING_INCOMPATIBLE -1
+
+// A frame published by the appsink. The data points to the mapped buffer of the sample and is valid until the frame is released.
+// The public fields come first, so that managed code can read them through a pointer.
+typedef struct {
+	void *data;
+	int width;
+	int height;
+	int channels;			// 8 bit channels (3 for BGR, 1 for GRAY8 and bayer)
+	int stride;			// bytes per row
+	guint64 sequence;		// increases by one for each published frame (starting at 1)
+	guint64 timestamp;		// the buffer pts in ns, or GST_CLOCK_TIME_NONE
+
+	// private:
+	int refcount;
+	GstSample *sample;
+	GstBuffer *buffer;
+	GstMapInfo map;
+} R2Frame;
+
+typedef struct R2FrameRing R2FrameRing;
+
+R2FrameRing* frame_ring_new();
+// Frees the ring. Frames still held by consumers are unmapped.
+void frame_ring_free(R2FrameRing *ring);
+
+// Maps the sample and publishes it as the latest frame. The ring keeps its own reference of the sample.
+int frame_ring_push(R2FrameRing *ring, GstSample *sample);
+
+// Returns the latest frame (or NULL if none has been published). The frame must be released using frame_ring_release.
+R2Frame* frame_ring_acquire(R2FrameRing *ring);
+// Waits at most timeout_ms for a frame with a sequence number larger than sequence. Returns NULL on timeout, or at once if
+// the ring is cleared while waiting.
+R2Frame* frame_ring_acquire_next(R2FrameRing *ring, guint64 sequence, int timeout_ms);
+void frame_ring_release(R2FrameRing *ring, R2Frame *frame);
+
+// Forgets the latest frame (i.e. after EOS) and wakes up the waiting consumers.
+void frame_ring_clear(R2FrameRing *ring);
+
+// The number of frames dropped because no slot was free.
+guint64 frame_ring_dropped(R2FrameRing *ring);
+
+#endif
@@ -0,0 +1,354 @@
+// This file is part of r2Poject.
+//
+// Copyright 2016 Tord Wessman
+//
+// r2Project is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// r2Project is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with r2Project. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "MotionDetector.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct R2MotionDetector {
+	int width;
+	int height;
+	int cols;			// cells per row
+	int rows;
+	gint32 *background;		// gray level << 8
+	int *cell_counts;		// changed pixels per cell
+	int *labels;			// the region of each active cell (0 = none)
+	int *stack;			// cells to visit while labelling
+	bool learned;			// false until the background has been taken from a frame
+
+	int pixel_threshold;
+	float area_threshold;
+	int learning_shift;
+
+	R2MotionCallback callback;
+	void *callback_data;
+
+	guint64 frames;			// analysed frames, the sequence of the events
+	R2MotionEvent last;
+	bool has_last;
+	GMutex mutex;
+	GCond cond;
+};
+
+typedef struct {
+	int x0, y0, x1, y1;		// in cells (inclusive)
+	int cells;
+} CellRegion;
+
+static void free_buffers(R2MotionDetector *d) {
+
+	free(d->background);
+	free(d->cell_counts);
+	free(d->labels);
+	free(d->stack);
+
+	d->background = NULL;
+	d->cell_counts = d->labels = d->stack = NULL;
+}
+
+static bool allocate_buffers(R2MotionDetector *d, int width, int height) {
+
+	free_buffers(d);
+
+	d->width = width;
+	d->height = height;
+	d->cols = (width + kMOTION_CELL_SIZE - 1) / kMOTION_CELL_SIZE;
+	d->rows = (height + kMOTION_CELL_SIZE - 1) / kMOTION_CELL_SIZE;
+	d->background = malloc(sizeof(gint32) * width * height);
+	d->cell_counts = malloc(sizeof(int) * d->cols * d->rows);
+	d->labels = malloc(sizeof(int) * d->cols * d->rows);
+	d->stack = malloc(sizeof(int) * d->cols * d->rows);
+
+	if (!d->background || !d->cell_counts || !d->labels || !d->stack) {
+		g_critical("Unable to allocate the motion detector buffers (%dx%d).", width, height);
+		free_buffers(d);
+		return false;
+	}
+
+	return true;
+}
+
+R2MotionDetector* motion_detector_new() {
+
+	R2MotionDetector *d = calloc(1, sizeof(R2MotionDetector));
+
+	d->pixel_threshold = kMOTION_DEFAULT_PIXEL_THRESHOLD;
+	d->area_threshold = kMOTION_DEFAULT_AREA_THRESHOLD;
+	d->learning_shift = kMOTION_DEFAULT_LEARNING_SHIFT;
+	g_mutex_init(&d->mutex);
+	g_cond_init(&d->cond);
+
+	return d;
+}
+
+void motion_detector_free(R2MotionDetector *d) {
+
+	if (!d) {
+		return;
+	}
+
+	free_buffers(d);
+	g_cond_clear(&d->cond);
+	g_mutex_clear(&d->mutex);
+	free(d);
+}
+
+void motion_detector_configure(R2MotionDetector *d, int pixel_threshold, float area_threshold, int learning_shift) {
+
+	g_mutex_lock(&d->mutex);
+	d->pixel_threshold = pixel_threshold;
+	d->area_threshold = area_threshold;
+	d->learning_shift = CLAMP(learning_shift, 0, 8);
+	g_mutex_unlock(&d->mutex);
+}
+
+void motion_detector_set_callback(R2MotionDetector *d, R2MotionCallback callback, void *user_data) {
+
+	g_mutex_lock(&d->mutex);
+	d->callback = callback;
+	d->callback_data = user_data;
+	g_mutex_unlock(&d->mutex);
+}
+
+void motion_detector_reset(R2MotionDetector *d) {
+
+	g_mutex_lock(&d->mutex);
+	d->learned = false;
+	g_mutex_unlock(&d->mutex);
+}
+
+// Labels the active cells connected to start and returns their bounding box.
+static CellRegion fill_region(R2MotionDetector *d, int start, int label, int min_count) {
+
+	CellRegion region = { d->cols, d->rows, -1, -1, 0 };
+	int top = 0;
+
+	d->labels[start] = label;
+	d->stack[top++] = start;
+
+	while (top > 0) {
+
+		int cell = d->stack[--top];
+		int x = cell % d->cols, y = cell / d->cols;
+
+		region.x0 = MIN(region.x0, x);
+		region.y0 = MIN(region.y0, y);
+		region.x1 = MAX(region.x1, x);
+		region.y1 = MAX(region.y1, y);
+		region.cells++;
+
+		int neighbours[] = { x > 0 ? cell - 1 : -1, x < d->cols - 1 ? cell + 1 : -1,
+			y > 0 ? cell - d->cols : -1, y < d->rows - 1 ? cell + d->cols : -1 };
+
+		for (int i = 0; i < 4; i++) {
+
+			int n = neighbours[i];
+
+			if (n >= 0 && !d->labels[n] && d->cell_counts[n] >= min_count) {
+				d->labels[n] = label;
+				d->stack[top++] = n;
+			}
+		}
+	}
+
+	return region;
+}
+
+// Groups the active cells into the largest kMOTION_MAX_REGIONS regions.
+static void find_regions(R2MotionDetector *d, R2MotionEvent *event) {
+
+	CellRegion regions[kMOTION_MAX_REGIONS];
+	int count = 0, label = 0;
+	// A cell is active when a quarter of its pixels has changed.
+	int min_count = kMOTION_CELL_SIZE * kMOTION_CELL_SIZE / 4;
+
+	memset(d->labels, 0, sizeof(int) * d->cols * d->rows);
+
+	for (int cell = 0; cell < d->cols * d->rows; cell++) {
+
+		if (d->labels[cell] || d->cell_counts[cell] < min_count) {
+			continue;
+		}
+
+		CellRegion region = fill_region(d, cell, ++label, min_count);
+
+		if (count < kMOTION_MAX_REGIONS) {
+			regions[count++] = region;
+			continue;
+		}
+
+		// Replaces the smallest one.
+		int smallest = 0;
+
+		for (int i = 1; i < count; i++) {
+			if (regions[i].cells < regions[smallest].cells) {
+				smallest = i;
+			}
+		}
+
+		if (region.cells > regions[smallest].cells) {
+			regions[smallest] = region;
+		}
+	}
+
+	event->region_count = count;
+
+	for (int i = 0; i < count; i++) {
+
+		int x0 = regions[i].x0 * kMOTION_CELL_SIZE, y0 = regions[i].y0 * kMOTION_CELL_SIZE;
+		int x1 = MIN((regions[i].x1 + 1) * kMOTION_CELL_SIZE, d->width);
+		int y1 = MIN((regions[i].y1 + 1) * kMOTION_CELL_SIZE, d->height);
+
+		event->regions[i].x = (float)x0 / d->width;
+		event->regions[i].y = (float)y0 / d->height;
+		event->regions[i].width = (float)(x1 - x0) / d->width;
+		event->regions[i].height = (float)(y1 - y0) / d->height;
+	}
+
+	// Changes spread too thin for a single active cell still cover the frame.
+	if (count == 0) {
+		event->region_count = 1;
+		event->regions[0] = (R2MotionRegion) { 0, 0, 1, 1 };
+	}
+}
+
+bool motion_detector_process(R2MotionDetector *d, const R2Frame *frame) {
+
+	if (frame->channels != 1) {
+		g_critical("The motion detector requires GRAY8 frames (got %d channels).", frame->channels);
+		return false;
+	}
+
+	g_mutex_lock(&d->mutex);
+	int pixel_threshold = d->pixel_threshold, shift = d->learning_shift;
+	float area_threshold = d->area_threshold;
+	bool learned = d->learned;
+	g_mutex_unlock(&d->mutex);
+
+	// The buffers are only used by the streaming thread.
+	if (frame->width != d->width || frame->height != d->height || !d->background) {
+
+		if (!allocate_buffers(d, frame->width, frame->height)) {
+			return false;
+		}
+
+		learned = false;
+	}
+
+	const guint8 *pixels = (const guint8 *)frame->data;
+
+	if (!learned) {
+
+		for (int y = 0; y < d->height; y++) {
+			for (int x = 0; x < d->width; x++) {
+				d->background[y * d->width + x] = pixels[y * frame->stride + x] << 8;
+			}
+		}
+
+		g_mutex_lock(&d->mutex);
+		d->learned = true;
+		g_mutex_unlock(&d->mutex);
+
+		return false;
+	}
+
+	int changed = 0;
+	guint64 sequence = ++d->frames;
+
+	memset(d->cell_counts, 0, sizeof(int) * d->cols * d->rows);
+
+	for (int y = 0; y < d->height; y++) {
+
+		const guint8 *row = pixels + y * frame->stride;
+		gint32 *background = d->background + y * d->width;
+		int *cells = d->cell_counts + (y / kMOTION_CELL_SIZE) * d->cols;
+
+		for (int x = 0; x < d->width; x++) {
+
+			gint32 value = row[x] << 8;
+
+			if (abs(value - background[x]) > pixel_threshold << 8) {
+				changed++;
+				cells[x / kMOTION_CELL_SIZE]++;
+			}
+
+			background[x] += (value - background[x]) >> shift;
+		}
+	}
+
+	float area = (float)changed / (d->width * d->height);
+
+	if (area < area_threshold) {
+		return false;
+	}
+
+	R2MotionEvent event = { .sequence = sequence, .timestamp = frame->timestamp, .area = area };
+
+	find_regions(d, &event);
+
+	g_mutex_lock(&d->mutex);
+	d->last = event;
+	d->has_last = true;
+	R2MotionCallback callback = d->callback;
+	void *callback_data = d->callback_data;
+	g_cond_broadcast(&d->cond);
+	g_mutex_unlock(&d->mutex);
+
+	if (callback) {
+		callback(&event, callback_data);
+	}
+
+	return true;
+}
+
+bool motion_detector_get_last(R2MotionDetector *d, R2MotionEvent *event) {
+
+	g_mutex_lock(&d->mutex);
+	bool has_last = d->has_last;
+
+	if (has_last) {
+		*event = d->last;
+	}
+
+	g_mutex_unlock(&d->mutex);
+
+	return has_last;
+}
+
+bool motion_detector_wait(R2MotionDetector *d, guint64 sequence, int timeout_ms, R2MotionEvent *event) {
+
+	gint64 end_time = g_get_monotonic_time() + (gint64)timeout_ms * G_TIME_SPAN_MILLISECOND;
+
+	g_mutex_lock(&d->mutex);
+
+	while (!d->has_last || d->last.sequence <= sequence) {
+		if (!g_cond_wait_until(&d->cond, &d->mutex, end_time)) {
+			break;
+		}
+	}
+
+	bool found = d->has_last && d->last.sequence > sequence;
+
+	if (found) {
+		*event = d->last;
+	}
+
+	g_mutex_unlock(&d->mutex);
+
+	return found;
+}
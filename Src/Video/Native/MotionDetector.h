@@ -0,0 +1,88 @@
+// This file is part of r2Poject.
+//
+// Copyright 2016 Tord Wessman
+//
+// r2Project is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// r2Project is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with r2Project. If not, see <http://www.gnu.org/licenses/>.
+//
+
+/**
+*	Motion detection on small GRAY8 frames (see kBRANCH_MOTION): each frame is compared to a running average of the
+*	previous ones. The changed pixels are counted in cells, and adjacent cells with activity are reported as regions,
+*	so that the expensive detectors only have to look at the frames (and the parts of them) where something moved.
+**/
+
+#ifndef MOTION_DETECTOR_H
+#define MOTION_DETECTOR_H
+
+#include <gst/gst.h>
+#include <stdbool.h>
+#include "FrameRing.h"
+
+// The default size of the frames of the motion branch
+#define kMOTION_DEFAULT_WIDTH 160
+#define kMOTION_DEFAULT_HEIGHT 120
+
+// A pixel has changed if it differs this many gray levels from the background
+#define kMOTION_DEFAULT_PIXEL_THRESHOLD 25
+// Motion is reported if at least this fraction of the pixels has changed
+#define kMOTION_DEFAULT_AREA_THRESHOLD 0.005
+// The background moves 1/2^n of the way towards each new frame
+#define kMOTION_DEFAULT_LEARNING_SHIFT 4
+
+// The side (in pixels) of the cells in which the changed pixels are counted
+#define kMOTION_CELL_SIZE 8
+// The largest regions reported for one frame
+#define kMOTION_MAX_REGIONS 8
+
+// Relative to the size of the frame (0 - 1), so that it can be applied to the frames of any branch.
+typedef struct {
+	float x;
+	float y;
+	float width;
+	float height;
+} R2MotionRegion;
+
+typedef struct {
+	guint64 sequence;		// the number of frames analysed by the detector (increases with each event)
+	guint64 timestamp;		// the pts of the frame (the same clock as the frames of the other branches)
+	float area;			// the fraction of changed pixels
+	int region_count;
+	R2MotionRegion regions[kMOTION_MAX_REGIONS];
+} R2MotionEvent;
+
+// Called from the streaming thread of the motion branch for each frame with motion. Must return quickly.
+typedef void (*R2MotionCallback)(const R2MotionEvent *event, void *user_data);
+
+typedef struct R2MotionDetector R2MotionDetector;
+
+R2MotionDetector* motion_detector_new();
+void motion_detector_free(R2MotionDetector *d);
+
+// pixel_threshold: gray levels, area_threshold: fraction of the pixels, learning_shift: see kMOTION_DEFAULT_LEARNING_SHIFT.
+void motion_detector_configure(R2MotionDetector *d, int pixel_threshold, float area_threshold, int learning_shift);
+void motion_detector_set_callback(R2MotionDetector *d, R2MotionCallback callback, void *user_data);
+
+// Compares a GRAY8 frame to the background and updates it. Returns true if motion was detected.
+bool motion_detector_process(R2MotionDetector *d, const R2Frame *frame);
+
+// Copies the latest motion. Returns false if no motion has been detected yet.
+bool motion_detector_get_last(R2MotionDetector *d, R2MotionEvent *event);
+
+// Waits at most timeout_ms for an event with a sequence greater than sequence. Returns false on timeout.
+bool motion_detector_wait(R2MotionDetector *d, guint64 sequence, int timeout_ms, R2MotionEvent *event);
+
+// Learns the background again from the next frame (i.e. after the camera has moved).
+void motion_detector_reset(R2MotionDetector *d);
+
+#endif
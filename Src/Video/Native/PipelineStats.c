@@ -0,0 +1,454 @@
+// This file is part of r2Poject.
+//
+// Copyright 2016 Tord Wessman
+//
+// r2Project is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// r2Project is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with r2Project. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "PipelineStats.h"
+#include <stdlib.h>
+#include <string.h>
+
+// The number of buffers that may be inside one element at the same time (queues hold more, but are matched as well as possible)
+#define kSTATS_PENDING 32
+
+typedef struct {
+	guint64 pts;
+	gint64 entered_at;
+} PendingBuffer;
+
+typedef struct {
+	R2Stats *owner;
+	GstElement *element;
+	GstPad *sink_pad;
+	GstPad *src_pad;
+	gulong sink_probe;
+	gulong src_probe;
+	gulong overrun_handler;
+	bool is_queue;
+
+	PendingBuffer pending[kSTATS_PENDING];
+	int next_pending;
+	guint32 samples[kSTATS_SAMPLES];
+	int sample_count;			// total, the ring holds the last kSTATS_SAMPLES
+
+	R2ElementStats counters;
+} ElementRecord;
+
+struct R2Stats {
+	GPtrArray *records;
+	GMutex mutex;
+};
+
+static void clear_counters(ElementRecord *r) {
+
+	char name[sizeof(r->counters.name)];
+
+	memcpy(name, r->counters.name, sizeof(name));
+	memset(&r->counters, 0, sizeof(r->counters));
+	memcpy(r->counters.name, name, sizeof(name));
+
+	for (int i = 0; i < kSTATS_PENDING; i++) {
+		r->pending[i].pts = GST_CLOCK_TIME_NONE;
+	}
+
+	r->sample_count = 0;
+}
+
+static GstPadProbeReturn buffer_entered(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+
+	ElementRecord *r = (ElementRecord *)user_data;
+	GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+	guint level = 0;
+
+	if (r->is_queue) {
+		g_object_get(r->element, "current-level-buffers", &level, NULL);
+	}
+
+	g_mutex_lock(&r->owner->mutex);
+
+	r->counters.buffers_in++;
+
+	if (GST_BUFFER_PTS(buffer) != GST_CLOCK_TIME_NONE && r->src_pad) {
+		r->pending[r->next_pending].pts = GST_BUFFER_PTS(buffer);
+		r->pending[r->next_pending].entered_at = g_get_monotonic_time();
+		r->next_pending = (r->next_pending + 1) % kSTATS_PENDING;
+	}
+
+	if (r->is_queue) {
+		r->counters.queue_level = level;
+		if ((int)level > r->counters.queue_max_level) {
+			r->counters.queue_max_level = level;
+		}
+	}
+
+	g_mutex_unlock(&r->owner->mutex);
+
+	return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn buffer_left(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+
+	ElementRecord *r = (ElementRecord *)user_data;
+	GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+	guint64 pts = GST_BUFFER_PTS(buffer);
+	gint64 now = g_get_monotonic_time();
+
+	g_mutex_lock(&r->owner->mutex);
+
+	r->counters.buffers_out++;
+
+	// Buffers split by the element (i.e. rtp packets) only match once.
+	for (int i = 0; pts != GST_CLOCK_TIME_NONE && i < kSTATS_PENDING; i++) {
+
+		if (r->pending[i].pts == pts) {
+
+			r->samples[r->sample_count % kSTATS_SAMPLES] = (guint32)(now - r->pending[i].entered_at);
+			r->sample_count++;
+			r->pending[i].pts = GST_CLOCK_TIME_NONE;
+			break;
+		}
+	}
+
+	g_mutex_unlock(&r->owner->mutex);
+
+	return GST_PAD_PROBE_OK;
+}
+
+// Emitted by a full queue before a leaky queue drops a buffer.
+static void queue_overrun(GstElement *queue, gpointer user_data) {
+
+	ElementRecord *r = (ElementRecord *)user_data;
+	guint leaky = 0;
+
+	g_object_get(queue, "leaky", &leaky, NULL);
+
+	if (leaky) {
+		g_mutex_lock(&r->owner->mutex);
+		r->counters.dropped++;
+		g_mutex_unlock(&r->owner->mutex);
+	}
+}
+
+// Returns a new reference to the first pad of the list (the static pads are created first).
+static GstPad* first_pad(GstElement *element, bool sink) {
+
+	GstPad *pad = NULL;
+
+	GST_OBJECT_LOCK(element);
+
+	GList *pads = sink ? element->sinkpads : element->srcpads;
+
+	if (pads) {
+		pad = gst_object_ref(GST_PAD(pads->data));
+	}
+
+	GST_OBJECT_UNLOCK(element);
+
+	return pad;
+}
+
+static void set_name(ElementRecord *r) {
+
+	GstObject *parent = gst_object_get_parent(GST_OBJECT(r->element));
+	gchar *element_name = gst_object_get_name(GST_OBJECT(r->element));
+
+	// Elements of the top level are named as they are, the others are prefixed by their bin.
+	if (parent && GST_OBJECT_PARENT(parent)) {
+
+		gchar *parent_name = gst_object_get_name(parent);
+		g_snprintf(r->counters.name, sizeof(r->counters.name), "%s/%s", parent_name, element_name);
+		g_free(parent_name);
+
+	} else {
+		g_strlcpy(r->counters.name, element_name, sizeof(r->counters.name));
+	}
+
+	g_free(element_name);
+
+	if (parent) {
+		gst_object_unref(parent);
+	}
+}
+
+// Must be called with the stats mutex held.
+static ElementRecord* find_record(R2Stats *stats, GstObject *element) {
+
+	for (guint i = 0; i < stats->records->len; i++) {
+
+		ElementRecord *r = g_ptr_array_index(stats->records, i);
+
+		if (GST_OBJECT(r->element) == element) {
+			return r;
+		}
+	}
+
+	return NULL;
+}
+
+static void watch_element(R2Stats *stats, GstElement *element) {
+
+	g_mutex_lock(&stats->mutex);
+	bool watched = find_record(stats, GST_OBJECT(element)) != NULL;
+	g_mutex_unlock(&stats->mutex);
+
+	if (watched) {
+		return;
+	}
+
+	GstPad *sink_pad = first_pad(element, true);
+	GstPad *src_pad = first_pad(element, false);
+
+	// The pipeline itself.
+	if (!sink_pad && !src_pad) {
+		return;
+	}
+
+	ElementRecord *r = g_new0(ElementRecord, 1);
+
+	r->owner = stats;
+	r->element = gst_object_ref(element);
+	r->sink_pad = sink_pad;
+	r->src_pad = src_pad;
+
+	GstElementFactory *factory = gst_element_get_factory(element);
+	r->is_queue = factory && !g_strcmp0(gst_plugin_feature_get_name(GST_PLUGIN_FEATURE(factory)), "queue");
+
+	set_name(r);
+	clear_counters(r);
+
+	g_mutex_lock(&stats->mutex);
+	g_ptr_array_add(stats->records, r);
+	g_mutex_unlock(&stats->mutex);
+
+	if (sink_pad) {
+		r->sink_probe = gst_pad_add_probe(sink_pad, GST_PAD_PROBE_TYPE_BUFFER, buffer_entered, r, NULL);
+	}
+
+	if (src_pad) {
+		r->src_probe = gst_pad_add_probe(src_pad, GST_PAD_PROBE_TYPE_BUFFER, buffer_left, r, NULL);
+	}
+
+	if (r->is_queue) {
+		r->overrun_handler = g_signal_connect(element, "overrun", G_CALLBACK(queue_overrun), r);
+	}
+}
+
+R2Stats* stats_new() {
+
+	R2Stats *stats = g_new0(R2Stats, 1);
+
+	stats->records = g_ptr_array_new();
+	g_mutex_init(&stats->mutex);
+
+	return stats;
+}
+
+// Removes the probes and the signal handler, and releases the references of the record.
+static void release_record(ElementRecord *r) {
+
+	if (r->sink_pad) {
+		gst_pad_remove_probe(r->sink_pad, r->sink_probe);
+		gst_object_unref(r->sink_pad);
+	}
+
+	if (r->src_pad) {
+		gst_pad_remove_probe(r->src_pad, r->src_probe);
+		gst_object_unref(r->src_pad);
+	}
+
+	if (r->overrun_handler) {
+		g_signal_handler_disconnect(r->element, r->overrun_handler);
+	}
+
+	gst_object_unref(r->element);
+	g_free(r);
+}
+
+void stats_free(R2Stats *stats) {
+
+	if (!stats) {
+		return;
+	}
+
+	for (guint i = 0; i < stats->records->len; i++) {
+		release_record(g_ptr_array_index(stats->records, i));
+	}
+
+	g_ptr_array_free(stats->records, true);
+	g_mutex_clear(&stats->mutex);
+	g_free(stats);
+}
+
+void stats_watch(R2Stats *stats, GstElement *element) {
+
+	watch_element(stats, element);
+
+	if (!GST_IS_BIN(element)) {
+		return;
+	}
+
+	GST_OBJECT_LOCK(element);
+	GList *children = g_list_copy_deep(GST_BIN_CHILDREN(element), (GCopyFunc)gst_object_ref, NULL);
+	GST_OBJECT_UNLOCK(element);
+
+	// The children are prepended when added, so the list is walked backwards to keep the stats in pipeline order.
+	for (GList *child = g_list_last(children); child; child = child->prev) {
+		stats_watch(stats, GST_ELEMENT(child->data));
+	}
+
+	g_list_free_full(children, gst_object_unref);
+}
+
+void stats_unwatch(R2Stats *stats, GstElement *element) {
+
+	GPtrArray *removed = g_ptr_array_new();
+
+	g_mutex_lock(&stats->mutex);
+
+	for (guint i = 0; i < stats->records->len;) {
+
+		ElementRecord *r = g_ptr_array_index(stats->records, i);
+
+		if (r->element == element || gst_object_has_as_ancestor(GST_OBJECT(r->element), GST_OBJECT(element))) {
+			g_ptr_array_add(removed, g_ptr_array_remove_index(stats->records, i));
+		} else {
+			i++;
+		}
+	}
+
+	g_mutex_unlock(&stats->mutex);
+
+	// Outside of the mutex, since a probe of the element may be waiting for it.
+	for (guint i = 0; i < removed->len; i++) {
+		release_record(g_ptr_array_index(removed, i));
+	}
+
+	g_ptr_array_free(removed, true);
+}
+
+void stats_handle_message(R2Stats *stats, GstMessage *message) {
+
+	if (GST_MESSAGE_TYPE(message) != GST_MESSAGE_QOS) {
+		return;
+	}
+
+	GstFormat format;
+	guint64 processed = 0, dropped = 0;
+	gint64 jitter = 0;
+	gdouble proportion = 0;
+	gint quality = 0;
+
+	gst_message_parse_qos_stats(message, &format, &processed, &dropped);
+	gst_message_parse_qos_values(message, &jitter, &proportion, &quality);
+
+	g_mutex_lock(&stats->mutex);
+
+	ElementRecord *r = find_record(stats, GST_MESSAGE_SRC(message));
+
+	if (r) {
+
+		r->counters.qos_events++;
+		r->counters.qos_jitter = jitter / 1000;
+		r->counters.qos_proportion = proportion;
+
+		// The QoS counters are totals, and a sink never leaks like a queue.
+		if (format == GST_FORMAT_BUFFERS && dropped != (guint64)-1) {
+			r->counters.dropped = dropped;
+		}
+	}
+
+	g_mutex_unlock(&stats->mutex);
+}
+
+int stats_count(R2Stats *stats) {
+
+	g_mutex_lock(&stats->mutex);
+	int count = stats->records->len;
+	g_mutex_unlock(&stats->mutex);
+
+	return count;
+}
+
+static int compare_samples(const void *a, const void *b) {
+
+	guint32 x = *(const guint32 *)a, y = *(const guint32 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+bool stats_get(R2Stats *stats, int index, R2ElementStats *out) {
+
+	guint32 samples[kSTATS_SAMPLES];
+
+	g_mutex_lock(&stats->mutex);
+
+	if (index < 0 || index >= (int)stats->records->len) {
+		g_mutex_unlock(&stats->mutex);
+		return false;
+	}
+
+	ElementRecord *r = g_ptr_array_index(stats->records, index);
+	int count = r->sample_count < kSTATS_SAMPLES ? r->sample_count : kSTATS_SAMPLES;
+
+	*out = r->counters;
+	memcpy(samples, r->samples, count * sizeof(guint32));
+
+	g_mutex_unlock(&stats->mutex);
+
+	out->samples = count;
+
+	if (count > 0) {
+
+		qsort(samples, count, sizeof(guint32), compare_samples);
+
+		out->processing_p50 = samples[count / 2];
+		out->processing_p95 = samples[count * 95 / 100];
+		out->processing_p99 = samples[count * 99 / 100];
+		out->processing_max = samples[count - 1];
+	}
+
+	return true;
+}
+
+void stats_reset(R2Stats *stats) {
+
+	g_mutex_lock(&stats->mutex);
+
+	for (guint i = 0; i < stats->records->len; i++) {
+		clear_counters(g_ptr_array_index(stats->records, i));
+	}
+
+	g_mutex_unlock(&stats->mutex);
+}
+
+void stats_print(R2Stats *stats) {
+
+	R2ElementStats s;
+
+	g_print("%-32s %10s %10s %8s %7s %6s %8s %8s %8s %8s\n", "element", "in", "out", "dropped", "queue", "qos",
+		"p50 µs", "p95 µs", "p99 µs", "max µs");
+
+	for (int i = 0; stats_get(stats, i, &s); i++) {
+
+		g_print("%-32s %10" G_GUINT64_FORMAT " %10" G_GUINT64_FORMAT " %8" G_GUINT64_FORMAT " %3d/%-3d %6" G_GUINT64_FORMAT,
+			s.name, s.buffers_in, s.buffers_out, s.dropped, s.queue_level, s.queue_max_level, s.qos_events);
+
+		if (s.samples > 0) {
+			g_print(" %8u %8u %8u %8u\n", s.processing_p50, s.processing_p95, s.processing_p99, s.processing_max);
+		} else {
+			g_print(" %8s %8s %8s %8s\n", "-", "-", "-", "-");
+		}
+	}
+}
@@ -0,0 +1,76 @@
+// This file is part of r2Poject.
+//
+// Copyright 2016 Tord Wessman
+//
+// r2Project is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// r2Project is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with r2Project. If not, see <http://www.gnu.org/licenses/>.
+//
+
+/**
+*	Optional instrumentation of a pipeline: buffer probes on the pads of each element measure its throughput and the time a
+*	buffer spends in it (matched by pts). Queues report their fill level and the buffers they leaked, sinks their QoS.
+**/
+
+#ifndef PIPELINE_STATS_H
+#define PIPELINE_STATS_H
+
+#include <gst/gst.h>
+#include <stdbool.h>
+
+// The number of processing times kept per element for the percentiles
+#define kSTATS_SAMPLES 256
+
+// A snapshot of the counters of one element. Times are in µs. Laid out for marshalling (no pointers).
+typedef struct {
+	char name[64];			// the element name, prefixed by the bin it's in (i.e. bin3/jpegenc0)
+	guint64 buffers_in;		// buffers received on the (first) sink pad
+	guint64 buffers_out;		// buffers pushed from the (first) src pad
+	guint64 dropped;		// buffers leaked by a queue, or dropped according to the QoS messages of a sink
+	int queue_level;		// the current fill level (buffers) of a queue
+	int queue_max_level;		// the highest fill level seen
+	guint64 qos_events;		// QoS messages posted by the element
+	gint64 qos_jitter;		// the jitter of the last QoS message (µs, positive when late)
+	double qos_proportion;		// the requested rate correction of the last QoS message
+	int samples;			// the number of processing times the percentiles are calculated from
+	guint32 processing_p50;
+	guint32 processing_p95;
+	guint32 processing_p99;
+	guint32 processing_max;
+} R2ElementStats;
+
+typedef struct R2Stats R2Stats;
+
+R2Stats* stats_new();
+// Removes the probes and frees the stats. The pipeline should be stopped before.
+void stats_free(R2Stats *stats);
+
+// Instruments the element (or every element of it if it's a bin). Elements added to the pipeline later have to be added
+// using this function (the tee branches are watched and unwatched by TeeBranch).
+void stats_watch(R2Stats *stats, GstElement *element);
+
+// Stops instrumenting the element and every element inside of it, and drops their counters. Must be called after the element
+// has been set to NULL and before it's removed from the pipeline (i.e. a tee branch), since the stats hold a reference to it.
+void stats_unwatch(R2Stats *stats, GstElement *element);
+
+// Collects the QoS messages. Called by the bus handler.
+void stats_handle_message(R2Stats *stats, GstMessage *message);
+
+int stats_count(R2Stats *stats);
+// Copies the counters of the element at index. Returns false if the index is out of range.
+bool stats_get(R2Stats *stats, int index, R2ElementStats *out);
+void stats_reset(R2Stats *stats);
+
+// Logs a table of all elements.
+void stats_print(R2Stats *stats);
+
+#endif
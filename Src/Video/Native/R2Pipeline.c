@@ -0,0 +1,256 @@
+// This file is part of r2Poject.
+//
+// Copyright 2016 Tord Wessman
+// 
+// r2Project is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// r2Project is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with r2Project. If not, see <http://www.gnu.org/licenses/>.
+// 
+
+#include "R2Pipeline.h"
+
+static void report(R2Pipeline *p, int type, const char *message) {
+
+	if (p->report_error != NULL) {
+		p->report_error(type, message);
+	}
+}
+
+static gboolean bus_call(GstBus *bus, GstMessage *msg, gpointer user_data) {
+
+	R2Pipeline *p = (R2Pipeline *)user_data;
+
+	if (p->stats) {
+		stats_handle_message(p->stats, msg);
+	}
+
+	if (p->on_message && p->on_message(p, msg)) {
+		return true;
+	}
+
+	switch (GST_MESSAGE_TYPE(msg)) {
+	case GST_MESSAGE_EOS: {
+
+		g_message("%s: End-of-stream", p->name);
+		r2_pipeline_stop(p);
+
+		if (p->report_eos != NULL) {
+			p->report_eos();
+		}
+
+		break;
+	}
+	case GST_MESSAGE_ERROR: {
+
+		GError *err = NULL;
+		gchar *name, *debug = NULL;
+
+		name = gst_object_get_path_string(msg->src);
+		gst_message_parse_error(msg, &err, &debug);
+
+		g_critical("%s ERROR: from element %s: %s", p->name, name, err->message);
+		if (debug != NULL) {
+			g_printerr("Additional debug info:\n%s\n", debug);
+		}
+
+		report(p, kERROR_CRITICAL, err->message);
+
+		g_error_free(err);
+		g_free(debug);
+		g_free(name);
+
+		r2_pipeline_stop(p);
+		break;
+	}
+	case GST_MESSAGE_WARNING: {
+
+		GError *err = NULL;
+		gchar *name, *debug = NULL;
+
+		name = gst_object_get_path_string(msg->src);
+		gst_message_parse_warning(msg, &err, &debug);
+
+		g_warning("%s WARNING: from element %s: %s", p->name, name, err->message);
+		if (debug != NULL) {
+			g_printerr("Additional debug info:\n%s\n", debug);
+		}
+
+		report(p, kERROR_WARNING, err->message);
+
+		g_error_free(err);
+		g_free(debug);
+		g_free(name);
+		break;
+	}
+	case GST_MESSAGE_STATE_CHANGED: {
+
+		GstState old_state, new_state;
+
+		if (p->stats && GST_MESSAGE_SRC(msg) == GST_OBJECT(p->pipeline)) {
+			gst_message_parse_state_changed(msg, &old_state, &new_state, NULL);
+			g_message("%s: State changed from %s to %s", p->name, gst_element_state_get_name(old_state),
+				gst_element_state_get_name(new_state));
+		}
+
+		break;
+	}
+	default:
+		break;
+	}
+
+	return true;
+}
+
+bool r2_pipeline_init(R2Pipeline *p, const char *name, R2MessageHandler on_message) {
+
+	// Starts GStreamer and the shared loop thread.
+	r2_loop_context();
+
+	p->name = name;
+	p->on_message = on_message;
+	p->running = false;
+	p->waiters = 0;
+	p->stats = NULL;
+	p->pipeline = gst_pipeline_new(NULL);
+
+	if (!p->pipeline) {
+		g_critical("%s: Unable to create pipeline.", name);
+		return false;
+	}
+
+	g_mutex_init(&p->mutex);
+	g_cond_init(&p->stopped);
+
+	p->bus_watch = r2_loop_add_bus_watch(p->pipeline, bus_call, p);
+
+	return true;
+}
+
+bool r2_pipeline_start(R2Pipeline *p) {
+
+	g_mutex_lock(&p->mutex);
+
+	if (p->running) {
+		g_mutex_unlock(&p->mutex);
+		g_critical("%s: Unable to start pipeline. It's already running.", p->name);
+		return false;
+	}
+
+	// Set before the state change, since the bus handler may stop the pipeline before set_state returns.
+	p->running = true;
+	g_mutex_unlock(&p->mutex);
+
+	if (gst_element_set_state(p->pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+		g_critical("%s: Unable to start pipeline.", p->name);
+		r2_pipeline_stop(p);
+		return false;
+	}
+
+	return true;
+}
+
+void r2_pipeline_stop(R2Pipeline *p) {
+
+	if (!p->pipeline) {
+		return;
+	}
+
+	gst_element_set_state(p->pipeline, GST_STATE_READY);
+
+	g_mutex_lock(&p->mutex);
+	p->running = false;
+	g_cond_broadcast(&p->stopped);
+	g_mutex_unlock(&p->mutex);
+}
+
+void r2_pipeline_wait(R2Pipeline *p) {
+
+	g_mutex_lock(&p->mutex);
+	p->waiters++;
+
+	while (p->running) {
+		g_cond_wait(&p->stopped, &p->mutex);
+	}
+
+	p->waiters--;
+	g_cond_broadcast(&p->stopped);
+	g_mutex_unlock(&p->mutex);
+}
+
+void r2_pipeline_run(R2Pipeline *p) {
+
+	if (r2_pipeline_start(p)) {
+		r2_pipeline_wait(p);
+	}
+}
+
+void r2_pipeline_send_eos(R2Pipeline *p) {
+
+	if (p->pipeline) {
+		gst_element_send_event(p->pipeline, gst_event_new_eos());
+	}
+}
+
+bool r2_pipeline_is_running(R2Pipeline *p) {
+
+	g_mutex_lock(&p->mutex);
+	bool running = p->running;
+	g_mutex_unlock(&p->mutex);
+
+	return running;
+}
+
+R2Stats* r2_pipeline_enable_stats(R2Pipeline *p) {
+
+	if (!p->pipeline) {
+		return NULL;
+	}
+
+	if (!p->stats) {
+		p->stats = stats_new();
+	}
+
+	stats_watch(p->stats, p->pipeline);
+
+	return p->stats;
+}
+
+void r2_pipeline_dispose(R2Pipeline *p) {
+
+	if (!p->pipeline) {
+		return;
+	}
+
+	// Removed on the loop thread, so no message handler is running on p once this returns.
+	r2_loop_remove_watch(p->bus_watch);
+	p->bus_watch = NULL;
+
+	r2_pipeline_stop(p);
+
+	// Let the blocked callers of r2_pipeline_run return before the mutex is cleared.
+	g_mutex_lock(&p->mutex);
+	while (p->waiters > 0) {
+		g_cond_wait(&p->stopped, &p->mutex);
+	}
+	g_mutex_unlock(&p->mutex);
+
+	gst_element_set_state(p->pipeline, GST_STATE_NULL);
+
+	stats_free(p->stats);
+	p->stats = NULL;
+
+	gst_object_unref(p->pipeline);
+	p->pipeline = NULL;
+
+	g_cond_clear(&p->stopped);
+	g_mutex_clear(&p->mutex);
+}
@@ -0,0 +1,80 @@
+// This file is part of r2Poject.
+//
+// Copyright 2016 Tord Wessman
+// 
+// r2Project is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// r2Project is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with r2Project. If not, see <http://www.gnu.org/licenses/>.
+// 
+
+#ifndef R2_PIPELINE_H
+#define R2_PIPELINE_H
+
+#include <gst/gst.h>
+#include <stdbool.h>
+#include "r2gstloop.h"
+#include "PipelineStats.h"
+
+#define kERROR_WARNING 0
+#define kERROR_CRITICAL 1
+
+typedef struct R2Pipeline R2Pipeline;
+
+// Called for each bus message before the default handling. Returns true if the message was handled.
+typedef bool (*R2MessageHandler)(R2Pipeline *p, GstMessage *message);
+
+// The state shared by all camera pipelines. Each camera/stream type embeds it as its first member, so that one process
+// can run any number of pipelines. The bus watches of all instances are attached to the shared loop thread (r2gstloop),
+// so the message handlers are called from that thread and never from the caller of r2_pipeline_start.
+struct R2Pipeline {
+	const char *name;		// used when logging
+	GstElement *pipeline;
+	GSource *bus_watch;
+	bool running;
+	int waiters;			// threads blocked in r2_pipeline_wait
+	GMutex mutex;
+	GCond stopped;
+	R2MessageHandler on_message;
+	R2Stats *stats;			// NULL unless r2_pipeline_enable_stats has been called
+
+	const char*(*report_error)(int type, const char *message);	//delegate method for reporting back error
+	const char*(*report_eos)();	//delegate method for reporting eos
+};
+
+// Creates the pipeline and attaches its bus watch to the shared loop.
+bool r2_pipeline_init(R2Pipeline *p, const char *name, R2MessageHandler on_message);
+
+// Sets the pipeline to PLAYING and returns.
+bool r2_pipeline_start(R2Pipeline *p);
+
+// Sets the pipeline to READY and wakes up r2_pipeline_wait. May be called from any thread (it's also called on EOS and errors).
+void r2_pipeline_stop(R2Pipeline *p);
+
+// Blocks until the pipeline has been stopped.
+void r2_pipeline_wait(R2Pipeline *p);
+
+// Starts the pipeline and blocks until it has been stopped. Kept for the blocking APIs.
+void r2_pipeline_run(R2Pipeline *p);
+
+// Sends EOS through the pipeline (it's stopped when the EOS reaches the sinks).
+void r2_pipeline_send_eos(R2Pipeline *p);
+
+bool r2_pipeline_is_running(R2Pipeline *p);
+
+// Instruments every element currently in the pipeline and starts collecting its QoS messages. Elements added later must
+// be passed to stats_watch. Returns the stats (owned by the pipeline and freed by r2_pipeline_dispose).
+R2Stats* r2_pipeline_enable_stats(R2Pipeline *p);
+
+// Stops and releases the pipeline. When it returns, the message handler will not be called again.
+void r2_pipeline_dispose(R2Pipeline *p);
+
+#endif
@@ -23,190 +23,402 @@
 #include <stdlib.h>
 
 // rpicamsrc inline-headers=true preview=false bitrate=524288 keyframe-interval=30 ! video/x-h264, parsed=false, stream-format=\"byte-stream\", level=\"4\", profile=\"high\", framerate=30/1,width=640,height=480 ! queue leaky=2 ! tcpserversink host=0.0.0.0 port=" + @cam_port.to_s
-		
-static GMainLoop *rpi_loop;
-static GstElement *rpi_pipeline, *rpi_src, *rpi_queue_tcp, *rpi_tcpserversink;
-static GstBus *rpi_bus;
 
 #define kDefaultKeyframeInterval 30
+#define kDefaultBitrate 524288
+#define kRtpPayloadType 96
 
-static int rpi_bitrate = 524288;
-static int rpi_framerate = kDefaultKeyframeInterval;
-static int rpi_width;
-static int rpi_height;
-static int rpi_port;
-static bool rpi_initiated = false;
-static bool rpi_recording = false;
+// Adaptive streaming
+#define kAdaptIntervalMs 1000
+#define kAdaptStableTicks 5		// adjustments without congestion before the quality is raised
+#define kAdaptFramerateStep 5
 
-void _ext_rpi_init(int width, int height, int port) {
+// The camera used by the functions without a camera argument.
+static RPiCamera rpi_default = {
+	.bitrate = kDefaultBitrate,
+	.framerate = kDefaultKeyframeInterval,
+};
+
+RPiCamera* _ext_rpi_camera_create(int width, int height, int port, int bitrate, int framerate) {
 
-	rpi_width = width;
-	rpi_height = height;
-	rpi_port = port;
+	RPiCamera *camera = calloc(1, sizeof(RPiCamera));
 
+	camera->width = width;
+	camera->height = height;
+	camera->port = port;
+	camera->bitrate = bitrate;
+	camera->framerate = framerate;
+
+	return camera;
 }
 
-void _ext_rpi_init_extended(int width, int height, int port, int bitrate, int framerate) {
+static GstCaps* create_camera_caps(RPiCamera *camera) {
 
-	rpi_width = width;
-	rpi_height = height;
-	rpi_port = port;
-	rpi_bitrate = bitrate;
-	rpi_framerate = framerate;
+	return gst_caps_new_simple("video/x-h264",
+			"stream-format", G_TYPE_STRING, "byte-stream",
+			"width", G_TYPE_INT, camera->width,
+			"height", G_TYPE_INT, camera->height,
+			"level", G_TYPE_STRING, "4",
+			"profile", G_TYPE_STRING, "high",
+			"parsed", G_TYPE_BOOLEAN, false,
+			"framerate", GST_TYPE_FRACTION, camera->framerate, 1,
+			NULL);
+}
+
+static void set_bitrate(RPiCamera *camera, int bitrate) {
+
+	bitrate = CLAMP(bitrate, camera->min_bitrate, camera->max_bitrate);
 
+	if (bitrate != camera->bitrate) {
+
+		g_message("libr2rpicamera: bitrate %d -> %d", camera->bitrate, bitrate);
+		camera->bitrate = bitrate;
+
+		// Applied by the encoder on the fly.
+		g_object_set(G_OBJECT(camera->src), "bitrate", bitrate, NULL);
+	}
 }
 
-static gboolean rpi_message_cb(GstBus * bus, GstMessage * message, gpointer user_data) {
+static void set_framerate(RPiCamera *camera, int framerate) {
 
-  switch(GST_MESSAGE_TYPE(message)) {
+	framerate = CLAMP(framerate, camera->min_framerate, camera->max_framerate);
 
-    case GST_MESSAGE_ERROR:{
+	if (framerate != camera->framerate) {
 
-      GError *err = NULL;
-      gchar *name, *debug = NULL;
+		g_message("libr2rpicamera: framerate %d -> %d", camera->framerate, framerate);
+		camera->framerate = framerate;
 
-      name = gst_object_get_path_string(message->src);
-      gst_message_parse_error(message, &err, &debug);
+		// The new caps make rpicamsrc renegotiate its output.
+		GstCaps *caps = create_camera_caps(camera);
+		g_object_set(G_OBJECT(camera->capsfilter), "caps", caps, NULL);
+		gst_caps_unref(caps);
+	}
+}
 
-      g_printerr("libr2rpicamera ERROR: from element %s: %s\n", name, err->message);
-      if(debug != NULL)
-        g_printerr("Additional debug info:\n%s\n", debug);
+// Emitted by queue_tcp before it leaks a buffer.
+static void queue_overrun(GstElement *queue, gpointer user_data) {
 
-      g_error_free(err);
-      g_free(debug);
-      g_free(name);
+	RPiCamera *camera = (RPiCamera *)user_data;
 
-      g_main_loop_quit(rpi_loop);
-      break;
+	g_atomic_int_inc(&camera->queue_drops);
+}
 
-    } case GST_MESSAGE_WARNING:{
+// Called on the loop thread every kAdaptIntervalMs. The bitrate is lowered before the framerate, and the framerate is
+// restored before the bitrate, so that the stream stays fluent as long as possible.
+static gboolean adapt_quality(gpointer user_data) {
 
-			GError *err = NULL;
-			gchar *name, *debug = NULL;
+	RPiCamera *camera = (RPiCamera *)user_data;
+	guint clients = 0, backlog = 0;
+	gint drops = g_atomic_int_get(&camera->queue_drops);
 
-			name = gst_object_get_path_string(message->src);
-			gst_message_parse_warning(message, &err, &debug);
+	g_atomic_int_add(&camera->queue_drops, -drops);
 
-			g_printerr("libr2rpicamera WARNING: from element %s: %s\n", name, err->message);
-			if(debug != NULL)
-			g_printerr("Additional debug info:\n%s\n", debug);
+	if (!r2_pipeline_is_running(&camera->base)) {
+		return G_SOURCE_CONTINUE;
+	}
 
-			g_error_free(err);
-			g_free(debug);
-			g_free(name);
-			break;
+	// buffers-queued is the backlog of the slowest client. UDP never backs up, so the RTP output only has the queue drops.
+	if (camera->tcpserversink) {
+		g_object_get(G_OBJECT(camera->tcpserversink), "num-handles", &clients, "buffers-queued", &backlog, NULL);
+	} else {
+		clients = 1;
+	}
+
+	if (clients == 0) {
+		camera->stable_ticks = 0;
+		return G_SOURCE_CONTINUE;
+	}
 
-    } case GST_MESSAGE_EOS:{
+	if (drops > 0 || backlog > (guint)camera->framerate / 2) {
 
-	    rpi_recording = false;
-			rpi_initiated = false;
-			g_main_loop_quit(rpi_loop);
-			gst_element_set_state(rpi_pipeline, GST_STATE_NULL);
-			g_main_loop_unref(rpi_loop);
-			gst_object_unref(rpi_pipeline);
-			break;
+		camera->stable_ticks = 0;
 
+		if (camera->bitrate > camera->min_bitrate) {
+			set_bitrate(camera, camera->bitrate * 3 / 4);
+		} else {
+			set_framerate(camera, camera->framerate - kAdaptFramerateStep);
 		}
 
-    default:
-		break;
+	} else if (backlog <= 1 && ++camera->stable_ticks >= kAdaptStableTicks) {
 
-  }
+		camera->stable_ticks = 0;
 
-  return true;
+		if (camera->framerate < camera->max_framerate) {
+			set_framerate(camera, camera->framerate + kAdaptFramerateStep);
+		} else {
+			set_bitrate(camera, camera->bitrate + MAX((camera->max_bitrate - camera->min_bitrate) / 8, 1));
+		}
+	}
+
+	return G_SOURCE_CONTINUE;
 }
 
-int _ext_rpi_setup() {
+// "host[:port],host[:port]" -> the clients property of multiudpsink. The port of the camera is used if none is given.
+static gchar* create_rtp_clients(const char *hosts, int port) {
+
+	gchar **tokens = g_strsplit(hosts, ",", -1);
+	GString *clients = g_string_new(NULL);
 
-	rpi_recording = false;
-	gst_init(NULL, NULL);
+	for (int i = 0; tokens[i]; i++) {
+
+		gchar *host = g_strstrip(tokens[i]);
+
+		if (!*host) {
+			continue;
+		}
+
+		if (clients->len) {
+			g_string_append_c(clients, ',');
+		}
+
+		if (strchr(host, ':')) {
+			g_string_append(clients, host);
+		} else {
+			g_string_append_printf(clients, "%s:%d", host, port);
+		}
+	}
+
+	g_strfreev(tokens);
+
+	return g_string_free(clients, false);
+}
+
+static bool rpi_message_cb(R2Pipeline *p, GstMessage *message) {
+
+	RPiCamera *camera = (RPiCamera *)p;
+
+	if (GST_MESSAGE_TYPE(message) == GST_MESSAGE_EOS || GST_MESSAGE_TYPE(message) == GST_MESSAGE_ERROR) {
+
+		// The pipeline has to be set up again before the next start.
+		camera->recording = false;
+		camera->initiated = false;
+
+	}
+
+	return false;
+}
+
+int _ext_rpi_camera_setup(RPiCamera *camera) {
+
+	camera->recording = false;
+
+	// Setting up again replaces the previous pipeline
+	r2_loop_remove_watch(camera->controller);
+	camera->controller = NULL;
+	r2_pipeline_dispose(&camera->base);
+
+	if (!r2_pipeline_init(&camera->base, "libr2rpicamera", rpi_message_cb)) {
+		return -1;
+	}
 
 	GstCaps *camera_caps;
 
-	rpi_pipeline = gst_pipeline_new(NULL);
-	rpi_src = gst_element_factory_make("rpicamsrc", NULL);
-	rpi_tcpserversink = gst_element_factory_make("tcpserversink", NULL);
-	rpi_queue_tcp = gst_element_factory_make("queue", "queue_tcp");
+	camera->src = gst_element_factory_make("rpicamsrc", NULL);
+	camera->capsfilter = gst_element_factory_make("capsfilter", NULL);
+	camera->queue_tcp = gst_element_factory_make("queue", "queue_tcp");
+	camera->tcpserversink = camera->parser = camera->payloader = camera->udpsink = NULL;
+
+	if (camera->rtp_hosts) {
+		camera->parser = gst_element_factory_make("h264parse", NULL);
+		camera->payloader = gst_element_factory_make("rtph264pay", NULL);
+		camera->udpsink = gst_element_factory_make("multiudpsink", NULL);
+	} else {
+		camera->tcpserversink = gst_element_factory_make("tcpserversink", NULL);
+	}
 
-	if(!rpi_pipeline || !rpi_src || !rpi_tcpserversink || !rpi_queue_tcp) {
+	if(!camera->src || !camera->capsfilter || !camera->queue_tcp ||
+		(camera->rtp_hosts ? !camera->parser || !camera->payloader || !camera->udpsink : !camera->tcpserversink)) {
 		g_error("Failed to create one or more elements");
 		return -1;
 	}
 
 	// Set up properties ---
-	g_object_set(G_OBJECT(rpi_src), "inline-headers", true, NULL);
-	g_object_set(G_OBJECT(rpi_src), "preview", false, NULL);
-	g_object_set(G_OBJECT(rpi_src), "bitrate", rpi_bitrate, NULL);
-	g_object_set(G_OBJECT(rpi_src), "keyframe-interval", kDefaultKeyframeInterval, NULL);
+	g_object_set(G_OBJECT(camera->src), "inline-headers", true, NULL);
+	g_object_set(G_OBJECT(camera->src), "preview", false, NULL);
+	g_object_set(G_OBJECT(camera->src), "bitrate", camera->bitrate, NULL);
+	g_object_set(G_OBJECT(camera->src), "keyframe-interval", kDefaultKeyframeInterval, NULL);
 
-	g_object_set(G_OBJECT(rpi_tcpserversink), "port", rpi_port, NULL);
-	g_object_set(G_OBJECT(rpi_tcpserversink), "host", "0.0.0.0", NULL);
-	g_object_set(G_OBJECT(rpi_queue_tcp), "leaky", 2, NULL);
+	if (camera->rtp_hosts) {
 
-	// Set up caps ---
-	camera_caps =  gst_caps_new_simple("video/x-h264",
-			"stream-format", G_TYPE_STRING, "byte-stream",
-			"width", G_TYPE_INT, rpi_width,
-			"height", G_TYPE_INT, rpi_height,
-			"level", G_TYPE_STRING, "4",
-			"profile", G_TYPE_STRING, "high",
-			"parsed", G_TYPE_BOOLEAN, false,
-			"framerate", GST_TYPE_FRACTION, rpi_framerate, 1,
-			NULL);
+		// SPS/PPS are repeated with every keyframe, so that receivers can join at any time.
+		g_object_set(G_OBJECT(camera->parser), "config-interval", -1, NULL);
+		g_object_set(G_OBJECT(camera->payloader), "config-interval", -1, NULL);
+		g_object_set(G_OBJECT(camera->payloader), "pt", kRtpPayloadType, NULL);
+
+		gchar *clients = create_rtp_clients(camera->rtp_hosts, camera->port);
+		g_object_set(G_OBJECT(camera->udpsink), "clients", clients, NULL);
+		g_object_set(G_OBJECT(camera->udpsink), "sync", false, NULL);
+		g_message("libr2rpicamera: Streaming RTP to %s", clients);
+		g_free(clients);
+
+	} else {
+
+		g_object_set(G_OBJECT(camera->tcpserversink), "port", camera->port, NULL);
+		g_object_set(G_OBJECT(camera->tcpserversink), "host", "0.0.0.0", NULL);
+	}
+
+	g_object_set(G_OBJECT(camera->queue_tcp), "leaky", 2, NULL);
+
+	// Set up caps (in a capsfilter, so that the framerate can be changed while streaming) ---
+	camera_caps = create_camera_caps(camera);
+	g_object_set(G_OBJECT(camera->capsfilter), "caps", camera_caps, NULL);
+	gst_caps_unref(camera_caps);
 
 	// Combine pipeline
 
-	gst_bin_add_many(GST_BIN(rpi_pipeline), rpi_src, rpi_queue_tcp, rpi_tcpserversink, NULL);
+	gst_bin_add_many(GST_BIN(camera->base.pipeline), camera->src, camera->capsfilter, camera->queue_tcp, NULL);
 
-	if(!gst_element_link_filtered(rpi_src, rpi_queue_tcp, camera_caps)) {
-		gst_object_unref(rpi_pipeline);
+	if(!gst_element_link(camera->src, camera->capsfilter) || !gst_element_link(camera->capsfilter, camera->queue_tcp)) {
 		g_critical("Unable to link rpi_src to queue");
 		return -2;
 	}
 
-	if(!gst_element_link_many(rpi_queue_tcp, rpi_tcpserversink, NULL)) {
-		g_error("Failed to link to tcpserversink");
-		return -4;
-	}
+	if (camera->rtp_hosts) {
 
-	rpi_loop = g_main_loop_new(NULL, false);
+		gst_bin_add_many(GST_BIN(camera->base.pipeline), camera->parser, camera->payloader, camera->udpsink, NULL);
+
+		if(!gst_element_link_many(camera->queue_tcp, camera->parser, camera->payloader, camera->udpsink, NULL)) {
+			g_error("Failed to link to multiudpsink");
+			return -4;
+		}
+
+	} else {
+
+		gst_bin_add(GST_BIN(camera->base.pipeline), camera->tcpserversink);
+
+		if(!gst_element_link_many(camera->queue_tcp, camera->tcpserversink, NULL)) {
+			g_error("Failed to link to tcpserversink");
+			return -4;
+		}
+	}
 
-	rpi_bus = gst_pipeline_get_bus(GST_PIPELINE(rpi_pipeline));
-	gst_bus_add_signal_watch(rpi_bus);
-	g_signal_connect(G_OBJECT(rpi_bus), "message", G_CALLBACK(rpi_message_cb), NULL);
-	gst_object_unref(GST_OBJECT(rpi_bus));
+	if (camera->adaptive) {
+		camera->queue_drops = 0;
+		camera->stable_ticks = 0;
+		g_signal_connect(camera->queue_tcp, "overrun", G_CALLBACK(queue_overrun), camera);
+		camera->controller = r2_loop_add_timeout(kAdaptIntervalMs, adapt_quality, camera);
+	}
 
-	rpi_initiated = true;
+	camera->initiated = true;
 	return 0;
 
 }
 
-void _ext_rpi_stop() {
+void _ext_rpi_camera_stop(RPiCamera *camera) {
+
+	r2_pipeline_send_eos(&camera->base);
+
+}
+
+bool _ext_rpi_camera_start(RPiCamera *camera) {
+
+	// Cleared by the EOS handler
+	camera->recording = true;
+
+	if (!r2_pipeline_start(&camera->base)) {
+		camera->recording = false;
+		return false;
+	}
+
+	return true;
+
+}
+
+void _ext_rpi_camera_destroy(RPiCamera *camera) {
+
+	r2_loop_remove_watch(camera->controller);
+	r2_pipeline_dispose(&camera->base);
+	g_free(camera->rtp_hosts);
+	free(camera);
+
+}
+
+bool _ext_rpi_camera_get_initiated(RPiCamera *camera) { return camera->initiated; }
+bool _ext_rpi_camera_get_recording(RPiCamera *camera) { return camera->recording; }
+int _ext_rpi_camera_get_bitrate(RPiCamera *camera) { return camera->bitrate; }
+int _ext_rpi_camera_get_framerate(RPiCamera *camera) { return camera->framerate; }
+
+void _ext_rpi_camera_set_rtp_output(RPiCamera *camera, const char *hosts) {
+
+	g_free(camera->rtp_hosts);
+	camera->rtp_hosts = hosts && *hosts ? g_strdup(hosts) : NULL;
+}
+
+bool _ext_rpi_camera_set_adaptive(RPiCamera *camera, int min_bitrate, int max_bitrate, int min_framerate, int max_framerate) {
+
+	if (min_bitrate <= 0 || min_bitrate > max_bitrate || min_framerate <= 0 || min_framerate > max_framerate) {
+		g_critical("libr2rpicamera: Invalid adaptive bounds (bitrate %d-%d, framerate %d-%d).",
+			min_bitrate, max_bitrate, min_framerate, max_framerate);
+		return false;
+	}
+
+	camera->adaptive = true;
+	camera->min_bitrate = min_bitrate;
+	camera->max_bitrate = max_bitrate;
+	camera->min_framerate = min_framerate;
+	camera->max_framerate = max_framerate;
+
+	// Starts at the configured quality, within the bounds.
+	camera->bitrate = CLAMP(camera->bitrate, min_bitrate, max_bitrate);
+	camera->framerate = CLAMP(camera->framerate, min_framerate, max_framerate);
+
+	return true;
+}
+
+void _ext_rpi_init(int width, int height, int port) {
+
+	rpi_default.width = width;
+	rpi_default.height = height;
+	rpi_default.port = port;
+
+}
+
+void _ext_rpi_init_extended(int width, int height, int port, int bitrate, int framerate) {
+
+	rpi_default.width = width;
+	rpi_default.height = height;
+	rpi_default.port = port;
+	rpi_default.bitrate = bitrate;
+	rpi_default.framerate = framerate;
+
+}
 
-	gst_element_send_event(rpi_pipeline, gst_event_new_eos());
+void _ext_rpi_set_rtp_output(const char *hosts) {
+	_ext_rpi_camera_set_rtp_output(&rpi_default, hosts);
+}
 
+bool _ext_rpi_set_adaptive(int min_bitrate, int max_bitrate, int min_framerate, int max_framerate) {
+	return _ext_rpi_camera_set_adaptive(&rpi_default, min_bitrate, max_bitrate, min_framerate, max_framerate);
 }
 
+int _ext_rpi_setup() { return _ext_rpi_camera_setup(&rpi_default); }
+void _ext_rpi_stop() { _ext_rpi_camera_stop(&rpi_default); }
+bool _ext_rpi_start_async() { return _ext_rpi_camera_start(&rpi_default); }
+
 void _ext_rpi_start() {
 
-	gst_element_set_state(rpi_pipeline, GST_STATE_PLAYING);
-	rpi_recording = true;
-	g_main_loop_run(rpi_loop);
-	rpi_recording = false;
-	rpi_initiated = false;
+	if (_ext_rpi_camera_start(&rpi_default)) {
+		r2_pipeline_wait(&rpi_default.base);
+	}
 
 }
 
-int _ext_rpi_get_framerate() { return rpi_framerate; }
-int _ext_rpi_get_width() { return rpi_width; }
-int _ext_rpi_get_height() { return rpi_height; }
-bool _ext_rpi_get_initiated() { return rpi_initiated; }
-bool _ext_rpi_get_recording() { return rpi_recording; }
+int _ext_rpi_get_framerate() { return rpi_default.framerate; }
+int _ext_rpi_get_bitrate() { return rpi_default.bitrate; }
+int _ext_rpi_get_width() { return rpi_default.width; }
+int _ext_rpi_get_height() { return rpi_default.height; }
+bool _ext_rpi_get_initiated() { return rpi_default.initiated; }
+bool _ext_rpi_get_recording() { return rpi_default.recording; }
 
 int main(int argc, char *argv[]) {
 
 	_ext_rpi_init(640, 480, 4444);
 
+	// i.e. r2picam 239.0.0.1 streams RTP to a multicast group instead of serving TCP clients
+	if (argc > 1) {
+		_ext_rpi_set_rtp_output(argv[1]);
+	}
+
 	int setupResult = _ext_rpi_setup(); 
 
 	if(setupResult < 0) {
@@ -217,4 +429,4 @@ int main(int argc, char *argv[]) {
 	_ext_rpi_start();	
 
 	return 0;
-}
\ No newline at end of file
+}
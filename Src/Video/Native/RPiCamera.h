@@ -17,16 +17,68 @@
 // 
 
 #include <stdbool.h>
+#include "R2Pipeline.h"
 
+// One Pi camera streaming H.264 through a tcpserversink (one copy of the stream per client), or as RTP to a multicast
+// group or a list of hosts (one copy per destination, regardless of the number of viewers).
+typedef struct {
+	R2Pipeline base;
+	GstElement *src, *capsfilter, *queue_tcp, *tcpserversink;
+	GstElement *parser, *payloader, *udpsink;	// RTP output only
+	char *rtp_hosts;		// NULL for the TCP output
+
+	int bitrate;			// bit/s. Follows the bandwidth of the clients if adaptive
+	int framerate;
+	int width;
+	int height;
+	int port;
+	bool initiated;
+	bool recording;
+
+	// Adaptive streaming (see _ext_rpi_camera_set_adaptive)
+	bool adaptive;
+	int min_bitrate, max_bitrate;
+	int min_framerate, max_framerate;
+	GSource *controller;		// the timer adjusting the quality on the shared loop thread
+	gint queue_drops;		// buffers leaked by queue_tcp since the last adjustment
+	int stable_ticks;		// adjustments without congestion
+} RPiCamera;
+
+// Functions using a camera instance:
+
+RPiCamera* _ext_rpi_camera_create(int width, int height, int port, int bitrate, int framerate);
+int _ext_rpi_camera_setup(RPiCamera *camera);
+// Starts streaming and returns. The bus is handled by the shared loop thread.
+bool _ext_rpi_camera_start(RPiCamera *camera);
+void _ext_rpi_camera_stop(RPiCamera *camera);
+void _ext_rpi_camera_destroy(RPiCamera *camera);
+bool _ext_rpi_camera_get_initiated(RPiCamera *camera);
+bool _ext_rpi_camera_get_recording(RPiCamera *camera);
+// Streams RTP (payload type 96) to hosts instead of serving TCP clients: a multicast group (i.e. "239.0.0.1") or a comma
+// separated list of "host[:port]" (the port of the camera is used if none is given). NULL restores the TCP output.
+// Must be called before the setup.
+void _ext_rpi_camera_set_rtp_output(RPiCamera *camera, const char *hosts);
+// Lets the bitrate and framerate follow the bandwidth of the clients within the bounds: they are lowered when the clients
+// fall behind or the queue leaks and raised again when the stream has been stable. Must be called before the setup.
+bool _ext_rpi_camera_set_adaptive(RPiCamera *camera, int min_bitrate, int max_bitrate, int min_framerate, int max_framerate);
+int _ext_rpi_camera_get_bitrate(RPiCamera *camera);
+int _ext_rpi_camera_get_framerate(RPiCamera *camera);
+
+// Functions using the default camera:
+
+// Streams until the camera is stopped (blocks).
 void _ext_rpi_start();
+bool _ext_rpi_start_async();
 void _ext_rpi_stop();
 int _ext_rpi_setup();
 void _ext_rpi_init(int width, int height, int port);
 void _ext_rpi_init_extended(int width, int height, int port, int bitrate, int framerate);
+void _ext_rpi_set_rtp_output(const char *hosts);
+bool _ext_rpi_set_adaptive(int min_bitrate, int max_bitrate, int min_framerate, int max_framerate);
 
 int _ext_rpi_get_framerate();
+int _ext_rpi_get_bitrate();
 int _ext_rpi_get_width();
 int _ext_rpi_get_height();
 bool _ext_rpi_get_initiated();
 bool _ext_rpi_get_recording();
-
@@ -20,16 +20,11 @@
 #include <string.h>
 #include <stdlib.h>
 
-static GMainLoop *rpir_loop;
-static GstElement *rpir_pipeline, *rpir_src, *rpir_queue_tcp, *rpir_filesink;
-static GstBus *rpir_bus;
+// Bounds the memory of the pre-event buffer, whatever its duration
+#define kPreEventMaxBytes (64 * 1024 * 1024)
 
-static int rpir_port;
-static bool rpir_initiated = false;
-static bool rpir_recording = false;
-static const char* rpir_address;
-static const char* rpir_filename;
-static const void*(*rpir_recording_done_callback)(const char *filename);
+// The recorder used by the functions without a recorder argument.
+static RPiRecorder rpir_default;
 
 char *strdupa (const char *s) {
     char *d = malloc (strlen (s) + 1);   // Allocate memory
@@ -38,157 +33,367 @@ char *strdupa (const char *s) {
     return d;                            // Return new memory
 }
 
-void _ext_rpir_init(int port, const char *address) {
+RPiRecorder* _ext_rpir_recorder_create(int port, const char *address) {
+
+	RPiRecorder *recorder = calloc(1, sizeof(RPiRecorder));
 
-	rpir_address = strdupa(address);
-	rpir_port = port;
+	recorder->address = strdupa(address);
+	recorder->port = port;
 
+	return recorder;
 }
 
-static gboolean
-rpir_message_cb (GstBus * bus, GstMessage * message, gpointer user_data)
+static bool rpir_message_cb (R2Pipeline *p, GstMessage *message)
 {
-  switch (GST_MESSAGE_TYPE (message)) {
-    case GST_MESSAGE_ERROR:{
-    	
-      GError *err = NULL;
-      gchar *name, *debug = NULL;
-
-      name = gst_object_get_path_string (message->src);
-      gst_message_parse_error (message, &err, &debug);
-
-      g_printerr ("libr2rpicamerarecorder ERROR: from element %s: %s\n", name, err->message);
-      if (debug != NULL)
-        g_printerr ("Additional debug info:\n%s\n", debug);
+	RPiRecorder *recorder = (RPiRecorder *)p;
 
-      g_error_free (err);
-      g_free (debug);
-      g_free (name);
+	if (GST_MESSAGE_TYPE (message) == GST_MESSAGE_EOS) {
 
-      g_main_loop_quit (rpir_loop);
-      break;
-    }
-    case GST_MESSAGE_WARNING:{
+		recorder->recording = false;
+		recorder->initiated = false;
 
-		GError *err = NULL;
-		gchar *name, *debug = NULL;
+		// The segments are reported when they are closed.
+		if (recorder->recording_done_callback && !recorder->splitmuxsink) {
 
-		name = gst_object_get_path_string (message->src);
-		gst_message_parse_warning (message, &err, &debug);
+			recorder->recording_done_callback(recorder->filename);
 
-		g_printerr ("libr2rpicamerarecorder WARNING: from element %s: %s\n", name, err->message);
-		if (debug != NULL)
-		g_printerr ("Additional debug info:\n%s\n", debug);
+		}
 
-		g_error_free (err);
-		g_free (debug);
-		g_free (name);
-		break;
+	} else if (GST_MESSAGE_TYPE (message) == GST_MESSAGE_ERROR) {
 
-    } case GST_MESSAGE_EOS:{
+		recorder->recording = false;
+		recorder->initiated = false;
+		recorder->armed = false;
 
-    	rpir_recording = false;
-		rpir_initiated = false;
+	} else if (GST_MESSAGE_TYPE (message) == GST_MESSAGE_ELEMENT &&
+		gst_message_has_name(message, "splitmuxsink-fragment-closed")) {
 
-		g_main_loop_quit (rpir_loop);
-		gst_element_set_state (rpir_pipeline, GST_STATE_NULL);
-		g_main_loop_unref (rpir_loop);
-		gst_object_unref (rpir_pipeline);
+		const gchar *location = gst_structure_get_string(gst_message_get_structure(message), "location");
 
-		if (rpir_recording_done_callback) {
+		if (recorder->recording_done_callback && location) {
 
-			rpir_recording_done_callback(rpir_filename);
+			recorder->recording_done_callback(location);
 
 		}
 
-		break;
+		return true;
+
 	}
-    default:
-		break;
-  }
 
-  return TRUE;
+	return false;
 }
 
-int rpir_setup(const char* filename) {
+int rpir_setup(RPiRecorder *recorder, const char* filename) {
 
-	rpir_filename = strdupa(filename);
-	rpir_recording = false;
-	gst_init (NULL, NULL);
+	if (!filename) {
+		g_error("No filename set");
+		return -42;
+	}
+
+	free(recorder->filename);
+	recorder->filename = strdupa(filename);
+	recorder->recording = false;
+	recorder->armed = false;
 
-	rpir_pipeline = gst_pipeline_new(NULL);
-	rpir_src = gst_element_factory_make("tcpclientsrc", NULL);
-	rpir_filesink = gst_element_factory_make("filesink", NULL);
-	rpir_queue_tcp = gst_element_factory_make("queue", "queue_tcp");
+	// Each recording uses a new pipeline
+	r2_pipeline_dispose(&recorder->base);
 
-	if (!rpir_pipeline || !rpir_src || !rpir_filesink || !rpir_queue_tcp) {
+	if (!r2_pipeline_init(&recorder->base, "libr2rpicamerarecorder", rpir_message_cb)) {
+		return -1;
+	}
+
+	recorder->parser = recorder->splitmuxsink = NULL;
+	recorder->src = gst_element_factory_make("tcpclientsrc", NULL);
+	recorder->filesink = gst_element_factory_make("filesink", NULL);
+	recorder->queue_tcp = gst_element_factory_make("queue", "queue_tcp");
+
+	if (!recorder->src || !recorder->filesink || !recorder->queue_tcp) {
 		g_error("Failed to create one or more elements");
 		return -1;
 	}
 
-	if (!rpir_filename) {
-		g_error("No filename set");
+	// Set up properties ---
+	g_object_set(G_OBJECT(recorder->filesink), "location", recorder->filename, NULL);
+	g_object_set(G_OBJECT(recorder->src), "port", recorder->port, NULL);
+	g_object_set(G_OBJECT(recorder->src), "host", recorder->address, NULL);
+
+	gst_bin_add_many(GST_BIN(recorder->base.pipeline), recorder->src, recorder->queue_tcp, recorder->filesink, NULL);
+
+	if (!gst_element_link_many(recorder->src, recorder->queue_tcp, recorder->filesink, NULL)) {
+		g_error("Failed to link to tcpserversink");
+		return -4;
+	}
+
+	recorder->initiated = true;
+	return 0;
+}
+
+// Holds the buffers in the pre-event queue, which leaks the oldest ones.
+static GstPadProbeReturn hold_buffers(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+
+	return GST_PAD_PROBE_OK;
+
+}
+
+// The file starts at the first keyframe of the pre-event window: older buffers (i.e. the one held since the recorder was
+// armed) and the frames that are not decodable on their own are dropped.
+static GstPadProbeReturn drop_until_keyframe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+
+	RPiRecorder *recorder = (RPiRecorder *)user_data;
+	GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+
+	if (GST_BUFFER_PTS(buffer) != GST_CLOCK_TIME_NONE && GST_BUFFER_PTS(buffer) < recorder->window_start) {
+
+		return GST_PAD_PROBE_DROP;
+
+	}
+
+	if (GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT)) {
+
+		return GST_PAD_PROBE_DROP;
+
+	}
+
+	return GST_PAD_PROBE_REMOVE;
+
+}
+
+static int rpir_setup_pre_event(RPiRecorder *recorder, const char* location, int pre_event_seconds, int segment_seconds) {
+
+	if (!location || pre_event_seconds <= 0 || segment_seconds <= 0) {
+		g_critical("Invalid pre-event recording (location: %s, pre-event: %d s, segments: %d s)",
+			location ? location : "", pre_event_seconds, segment_seconds);
 		return -42;
 	}
 
+	free(recorder->filename);
+	recorder->filename = strdupa(location);
+	recorder->recording = false;
+	recorder->armed = false;
+	recorder->pre_event = (GstClockTime)pre_event_seconds * GST_SECOND;
+	recorder->window_start = 0;
+
+	r2_pipeline_dispose(&recorder->base);
+
+	if (!r2_pipeline_init(&recorder->base, "libr2rpicamerarecorder", rpir_message_cb)) {
+		return -1;
+	}
+
+	recorder->filesink = NULL;
+	recorder->src = gst_element_factory_make("tcpclientsrc", NULL);
+	GstElement *capsfilter = gst_element_factory_make("capsfilter", NULL);
+	recorder->parser = gst_element_factory_make("h264parse", NULL);
+	recorder->queue_tcp = gst_element_factory_make("queue", "queue_tcp");
+	recorder->splitmuxsink = gst_element_factory_make("splitmuxsink", NULL);
+	GstElement *muxer = gst_element_factory_make("matroskamux", NULL);
+	GstElement *segment_sink = gst_element_factory_make("filesink", NULL);
+
+	if (!recorder->src || !capsfilter || !recorder->parser || !recorder->queue_tcp || !recorder->splitmuxsink || !muxer ||
+		!segment_sink) {
+		g_error("Failed to create one or more elements");
+		return -1;
+	}
+
 	// Set up properties ---
-	g_object_set(G_OBJECT(rpir_filesink), "location", rpir_filename, NULL);
-	g_object_set(G_OBJECT(rpir_src), "port", rpir_port, NULL);
-	g_object_set(G_OBJECT(rpir_src), "host", rpir_address, NULL);
+	g_object_set(G_OBJECT(recorder->src), "port", recorder->port, NULL);
+	g_object_set(G_OBJECT(recorder->src), "host", recorder->address, NULL);
+	// The camera stream has no timestamps, and the queue is limited by time.
+	g_object_set(G_OBJECT(recorder->src), "do-timestamp", true, NULL);
 
-	gst_bin_add_many(GST_BIN(rpir_pipeline), rpir_src, rpir_queue_tcp, rpir_filesink, NULL);
+	GstCaps *caps = gst_caps_new_simple("video/x-h264", "stream-format", G_TYPE_STRING, "byte-stream", NULL);
+	g_object_set(G_OBJECT(capsfilter), "caps", caps, NULL);
+	gst_caps_unref(caps);
 
-	if (!gst_element_link_many(rpir_src, rpir_queue_tcp, rpir_filesink, NULL)) {
-		g_error("Failed to link to tcpserversink");
+	// Marks the keyframes (and repeats SPS/PPS in front of them).
+	g_object_set(G_OBJECT(recorder->parser), "config-interval", -1, NULL);
+
+	g_object_set(G_OBJECT(recorder->queue_tcp), "leaky", 2, NULL);
+	g_object_set(G_OBJECT(recorder->queue_tcp), "max-size-buffers", 0, NULL);
+	g_object_set(G_OBJECT(recorder->queue_tcp), "max-size-bytes", kPreEventMaxBytes, NULL);
+	g_object_set(G_OBJECT(recorder->queue_tcp), "max-size-time", recorder->pre_event, NULL);
+
+	// The sink can't preroll while the buffers are held. Without async=false the pipeline would never reach PLAYING, and
+	// without a running clock do-timestamp has nothing to stamp the buffers with.
+	g_object_set(G_OBJECT(segment_sink), "async", false, NULL);
+
+	g_object_set(G_OBJECT(recorder->splitmuxsink), "location", recorder->filename, NULL);
+	g_object_set(G_OBJECT(recorder->splitmuxsink), "max-size-time", (guint64)segment_seconds * GST_SECOND, NULL);
+	g_object_set(G_OBJECT(recorder->splitmuxsink), "muxer", muxer, NULL);
+	g_object_set(G_OBJECT(recorder->splitmuxsink), "sink", segment_sink, NULL);
+
+	gst_bin_add_many(GST_BIN(recorder->base.pipeline), recorder->src, capsfilter, recorder->parser, recorder->queue_tcp,
+		recorder->splitmuxsink, NULL);
+
+	if (!gst_element_link_many(recorder->src, capsfilter, recorder->parser, recorder->queue_tcp, recorder->splitmuxsink, NULL)) {
+		g_error("Failed to link to splitmuxsink");
 		return -4;
 	}
 
-	rpir_loop = g_main_loop_new(NULL, FALSE);
+	// Only the buffers are held, so that a stop can still pass.
+	GstPad *pad = gst_element_get_static_pad(recorder->queue_tcp, "src");
+	recorder->hold_probe = gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BLOCK | GST_PAD_PROBE_TYPE_BUFFER, hold_buffers, NULL, NULL);
+	gst_object_unref(pad);
 
-	rpir_bus = gst_pipeline_get_bus(GST_PIPELINE (rpir_pipeline));
-	gst_bus_add_signal_watch(rpir_bus);
-	g_signal_connect(G_OBJECT(rpir_bus), "message", G_CALLBACK(rpir_message_cb), NULL);
-	gst_object_unref(GST_OBJECT(rpir_bus));
+	recorder->initiated = true;
+	return 0;
+}
+
+int _ext_rpir_recorder_arm(RPiRecorder *recorder, const char* location, int pre_event_seconds, int segment_seconds,
+	const void*(*recording_done_callback)(const char *location)) {
+
+	recorder->recording_done_callback = recording_done_callback;
+	int status = rpir_setup_pre_event(recorder, location, pre_event_seconds, segment_seconds);
+	if (status != 0) {
+		return status;
+	}
+
+	// Cleared by the trigger
+	recorder->armed = true;
+
+	if (!r2_pipeline_start(&recorder->base)) {
+		recorder->armed = false;
+		return -5;
+	}
 
-	rpir_initiated = true;
 	return 0;
 }
 
-void _ext_rpir_stop() {
+// Called on the loop thread, so that the trigger never runs at the same time as the error handler.
+static gboolean trigger_on_loop(gpointer user_data) {
 
-	if (rpir_recording) {
+	RPiRecorder *recorder = (RPiRecorder *)user_data;
 
-		gst_element_send_event(rpir_pipeline, gst_event_new_eos());
-	
+	if (!recorder->armed) {
+		return G_SOURCE_REMOVE;
+	}
+
+	GstElement *pipeline = recorder->base.pipeline;
+	GstClock *clock = gst_element_get_clock(pipeline);
+
+	// The buffers are timestamped with the running time of the pipeline when they were received.
+	if (clock) {
+
+		GstClockTime now = gst_clock_get_time(clock) - gst_element_get_base_time(pipeline);
+		recorder->window_start = now > recorder->pre_event ? now - recorder->pre_event : 0;
+		gst_object_unref(clock);
+
+	}
+
+	GstPad *pad = gst_element_get_static_pad(recorder->queue_tcp, "src");
+	GstPad *sink_pad = gst_pad_get_peer(pad);
+
+	// On the sink side, so that it also sees the buffer that has been held at the src pad since the recorder was armed.
+	gst_pad_add_probe(sink_pad, GST_PAD_PROBE_TYPE_BUFFER, drop_until_keyframe, recorder, NULL);
+	gst_pad_remove_probe(pad, recorder->hold_probe);
+	gst_object_unref(sink_pad);
+	gst_object_unref(pad);
+
+	recorder->hold_probe = 0;
+	recorder->armed = false;
+	recorder->recording = true;
+
+	return G_SOURCE_REMOVE;
+}
+
+bool _ext_rpir_recorder_trigger(RPiRecorder *recorder) {
+
+	if (!recorder->armed) {
+		g_critical("Unable to trigger recording: the recorder is not armed.");
+		return false;
 	}
 
+	r2_loop_invoke_sync(trigger_on_loop, recorder);
+
+	return recorder->recording;
 }
 
-const char* _ext_rpir_get_filename() {
+void _ext_rpir_recorder_stop(RPiRecorder *recorder) {
 
-	return rpir_filename;
+	if (recorder->recording) {
+
+		r2_pipeline_send_eos(&recorder->base);
+	
+	} else if (recorder->armed) {
+
+		// Nothing has been written. Stopping releases the held buffers.
+		recorder->armed = false;
+		recorder->initiated = false;
+		r2_pipeline_stop(&recorder->base);
+
+	}
 
 }
 
-int _ext_rpir_record(const char* filename, const void*(*recording_done_callback)(const char *filename)) {
+int _ext_rpir_recorder_record(RPiRecorder *recorder, const char* filename, const void*(*recording_done_callback)(const char *filename)) {
 
-	rpir_recording_done_callback = recording_done_callback;
-	int status = rpir_setup(filename);
+	recorder->recording_done_callback = recording_done_callback;
+	int status = rpir_setup(recorder, filename);
 	if (status != 0) {
 		return status;
 	}
 	
-	gst_element_set_state(rpir_pipeline, GST_STATE_PLAYING);
-	rpir_recording = true;
-	g_main_loop_run(rpir_loop);
-	rpir_recording = false;
-	rpir_initiated = false;
+	// Cleared by the EOS handler
+	recorder->recording = true;
+
+	if (!r2_pipeline_start(&recorder->base)) {
+		recorder->recording = false;
+		return -5;
+	}
 
 	return 0;
 }
 
-bool _ext_rpir_get_initiated() { return rpir_initiated; }
-bool _ext_rpir_get_recording() { return rpir_recording; }
+void _ext_rpir_recorder_destroy(RPiRecorder *recorder) {
+
+	r2_pipeline_dispose(&recorder->base);
+	free(recorder->address);
+	free(recorder->filename);
+	free(recorder);
+
+}
+
+const char* _ext_rpir_recorder_get_filename(RPiRecorder *recorder) { return recorder->filename; }
+bool _ext_rpir_recorder_get_recording(RPiRecorder *recorder) { return recorder->recording; }
+
+void _ext_rpir_init(int port, const char *address) {
+
+	free(rpir_default.address);
+	rpir_default.address = strdupa(address);
+	rpir_default.port = port;
+
+}
+
+void _ext_rpir_stop() { _ext_rpir_recorder_stop(&rpir_default); }
+bool _ext_rpir_trigger() { return _ext_rpir_recorder_trigger(&rpir_default); }
+
+int _ext_rpir_arm(const char* location, int pre_event_seconds, int segment_seconds,
+	const void*(*recording_done_callback)(const char *location)) {
+
+	return _ext_rpir_recorder_arm(&rpir_default, location, pre_event_seconds, segment_seconds, recording_done_callback);
+
+}
+const char* _ext_rpir_get_filename() { return rpir_default.filename; }
+
+int _ext_rpir_record(const char* filename, const void*(*recording_done_callback)(const char *filename)) {
+
+	int status = _ext_rpir_recorder_record(&rpir_default, filename, recording_done_callback);
+
+	if (status == 0) {
+		r2_pipeline_wait(&rpir_default.base);
+	}
+
+	return status;
+
+}
+
+int _ext_rpir_record_async(const char* filename, const void*(*recording_done_callback)(const char *filename)) {
+
+	return _ext_rpir_recorder_record(&rpir_default, filename, recording_done_callback);
+
+}
+
+bool _ext_rpir_get_initiated() { return rpir_default.initiated; }
+bool _ext_rpir_get_recording() { return rpir_default.recording; }
 
 int main(int argc, char *argv[]) {
 
@@ -201,4 +406,4 @@ int main(int argc, char *argv[]) {
 	} 
 
 	return 0;
-}
\ No newline at end of file
+}
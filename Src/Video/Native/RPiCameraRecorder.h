@@ -17,11 +17,56 @@
 // 
 
 #include <stdbool.h>
+#include "R2Pipeline.h"
+
+// Records the H.264 stream of an RPiCamera to a file, or (pre-event mode) keeps the last seconds of the stream in memory
+// and writes them, followed by the live stream, to fixed-duration segments once triggered.
+typedef struct {
+	R2Pipeline base;
+	GstElement *src, *queue_tcp, *filesink;
+	GstElement *parser, *splitmuxsink;	// pre-event mode only (queue_tcp is the pre-event buffer)
+
+	int port;
+	char *address;
+	char *filename;			// the location pattern of the segments in pre-event mode
+	bool initiated;
+	bool recording;
+	bool armed;			// buffering the pre-event seconds (pre-event mode)
+	gulong hold_probe;		// blocks queue_tcp until the trigger
+	GstClockTime pre_event;		// the duration of the pre-event buffer
+	GstClockTime window_start;	// the running time of the oldest buffer written when triggered
+	const void*(*recording_done_callback)(const char *filename);
+} RPiRecorder;
+
+// Functions using a recorder instance:
+
+RPiRecorder* _ext_rpir_recorder_create(int port, const char *address);
+// Starts recording and returns. recording_done_callback is called from the shared loop thread.
+int _ext_rpir_recorder_record(RPiRecorder *recorder, const char* filename, const void*(*recording_done_callback)(const char *filename));
+void _ext_rpir_recorder_stop(RPiRecorder *recorder);
+// Starts buffering the last pre_event_seconds of the stream in memory, without writing anything. location is a printf
+// pattern for the segment index (i.e. "event_%05d.mkv"). recording_done_callback is called with the location of each
+// segment when it has been closed. Returns 0 on success.
+int _ext_rpir_recorder_arm(RPiRecorder *recorder, const char* location, int pre_event_seconds, int segment_seconds,
+	const void*(*recording_done_callback)(const char *location));
+// Writes the buffered seconds (from their first keyframe within the last pre_event_seconds) and keeps recording until the
+// recorder is stopped.
+bool _ext_rpir_recorder_trigger(RPiRecorder *recorder);
+void _ext_rpir_recorder_destroy(RPiRecorder *recorder);
+const char* _ext_rpir_recorder_get_filename(RPiRecorder *recorder);
+bool _ext_rpir_recorder_get_recording(RPiRecorder *recorder);
+
+// Functions using the default recorder:
 
 const char* _ext_rpir_get_filename();
+// Records until the recorder is stopped (blocks).
 int _ext_rpir_record(const char* filename, const void*(*recording_done_callback)(const char *filename));
+// Starts recording and returns. recording_done_callback is called from the shared loop thread.
+int _ext_rpir_record_async(const char* filename, const void*(*recording_done_callback)(const char *filename));
 void _ext_rpir_stop();
+int _ext_rpir_arm(const char* location, int pre_event_seconds, int segment_seconds,
+	const void*(*recording_done_callback)(const char *location));
+bool _ext_rpir_trigger();
 void _ext_rpir_init(int port, const char *address);
-bool _ext_rpi_get_recording();
-
-
+bool _ext_rpir_get_initiated();
+bool _ext_rpir_get_recording();
@@ -0,0 +1,503 @@
+// This file is part of r2Poject.
+//
+// Copyright 2016 Tord Wessman
+//
+// r2Project is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// r2Project is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with r2Project. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "TeeBranch.h"
+#include "r2gstloop.h"
+#include <stdlib.h>
+#include "gst/app/gstappsink.h"
+
+// The number of raw frames a branch queue holds before it starts dropping the oldest ones.
+#define kBRANCH_QUEUE_SIZE 2
+// The file branch may lag behind a bit more (i.e. while the disk is busy).
+#define kBRANCH_FILE_QUEUE_SIZE 30
+
+struct R2TeeBranch {
+	int type;
+	R2Tee *owner;
+	GstElement *bin;
+	GstElement *sink;
+	GstPad *tee_pad;
+	R2FrameRing *ring;
+	R2MotionDetector *motion;
+	bool removing;
+	bool finalized;
+	// Held by the owner's list and by each pending probe or loop callback.
+	gint refcount;
+};
+
+static R2TeeBranch* branch_ref(R2TeeBranch *b) {
+
+	g_atomic_int_inc(&b->refcount);
+
+	return b;
+}
+
+static void branch_unref(gpointer user_data) {
+
+	R2TeeBranch *b = (R2TeeBranch *)user_data;
+
+	if (g_atomic_int_dec_and_test(&b->refcount)) {
+
+		R2Tee *t = b->owner;
+
+		frame_ring_free(b->ring);
+		motion_detector_free(b->motion);
+		free(b);
+
+		g_mutex_lock(&t->mutex);
+		t->allocated--;
+		g_cond_broadcast(&t->freed);
+		g_mutex_unlock(&t->mutex);
+	}
+}
+
+// Analyses the sample itself rather than the ring, so that every frame is seen once, however long the consumers hold theirs.
+static void detect_motion(R2TeeBranch *b, GstSample *sample) {
+
+	GstBuffer *buffer = gst_sample_get_buffer(sample);
+	GstStructure *structure = gst_caps_get_structure(gst_sample_get_caps(sample), 0);
+	R2Frame frame = { .channels = 1, .timestamp = GST_BUFFER_PTS(buffer) };
+	GstMapInfo map;
+
+	if (!gst_structure_get_int(structure, "width", &frame.width) || !gst_structure_get_int(structure, "height", &frame.height)) {
+		return;
+	}
+
+	if (!gst_buffer_map(buffer, &map, GST_MAP_READ)) {
+		g_critical ("Unable to map buffer.");
+		return;
+	}
+
+	frame.stride = GST_ROUND_UP_4(frame.width);
+	frame.data = map.data;
+
+	if (map.size >= (gsize)(frame.stride * frame.height)) {
+		motion_detector_process(b->motion, &frame);
+	}
+
+	gst_buffer_unmap(buffer, &map);
+}
+
+static GstFlowReturn fetch_branch_frame(GstAppSink *asink, gpointer user_data) {
+
+	R2TeeBranch *b = (R2TeeBranch *)user_data;
+	GstSample *sample = gst_app_sink_pull_sample(asink);
+
+	if (!sample) {
+		return GST_FLOW_OK;
+	}
+
+	// Detected on the streaming thread of the branch: its leaky queue drops frames if the detector can't keep up.
+	if (b->motion) {
+		detect_motion(b, sample);
+	}
+
+	int result = frame_ring_push(b->ring, sample);
+	gst_sample_unref(sample);
+
+	return result == kFRAME_RING_INCOMPATIBLE ? GST_FLOW_CUSTOM_ERROR : GST_FLOW_OK;
+}
+
+// Tries the hardware encoders of the Raspberry Pi before x264enc.
+static GstElement* make_h264_encoder() {
+
+	GstElement *encoder;
+
+	if ((encoder = gst_element_factory_make("v4l2h264enc", NULL))) {
+		return encoder;
+	} else if ((encoder = gst_element_factory_make("omxh264enc", NULL))) {
+		g_object_set(G_OBJECT(encoder), "target-bitrate", kBRANCH_H264_BITRATE * 1000, "control-rate", 1, NULL);
+		return encoder;
+	} else if ((encoder = gst_element_factory_make("x264enc", NULL))) {
+		g_object_set(G_OBJECT(encoder), "bitrate", kBRANCH_H264_BITRATE, NULL);
+		gst_util_set_object_arg(G_OBJECT(encoder), "tune", "zerolatency");
+		gst_util_set_object_arg(G_OBJECT(encoder), "speed-preset", "ultrafast");
+		return encoder;
+	}
+
+	return NULL;
+}
+
+static GstCaps* branch_caps(const char *format, int width, int height) {
+
+	GstCaps *caps = gst_caps_new_empty_simple("video/x-raw");
+
+	if (format) {
+		gst_caps_set_simple(caps, "format", G_TYPE_STRING, format, NULL);
+	}
+
+	if (width > 0 && height > 0) {
+		gst_caps_set_simple(caps, "width", G_TYPE_INT, width, "height", G_TYPE_INT, height, NULL);
+	}
+
+	return caps;
+}
+
+// Creates the elements of a branch in a bin with a ghost "sink" pad. Returns NULL if an element is missing.
+static GstElement* create_branch_bin(R2TeeBranch *b, const char *target, int port, int width, int height) {
+
+	GstElement *bin = gst_bin_new(NULL);
+	GstElement *queue = gst_element_factory_make("queue", NULL);
+	GstElement *convert = gst_element_factory_make("videoconvert", NULL);
+	GstElement *scale = gst_element_factory_make("videoscale", NULL);
+	GstElement *filter = gst_element_factory_make("capsfilter", NULL);
+	GstElement *encoder = NULL, *parser = NULL, *payloader = NULL, *sink = NULL;
+	GstCaps *caps;
+
+	switch (b->type) {
+	case kBRANCH_APPSINK:
+		sink = gst_element_factory_make("appsink", NULL);
+		caps = branch_caps("BGR", width, height);
+		break;
+	case kBRANCH_MOTION:
+		sink = gst_element_factory_make("appsink", NULL);
+		caps = branch_caps("GRAY8", width > 0 ? width : kMOTION_DEFAULT_WIDTH, height > 0 ? height : kMOTION_DEFAULT_HEIGHT);
+		break;
+	case kBRANCH_MJPEG_TCP:
+		encoder = gst_element_factory_make("jpegenc", NULL);
+		payloader = gst_element_factory_make("multipartmux", NULL);
+		sink = gst_element_factory_make("tcpserversink", NULL);
+		caps = branch_caps(NULL, width, height);
+		break;
+	case kBRANCH_H264_RTP:
+		encoder = make_h264_encoder();
+		parser = gst_element_factory_make("h264parse", NULL);
+		payloader = gst_element_factory_make("rtph264pay", NULL);
+		sink = gst_element_factory_make("udpsink", NULL);
+		caps = branch_caps("I420", width, height);
+		break;
+	case kBRANCH_FILE:
+		encoder = make_h264_encoder();
+		parser = gst_element_factory_make("h264parse", NULL);
+		payloader = gst_element_factory_make("matroskamux", NULL);
+		sink = gst_element_factory_make("filesink", NULL);
+		caps = branch_caps("I420", width, height);
+		break;
+	default:
+		g_critical("Unknown branch type: %d", b->type);
+		gst_object_unref(bin);
+		return NULL;
+	}
+
+	g_object_set(G_OBJECT(filter), "caps", caps, NULL);
+	gst_caps_unref(caps);
+
+	// Add what has been created, so that the bin releases it on failure.
+	GstElement *elements[] = { queue, convert, scale, filter, encoder, parser, payloader, sink };
+
+	for (int i = 0; i < G_N_ELEMENTS(elements); i++) {
+		if (elements[i]) {
+			gst_bin_add(GST_BIN(bin), elements[i]);
+		}
+	}
+
+	bool is_appsink = b->type == kBRANCH_APPSINK || b->type == kBRANCH_MOTION;
+	bool needs_encoder = !is_appsink;
+	bool needs_parser = b->type == kBRANCH_H264_RTP || b->type == kBRANCH_FILE;
+
+	if (!queue || !convert || !scale || !filter || !sink || (needs_encoder && (!encoder || !payloader)) || (needs_parser && !parser)) {
+		g_critical("Unable to create the elements of branch type %d.", b->type);
+		gst_object_unref(bin);
+		return NULL;
+	}
+
+	b->sink = sink;
+
+	// A branch drops frames instead of blocking the tee (and thereby the other branches).
+	g_object_set(G_OBJECT(queue), "leaky", 2, "max-size-bytes", 0, "max-size-time", (guint64)0,
+		"max-size-buffers", b->type == kBRANCH_FILE ? kBRANCH_FILE_QUEUE_SIZE : kBRANCH_QUEUE_SIZE, NULL);
+
+	switch (b->type) {
+	case kBRANCH_APPSINK:
+	case kBRANCH_MOTION:
+		gst_app_sink_set_emit_signals((GstAppSink*)sink, true);
+		gst_app_sink_set_drop((GstAppSink*)sink, true);
+		gst_app_sink_set_max_buffers((GstAppSink*)sink, 1);
+		g_object_set(G_OBJECT(sink), "sync", false, NULL);
+		g_signal_connect(sink, "new-sample", G_CALLBACK(fetch_branch_frame), b);
+		break;
+	case kBRANCH_MJPEG_TCP:
+		g_object_set(G_OBJECT(sink), "host", target, "port", port, "sync", false, NULL);
+		break;
+	case kBRANCH_H264_RTP:
+		// Repeat SPS/PPS with every keyframe, so that receivers can join at any time.
+		g_object_set(G_OBJECT(payloader), "config-interval", 1, "pt", 96, NULL);
+		g_object_set(G_OBJECT(sink), "host", target, "port", port, "sync", false, "async", false, NULL);
+		break;
+	case kBRANCH_FILE:
+		g_object_set(G_OBJECT(sink), "location", target, "async", false, NULL);
+		break;
+	}
+
+	bool linked = gst_element_link_many(queue, convert, scale, filter, NULL);
+
+	if (is_appsink) {
+		linked = linked && gst_element_link(filter, sink);
+	} else if (parser) {
+		linked = linked && gst_element_link_many(filter, encoder, parser, payloader, sink, NULL);
+	} else {
+		linked = linked && gst_element_link_many(filter, encoder, payloader, sink, NULL);
+	}
+
+	if (!linked) {
+		g_critical("Unable to link branch type %d.", b->type);
+		gst_object_unref(bin);
+		return NULL;
+	}
+
+	GstPad *queue_pad = gst_element_get_static_pad(queue, "sink");
+	gst_element_add_pad(bin, gst_ghost_pad_new("sink", queue_pad));
+	gst_object_unref(queue_pad);
+
+	return bin;
+}
+
+// Removes the branch from the pipeline. Called on the loop thread (or from tee_clear).
+static void finalize_branch(R2TeeBranch *b) {
+
+	R2Tee *t = b->owner;
+
+	g_mutex_lock(&t->mutex);
+
+	if (b->finalized) {
+		g_mutex_unlock(&t->mutex);
+		return;
+	}
+
+	b->finalized = true;
+	t->branches = g_list_remove(t->branches, b);
+	g_mutex_unlock(&t->mutex);
+
+	GstPad *sink_pad = gst_element_get_static_pad(b->bin, "sink");
+
+	if (gst_pad_is_linked(sink_pad)) {
+		gst_pad_unlink(b->tee_pad, sink_pad);
+	}
+
+	gst_object_unref(sink_pad);
+
+	gst_element_set_state(b->bin, GST_STATE_NULL);
+
+	if (t->base->stats) {
+		stats_unwatch(t->base->stats, b->bin);
+	}
+
+	gst_bin_remove(GST_BIN(t->pipeline), b->bin);
+
+	gst_element_release_request_pad(t->tee, b->tee_pad);
+	gst_object_unref(b->tee_pad);
+
+	// The reference of the owner's list
+	branch_unref(b);
+}
+
+static gboolean finalize_on_loop(gpointer user_data) {
+
+	R2TeeBranch *b = (R2TeeBranch *)user_data;
+
+	finalize_branch(b);
+	branch_unref(b);
+
+	return G_SOURCE_REMOVE;
+}
+
+static GstPadProbeReturn eos_reached(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+
+	if (GST_EVENT_TYPE(GST_PAD_PROBE_INFO_EVENT(info)) != GST_EVENT_EOS) {
+		return GST_PAD_PROBE_PASS;
+	}
+
+	// The muxer has written its trailer. Dropping the EOS keeps it from being counted as an EOS of the pipeline.
+	r2_loop_invoke(finalize_on_loop, branch_ref((R2TeeBranch *)user_data));
+
+	return GST_PAD_PROBE_DROP;
+}
+
+static GstPadProbeReturn unlink_branch(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+
+	R2TeeBranch *b = (R2TeeBranch *)user_data;
+	GstPad *sink_pad = gst_element_get_static_pad(b->bin, "sink");
+
+	gst_pad_unlink(b->tee_pad, sink_pad);
+
+	if (b->type == kBRANCH_FILE && GST_STATE(b->owner->pipeline) == GST_STATE_PLAYING) {
+
+		GstPad *filesink_pad = gst_element_get_static_pad(b->sink, "sink");
+
+		gst_pad_add_probe(filesink_pad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, eos_reached, branch_ref(b), branch_unref);
+		gst_pad_send_event(sink_pad, gst_event_new_eos());
+
+		gst_object_unref(filesink_pad);
+
+	} else {
+		r2_loop_invoke(finalize_on_loop, branch_ref(b));
+	}
+
+	gst_object_unref(sink_pad);
+
+	return GST_PAD_PROBE_REMOVE;
+}
+
+static GstPadProbeReturn hold_buffers(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+
+	return GST_PAD_PROBE_OK;
+}
+
+void tee_init(R2Tee *t, R2Pipeline *base, GstElement *tee) {
+
+	t->base = base;
+	t->pipeline = base->pipeline;
+	t->tee = tee;
+	t->branches = NULL;
+	t->allocated = 0;
+	g_mutex_init(&t->mutex);
+	g_cond_init(&t->freed);
+
+	// Keep streaming while no branch is linked
+	g_object_set(G_OBJECT(tee), "allow-not-linked", true, NULL);
+}
+
+R2TeeBranch* tee_branch_add(R2Tee *t, int type, const char *target, int port, int width, int height) {
+
+	if (!t->tee) {
+		g_critical("Unable to add branch: the tee has not been initialized.");
+		return NULL;
+	}
+
+	if (type != kBRANCH_APPSINK && type != kBRANCH_MOTION && !target) {
+		g_critical("Unable to add branch type %d: no target given.", type);
+		return NULL;
+	}
+
+	R2TeeBranch *b = calloc(1, sizeof(R2TeeBranch));
+	b->type = type;
+	b->owner = t;
+	b->refcount = 1;
+
+	g_mutex_lock(&t->mutex);
+	t->allocated++;
+	g_mutex_unlock(&t->mutex);
+	b->ring = type == kBRANCH_APPSINK || type == kBRANCH_MOTION ? frame_ring_new() : NULL;
+	b->motion = type == kBRANCH_MOTION ? motion_detector_new() : NULL;
+
+	if (!(b->bin = create_branch_bin(b, target, port, width, height))) {
+		branch_unref(b);
+		return NULL;
+	}
+
+	GstPadTemplate *tee_src_pad_template = gst_element_class_get_pad_template(GST_ELEMENT_GET_CLASS(t->tee), "src_%u");
+	b->tee_pad = gst_element_request_pad(t->tee, tee_src_pad_template, NULL, NULL);
+
+	// Nothing may flow into the branch before its elements have left the NULL state.
+	gulong block_id = gst_pad_add_probe(b->tee_pad, GST_PAD_PROBE_TYPE_BLOCK_DOWNSTREAM, hold_buffers, NULL, NULL);
+
+	gst_bin_add(GST_BIN(t->pipeline), b->bin);
+	GstPad *sink_pad = gst_element_get_static_pad(b->bin, "sink");
+	GstPadLinkReturn link_result = gst_pad_link(b->tee_pad, sink_pad);
+	gst_object_unref(sink_pad);
+
+	if (link_result != GST_PAD_LINK_OK) {
+		g_critical("Unable to link branch type %d to the tee.", type);
+		gst_pad_remove_probe(b->tee_pad, block_id);
+		gst_bin_remove(GST_BIN(t->pipeline), b->bin);
+		gst_element_release_request_pad(t->tee, b->tee_pad);
+		gst_object_unref(b->tee_pad);
+		branch_unref(b);
+		return NULL;
+	}
+
+	gst_element_sync_state_with_parent(b->bin);
+
+	if (t->base->stats) {
+		stats_watch(t->base->stats, b->bin);
+	}
+
+	gst_pad_remove_probe(b->tee_pad, block_id);
+
+	g_mutex_lock(&t->mutex);
+	t->branches = g_list_append(t->branches, b);
+	g_mutex_unlock(&t->mutex);
+
+	return b;
+}
+
+void tee_branch_remove(R2Tee *t, R2TeeBranch *branch) {
+
+	g_mutex_lock(&t->mutex);
+
+	if (branch->removing || branch->finalized) {
+		g_mutex_unlock(&t->mutex);
+		return;
+	}
+
+	branch->removing = true;
+	g_mutex_unlock(&t->mutex);
+
+	// Called at once if the pad is idle, otherwise as soon as the current buffer has been pushed.
+	gst_pad_add_probe(branch->tee_pad, GST_PAD_PROBE_TYPE_IDLE, unlink_branch, branch_ref(branch), branch_unref);
+}
+
+static gboolean clear_on_loop(gpointer user_data) {
+
+	R2Tee *t = (R2Tee *)user_data;
+
+	g_mutex_lock(&t->mutex);
+	GList *branches = g_list_copy(t->branches);
+	g_mutex_unlock(&t->mutex);
+
+	for (GList *it = branches; it != NULL; it = it->next) {
+		finalize_branch((R2TeeBranch *)it->data);
+	}
+
+	g_list_free(branches);
+
+	return G_SOURCE_REMOVE;
+}
+
+void tee_clear(R2Tee *t) {
+
+	if (!t->tee) {
+		return;
+	}
+
+	// On the loop thread, so that it can't race with a pending finalize_on_loop.
+	r2_loop_invoke_sync(clear_on_loop, t);
+
+	// The EOS probe of a file branch, or a finalize_on_loop queued before the clear, may still hold a reference.
+	g_mutex_lock(&t->mutex);
+
+	while (t->allocated > 0) {
+		g_cond_wait(&t->freed, &t->mutex);
+	}
+
+	g_mutex_unlock(&t->mutex);
+
+	g_cond_clear(&t->freed);
+	g_mutex_clear(&t->mutex);
+	t->tee = NULL;
+}
+
+R2FrameRing* tee_branch_get_ring(R2TeeBranch *branch) {
+
+	return branch->ring;
+}
+
+R2MotionDetector* tee_branch_get_motion(R2TeeBranch *branch) {
+
+	return branch->motion;
+}
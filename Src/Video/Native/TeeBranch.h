@@ -0,0 +1,79 @@
+// This file is part of r2Poject.
+//
+// Copyright 2016 Tord Wessman
+//
+// r2Project is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// r2Project is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with r2Project. If not, see <http://www.gnu.org/licenses/>.
+//
+
+/**
+*	Output branches that are attached to (and detached from) the tee of a running pipeline.
+*	A branch is a bin starting with a leaky queue, so that a slow consumer never stalls the tee.
+*	The encoders of a branch only run while the branch is attached.
+**/
+
+#ifndef TEE_BRANCH_H
+#define TEE_BRANCH_H
+
+#include <gst/gst.h>
+#include <stdbool.h>
+#include "FrameRing.h"
+#include "MotionDetector.h"
+#include "R2Pipeline.h"
+
+// Branch types
+#define kBRANCH_APPSINK 0		// BGR frames published through a frame ring
+#define kBRANCH_MJPEG_TCP 1		// multipart JPEG served by a tcpserversink (target = host)
+#define kBRANCH_H264_RTP 2		// H.264 over RTP sent by an udpsink (target = host)
+#define kBRANCH_FILE 3			// H.264 in a matroska file (target = location)
+#define kBRANCH_MOTION 4		// small GRAY8 frames published through a frame ring and fed to a motion detector
+
+// The bitrate (kbit/s) of the H.264 branches
+#define kBRANCH_H264_BITRATE 1024
+
+typedef struct R2TeeBranch R2TeeBranch;
+
+// The branches of one tee.
+typedef struct {
+	R2Pipeline *base;		// the branches are instrumented when the stats of the pipeline are enabled
+	GstElement *pipeline;
+	GstElement *tee;
+	GList *branches;
+	int allocated;			// branches that have not been freed yet (they may still be referenced by probes or loop callbacks)
+	GMutex mutex;
+	GCond freed;
+} R2Tee;
+
+// Must be called after the tee has been added to the pipeline.
+void tee_init(R2Tee *t, R2Pipeline *base, GstElement *tee);
+
+// Removes and frees all branches at once, and waits until none of them references the tee any more. The pipeline must not be
+// playing (i.e. stop it before).
+void tee_clear(R2Tee *t);
+
+// Builds a branch and links it to a new tee pad. The tee pad is blocked until the branch has reached the state of the pipeline.
+// width and height may be 0 to keep the size of the source (kMOTION_DEFAULT_WIDTH/HEIGHT for the motion branch).
+// port is ignored by the appsink, file and motion branches, target by the appsink and motion branches.
+R2TeeBranch* tee_branch_add(R2Tee *t, int type, const char *target, int port, int width, int height);
+
+// Unlinks the branch when its tee pad is idle and releases it from the shared loop thread. The file branch is sent EOS first,
+// so that the muxer can finish the file. The branch must not be used after this call (release its frames before).
+void tee_branch_remove(R2Tee *t, R2TeeBranch *branch);
+
+// The frames of an appsink or motion branch (NULL for the other types).
+R2FrameRing* tee_branch_get_ring(R2TeeBranch *branch);
+
+// The motion detector of a motion branch (NULL for the other types).
+R2MotionDetector* tee_branch_get_motion(R2TeeBranch *branch);
+
+#endif
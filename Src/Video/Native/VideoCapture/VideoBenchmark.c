@@ -0,0 +1,286 @@
+// This file is part of r2Poject.
+//
+// Copyright 2016 Tord Wessman
+//
+// r2Project is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// r2Project is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with r2Project. If not, see <http://www.gnu.org/licenses/>.
+//
+
+/**
+*	Runs the web cam pipeline on a synthetic source and reports the sustained frame rate, the CPU time per frame and the
+*	latency from the source to the consumer of the appsink frames. Optionally with an output branch attached, and with the
+*	per-element stats (-S, see PipelineStats.h) printed at the end.
+*
+*	Usage: r2videobench [-s test|file] [-l location] [-p pattern] [-w width] [-h height] [-f fps] [-d seconds]
+*	                    [-b mjpeg|rtp|file|motion] [-t target] [-P port] [-S]
+*
+*	i.e: r2videobench -s file -l ../../../../TestData/VideoTestData/delme1.mp4 -w 640 -h 480 -b rtp -t 127.0.0.1 -P 5004
+**/
+
+#include "WebCamGst.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include "gst/app/gstappsink.h"
+
+// The number of source time stamps remembered for the latency measurement
+#define kBENCH_STAMPS 256
+// Frames before the measurement starts (the pipeline and encoders settle)
+#define kBENCH_WARMUP_S 1
+
+typedef struct {
+	guint64 pts;
+	gint64 produced_at;	// monotonic time (µs) at which the buffer left the source
+} SourceStamp;
+
+static SourceStamp stamps[kBENCH_STAMPS];
+static guint64 stamp_count;
+static GMutex stamp_mutex;
+
+static GstPadProbeReturn stamp_buffer(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+
+	GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+
+	g_mutex_lock(&stamp_mutex);
+	stamps[stamp_count % kBENCH_STAMPS].pts = GST_BUFFER_PTS(buffer);
+	stamps[stamp_count % kBENCH_STAMPS].produced_at = g_get_monotonic_time();
+	stamp_count++;
+	g_mutex_unlock(&stamp_mutex);
+
+	return GST_PAD_PROBE_OK;
+}
+
+// Returns the time at which the buffer with pts left the source, or -1 if it's no longer remembered.
+static gint64 produced_at(guint64 pts) {
+
+	gint64 result = -1;
+
+	g_mutex_lock(&stamp_mutex);
+
+	for (int i = 0; i < kBENCH_STAMPS; i++) {
+		if (stamps[i].pts == pts) {
+			result = stamps[i].produced_at;
+			break;
+		}
+	}
+
+	g_mutex_unlock(&stamp_mutex);
+
+	return result;
+}
+
+static guint64 produced_count() {
+
+	g_mutex_lock(&stamp_mutex);
+	guint64 count = stamp_count;
+	g_mutex_unlock(&stamp_mutex);
+
+	return count;
+}
+
+static GstFlowReturn fetch_frame(GstAppSink *asink, gpointer user_data) {
+
+	WebCamPipeline *p = (WebCamPipeline *)user_data;
+	GstSample *sample = gst_app_sink_pull_sample(asink);
+
+	if (!sample) {
+		return GST_FLOW_OK;
+	}
+
+	int result = frame_ring_push(p->ring, sample);
+	gst_sample_unref(sample);
+
+	return result == kFRAME_RING_INCOMPATIBLE ? GST_FLOW_CUSTOM_ERROR : GST_FLOW_OK;
+}
+
+static double cpu_seconds() {
+
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+
+	return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+static guint64 motion_events;
+
+static void count_motion(const R2MotionEvent *event, void *user_data) {
+
+	motion_events++;
+}
+
+static int compare_latency(const void *a, const void *b) {
+
+	gint64 x = *(const gint64 *)a, y = *(const gint64 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void usage() {
+
+	printf("Usage: r2videobench [-s test|file] [-l location] [-p pattern] [-w width] [-h height] [-f fps] [-d seconds] "
+		"[-b mjpeg|rtp|file|motion] [-t target] [-P port] [-S]\n");
+	exit(1);
+}
+
+int main(int argc, char *argv[]) {
+
+	int source = kSOURCE_TEST, pattern = 0, fps = kSOURCE_DEFAULT_FPS, duration = 10, branch_type = -1, port = 5004;
+	const char *location = NULL, *width = "640", *height = "480", *target = NULL;
+	bool print_stats = false;
+
+	for (int i = 1; i < argc; i++) {
+
+		bool has_value = i + 1 < argc;
+
+		if (!strcmp(argv[i], "-s") && has_value) { source = !strcmp(argv[++i], "file") ? kSOURCE_FILE : kSOURCE_TEST; }
+		else if (!strcmp(argv[i], "-l") && has_value) { location = argv[++i]; }
+		else if (!strcmp(argv[i], "-p") && has_value) { pattern = atoi(argv[++i]); }
+		else if (!strcmp(argv[i], "-w") && has_value) { width = argv[++i]; }
+		else if (!strcmp(argv[i], "-h") && has_value) { height = argv[++i]; }
+		else if (!strcmp(argv[i], "-f") && has_value) { fps = atoi(argv[++i]); }
+		else if (!strcmp(argv[i], "-d") && has_value) { duration = atoi(argv[++i]); }
+		else if (!strcmp(argv[i], "-t") && has_value) { target = argv[++i]; }
+		else if (!strcmp(argv[i], "-P") && has_value) { port = atoi(argv[++i]); }
+		else if (!strcmp(argv[i], "-S")) { print_stats = true; }
+		else if (!strcmp(argv[i], "-b") && has_value) {
+			i++;
+			if (!strcmp(argv[i], "mjpeg")) { branch_type = kBRANCH_MJPEG_TCP; }
+			else if (!strcmp(argv[i], "rtp")) { branch_type = kBRANCH_H264_RTP; }
+			else if (!strcmp(argv[i], "file")) { branch_type = kBRANCH_FILE; }
+			else if (!strcmp(argv[i], "motion")) { branch_type = kBRANCH_MOTION; }
+			else { usage(); }
+		}
+		else { usage(); }
+	}
+
+	if ((source == kSOURCE_FILE && !location) || duration <= 0 || (branch_type >= 0 && branch_type != kBRANCH_MOTION && !target)) {
+		usage();
+	}
+
+	WebCamPipeline *p = webcam_pipeline_new();
+	set_input_vars(p, NULL, width, height);
+	set_source(p, source, location, pattern, fps);
+
+	if (!init_gst(p)) {
+		printf("Unable to initialize the pipeline.\n");
+		dealloc(p);
+		return 1;
+	}
+
+	g_signal_connect(get_appsink(p), "new-sample", G_CALLBACK(fetch_frame), p);
+
+	GstPad *src_pad = gst_element_get_static_pad(p->src, "src");
+	gst_pad_add_probe(src_pad, GST_PAD_PROBE_TYPE_BUFFER, stamp_buffer, NULL, NULL);
+	gst_object_unref(src_pad);
+
+	if (print_stats) {
+		r2_pipeline_enable_stats(&p->base);
+	}
+
+	if (!start_gst_pipeline(p)) {
+		dealloc(p);
+		return 1;
+	}
+
+	R2TeeBranch *branch = NULL;
+
+	if (branch_type >= 0 && !(branch = add_branch(p, branch_type, target, port, 0, 0))) {
+		dealloc(p);
+		return 1;
+	}
+
+	if (branch_type == kBRANCH_MOTION) {
+		motion_detector_set_callback(tee_branch_get_motion(branch), count_motion, NULL);
+	}
+
+	size_t max_latencies = (size_t)(duration + 1) * (fps > 0 ? fps : kSOURCE_DEFAULT_FPS) * 2;
+	gint64 *latencies = calloc(max_latencies, sizeof(gint64));
+	size_t latency_count = 0;
+	guint64 sequence = 0, delivered = 0, produced_start = 0;
+	double cpu_start = 0;
+	gint64 now = g_get_monotonic_time();
+	gint64 measure_start = now + kBENCH_WARMUP_S * G_USEC_PER_SEC;
+	gint64 measure_end = measure_start + (gint64)duration * G_USEC_PER_SEC;
+	bool measuring = false;
+
+	while ((now = g_get_monotonic_time()) < measure_end && is_running_gst_loop(p)) {
+
+		if (!measuring && now >= measure_start) {
+			measuring = true;
+			cpu_start = cpu_seconds();
+			produced_start = produced_count();
+
+			if (print_stats) {
+				stats_reset(p->base.stats);
+			}
+		}
+
+		R2Frame *frame = frame_ring_acquire_next(p->ring, sequence, 1000);
+
+		if (!frame) {
+			continue;
+		}
+
+		sequence = frame->sequence;
+
+		if (measuring) {
+
+			gint64 produced = produced_at(frame->timestamp);
+			delivered++;
+
+			if (produced >= 0 && latency_count < max_latencies) {
+				latencies[latency_count++] = g_get_monotonic_time() - produced;
+			}
+		}
+
+		frame_ring_release(p->ring, frame);
+	}
+
+	if (!measuring) {
+		printf("The pipeline stopped before the measurement started.\n");
+		free(latencies);
+		dealloc(p);
+		return 1;
+	}
+
+	double elapsed = (g_get_monotonic_time() - measure_start) / 1e6;
+	double cpu = cpu_seconds() - cpu_start;
+	guint64 produced = produced_count() - produced_start;
+
+	qsort(latencies, latency_count, sizeof(gint64), compare_latency);
+
+	printf("source: %s %sx%s @ %d fps, branch: %d, duration: %.1f s\n", source == kSOURCE_FILE ? location : "videotestsrc",
+		width, height, fps, branch_type, elapsed);
+	printf("produced: %" G_GUINT64_FORMAT " (%.1f fps), delivered: %" G_GUINT64_FORMAT " (%.1f fps), ring drops: %" G_GUINT64_FORMAT "\n",
+		produced, produced / elapsed, delivered, delivered / elapsed, frame_ring_dropped(p->ring));
+	printf("cpu: %.1f%% of one core, %.2f ms per produced frame\n", 100.0 * cpu / elapsed, produced ? 1000.0 * cpu / produced : 0);
+
+	if (latency_count) {
+		printf("latency (ms): p50 %.2f, p95 %.2f, max %.2f\n", latencies[latency_count / 2] / 1000.0,
+			latencies[latency_count * 95 / 100] / 1000.0, latencies[latency_count - 1] / 1000.0);
+	}
+
+	if (branch_type == kBRANCH_MOTION) {
+		printf("motion: %" G_GUINT64_FORMAT " frames with motion\n", motion_events);
+	}
+
+	if (print_stats) {
+		stats_print(p->base.stats);
+	}
+
+	free(latencies);
+	dealloc(p);
+
+	return 0;
+}
@@ -18,6 +18,7 @@
 
 #include "WebCam.h"
 #include "WebCamGst.h"
+#include "FrameRing.h"
 #include <stdio.h>
 #include <glib-2.0/glib-object.h>
 #include <opencv/cv.h>
@@ -37,150 +38,202 @@
 
 //void process_frame (IplImage *frame);
 
-static bool is_reading = false, is_processing = false, pause_fetching = false;
-
-/** Used by the frame fetcher: **/
-static GstSample* sample;
-static GstMapInfo* info;
-static GstBuffer* buffer;
-static GstCaps* buffer_caps;
-static IplImage* tmp_frame;
-static GstElement *appsink;
+// The instance used by the functions without a handle argument.
+static WebCamPipeline *webcam;
 
+// The frame returned by _ext_get_frame (held until the next call) and its image header.
+static R2Frame *current;
 static IplImage* current_frame;
 
-GstFlowReturn fetch_frame(GstAppSink *asink, gpointer notUsed );
+GstFlowReturn fetch_frame(GstAppSink *asink, gpointer user_data );
 void send_report(int type, const char* msg);
 
 static const char*(*report_error)(int type, const char *message);	//delegate method for reporting back error
 
 
-GstFlowReturn fetch_frame(GstAppSink *asink, gpointer notUsed ) {
+GstFlowReturn fetch_frame(GstAppSink *asink, gpointer user_data ) {
 
-	if (!is_reading && !is_processing && !pause_fetching) {
+	WebCamPipeline *p = (WebCamPipeline *)user_data;
+	GstSample *sample = gst_app_sink_pull_sample (asink);
 
-		is_reading = true;
-		
-		gint height, width;
-		GstStructure* structure;
-		
-		if (sample) {
-			gst_sample_unref(sample);
-		}
+	if (!sample) {
+		return GST_FLOW_OK;
+	}
 
-		sample = gst_app_sink_pull_sample (asink);
-
-		if (sample) {
-			
-			buffer = gst_sample_get_buffer(sample);
-			
-			/* if tmp_frame is null, create a new imag header by
-			   extracting meta data from the caps
-			*/
-			if (!tmp_frame) {
-
-				if (buffer_caps) {
-					gst_caps_unref(buffer_caps);
-				}
-			
-				buffer_caps = gst_sample_get_caps(sample);
-
-				assert(gst_caps_get_size(buffer_caps) == 1);
-
-				structure = gst_caps_get_structure(buffer_caps, 0);
-
-				//Make sure width > 0 && height > 0
-				assert (gst_structure_get_int(structure, "width", &width) && gst_structure_get_int(structure, "height", &height));
-			
-				int depth = 0;
-				const gchar* name = gst_structure_get_name(structure);
-				const gchar* format = gst_structure_get_string(structure, "format");
-
-				if (!(name && format)) {
-					g_critical ("Name and format could not be retrieved.");
-					return GST_FLOW_CUSTOM_ERROR;					
-				}
-				  
-				// we support 3 types of data:
-				// video/x-raw, format=BGR -> 8bit, 3 channels
-				// video/x-raw, format=GRAY8 -> 8bit, 1 channel
-				// video/x-bayer -> 8bit, 1 channel
-				// bayer data is never decoded, the user is responsible for that
-				// everything is 8 bit, so we just test the caps for bit depth
-
-				if (strcasecmp(name, "video/x-raw") == 0)
-				{
-				    if (strcasecmp(format, "BGR") == 0) {
-					depth = 3;
-				    }
-				    else if(strcasecmp(format, "GRAY8") == 0){
-					depth = 1;
-				    }
-				}
-				else if (strcasecmp(name, "video/x-bayer") == 0)
-				{
-				    depth = 1;
-				}
-
-				if (depth < 1) {
-					
-					g_critical ("Caps not compatible: %s", format);
-					return GST_FLOW_CUSTOM_ERROR;
-				}
-
-				tmp_frame = cvCreateImageHeader(cvSize(width, height), IPL_DEPTH_8U, depth);
-			}
-
-			assert (gst_buffer_map(buffer,info, (GstMapFlags)GST_MAP_READ));
-
-			//now we have the frame:
-
-			tmp_frame->imageData = (char*)info->data;
-
-			//
-			// Here be your image processing if you like to
-			//
-			// process_frame(tmp_frame);
-			//
-
-			gst_buffer_unmap(buffer,info);
+	// The ring keeps the sample mapped until the consumers are done with it.
+	int result = p->pause_fetching ? kFRAME_RING_DROPPED : frame_ring_push(p->ring, sample);
 
-		}
+	gst_sample_unref(sample);
 
-		is_reading = false;
-	}
-	
-	return GST_FLOW_OK;
+	return result == kFRAME_RING_INCOMPATIBLE ? GST_FLOW_CUSTOM_ERROR : GST_FLOW_OK;
 }
 
 
 
-int init_opencv () {
+int init_opencv (WebCamPipeline *p) {
 	
-	//initialize the variables used by OpenCv
-	tmp_frame = NULL;
-	buffer = NULL;
-	buffer_caps = NULL;
-	sample = NULL;
-	info = calloc(sizeof(GstMapInfo), 1); //GST_MAP_INFO_INIT;//new GstMapInfo();
-	appsink = get_appsink();
+	GstElement *appsink = get_appsink(p);
 
 	if (!appsink) {
 		g_critical ("Unable to fetch appsink. Object initialized?\n");
 		return 0;
 	}
 
-	g_signal_connect(appsink, "new-sample", G_CALLBACK(fetch_frame), NULL);
+	g_signal_connect(appsink, "new-sample", G_CALLBACK(fetch_frame), p);
 	
 	return true;
 }
 
+static WebCamPipeline* default_webcam() {
+
+	if (!webcam) {
+		webcam = webcam_pipeline_new();
+	}
+
+	return webcam;
+}
+
+/**
+* 	External methods (one instance per camera):
+**/
+
+WebCamPipeline* _ext_webcam_create(const char* device, const char* width, const char* height) {
+
+	WebCamPipeline *p = webcam_pipeline_new();
+
+	set_input_vars(p, device, width, height);
+
+	if (!init_gst(p) || !init_opencv(p)) {
+		g_critical ("Unable to init camera %s\n", device ? device : "");
+		dealloc(p);
+		return NULL;
+	}
+
+	return p;
+}
+
+WebCamPipeline* _ext_webcam_create_with_source(int type, const char* location, int pattern,
+	const char* width, const char* height, int fps) {
+
+	WebCamPipeline *p = webcam_pipeline_new();
+
+	set_input_vars(p, NULL, width, height);
+	set_source(p, type, location, pattern, fps);
+
+	if (!init_gst(p) || !init_opencv(p)) {
+		g_critical ("Unable to init source type %d %s\n", type, location ? location : "");
+		dealloc(p);
+		return NULL;
+	}
+
+	return p;
+}
+
+void _ext_webcam_set_callbacks (WebCamPipeline *p,
+	const char*(*report_error_callback)(int type, const char *message),
+	const char*(*report_eos_callback)())
+{
+	set_cb(p, report_error_callback, report_eos_callback);
+}
+
+bool _ext_webcam_start(WebCamPipeline *p) {
+	return start_gst_pipeline(p);
+}
+
+void _ext_webcam_stop(WebCamPipeline *p) {
+	stop_gst_loop(p);
+}
+
+bool _ext_webcam_is_running(WebCamPipeline *p) {
+	return is_running_gst_loop(p);
+}
+
+void _ext_webcam_destroy(WebCamPipeline *p) {
+	dealloc(p);
+}
+
+R2Frame* _ext_webcam_acquire_frame(WebCamPipeline *p) {
+	return frame_ring_acquire(p->ring);
+}
+
+R2Frame* _ext_webcam_acquire_next_frame(WebCamPipeline *p, guint64 sequence, int timeout_ms) {
+	return frame_ring_acquire_next(p->ring, sequence, timeout_ms);
+}
+
+void _ext_webcam_release_frame(WebCamPipeline *p, R2Frame* frame) {
+	frame_ring_release(p->ring, frame);
+}
+
+R2TeeBranch* _ext_webcam_add_branch(WebCamPipeline *p, int type, const char *target, int port, int width, int height) {
+	return add_branch(p, type, target, port, width, height);
+}
+
+void _ext_webcam_remove_branch(WebCamPipeline *p, R2TeeBranch *branch) {
+	remove_branch(p, branch);
+}
+
+R2Frame* _ext_webcam_branch_acquire_next_frame(R2TeeBranch *branch, guint64 sequence, int timeout_ms) {
+	R2FrameRing *ring = tee_branch_get_ring(branch);
+	return ring ? frame_ring_acquire_next(ring, sequence, timeout_ms) : NULL;
+}
+
+void _ext_webcam_branch_release_frame(R2TeeBranch *branch, R2Frame* frame) {
+	frame_ring_release(tee_branch_get_ring(branch), frame);
+}
+
+bool _ext_webcam_branch_configure_motion(R2TeeBranch *branch, int pixel_threshold, float area_threshold, int learning_shift) {
+	R2MotionDetector *motion = tee_branch_get_motion(branch);
+	if (motion) {
+		motion_detector_configure(motion, pixel_threshold, area_threshold, learning_shift);
+	}
+	return motion != NULL;
+}
+
+void _ext_webcam_branch_set_motion_callback(R2TeeBranch *branch, R2MotionCallback callback, void *user_data) {
+	R2MotionDetector *motion = tee_branch_get_motion(branch);
+	if (motion) {
+		motion_detector_set_callback(motion, callback, user_data);
+	}
+}
+
+bool _ext_webcam_branch_get_motion(R2TeeBranch *branch, R2MotionEvent *event) {
+	R2MotionDetector *motion = tee_branch_get_motion(branch);
+	return motion ? motion_detector_get_last(motion, event) : false;
+}
+
+bool _ext_webcam_branch_wait_motion(R2TeeBranch *branch, guint64 sequence, int timeout_ms, R2MotionEvent *event) {
+	R2MotionDetector *motion = tee_branch_get_motion(branch);
+	return motion ? motion_detector_wait(motion, sequence, timeout_ms, event) : false;
+}
+
+bool _ext_webcam_enable_stats(WebCamPipeline *p) {
+	return r2_pipeline_enable_stats(&p->base) != NULL;
+}
+
+int _ext_webcam_get_stats_count(WebCamPipeline *p) {
+	return p->base.stats ? stats_count(p->base.stats) : 0;
+}
+
+bool _ext_webcam_get_stats(WebCamPipeline *p, int index, R2ElementStats *stats) {
+	return p->base.stats ? stats_get(p->base.stats, index, stats) : false;
+}
+
+void _ext_webcam_reset_stats(WebCamPipeline *p) {
+	if (p->base.stats) {
+		stats_reset(p->base.stats);
+	}
+}
+
+guint64 _ext_webcam_get_dropped_frames(WebCamPipeline *p) {
+	return frame_ring_dropped(p->ring);
+}
+
 /**
-* 	External methods:
+* 	External methods (default instance):
 **/
 
 void _ext_resume_from_eos() {
-	resume_from_eos ();
+	resume_from_eos (default_webcam());
 }
 
 
@@ -190,16 +243,16 @@ void _ext_set_callbacks (
 {
 	report_error = report_error_callback;
 
-	set_cb(report_error_callback, report_eos_callback);
+	set_cb(default_webcam(), report_error_callback, report_eos_callback);
 
 }
 
 
 int _ext_init(){
-	if (!init_gst()) {
+	if (!init_gst(default_webcam())) {
 		g_critical ("Unable to init gstreamer\n");
 		return false;
-	} else if (!init_opencv()) {
+	} else if (!init_opencv(webcam)) {
 		g_critical ("Unable to init opencv\n");
 		return false;
 	}
@@ -208,47 +261,56 @@ int _ext_init(){
 }
 
 void _ext_stop() {
-	stop_gst_loop();
+	stop_gst_loop(default_webcam());
 }
 
 void _ext_start() {
-	start_gst_loop();
+	start_gst_loop(default_webcam());
 }
 
 void* _ext_get_frame() {
-	if (is_processing) {
-		send_report(kERROR_WARNING, "Unable to create dump. Processing in progress.\n");
-	} else {
-		is_processing = true;
-		pause_fetching = true;
-		while (is_reading) {/* "sleep" */ }
-		
+
+	R2Frame *frame = webcam ? frame_ring_acquire(webcam->ring) : NULL;
+
+	if (!frame) {
+		g_critical ("First frame not yet initialized!");
+		return NULL;
+	} else if (frame->width != get_video_width(webcam) || frame->height != get_video_height(webcam)) {
+		g_critical ("Input frame size mismatch. The input height/width (%i,%i) differs from expected (%i,%i)", frame->width, frame->height, get_video_width(webcam), get_video_height(webcam));
+		frame_ring_release(webcam->ring, frame);
+		return NULL;
+	}
+
+	frame_ring_release(webcam->ring, current);
+	current = frame;
+
+	if (!current_frame || current_frame->width != frame->width || current_frame->height != frame->height || current_frame->nChannels != frame->channels) {
+
 		if (current_frame) {
-			cvReleaseImage(&current_frame);
-		} else if (!tmp_frame) {
-			g_critical ("First frame not yet initialized!");
-			is_processing = false;
-			return NULL;
-		} else if ( tmp_frame->width != get_video_width() || tmp_frame->height != get_video_height()) {
-			g_critical ("Input frame size mismatch. The input height/width (%i,%i) differs from expected (%i,%i)", tmp_frame->width,  tmp_frame->height , get_video_width(),get_video_height());
-			is_processing = false;
-			return NULL;
+			cvReleaseImageHeader(&current_frame);
 		}
 
-		current_frame = cvCreateImage(cvGetSize(tmp_frame),
-                           tmp_frame->depth,
-                           tmp_frame->nChannels);		
-		
-
-		cvCopy(tmp_frame, current_frame, NULL);
-		is_processing = false;
-		pause_fetching = false;
-		return current_frame;//ptr;
+		current_frame = cvCreateImageHeader(cvSize(frame->width, frame->height), IPL_DEPTH_8U, frame->channels);
 	}
 
-	send_report(kERROR_WARNING, "Unable to retrieve frame.\n");
+	// No copy: the header points to the mapped sample.
+	cvSetData(current_frame, frame->data, frame->stride);
+
+	return current_frame;
+}
+
+R2Frame* _ext_acquire_frame() {
+	return webcam ? frame_ring_acquire(webcam->ring) : NULL;
+}
+
+R2Frame* _ext_acquire_next_frame(guint64 sequence, int timeout_ms) {
+	return webcam ? frame_ring_acquire_next(webcam->ring, sequence, timeout_ms) : NULL;
+}
 
-	return NULL;
+void _ext_release_frame(R2Frame* frame) {
+	if (webcam) {
+		frame_ring_release(webcam->ring, frame);
+	}
 }
 
 
@@ -268,13 +330,11 @@ void send_report(int type, const char* msg) {
 
 int main (int argc, char** argv) {
 
-	set_input_vars("640", "480");
-
+	WebCamPipeline *p = _ext_webcam_create(argc > 1 ? argv[1] : NULL, "640", "480");
 
-	if (init_gst() &&
-	    init_opencv()) {
-		start_gst_loop ();
-		stop_gst_loop();
+	if (p) {
+		start_gst_loop (p);
+		dealloc (p);
 	}
 	else {
 		printf ("unable to initialize");
@@ -286,22 +346,35 @@ int main (int argc, char** argv) {
 /**/
 
 void _ext_dealloc() {
-	dealloc();
+
+	if (!webcam) {
+		return;
+	}
+
+	frame_ring_release(webcam->ring, current);
+	current = NULL;
+
+	dealloc(webcam);
+	webcam = NULL;
+
+	if (current_frame) {
+		cvReleaseImageHeader(&current_frame);
+	}
 }
 
 bool _ext_is_running() {
-	return is_running_gst_loop();
+	return webcam && is_running_gst_loop(webcam);
 }
 
 void _ext_set_input_vars (const char* width, const char* height) {
-	set_input_vars(width, height);
+	set_input_vars(default_webcam(), NULL, width, height);
 }
 
 
 int _ext_get_video_width() {
-	return get_video_width();
+	return get_video_width(default_webcam());
 }
 
 int _ext_get_video_height() {
-	return get_video_height();
+	return get_video_height(default_webcam());
 }
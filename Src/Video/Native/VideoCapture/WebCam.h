@@ -17,6 +17,7 @@
 // 
 
 #include <stdbool.h>
+#include "WebCamGst.h"
 
 //initializes the server and alocate resources. returns 1 if successfull
 int _ext_init();
@@ -32,9 +33,15 @@ void _ext_set_callbacks (
 //returns true if the engine is running
 bool _ext_is_running();
 
-//copies and returns a pointer to the current frame
+//returns the latest frame as an IplImage without copying it. the image is valid until the next call
 void* _ext_get_frame();
 
+//returns the latest frame (or NULL). the frame stays mapped until it's released
+R2Frame* _ext_acquire_frame();
+//waits at most timeout_ms for a frame newer than sequence (or returns NULL)
+R2Frame* _ext_acquire_next_frame(guint64 sequence, int timeout_ms);
+void _ext_release_frame(R2Frame* frame);
+
 
 void _ext_set_input_vars (const char* width, const char* height);
 
@@ -44,3 +51,49 @@ int _ext_get_video_height();
 void _ext_dealloc();
 
 void _ext_resume_from_eos();
+
+// Functions for running several cameras. Each instance owns its pipeline and frames.
+
+//creates and initializes a camera (device may be NULL for the default camera). returns NULL on failure
+WebCamPipeline* _ext_webcam_create(const char* device, const char* width, const char* height);
+//creates a camera reading from a test pattern (kSOURCE_TEST) or a looped video file (kSOURCE_FILE) instead of a device
+WebCamPipeline* _ext_webcam_create_with_source(int type, const char* location, int pattern,
+	const char* width, const char* height, int fps);
+void _ext_webcam_set_callbacks (WebCamPipeline *p,
+	const char*(*report_error_callback)(int type, const char *message),
+	const char*(*report_eos_callback)());
+//starts the camera and returns. the legacy _ext_start still blocks until it's stopped
+bool _ext_webcam_start(WebCamPipeline *p);
+void _ext_webcam_stop(WebCamPipeline *p);
+bool _ext_webcam_is_running(WebCamPipeline *p);
+//stops the camera and frees all its resources
+void _ext_webcam_destroy(WebCamPipeline *p);
+
+R2Frame* _ext_webcam_acquire_frame(WebCamPipeline *p);
+R2Frame* _ext_webcam_acquire_next_frame(WebCamPipeline *p, guint64 sequence, int timeout_ms);
+void _ext_webcam_release_frame(WebCamPipeline *p, R2Frame* frame);
+
+//adds an output branch (kBRANCH_APPSINK, kBRANCH_MJPEG_TCP, kBRANCH_H264_RTP, kBRANCH_FILE or kBRANCH_MOTION) to the running camera.
+//target is the host (or the file location), width and height may be 0 to keep the input size. returns NULL on failure
+R2TeeBranch* _ext_webcam_add_branch(WebCamPipeline *p, int type, const char *target, int port, int width, int height);
+//detaches the branch without interrupting the other outputs. the branch must not be used afterwards
+void _ext_webcam_remove_branch(WebCamPipeline *p, R2TeeBranch *branch);
+//frames of an appsink branch
+R2Frame* _ext_webcam_branch_acquire_next_frame(R2TeeBranch *branch, guint64 sequence, int timeout_ms);
+void _ext_webcam_branch_release_frame(R2TeeBranch *branch, R2Frame* frame);
+//motion detection on a kBRANCH_MOTION branch (see MotionDetector.h). the regions are relative to the frame size, so they
+//apply to the frames of the other branches, and the timestamps are the pts of the frames
+bool _ext_webcam_branch_configure_motion(R2TeeBranch *branch, int pixel_threshold, float area_threshold, int learning_shift);
+//the callback is called from the streaming thread of the branch. clear it before removing the branch
+void _ext_webcam_branch_set_motion_callback(R2TeeBranch *branch, R2MotionCallback callback, void *user_data);
+bool _ext_webcam_branch_get_motion(R2TeeBranch *branch, R2MotionEvent *event);
+//waits at most timeout_ms for a motion event with a sequence greater than sequence. returns false on timeout
+bool _ext_webcam_branch_wait_motion(R2TeeBranch *branch, guint64 sequence, int timeout_ms, R2MotionEvent *event);
+//instruments every element of the pipeline (see PipelineStats.h). branches added later are included
+bool _ext_webcam_enable_stats(WebCamPipeline *p);
+int _ext_webcam_get_stats_count(WebCamPipeline *p);
+//copies the counters of the element at index (0 to count - 1). returns false if the stats are disabled or out of range
+bool _ext_webcam_get_stats(WebCamPipeline *p, int index, R2ElementStats *stats);
+void _ext_webcam_reset_stats(WebCamPipeline *p);
+//frames dropped because consumers held every slot of the ring (the consumers hold their frames too long)
+guint64 _ext_webcam_get_dropped_frames(WebCamPipeline *p);
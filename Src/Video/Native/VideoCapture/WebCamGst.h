@@ -16,25 +16,87 @@
 // along with r2Project. If not, see <http://www.gnu.org/licenses/>.
 // 
 
+#ifndef WEBCAM_GST_H
+#define WEBCAM_GST_H
+
 #include <gst/gst.h>
+#include "R2Pipeline.h"
+#include "FrameRing.h"
+#include "TeeBranch.h"
+#include "VideoSource.h"
+
+// One camera: its pipeline, elements and frames.
+typedef struct {
+	R2Pipeline base;
+
+	GstElement
+		*src,			// source
+		*csp_src, *csp_out, *csp_app, *csp_rtp, *csp_xvimg,
+		*tee,
+		*queue_out, // queue between tee and
+		*queue_app,
+		*queue_rtp,
+		*queue_xvimg,
+		*appsink,
+		*jpegenc,
+		*videorate, *videoscale,
+		*xvimagesink, //for debugging
+		*phone_sink,
+		*test_sink;
+
+	// the output branches added at runtime
+	R2Tee branches;
 
-#define kERROR_WARNING 0
-#define kERROR_CRITICAL 1
+	// frames from the appsink
+	R2FrameRing *ring;
+	bool pause_fetching;
 
-int init_gst();
+	// input data:
+	int source_type;	// kSOURCE_DEVICE (default), kSOURCE_TEST or kSOURCE_FILE
+	char *source_location;	// the video file of kSOURCE_FILE
+	int source_pattern;	// the videotestsrc pattern of kSOURCE_TEST
+	int source_fps;		// the frame rate of the test and file sources (0 for the default)
+	char *device;		// the v4l2 device (i.e. /dev/video1) or NULL for the default one
+	char *input_width;
+	char *input_height;
+	bool input_is_set;
 
-GstCaps* get_udpsrc_caps();
-void start_gst_loop();
-void stop_gst_loop();
-GstElement* get_appsink();
-int is_running_gst_loop ();
-void set_cb(const char*(*report_error_callback)(int type, const char *message),
+	// Client Data
+	char *client_ip;
+	char *client_port;
+	char *output_width;
+	char *output_height;
+	bool output_is_set;
+} WebCamPipeline;
+
+WebCamPipeline* webcam_pipeline_new();
+int init_gst(WebCamPipeline *p);
+
+// blocks until the pipeline is stopped
+void start_gst_loop(WebCamPipeline *p);
+// returns as soon as the pipeline is playing. the bus is handled by the shared loop thread
+bool start_gst_pipeline(WebCamPipeline *p);
+void stop_gst_loop(WebCamPipeline *p);
+GstElement* get_appsink(WebCamPipeline *p);
+int is_running_gst_loop (WebCamPipeline *p);
+void set_cb(WebCamPipeline *p, const char*(*report_error_callback)(int type, const char *message),
 			const char*(*report_eos_callback)());
 
-void set_input_vars (const char* width, const char* height);
+void set_input_vars (WebCamPipeline *p, const char* device, const char* width, const char* height);
+// Replaces the camera by a test pattern or a looped video file (see VideoSource.h). Must be called before init_gst.
+void set_source (WebCamPipeline *p, int type, const char* location, int pattern, int fps);
+void set_output_vars (WebCamPipeline *p, const char* remote_address, const char* remote_port,
+		     const char* width, const char* height);
+
+int get_video_width(WebCamPipeline *p);
+int get_video_height(WebCamPipeline *p);
+
+// Adds an output branch (see TeeBranch.h) to the tee. May be called while the pipeline is playing.
+R2TeeBranch* add_branch(WebCamPipeline *p, int type, const char *target, int port, int width, int height);
+void remove_branch(WebCamPipeline *p, R2TeeBranch *branch);
 
-int get_video_width();
-int get_video_height();
+// Stops the pipeline and frees the instance.
+void dealloc (WebCamPipeline *p);
+void resume_from_eos (WebCamPipeline *p);
 
-void dealloc ();
-void resume_from_eos ();
+#endif
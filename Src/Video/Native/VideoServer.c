@@ -18,6 +18,7 @@
 
 #include "VideoServer.h"
 #include "VideoServerGst.h"
+#include "FrameRing.h"
 #include <stdio.h>
 #include <glib-2.0/glib-object.h>
 #include <opencv/cv.h>
@@ -37,150 +38,197 @@
 
 //void process_frame (IplImage *frame);
 
-static bool is_reading = false, is_processing = false, pause_fetching = false;
-
-/** Used by the frame fetcher: **/
-static GstSample* sample;
-static GstMapInfo* info;
-static GstBuffer* buffer;
-static GstCaps* buffer_caps;
-static IplImage* tmp_frame;
-static GstElement *appsink;
+// The instance used by the functions without a handle argument.
+static VideoServerPipeline *server;
 
+// The frame returned by _ext_get_frame (held until the next call) and its image header.
+static R2Frame *current;
 static IplImage* current_frame;
 
-GstFlowReturn fetch_frame(GstAppSink *asink, gpointer notUsed );
+GstFlowReturn fetch_frame(GstAppSink *asink, gpointer user_data );
 void send_report(int type, const char* msg);
 
 static const char*(*report_error)(int type, const char *message);	//delegate method for reporting back error
 
 
-GstFlowReturn fetch_frame(GstAppSink *asink, gpointer notUsed ) {
+GstFlowReturn fetch_frame(GstAppSink *asink, gpointer user_data ) {
 
-	if (!is_reading && !is_processing && !pause_fetching) {
+	VideoServerPipeline *p = (VideoServerPipeline *)user_data;
+	GstSample *sample = gst_app_sink_pull_sample (asink);
 
-		is_reading = true;
-		
-		gint height, width;
-		GstStructure* structure;
-		
-		if (sample) {
-			gst_sample_unref(sample);
-		}
+	if (!sample) {
+		return GST_FLOW_OK;
+	}
 
-		sample = gst_app_sink_pull_sample (asink);
-
-		if (sample) {
-			
-			buffer = gst_sample_get_buffer(sample);
-			
-			/* if tmp_frame is null, create a new imag header by
-			   extracting meta data from the caps
-			*/
-			if (!tmp_frame) {
-
-				if (buffer_caps) {
-					gst_caps_unref(buffer_caps);
-				}
-			
-				buffer_caps = gst_sample_get_caps(sample);
-
-				assert(gst_caps_get_size(buffer_caps) == 1);
-
-				structure = gst_caps_get_structure(buffer_caps, 0);
-
-				//Make sure width > 0 && height > 0
-				assert (gst_structure_get_int(structure, "width", &width) && gst_structure_get_int(structure, "height", &height));
-			
-				int depth = 0;
-				const gchar* name = gst_structure_get_name(structure);
-				const gchar* format = gst_structure_get_string(structure, "format");
-
-				if (!(name && format)) {
-					g_critical ("Name and format could not be retrieved.");
-					return GST_FLOW_CUSTOM_ERROR;					
-				}
-				  
-				// we support 3 types of data:
-				// video/x-raw, format=BGR -> 8bit, 3 channels
-				// video/x-raw, format=GRAY8 -> 8bit, 1 channel
-				// video/x-bayer -> 8bit, 1 channel
-				// bayer data is never decoded, the user is responsible for that
-				// everything is 8 bit, so we just test the caps for bit depth
-
-				if (strcasecmp(name, "video/x-raw") == 0)
-				{
-				    if (strcasecmp(format, "BGR") == 0) {
-					depth = 3;
-				    }
-				    else if(strcasecmp(format, "GRAY8") == 0){
-					depth = 1;
-				    }
-				}
-				else if (strcasecmp(name, "video/x-bayer") == 0)
-				{
-				    depth = 1;
-				}
-
-				if (depth < 1) {
-					
-					g_critical ("Caps not compatible: %s", format);
-					return GST_FLOW_CUSTOM_ERROR;
-				}
-
-				tmp_frame = cvCreateImageHeader(cvSize(width, height), IPL_DEPTH_8U, depth);
-			}
-
-			assert (gst_buffer_map(buffer,info, (GstMapFlags)GST_MAP_READ));
-
-			//now we have the frame:
-
-			tmp_frame->imageData = (char*)info->data;
-
-			//
-			// Here be your image processing if you like to
-			//
-			// process_frame(tmp_frame);
-			//
-
-			gst_buffer_unmap(buffer,info);
+	// The ring keeps the sample mapped until the consumers are done with it.
+	int result = p->pause_fetching ? kFRAME_RING_DROPPED : frame_ring_push(p->ring, sample);
 
-		}
+	gst_sample_unref(sample);
 
-		is_reading = false;
-	}
-	
-	return GST_FLOW_OK;
+	return result == kFRAME_RING_INCOMPATIBLE ? GST_FLOW_CUSTOM_ERROR : GST_FLOW_OK;
 }
 
 
 
-int init_opencv () {
+int init_opencv (VideoServerPipeline *p) {
 	
-	//initialize the variables used by OpenCv
-	tmp_frame = NULL;
-	buffer = NULL;
-	buffer_caps = NULL;
-	sample = NULL;
-	info = calloc(sizeof(GstMapInfo), 1); //GST_MAP_INFO_INIT;//new GstMapInfo();
-	appsink = get_appsink();
+	GstElement *appsink = get_appsink(p);
 
 	if (!appsink) {
 		g_critical ("Unable to fetch appsink. Object initialized?\n");
 		return 0;
 	}
 
-	g_signal_connect(appsink, "new-sample", G_CALLBACK(fetch_frame), NULL);
+	g_signal_connect(appsink, "new-sample", G_CALLBACK(fetch_frame), p);
 	
 	return true;
 }
 
+static VideoServerPipeline* default_server() {
+
+	if (!server) {
+		server = videoserver_pipeline_new();
+	}
+
+	return server;
+}
+
 /**
-* 	External methods:
+* 	External methods (one instance per stream):
+**/
+
+VideoServerPipeline* _ext_videoserver_create(const char* remote_address, int remote_port, const char *local_ip,
+		     const char* width, const char* height,
+		     const char* client_address, const char* client_port,
+		     const char* output_width, const char* output_height) {
+
+	VideoServerPipeline *p = videoserver_pipeline_new();
+
+	set_input_vars(p, remote_address, remote_port, local_ip, width, height);
+	set_output_vars(p, client_address, client_port, output_width, output_height);
+
+	if (!init_gst(p) || !init_opencv(p)) {
+		g_critical ("Unable to init stream on port %i\n", remote_port);
+		dealloc(p);
+		return NULL;
+	}
+
+	return p;
+}
+
+void _ext_videoserver_set_callbacks (VideoServerPipeline *p,
+	const char*(*report_error_callback)(int type, const char *message),
+	const char*(*report_eos_callback)())
+{
+	set_cb(p, report_error_callback, report_eos_callback);
+}
+
+bool _ext_videoserver_start(VideoServerPipeline *p) {
+	return start_gst_pipeline(p);
+}
+
+void _ext_videoserver_stop(VideoServerPipeline *p) {
+	stop_gst_loop(p);
+}
+
+bool _ext_videoserver_is_running(VideoServerPipeline *p) {
+	return is_running_gst_loop(p);
+}
+
+void _ext_videoserver_destroy(VideoServerPipeline *p) {
+	dealloc(p);
+}
+
+R2Frame* _ext_videoserver_acquire_frame(VideoServerPipeline *p) {
+	return frame_ring_acquire(p->ring);
+}
+
+R2Frame* _ext_videoserver_acquire_next_frame(VideoServerPipeline *p, guint64 sequence, int timeout_ms) {
+	return frame_ring_acquire_next(p->ring, sequence, timeout_ms);
+}
+
+void _ext_videoserver_release_frame(VideoServerPipeline *p, R2Frame* frame) {
+	frame_ring_release(p->ring, frame);
+}
+
+R2TeeBranch* _ext_videoserver_add_branch(VideoServerPipeline *p, int type, const char *target, int port, int width, int height) {
+	return add_branch(p, type, target, port, width, height);
+}
+
+void _ext_videoserver_remove_branch(VideoServerPipeline *p, R2TeeBranch *branch) {
+	remove_branch(p, branch);
+}
+
+R2Frame* _ext_videoserver_branch_acquire_next_frame(R2TeeBranch *branch, guint64 sequence, int timeout_ms) {
+	R2FrameRing *ring = tee_branch_get_ring(branch);
+	return ring ? frame_ring_acquire_next(ring, sequence, timeout_ms) : NULL;
+}
+
+void _ext_videoserver_branch_release_frame(R2TeeBranch *branch, R2Frame* frame) {
+	frame_ring_release(tee_branch_get_ring(branch), frame);
+}
+
+bool _ext_videoserver_branch_configure_motion(R2TeeBranch *branch, int pixel_threshold, float area_threshold, int learning_shift) {
+	R2MotionDetector *motion = tee_branch_get_motion(branch);
+	if (motion) {
+		motion_detector_configure(motion, pixel_threshold, area_threshold, learning_shift);
+	}
+	return motion != NULL;
+}
+
+void _ext_videoserver_branch_set_motion_callback(R2TeeBranch *branch, R2MotionCallback callback, void *user_data) {
+	R2MotionDetector *motion = tee_branch_get_motion(branch);
+	if (motion) {
+		motion_detector_set_callback(motion, callback, user_data);
+	}
+}
+
+bool _ext_videoserver_branch_get_motion(R2TeeBranch *branch, R2MotionEvent *event) {
+	R2MotionDetector *motion = tee_branch_get_motion(branch);
+	return motion ? motion_detector_get_last(motion, event) : false;
+}
+
+bool _ext_videoserver_branch_wait_motion(R2TeeBranch *branch, guint64 sequence, int timeout_ms, R2MotionEvent *event) {
+	R2MotionDetector *motion = tee_branch_get_motion(branch);
+	return motion ? motion_detector_wait(motion, sequence, timeout_ms, event) : false;
+}
+
+bool _ext_videoserver_enable_stats(VideoServerPipeline *p) {
+	return r2_pipeline_enable_stats(&p->base) != NULL;
+}
+
+int _ext_videoserver_get_stats_count(VideoServerPipeline *p) {
+	return p->base.stats ? stats_count(p->base.stats) : 0;
+}
+
+bool _ext_videoserver_get_stats(VideoServerPipeline *p, int index, R2ElementStats *stats) {
+	return p->base.stats ? stats_get(p->base.stats, index, stats) : false;
+}
+
+void _ext_videoserver_reset_stats(VideoServerPipeline *p) {
+	if (p->base.stats) {
+		stats_reset(p->base.stats);
+	}
+}
+
+guint64 _ext_videoserver_get_dropped_frames(VideoServerPipeline *p) {
+	return frame_ring_dropped(p->ring);
+}
+
+void _ext_videoserver_pause_frame_fetching(VideoServerPipeline *p) {
+	p->pause_fetching = true;
+}
+
+void _ext_videoserver_resume_frame_fetching(VideoServerPipeline *p) {
+	p->pause_fetching = false;
+}
+
+/**
+* 	External methods (default instance):
 **/
 
 void _ext_resume_from_eos() {
-	resume_from_eos ();
+	resume_from_eos (default_server());
 }
 
 
@@ -190,16 +238,16 @@ void _ext_set_callbacks (
 {
 	report_error = report_error_callback;
 
-	set_cb(report_error_callback, report_eos_callback);
+	set_cb(default_server(), report_error_callback, report_eos_callback);
 
 }
 
 
 int _ext_init(){
-	if (!init_gst()) {
+	if (!init_gst(default_server())) {
 		g_critical ("Unable to init gstreamer\n");
 		return false;
-	} else if (!init_opencv()) {
+	} else if (!init_opencv(server)) {
 		g_critical ("Unable to init opencv\n");
 		return false;
 	}
@@ -208,56 +256,64 @@ int _ext_init(){
 }
 
 void _ext_stop() {
-	stop_gst_loop();
+	stop_gst_loop(default_server());
 }
 
 void _ext_start() {
-	start_gst_loop();
+	start_gst_loop(default_server());
 }
 
 void _ext_pause_frame_fetching() {
-	pause_fetching = true;
+	default_server()->pause_fetching = true;
 }
 
 void _ext_resume_frame_fetching() {
-	pause_fetching = false;
+	default_server()->pause_fetching = false;
 }
 
 void* _ext_get_frame() {
-	if (is_processing) {
-		send_report(kERROR_WARNING, "Unable to create dump. Processing in progress.\n");
-	} else {
-		is_processing = true;
-		while (is_reading) {/* "sleep" */ }
-		
+
+	R2Frame *frame = server ? frame_ring_acquire(server->ring) : NULL;
+
+	if (!frame) {
+		g_critical ("First frame not yet initialized!");
+		return NULL;
+	} else if (frame->width != get_video_width(server) || frame->height != get_video_height(server)) {
+		g_critical ("Input frame size mismatch. The input height/width (%i,%i) differs from expected (%i,%i)", frame->width, frame->height, get_video_width(server), get_video_height(server));
+		frame_ring_release(server->ring, frame);
+		return NULL;
+	}
+
+	frame_ring_release(server->ring, current);
+	current = frame;
+
+	if (!current_frame || current_frame->width != frame->width || current_frame->height != frame->height || current_frame->nChannels != frame->channels) {
+
 		if (current_frame) {
-			cvReleaseImage(&current_frame);
-		} else if (!tmp_frame || tmp_frame->width != get_video_width() || tmp_frame->height != get_video_height()) {
-			g_critical ("First frame not yet initialized!");
-			is_processing = false;
-			return NULL;
+			cvReleaseImageHeader(&current_frame);
 		}
 
-		current_frame = cvCreateImage(cvGetSize(tmp_frame),
-                           tmp_frame->depth,
-                           tmp_frame->nChannels);		
-		
-		//IplImage *ptr = cvCreateImage(cvGetSize(tmp_frame),
-        //                   tmp_frame->depth,
-        //                   tmp_frame->nChannels);
-		//printf("[");
-		//printf("\nVideoServer: Copying frame to current frame... \n");
-		cvCopy(tmp_frame, current_frame, NULL);
-		//cvCopy(tmp_frame, ptr, NULL);
-		is_processing = false;
-		//printf("]");
-		//printf("\nVideoServer: ...did copy current frame. \n");
-		return current_frame;//ptr;
+		current_frame = cvCreateImageHeader(cvSize(frame->width, frame->height), IPL_DEPTH_8U, frame->channels);
 	}
 
-	send_report(kERROR_WARNING, "Unable to retrieve frame.\n");
+	// No copy: the header points to the mapped sample.
+	cvSetData(current_frame, frame->data, frame->stride);
+
+	return current_frame;
+}
 
-	return NULL;
+R2Frame* _ext_acquire_frame() {
+	return server ? frame_ring_acquire(server->ring) : NULL;
+}
+
+R2Frame* _ext_acquire_next_frame(guint64 sequence, int timeout_ms) {
+	return server ? frame_ring_acquire_next(server->ring, sequence, timeout_ms) : NULL;
+}
+
+void _ext_release_frame(R2Frame* frame) {
+	if (server) {
+		frame_ring_release(server->ring, frame);
+	}
 }
 
 
@@ -277,16 +333,13 @@ void send_report(int type, const char* msg) {
 
 int main (int argc, char** argv) {
 
-	set_input_vars("192.168.1.99", 5005, "192.168.1.99",
-		     "640", "480");
-
-	set_output_vars("192.168.0.19", "5006",
+	VideoServerPipeline *p = _ext_videoserver_create("192.168.1.99", 5005, "192.168.1.99",
+		     "640", "480", "192.168.0.19", "5006",
 		     "320", "240");
 
-	if (init_gst() &&
-	    init_opencv()) {
-		start_gst_loop ();
-		stop_gst_loop();
+	if (p) {
+		start_gst_loop (p);
+		dealloc (p);
 	}
 	else {
 		printf ("unable to initialize");
@@ -298,29 +351,43 @@ int main (int argc, char** argv) {
 /**/
 
 void _ext_dealloc() {
-	dealloc();
+
+	if (!server) {
+		return;
+	}
+
+	frame_ring_release(server->ring, current);
+	current = NULL;
+
+	dealloc(server);
+	server = NULL;
+
+	if (current_frame) {
+		cvReleaseImageHeader(&current_frame);
+	}
 }
 
 bool _ext_is_running() {
-	return is_running_gst_loop();
+	return server && is_running_gst_loop(server);
 }
 
 void _ext_set_input_vars (const char* remote_address, int remote_port, const char *local_ip,
 		     const char* width, const char* height) {
-	set_input_vars(remote_address, remote_port, local_ip,
+	set_input_vars(default_server(), remote_address, remote_port, local_ip,
 		     width, height);
 }
 
 void _ext_set_output_vars (const char* remote_address, const char* remote_port,
 		     const char* width, const char* height) {
-	set_output_vars(remote_address, remote_port,
+	set_output_vars(default_server(), remote_address, remote_port,
 		     width, height);
 }
 
+
 int _ext_get_video_width() {
-	return get_video_width();
+	return get_video_width(default_server());
 }
 
 int _ext_get_video_height() {
-	return get_video_height();
+	return get_video_height(default_server());
 }
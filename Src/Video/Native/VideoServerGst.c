@@ -23,12 +23,10 @@
 #include <stdlib.h>
 #include "gst/app/gstappsink.h"
 
-#define kTURN_OFF_BUS_MESSAGE "turn-off"
 #define DEFAULT_PORT "5005"
 #define DEFAULT_PREFIX "udp://"
 
 #define kUSE_APP_SINK
-//#define kUSE_V4L2SRC
 //#define kUSE_phone_sink
 //#define kUSE_DEBUG_SINK
 //#define kUSE_TEST_SINK
@@ -36,96 +34,67 @@
 #if (defined(kUSE_TEST_SINK) && defined(kUSE_phone_sink))
 #error "EN SINK DUMMER!"
 #endif
-static GMainLoop *loop;
-
-static GstElement
-		*pipeline, 	 		// the pipeline for the bin
-		*src,			// source
-		*csp_src, *csp_out, *csp_app, *csp_rtp, *csp_xvimg,
-		*tee,
-		*queue_out, // queue between tee and
-		*queue_app, 
-		*queue_rtp, 
-		*queue_xvimg,
-		*appsink,
-#ifndef kUSE_V4L2SRC
-		*rtpjitterbuffer, *rtph264depay, *avdec_h264,
-#endif
-		*jpegenc,
-		*videorate, *videoscale,
-		*xvimagesink, //for debugging
-		*phone_sink,
-		*test_sink;
-
-static GstBus *bus;	//the bus element te transport messages from/to the pipeline
-
-static int is_running;
-
-// UDP-data:
-
-static const char *ip;
-static int port;
-static const char *multicast;
-static const char *input_width;
-static const char *input_height;
-static bool input_is_set;
-// Client Data
 
-static const char *client_ip;
-static const char *client_port;
-static const char *output_width;
-static const char *output_height;
-static bool output_is_set;
+VideoServerPipeline* videoserver_pipeline_new() {
 
-static gboolean bus_call(GstBus *bus, GstMessage *msg, void *user_data);
+	VideoServerPipeline *p = calloc(1, sizeof(VideoServerPipeline));
+	p->ring = frame_ring_new();
 
-static const char*(*report_error)(int type, const char *message);	//delegate method for reporting back error
-static const char*(*report_eos)();	//delegate method for reporting eos
+	return p;
+}
 
-void set_cb(const char*(*report_error_callback)(int type, const char *message),
+void set_cb(VideoServerPipeline *p, const char*(*report_error_callback)(int type, const char *message),
 			const char*(*report_eos_callback)()) {
-	report_error = report_error_callback;
-	report_eos = report_eos_callback;
+	p->base.report_error = report_error_callback;
+	p->base.report_eos = report_eos_callback;
 }
 
 
 
-void set_input_vars (const char* remote_address, int remote_port, const char *local_ip,
+void set_input_vars (VideoServerPipeline *p, const char* remote_address, int remote_port, const char *local_ip,
 		     const char* width, const char* height) {
 
-	ip = strdup (remote_address);
-	port = remote_port;
-	multicast = strdup (local_ip);
-	input_width = strdup (width);
-	input_height = strdup (height);
-	input_is_set = true;
+	free (p->ip);
+	free (p->multicast);
+	free (p->input_width);
+	free (p->input_height);
+
+	p->ip = strdup (remote_address);
+	p->port = remote_port;
+	p->multicast = strdup (local_ip);
+	p->input_width = strdup (width);
+	p->input_height = strdup (height);
+	p->input_is_set = true;
 
 } 
 
-void set_output_vars (const char* remote_address, const char* remote_port,
+void set_output_vars (VideoServerPipeline *p, const char* remote_address, const char* remote_port,
 		     const char* width, const char* height) {
 
-	client_ip = strdup (remote_address);
-	client_port = strdup (remote_port);
-	output_width = strdup (width);
-	output_height = strdup (height);
-	output_is_set = true;
+	free (p->client_ip);
+	free (p->client_port);
+	free (p->output_width);
+	free (p->output_height);
+
+	p->client_ip = strdup (remote_address);
+	p->client_port = strdup (remote_port);
+	p->output_width = strdup (width);
+	p->output_height = strdup (height);
+	p->output_is_set = true;
 } 
 
-int init_gst() {
+int init_gst(VideoServerPipeline *p) {
 
 	
-	if (!input_is_set) {
+	if (!p->input_is_set) {
 		g_critical ("Input variables not set!\n");
 		return 0;
 	} else 
-	if (!output_is_set) {
+	if (!p->output_is_set) {
 		g_critical ("Output variables not set!\n");
 		return 0;
 	}
 
-	gst_init (NULL, NULL);
-
 	GstCaps *caps_out, *caps_app, *caps_tee, *caps_phone, *caps_src;
 #ifdef kUSE_TEST_SINK		
 #endif
@@ -138,64 +107,56 @@ int init_gst() {
 #endif
 ;
 
-	/* create the main loop */
-	loop = g_main_loop_new(NULL, FALSE);
-
-	pipeline = gst_pipeline_new ("video_pipeline");
-
-	/* create the bus for the pipeline */
-	bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline));
-
-	/* add the bus handler method */
-	gst_bus_add_watch(bus, bus_call, NULL);
-
-	gst_object_unref(bus);
+	/* create the pipeline, its main loop and the bus handler */
+	if (!r2_pipeline_init(&p->base, "VideoServer", NULL)) {
+		return 0;
+	}
 
 	//initializing elements
 #ifdef kUSE_V4L2SRC
-	src = gst_element_factory_make ("v4l2src", "src");
+	p->src = gst_element_factory_make ("v4l2src", "src");
 #else
-	src = gst_element_factory_make ("udpsrc", "src");
-	rtpjitterbuffer =  gst_element_factory_make ("rtpjitterbuffer", "rtpjitterbuffer");
-	rtph264depay  =  gst_element_factory_make ("rtph264depay", "rtph264depay");
-	avdec_h264  =  gst_element_factory_make ("avdec_h264", "avdec_h264");
+	p->src = gst_element_factory_make ("udpsrc", "src");
+	p->rtpjitterbuffer =  gst_element_factory_make ("rtpjitterbuffer", "rtpjitterbuffer");
+	p->rtph264depay  =  gst_element_factory_make ("rtph264depay", "rtph264depay");
+	p->avdec_h264  =  gst_element_factory_make ("avdec_h264", "avdec_h264");
 #endif	 
-	xvimagesink = gst_element_factory_make ("fpsdisplaysink", "fpsdisplaysink"); 
+	p->xvimagesink = gst_element_factory_make ("fpsdisplaysink", "fpsdisplaysink"); 
 	//xvimagesink = gst_element_factory_make ("fakesink", "xvimagesink");
-	phone_sink = gst_element_factory_make ("tcpserversink", "phone_sink");
-	appsink = gst_element_factory_make ("appsink", "appsink");
-	csp_src = gst_element_factory_make("videoconvert", "csp_src");
-	csp_out = gst_element_factory_make("videoconvert", "csp_out");
-	csp_app = gst_element_factory_make("videoconvert", "csp_app");
-	csp_rtp = gst_element_factory_make("videoconvert", "csp_rtp");
-	csp_xvimg = gst_element_factory_make("videoconvert", "csp_xvimg");
-	tee = gst_element_factory_make ("tee", "videotee");
-	queue_out = gst_element_factory_make ("queue", "queue_out");
-	queue_app = gst_element_factory_make ("queue", "queue_app");
-	queue_rtp = gst_element_factory_make ("queue", "queue_rtp");
-	queue_xvimg = gst_element_factory_make ("queue", "queue_xvimg");
-	videorate = gst_element_factory_make ("videorate", "videorate");
-	videoscale = gst_element_factory_make ("videoscale", "videoscale");
-	jpegenc = gst_element_factory_make ("jpegenc", "jpegenc");
+	p->phone_sink = gst_element_factory_make ("tcpserversink", "phone_sink");
+	p->appsink = gst_element_factory_make ("appsink", "appsink");
+	p->csp_src = gst_element_factory_make("videoconvert", "csp_src");
+	p->csp_out = gst_element_factory_make("videoconvert", "csp_out");
+	p->csp_app = gst_element_factory_make("videoconvert", "csp_app");
+	p->csp_rtp = gst_element_factory_make("videoconvert", "csp_rtp");
+	p->csp_xvimg = gst_element_factory_make("videoconvert", "csp_xvimg");
+	p->tee = gst_element_factory_make ("tee", "videotee");
+	p->queue_out = gst_element_factory_make ("queue", "queue_out");
+	p->queue_app = gst_element_factory_make ("queue", "queue_app");
+	p->queue_rtp = gst_element_factory_make ("queue", "queue_rtp");
+	p->queue_xvimg = gst_element_factory_make ("queue", "queue_xvimg");
+	p->videorate = gst_element_factory_make ("videorate", "videorate");
+	p->videoscale = gst_element_factory_make ("videoscale", "videoscale");
+	p->jpegenc = gst_element_factory_make ("jpegenc", "jpegenc");
 	
-	test_sink = gst_element_factory_make ("udpsink", "testsink");
+	p->test_sink = gst_element_factory_make ("udpsink", "testsink");
 
 
-	if (src == NULL || phone_sink == NULL || appsink == NULL) {
+	if (p->src == NULL || p->phone_sink == NULL || p->appsink == NULL) {
 		g_critical ("Unable to create src/sink elements.");
 		return 0;
-	} else 	if (!csp_out || !csp_src || !csp_app) {
+	} else 	if (!p->csp_out || !p->csp_src || !p->csp_app) {
 		g_critical ("Unable to create csps");
 		return 0;
-	} else if (!queue_out || !queue_app || !queue_rtp || !tee || !appsink || !jpegenc || !videorate || !videoscale) {
+	} else if (!p->queue_out || !p->queue_app || !p->queue_rtp || !p->tee || !p->appsink || !p->jpegenc || !p->videorate || !p->videoscale) {
 		g_critical ("Unable to create other elements");
 		return 0;
 	} 
-	 else if (!queue_xvimg || !csp_xvimg || !xvimagesink) {
+	 else if (!p->queue_xvimg || !p->csp_xvimg || !p->xvimagesink) {
 		g_critical ("Unable to create debug elements");
 		return 0;
 #ifndef kUSE_V4L2SRC
-	}  else if (!rtpjitterbuffer ||  !rtph264depay || !avdec_h264) {
+	}  else if (!p->rtpjitterbuffer ||  !p->rtph264depay || !p->avdec_h264) {
 		g_critical ("Unable to create input-elements (do you have h264 support?)");
 		return 0;
 #endif
@@ -207,73 +168,75 @@ int init_gst() {
 	
 	//g_object_set(G_OBJECT(src), "host", ip, NULL);
 #ifndef kUSE_V4L2SRC
-	g_object_set(G_OBJECT(src), "port", port, NULL);
+	g_object_set(G_OBJECT(p->src), "port", p->port, NULL);
 #endif
 	//free (address);
 
 	// Make sure the "new-sample" signal is emitted
-	gst_app_sink_set_emit_signals((GstAppSink*)appsink, true);
+	gst_app_sink_set_emit_signals((GstAppSink*)p->appsink, true);
 	// Tell the app sink to drop samples when the internal queue is full
-	gst_app_sink_set_drop((GstAppSink*)appsink, true);
+	gst_app_sink_set_drop((GstAppSink*)p->appsink, true);
 	// Set the internal queue to one element
-	gst_app_sink_set_max_buffers((GstAppSink*)appsink, 1);
+	gst_app_sink_set_max_buffers((GstAppSink*)p->appsink, 1);
 	
 	//set up video decoding
-	g_object_set(G_OBJECT(jpegenc), "quality", 10, NULL);
-	g_object_set(G_OBJECT(videorate), "max_rate", 2, NULL);
+	g_object_set(G_OBJECT(p->jpegenc), "quality", 10, NULL);
+	g_object_set(G_OBJECT(p->videorate), "max_rate", 2, NULL);
 
 	/* Add the elements to the pipeline prior to linking them */	
 
 	//gst_bin_add_many(GST_BIN(pipeline), src, rtpdepay , csp_src, tee, queue_out, csp_out, sink, queue_app, csp_app, appsink, queue_rtp, csp_rtp, videorate, videoscale, xvimagesink, csp_xvimg, queue_xvimg, NULL);
-	gst_bin_add_many(GST_BIN(pipeline), src, csp_src, tee, 
+	gst_bin_add_many(GST_BIN(p->base.pipeline), p->src, p->csp_src, p->tee, 
 #ifndef kUSE_V4L2SRC
-	rtpjitterbuffer, rtph264depay, avdec_h264, 
+	p->rtpjitterbuffer, p->rtph264depay, p->avdec_h264, 
 #endif
 #ifdef kUSE_DEBUG_SINK
-			xvimagesink, csp_xvimg, queue_xvimg, 
+			p->xvimagesink, p->csp_xvimg, p->queue_xvimg, 
 #endif
 #ifdef kUSE_APP_SINK
-			queue_app, csp_app, appsink,
+			p->queue_app, p->csp_app, p->appsink,
 #endif
 #ifdef kUSE_phone_sink
-			jpegenc, queue_out, csp_out, queue_rtp, csp_rtp, videoscale, phone_sink,
+			p->jpegenc, p->queue_out, p->csp_out, p->queue_rtp, p->csp_rtp, p->videoscale, p->phone_sink,
 #endif
 #ifdef kUSE_TEST_SINK
 			
-			queue_out, csp_out, videoscale , jpegenc, test_sink,
+			p->queue_out, p->csp_out, p->videoscale , p->jpegenc, p->test_sink,
 #endif
 //phone_sink,
 			NULL);
 
+	tee_init(&p->branches, &p->base, p->tee);
+
 	/* Specify caps for the csp-filters (modify these if you require).
 	   Currently, the first videoconvert (csp) changes resolution. 
 	*/
 #ifdef kUSE_V4L2SRC
 	caps_src = gst_caps_new_simple("application/x-rtp",
 			"payload", G_TYPE_INT, 96,
-			"width", G_TYPE_INT, atoi(input_width),
-			"height", G_TYPE_INT, atoi(input_height),
+			"width", G_TYPE_INT, atoi(p->input_width),
+			"height", G_TYPE_INT, atoi(p->input_height),
 			NULL);
 #else
 
 #endif
 	caps_tee = gst_caps_new_simple("video/x-raw",
-			"width", G_TYPE_INT, atoi(input_width),
-			"height", G_TYPE_INT, atoi(input_height),
+			"width", G_TYPE_INT, atoi(p->input_width),
+			"height", G_TYPE_INT, atoi(p->input_height),
 			NULL);
 
 	// Does nothing really... 
 	caps_out = gst_caps_new_simple("video/x-raw", 
 				"format", G_TYPE_STRING, "YUY2",
-				"width", G_TYPE_INT, atoi(input_width),
-				"height", G_TYPE_INT, atoi(input_height),
+				"width", G_TYPE_INT, atoi(p->input_width),
+				"height", G_TYPE_INT, atoi(p->input_height),
 				NULL);
 
 
 	// Caps for scaling before rtpvrawdepay
 	caps_phone = gst_caps_new_simple("video/x-raw",
-			"width", G_TYPE_INT, atoi(output_width),
-			"height", G_TYPE_INT, atoi(output_height),
+			"width", G_TYPE_INT, atoi(p->output_width),
+			"height", G_TYPE_INT, atoi(p->output_height),
 			NULL);
 
 	/* OpenCV requires BGR format */
@@ -283,93 +246,82 @@ int init_gst() {
 
 
 	/* Set the Output queue */
-	g_object_set(G_OBJECT(queue_rtp), "max_size_buffers", 2, NULL);
-	g_object_set(G_OBJECT(queue_rtp), "leaky", true, NULL);
+	g_object_set(G_OBJECT(p->queue_rtp), "max_size_buffers", 2, NULL);
+	g_object_set(G_OBJECT(p->queue_rtp), "leaky", true, NULL);
 
 	/* Set up the udpsink */
-	g_object_set(G_OBJECT(phone_sink), "port", atoi(client_port), NULL);
-	g_object_set(G_OBJECT(phone_sink), "host", client_ip, NULL);
+	g_object_set(G_OBJECT(p->phone_sink), "port", atoi(p->client_port), NULL);
+	g_object_set(G_OBJECT(p->phone_sink), "host", p->client_ip, NULL);
 	
 	/* Link the camera source and colorspace filter using capabilities
 	 * specified */
 #ifndef kUSE_V4L2SRC
-	if(!gst_element_link_filtered(src, rtpjitterbuffer, caps_src))
+	if(!gst_element_link_filtered(p->src, p->rtpjitterbuffer, caps_src))
 	{
-		gst_object_unref (pipeline);
 		g_critical ("Unable to link udpsrc with caps_src to rtpjitterbuffer. check your caps.");
 		return 0;
 	}
 
-	if(!gst_element_link_many(rtpjitterbuffer, rtph264depay, avdec_h264, NULL))
+	if(!gst_element_link_many(p->rtpjitterbuffer, p->rtph264depay, p->avdec_h264, NULL))
 	{
-		gst_object_unref (pipeline);
 		g_critical ("Unable to link rtpjitterbuffer, rtph264depay, avdec_h264 ");
 		return 0;
 	}
 	
-	if(!gst_element_link_filtered(avdec_h264, csp_src, caps_tee))
+	if(!gst_element_link_filtered(p->avdec_h264, p->csp_src, caps_tee))
 	{
-		gst_object_unref (pipeline);
 		g_critical ("Unable to link csp_src to tee. check your caps.");
 		return 0;
 	}
 #else
-	if(!gst_element_link_many(src, csp_src, NULL))
+	if(!gst_element_link_many(p->src, p->csp_src, NULL))
 	{
-		gst_object_unref (pipeline);
 		g_critical ("Unable to link rtpjitterbuffer, rtph264depay, avdec_h264 ");
 		return 0;
 	}
 #endif
-	if(!gst_element_link_many(csp_src, tee, NULL))
+	if(!gst_element_link_many(p->csp_src, p->tee, NULL))
 	{
-		gst_object_unref (pipeline);
 		g_critical ("Unable to linkcsp_src to tee ");
 		return 0;
 	}
 	
 	// Link the udp-sink
 #ifdef kUSE_phone_sink	
-	if(!gst_element_link_filtered(queue_out, csp_out, caps_out))
+	if(!gst_element_link_filtered(p->queue_out, p->csp_out, caps_out))
 	{
-		gst_object_unref (pipeline);
 		g_critical ("Unable to link first for the queue 1");
 		return 0;
 	}
 
-	if(!gst_element_link_many(csp_out, videoscale, NULL))
+	if(!gst_element_link_many(p->csp_out, p->videoscale, NULL))
 	{
-		gst_object_unref (pipeline);
 		g_critical ("Unable to link second. for queue1");
 		return 0;
 	}
 
-	if(!gst_element_link_filtered(videoscale, jpegenc, caps_phone))
+	if(!gst_element_link_filtered(p->videoscale, p->jpegenc, caps_phone))
 	{
-		gst_object_unref (pipeline);
 		g_critical ("Unable to link third. check your caps.");
 		return 0;
 	}
 
-	if(!gst_element_link_many( jpegenc, phone_sink,NULL))
+	if(!gst_element_link_many( p->jpegenc, p->phone_sink,NULL))
 	{
-		gst_object_unref (pipeline);
 		g_critical ("Unable to link middle. for queue1");
 		return 0;
 	}
 
 #endif
 #ifdef kUSE_TEST_SINK
-	if(!gst_element_link_filtered(queue_out, csp_out, caps_out))
+	if(!gst_element_link_filtered(p->queue_out, p->csp_out, caps_out))
 	{
-		gst_object_unref (pipeline);
 		g_critical ("TEST: Unable to link first for the queue 1");
 		return 0;
 	}
 
-	if(!gst_element_link_many(csp_out, videoscale, jpegenc, test_sink,NULL))
+	if(!gst_element_link_many(p->csp_out, p->videoscale, p->jpegenc, p->test_sink,NULL))
 	{
-		gst_object_unref (pipeline);
 		g_critical ("TEST: Unable to link middle. for queue1");
 		return 0;
 	}
@@ -379,16 +331,14 @@ int init_gst() {
 #ifdef kUSE_APP_SINK
 	// Link the app-sink
 
-	if(!gst_element_link_many(queue_app, csp_app, NULL))
+	if(!gst_element_link_many(p->queue_app, p->csp_app, NULL))
 	{
-		gst_object_unref (pipeline);
 		g_critical ("Unable to link queue_app to csp");
 		return 0;
 	}
 
-	if(!gst_element_link_filtered(csp_app, appsink, caps_app))
+	if(!gst_element_link_filtered(p->csp_app, p->appsink, caps_app))
 	{
-		gst_object_unref (pipeline);
 		g_critical ("Unable to link csp_app to appsink. check your caps.");
 		return 0;
 	}
@@ -397,9 +347,8 @@ int init_gst() {
 #ifdef kUSE_DEBUG_SINK	
 	/* Link the (debug) xvimagesink */
 
-	if(!gst_element_link_many(queue_xvimg, csp_xvimg,xvimagesink, NULL))
+	if(!gst_element_link_many(p->queue_xvimg, p->csp_xvimg,p->xvimagesink, NULL))
 	{
-		gst_object_unref (pipeline);
 		g_critical ("Unable to link queue_xvimg to csp");
 		return 0;
 	}
@@ -409,8 +358,7 @@ int init_gst() {
 
 	GstPadTemplate *tee_src_pad_template;
 
-	if ( !(tee_src_pad_template = gst_element_class_get_pad_template (GST_ELEMENT_GET_CLASS (tee), "src_%u"))) {
-		gst_object_unref (pipeline);
+	if ( !(tee_src_pad_template = gst_element_class_get_pad_template (GST_ELEMENT_GET_CLASS (p->tee), "src_%u"))) {
 		g_critical ("Unable to get pad template");
 		return 0;		
 	}
@@ -418,14 +366,13 @@ int init_gst() {
 #if defined(kUSE_phone_sink) || defined(kUSE_TEST_SINK)
 	GstPad *tee_queue_out_pad, *queue_out_pad;
 
-	tee_queue_out_pad = gst_element_request_pad (tee, tee_src_pad_template, NULL, NULL);
+	tee_queue_out_pad = gst_element_request_pad (p->tee, tee_src_pad_template, NULL, NULL);
 	g_print ("Obtained request pad %s for queue_out branch.\n", gst_pad_get_name (tee_queue_out_pad));
-	queue_out_pad = gst_element_get_static_pad (queue_out, "sink");
+	queue_out_pad = gst_element_get_static_pad (p->queue_out, "sink");
 
 	if (gst_pad_link (tee_queue_out_pad, queue_out_pad) != GST_PAD_LINK_OK ){
 	
 		g_critical ("Tee for queue_out could not be linked.\n");
-		gst_object_unref (pipeline);
 		return 0;
 
 	}
@@ -440,14 +387,13 @@ int init_gst() {
 	
 	GstPad  *tee_queue_app_pad, *queue_app_pad;
 
-	tee_queue_app_pad = gst_element_request_pad (tee, tee_src_pad_template, NULL, NULL);
+	tee_queue_app_pad = gst_element_request_pad (p->tee, tee_src_pad_template, NULL, NULL);
 	g_print ("Obtained request pad %s for queue_app branch.\n", gst_pad_get_name (tee_queue_app_pad));
-	queue_app_pad = gst_element_get_static_pad (queue_app, "sink");
+	queue_app_pad = gst_element_get_static_pad (p->queue_app, "sink");
 
 	if (gst_pad_link (tee_queue_app_pad, queue_app_pad) != GST_PAD_LINK_OK) {
 
 		g_critical ("Tee for queue_app could not be linked.\n");
-		gst_object_unref (pipeline);
 		return 0;
 	}
 
@@ -459,14 +405,13 @@ int init_gst() {
 
 	GstPad   *tee_queue_xvimg_pad, *queue_xvimg_pad;
 
-	tee_queue_xvimg_pad = gst_element_request_pad (tee, tee_src_pad_template, NULL, NULL);
+	tee_queue_xvimg_pad = gst_element_request_pad (p->tee, tee_src_pad_template, NULL, NULL);
 	g_print ("Obtained request pad %s for queue_out branch.\n", gst_pad_get_name (tee_queue_xvimg_pad));
-	queue_xvimg_pad = gst_element_get_static_pad (queue_xvimg, "sink");
+	queue_xvimg_pad = gst_element_get_static_pad (p->queue_xvimg, "sink");
 
 	if (gst_pad_link (tee_queue_xvimg_pad, queue_xvimg_pad) != GST_PAD_LINK_OK) {
 
 		g_critical ("Tee for queue_xvimg could not be linked.\n");
-		gst_object_unref (pipeline);
 		return 0;
 	}
 	
@@ -478,152 +423,72 @@ int init_gst() {
 	return 1;
 }
 
-GstElement* get_appsink() {
-	return appsink;
+GstElement* get_appsink(VideoServerPipeline *p) {
+	return p->appsink;
 }
 
-void dealloc () {
-	if (is_running) {
-		g_main_loop_quit(loop);
-	}
-	is_running = 0;
-	gst_element_set_state(GST_ELEMENT(pipeline), GST_STATE_NULL);
-	gst_object_unref(GST_OBJECT(pipeline));
-	g_main_loop_unref (loop);
+R2TeeBranch* add_branch(VideoServerPipeline *p, int type, const char *target, int port, int width, int height) {
+	return tee_branch_add(&p->branches, type, target, port, width, height);
 }
 
-void start_gst_loop() {
+void remove_branch(VideoServerPipeline *p, R2TeeBranch *branch) {
+	tee_branch_remove(&p->branches, branch);
+}
+
+void dealloc (VideoServerPipeline *p) {
+
+	// The branches are released while nothing is streaming through the tee.
+	r2_pipeline_stop(&p->base);
+	tee_clear(&p->branches);
+	r2_pipeline_dispose(&p->base);
+	frame_ring_free(p->ring);
+
+	free (p->ip);
+	free (p->multicast);
+	free (p->input_width);
+	free (p->input_height);
+	free (p->client_ip);
+	free (p->client_port);
+	free (p->output_width);
+	free (p->output_height);
+	free (p);
+}
+
+void start_gst_loop(VideoServerPipeline *p) {
 
 	g_message ("Starting loop.");
-	gst_element_set_state(GST_ELEMENT(pipeline), GST_STATE_PLAYING);
-	is_running = 1;
-	g_main_loop_run(loop);
-	gst_element_set_state(GST_ELEMENT(pipeline), GST_STATE_READY);
-	
-	is_running = 0;
+	r2_pipeline_run(&p->base);
 }
 
-//stop the main loop and dealocate resources
+bool start_gst_pipeline(VideoServerPipeline *p) {
 
-void stop_gst_loop() {
+	g_message ("Starting pipeline.");
+	return r2_pipeline_start(&p->base);
+}
 
-	GValue text_gv = {0};
-	g_value_init (&text_gv, G_TYPE_STRING);
-	g_value_set_string(&text_gv, "turn_off");
+//stop the pipeline (and make start_gst_loop return)
 
-	//creates message structure for the partial result:
-	GstStructure *messageStruct = gst_structure_new_empty (kTURN_OFF_BUS_MESSAGE);
-	//set the hypothesis (the guessed text)
-	gst_structure_set_value (messageStruct, "hyp", &text_gv);	
+void stop_gst_loop(VideoServerPipeline *p) {
 
-	//post message to the pipeline bus
-	
-	if (gst_bus_post(
-		gst_element_get_bus(src), 
-		gst_message_new_application((GstObject *) src, messageStruct)))
-	{
-		//TODO: something if post failed...
-	}
-		//unref elements
-	
+	r2_pipeline_stop(&p->base);
 	printf("---------------------------------turned off video server.");
-/*
-	g_main_loop_quit(loop);
-	gst_object_unref(GST_OBJECT(pipeline));
-	g_main_loop_unref (loop);
-*/
-}
-
-int is_running_gst_loop () {
-	return is_running;
 }
 
-void resume_from_eos () 
-{
-	
-	gst_element_set_state (pipeline, GST_STATE_PLAYING);
-	is_running = true;
+int is_running_gst_loop (VideoServerPipeline *p) {
+	return r2_pipeline_is_running(&p->base);
 }
 
-
-static gboolean bus_call(GstBus *bus, GstMessage *msg, void *user_data)
+void resume_from_eos (VideoServerPipeline *p)
 {
-
-	switch (GST_MESSAGE_TYPE(msg)) {
-	case GST_MESSAGE_EOS: {
-		
-		is_running = false;
-
-		g_main_loop_quit(loop);
-		if (report_eos != NULL) {
-			report_eos();		
-		}
-		g_message("End-of-stream - Dealocating everything");
-		dealloc();
-		break;
+	if (!r2_pipeline_is_running(&p->base)) {
+		r2_pipeline_start(&p->base);
 	}
-	case GST_MESSAGE_ERROR: {
-		GError *err;
-		gst_message_parse_error(msg, &err, NULL);
-		is_running = false;
-		if (report_error != NULL) {
-			report_error(kERROR_CRITICAL , "VideoServer encountered an error and will stop:");
-		}
-
-		g_critical ("ERROR: %s", err->message);
-		g_error_free(err);
-		
-		g_main_loop_quit(loop);
-		dealloc();
-		
-		break;
-	} 
-	case GST_MESSAGE_APPLICATION: {
-
-		const GstStructure *str;
-		str = gst_message_get_structure (msg);
-		 if (gst_structure_has_name(str, kTURN_OFF_BUS_MESSAGE))
-			{
-				is_running = false;
-				g_main_loop_quit(loop);
-			}
-
-		break;
-	}
-	default:
-	
-		break;
-	}
-		if (msg->type == GST_MESSAGE_STATE_CHANGED ) {
-			GstState old_state, new_state, pending_state;
-     			gst_message_parse_state_changed (msg, &old_state, &new_state, &pending_state);
-/*
-			g_print ("Element %s changed state from %s to %s with pending: %s.\n",
-        			GST_OBJECT_NAME (msg->src),
-        			gst_element_state_get_name (old_state),
-       				 gst_element_state_get_name (new_state),
-				gst_element_state_get_name (pending_state));
-*/
-
-		} else {
-//			g_print ("info: %i %s type: %i\n", (int)(msg->timestamp), GST_MESSAGE_TYPE_NAME (msg), msg->type);
-		}
-
-	return true;
 }
 
-
-void dealloc_gst() {
-//	free (ip);
-//	free (multicast);
-//	free (port);
-}
-
-
-int get_video_width() {
-	return atoi(input_width);
+int get_video_width(VideoServerPipeline *p) {
+	return atoi(p->input_width);
 }
 
-int get_video_height() {
-	return atoi(input_height);
+int get_video_height(VideoServerPipeline *p) {
+	return atoi(p->input_height);
 }
@@ -16,28 +16,89 @@
 // along with r2Project. If not, see <http://www.gnu.org/licenses/>.
 // 
 
+#ifndef VIDEO_SERVER_GST_H
+#define VIDEO_SERVER_GST_H
+
 #include <gst/gst.h>
+#include "R2Pipeline.h"
+#include "FrameRing.h"
+#include "TeeBranch.h"
+
+// Uses a local camera instead of the H.264 UDP stream
+//#define kUSE_V4L2SRC
+
+// One H.264/UDP input stream: its pipeline, elements and frames.
+typedef struct {
+	R2Pipeline base;
+
+	GstElement
+		*src,			// source
+		*csp_src, *csp_out, *csp_app, *csp_rtp, *csp_xvimg,
+		*tee,
+		*queue_out, // queue between tee and
+		*queue_app,
+		*queue_rtp,
+		*queue_xvimg,
+		*appsink,
+#ifndef kUSE_V4L2SRC
+		*rtpjitterbuffer, *rtph264depay, *avdec_h264,
+#endif
+		*jpegenc,
+		*videorate, *videoscale,
+		*xvimagesink, //for debugging
+		*phone_sink,
+		*test_sink;
+
+	// the output branches added at runtime
+	R2Tee branches;
 
-#define kERROR_WARNING 0
-#define kERROR_CRITICAL 1
+	// frames from the appsink
+	R2FrameRing *ring;
+	bool pause_fetching;
 
-int init_gst();
+	// UDP-data:
+	char *ip;
+	int port;
+	char *multicast;
+	char *input_width;
+	char *input_height;
+	bool input_is_set;
 
-GstCaps* get_udpsrc_caps();
-void start_gst_loop();
-void stop_gst_loop();
-GstElement* get_appsink();
-int is_running_gst_loop ();
-void set_cb(const char*(*report_error_callback)(int type, const char *message),
+	// Client Data
+	char *client_ip;
+	char *client_port;
+	char *output_width;
+	char *output_height;
+	bool output_is_set;
+} VideoServerPipeline;
+
+VideoServerPipeline* videoserver_pipeline_new();
+int init_gst(VideoServerPipeline *p);
+
+// blocks until the pipeline is stopped
+void start_gst_loop(VideoServerPipeline *p);
+// returns as soon as the pipeline is playing. the bus is handled by the shared loop thread
+bool start_gst_pipeline(VideoServerPipeline *p);
+void stop_gst_loop(VideoServerPipeline *p);
+GstElement* get_appsink(VideoServerPipeline *p);
+int is_running_gst_loop (VideoServerPipeline *p);
+void set_cb(VideoServerPipeline *p, const char*(*report_error_callback)(int type, const char *message),
 			const char*(*report_eos_callback)());
 
-void set_input_vars (const char* remote_address, int remote_port, const char *local_ip,
+void set_input_vars (VideoServerPipeline *p, const char* remote_address, int remote_port, const char *local_ip,
 		     const char* width, const char* height);
-void set_output_vars (const char* remote_address, const char* remote_port,
+void set_output_vars (VideoServerPipeline *p, const char* remote_address, const char* remote_port,
 		     const char* width, const char* height);
 
-int get_video_width();
-int get_video_height();
+int get_video_width(VideoServerPipeline *p);
+int get_video_height(VideoServerPipeline *p);
+
+// Adds an output branch (see TeeBranch.h) to the tee. May be called while the pipeline is playing.
+R2TeeBranch* add_branch(VideoServerPipeline *p, int type, const char *target, int port, int width, int height);
+void remove_branch(VideoServerPipeline *p, R2TeeBranch *branch);
+
+// Stops the pipeline and frees the instance.
+void dealloc (VideoServerPipeline *p);
+void resume_from_eos (VideoServerPipeline *p);
 
-void dealloc ();
-void resume_from_eos ();
+#endif
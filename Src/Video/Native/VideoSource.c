@@ -0,0 +1,178 @@
+// This file is part of r2Poject.
+//
+// Copyright 2016 Tord Wessman
+//
+// r2Project is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// r2Project is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with r2Project. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "VideoSource.h"
+#include "r2gstloop.h"
+#include <stdbool.h>
+#include <string.h>
+
+static GstCaps* source_caps(int width, int height, int fps) {
+
+	return gst_caps_new_simple("video/x-raw",
+		"width", G_TYPE_INT, width,
+		"height", G_TYPE_INT, height,
+		"framerate", GST_TYPE_FRACTION, fps > 0 ? fps : kSOURCE_DEFAULT_FPS, 1,
+		NULL);
+}
+
+static void add_ghost_src_pad(GstElement *bin, GstElement *last) {
+
+	GstPad *pad = gst_element_get_static_pad(last, "src");
+	gst_element_add_pad(bin, gst_ghost_pad_new("src", pad));
+	gst_object_unref(pad);
+}
+
+static GstElement* test_source_new(int pattern, int width, int height, int fps) {
+
+	GstElement *bin = gst_bin_new("test_source");
+	GstElement *src = gst_element_factory_make("videotestsrc", NULL);
+	GstElement *filter = gst_element_factory_make("capsfilter", NULL);
+
+	if (src) { gst_bin_add(GST_BIN(bin), src); }
+	if (filter) { gst_bin_add(GST_BIN(bin), filter); }
+
+	if (!src || !filter) {
+		g_critical("Unable to create videotestsrc.");
+		gst_object_unref(bin);
+		return NULL;
+	}
+
+	// Live, so that the frames are produced at the frame rate (like a camera) and time stamped with the running time.
+	g_object_set(G_OBJECT(src), "is-live", true, "pattern", pattern, NULL);
+
+	GstCaps *caps = source_caps(width, height, fps);
+	g_object_set(G_OBJECT(filter), "caps", caps, NULL);
+	gst_caps_unref(caps);
+
+	gst_element_link(src, filter);
+	add_ghost_src_pad(bin, filter);
+
+	return bin;
+}
+
+// Links the first raw video pad of decodebin to the converter.
+static void decoded_pad_added(GstElement *decodebin, GstPad *pad, gpointer user_data) {
+
+	GstElement *convert = (GstElement *)user_data;
+	GstPad *sink_pad = gst_element_get_static_pad(convert, "sink");
+	GstCaps *caps = gst_pad_get_current_caps(pad);
+
+	if (!caps) {
+		caps = gst_pad_query_caps(pad, NULL);
+	}
+
+	const gchar *name = gst_structure_get_name(gst_caps_get_structure(caps, 0));
+
+	if (!gst_pad_is_linked(sink_pad) && g_str_has_prefix(name, "video/x-raw")) {
+
+		if (gst_pad_link(pad, sink_pad) != GST_PAD_LINK_OK) {
+			g_critical("Unable to link the decoded video.");
+		}
+	}
+
+	gst_caps_unref(caps);
+	gst_object_unref(sink_pad);
+}
+
+static gboolean rewind_file(gpointer user_data) {
+
+	GstElement *decodebin = (GstElement *)user_data;
+
+	if (!gst_element_seek_simple(decodebin, GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT, 0)) {
+		g_critical("Unable to rewind the video file.");
+	}
+
+	gst_object_unref(decodebin);
+
+	return G_SOURCE_REMOVE;
+}
+
+// Replaces the EOS of the file with a seek to its beginning. The seek can't be done from the streaming thread.
+static GstPadProbeReturn loop_on_eos(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+
+	if (GST_EVENT_TYPE(GST_PAD_PROBE_INFO_EVENT(info)) != GST_EVENT_EOS) {
+		return GST_PAD_PROBE_PASS;
+	}
+
+	r2_loop_invoke(rewind_file, gst_object_ref(GST_ELEMENT(user_data)));
+
+	return GST_PAD_PROBE_DROP;
+}
+
+static GstElement* file_source_new(const char *location, int width, int height, int fps) {
+
+	if (!location) {
+		g_critical("No video file given.");
+		return NULL;
+	}
+
+	GstElement *bin = gst_bin_new("file_source");
+	GstElement *src = gst_element_factory_make("filesrc", NULL);
+	GstElement *decodebin = gst_element_factory_make("decodebin", NULL);
+	GstElement *convert = gst_element_factory_make("videoconvert", NULL);
+	GstElement *scale = gst_element_factory_make("videoscale", NULL);
+	GstElement *rate = gst_element_factory_make("videorate", NULL);
+	GstElement *filter = gst_element_factory_make("capsfilter", NULL);
+	GstElement *elements[] = { src, decodebin, convert, scale, rate, filter };
+
+	for (int i = 0; i < G_N_ELEMENTS(elements); i++) {
+		if (elements[i]) {
+			gst_bin_add(GST_BIN(bin), elements[i]);
+		}
+	}
+
+	if (!src || !decodebin || !convert || !scale || !rate || !filter) {
+		g_critical("Unable to create the file source elements.");
+		gst_object_unref(bin);
+		return NULL;
+	}
+
+	g_object_set(G_OBJECT(src), "location", location, NULL);
+
+	GstCaps *caps = source_caps(width, height, fps);
+	g_object_set(G_OBJECT(filter), "caps", caps, NULL);
+	gst_caps_unref(caps);
+
+	if (!gst_element_link(src, decodebin) || !gst_element_link_many(convert, scale, rate, filter, NULL)) {
+		g_critical("Unable to link the file source.");
+		gst_object_unref(bin);
+		return NULL;
+	}
+
+	g_signal_connect(decodebin, "pad-added", G_CALLBACK(decoded_pad_added), convert);
+
+	GstPad *convert_pad = gst_element_get_static_pad(convert, "sink");
+	gst_pad_add_probe(convert_pad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, loop_on_eos, decodebin, NULL);
+	gst_object_unref(convert_pad);
+
+	add_ghost_src_pad(bin, filter);
+
+	return bin;
+}
+
+GstElement* video_source_new(int type, const char *location, int pattern, int width, int height, int fps) {
+
+	switch (type) {
+	case kSOURCE_TEST:
+		return test_source_new(pattern, width, height, fps);
+	case kSOURCE_FILE:
+		return file_source_new(location, width, height, fps);
+	default:
+		return NULL;
+	}
+}
@@ -0,0 +1,41 @@
+// This file is part of r2Poject.
+//
+// Copyright 2016 Tord Wessman
+//
+// r2Project is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// r2Project is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with r2Project. If not, see <http://www.gnu.org/licenses/>.
+//
+
+/**
+*	Sources that don't require a camera: videotestsrc patterns and video files decoded in a loop.
+*	Used to run (and benchmark) the pipelines on machines without capture hardware.
+**/
+
+#ifndef VIDEO_SOURCE_H
+#define VIDEO_SOURCE_H
+
+#include <gst/gst.h>
+
+// Source types
+#define kSOURCE_DEVICE 0		// the camera (v4l2src)
+#define kSOURCE_TEST 1			// videotestsrc (location is ignored)
+#define kSOURCE_FILE 2			// the video file at location, restarted when it ends
+
+// The frame rate used if none is given
+#define kSOURCE_DEFAULT_FPS 30
+
+// Creates a bin with a "src" pad producing raw video of the given size and frame rate (0 for the default).
+// pattern is the videotestsrc pattern (i.e. 0 for smpte, 18 for ball). Returns NULL for kSOURCE_DEVICE or on failure.
+GstElement* video_source_new(int type, const char *location, int pattern, int width, int height, int fps);
+
+#endif
@@ -13,7 +13,7 @@ namespace R2Core.Video
 		protected delegate void FileRecordedCallback(string filename);
 
 		[DllImport(dllPath, CharSet = CharSet.Auto)]
-		protected static extern int _ext_rpir_record(string filename, FileRecordedCallback done);
+		protected static extern int _ext_rpir_record_async(string filename, FileRecordedCallback done);
 
 		[DllImport(dllPath, CharSet = CharSet.Auto)]
 		protected static extern void _ext_rpir_stop();
@@ -27,9 +27,17 @@ namespace R2Core.Video
 		[DllImport(dllPath, CharSet = CharSet.Auto)]
 		protected static extern void _ext_rpir_init(int port, string address);
 
-		private Task m_recordTask;
+		[DllImport(dllPath, CharSet = CharSet.Auto)]
+		protected static extern int _ext_rpir_arm(string location, int preEventSeconds, int segmentSeconds, FileRecordedCallback done);
+
+		[DllImport(dllPath, CharSet = CharSet.Auto)]
+		protected static extern bool _ext_rpir_trigger();
+
 		private string m_path;
 		private IFileConverter m_converter;
+		// Referenced for as long as the native recorder may call them.
+		private FileRecordedCallback m_segmentCallback;
+		private FileRecordedCallback m_recordingCallback;
 
 		public RPiCameraClient(string id, string path, IFileConverter converter) : base (id) {
 
@@ -47,8 +55,55 @@ namespace R2Core.Video
 		protected void RecordingFinished(string filename) {
 
 			string outputFilename = System.IO.Path.Combine(m_path, filename + ".mp4");
-			m_converter.Convert(filename, outputFilename);
-			System.IO.File.Delete(filename);
+
+			// Called from the shared GStreamer loop thread, which must not wait for the conversion.
+			Task.Run(() => {
+
+				try {
+
+					m_converter.Convert(filename, outputFilename);
+					System.IO.File.Delete(filename);
+
+				} catch (Exception ex) {
+
+					Log.x(ex);
+
+				}
+
+			});
+
+		}
+
+		protected void SegmentRecorded(string filename) {
+
+			Log.d($"Recorded segment: '{filename}'.");
+
+		}
+
+		/// <summary>
+		/// Keeps the last preEventSeconds of the stream in memory without writing anything. When Trigger is called, they are
+		/// written to segments of segmentSeconds (in the path of the client), followed by the live stream until Stop is called.
+		/// </summary>
+		public void Arm(int preEventSeconds, int segmentSeconds) {
+
+			string location = System.IO.Path.Combine(m_path, DateTime.Now.ToString("yyyyMMddHHmmss") + "_%05d.mkv");
+			m_segmentCallback = new FileRecordedCallback(this.SegmentRecorded);
+
+			if (_ext_rpir_arm(location, preEventSeconds, segmentSeconds, m_segmentCallback) != 0) {
+
+				throw new ApplicationException($"Unable to arm the pre-event recording to '{location}'.");
+
+			}
+
+		}
+
+		public void Trigger() {
+
+			if (!_ext_rpir_trigger()) {
+
+				throw new ApplicationException("Unable to trigger the recording. The recorder is not armed.");
+
+			}
 
 		}
 
@@ -74,17 +129,14 @@ namespace R2Core.Video
 			
 			}
 
-			m_recordTask = new Task (() => {
+			m_recordingCallback = new FileRecordedCallback(this.RecordingFinished);
 
-				if (_ext_rpir_record(filename, new FileRecordedCallback(this.RecordingFinished)) != 0) {
-					
-					Log.e($"Recording failed for file: '{_ext_rpir_get_filename()}'.");
+			// The recording runs on the shared GStreamer loop thread.
+			if (_ext_rpir_record_async(filename, m_recordingCallback) != 0) {
 
-				}
-
-			});
+				Log.e($"Recording failed for file: '{_ext_rpir_get_filename()}'.");
 
-			m_recordTask.Start();
+			}
 
 		}
 
@@ -1,7 +1,6 @@
 ﻿using System;
 using R2Core.Device;
 using System.Runtime.InteropServices;
-using System.Threading.Tasks;
 
 namespace R2Core.Video
 {
@@ -10,7 +9,7 @@ namespace R2Core.Video
 		private const string dllPath = "libr2picam.so";
 
 		[DllImport(dllPath, CharSet = CharSet.Auto)]
-		protected static extern void _ext_rpi_start();
+		protected static extern bool _ext_rpi_start_async();
 
 		[DllImport(dllPath, CharSet = CharSet.Auto)]
 		protected static extern void _ext_rpi_stop();
@@ -39,6 +38,15 @@ namespace R2Core.Video
 		[DllImport(dllPath, CharSet = CharSet.Auto)]
 		protected static extern void _ext_rpi_init_extended(int width, int height, int port, int bitrate, int framerate);
 
+		[DllImport(dllPath, CharSet = CharSet.Auto)]
+		protected static extern bool _ext_rpi_set_adaptive(int minBitrate, int maxBitrate, int minFramerate, int maxFramerate);
+
+		[DllImport(dllPath, CharSet = CharSet.Auto)]
+		protected static extern int _ext_rpi_get_bitrate();
+
+		[DllImport(dllPath, CharSet = CharSet.Auto)]
+		protected static extern void _ext_rpi_set_rtp_output(string hosts);
+
 		public RPiCameraServer(string id, int width, int height, int port) : base(id) {
 
 			_ext_rpi_init(width, height, port); 
@@ -50,6 +58,30 @@ namespace R2Core.Video
 		public int Width { get { return _ext_rpi_get_width(); } }
 		public int Height { get { return _ext_rpi_get_height(); } }
 		public int Framerate { get { return _ext_rpi_get_framerate(); } }
+		public int Bitrate { get { return _ext_rpi_get_bitrate(); } }
+
+		/// <summary>
+		/// Streams RTP to a multicast group (i.e. "239.0.0.1") or to a comma separated list of "host[:port]" instead of serving
+		/// TCP clients. null restores the TCP output. Must be called before Start.
+		/// </summary>
+		public void SetRtpOutput(string hosts) {
+
+			_ext_rpi_set_rtp_output(hosts);
+
+		}
+
+		/// <summary>
+		/// Lets the bitrate (bit/s) and framerate follow the bandwidth of the clients within the bounds. Must be called before Start.
+		/// </summary>
+		public void SetAdaptive(int minBitrate, int maxBitrate, int minFramerate, int maxFramerate) {
+
+			if (!_ext_rpi_set_adaptive(minBitrate, maxBitrate, minFramerate, maxFramerate)) {
+
+				throw new ArgumentException("Invalid adaptive bitrate or framerate bounds.");
+
+			}
+
+		}
 
 		public override void Start() {
 			
@@ -61,7 +93,12 @@ namespace R2Core.Video
 
 			}
 
-			Task.Factory.StartNew (() => { _ext_rpi_start(); });
+			// The native pipeline runs on the shared GStreamer loop thread.
+			if (!_ext_rpi_start_async()) {
+
+				throw new ApplicationException("Unable to start rpi camera pipeline.");
+
+			}
 		
 		}
 